@@ -0,0 +1,66 @@
+#pragma once
+
+#include "types.h"
+
+#include <chrono>
+#include <cstdio>
+
+// minimal self-registering benchmark harness, mirrors tests/test.h
+
+using BenchFunc = void ( * )();
+
+struct BenchCase {
+    const char* m_name;
+    BenchFunc   m_func;
+    BenchCase*  m_next;
+};
+
+BenchCase*& BenchRegistry();
+
+struct BenchRegistrar {
+    BenchRegistrar( BenchCase* bench ) {
+        bench->m_next = BenchRegistry();
+        BenchRegistry() = bench;
+    }
+};
+
+#define BENCHMARK( name )                                                   \
+    static void name();                                                     \
+    static BenchCase name##_case = { #name, &name, nullptr };               \
+    static BenchRegistrar name##_registrar( &name##_case );                 \
+    static void name()
+
+struct BenchTiming {
+    f64 m_minMs = 0.0;
+    f64 m_meanMs = 0.0;
+};
+
+// runs fn once to warm up, then repetitions times, and reports per-call times
+template< typename Func >
+BenchTiming MeasureMs( u32 repetitions, Func&& fn ) {
+    using Clock = std::chrono::steady_clock;
+    fn();
+
+    BenchTiming timing;
+    f64 total = 0.0;
+    for ( u32 i = 0; i < repetitions; ++i ) {
+        auto start = Clock::now();
+        fn();
+        f64 ms = std::chrono::duration< f64, std::milli >( Clock::now() - start ).count();
+        timing.m_minMs = i == 0 ? ms : ( ms < timing.m_minMs ? ms : timing.m_minMs );
+        total += ms;
+    }
+    timing.m_meanMs = repetitions ? total / repetitions : 0.0;
+    return timing;
+}
+
+// keeps the optimizer from dropping work whose result is otherwise unused
+template< typename T >
+inline void DoNotOptimize( const T& value ) {
+#if defined( _MSC_VER )
+    static volatile const void* sink;
+    sink = &value;
+#else
+    asm volatile( "" : : "r,m"( value ) : "memory" );
+#endif
+}
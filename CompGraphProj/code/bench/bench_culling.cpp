@@ -0,0 +1,174 @@
+#include "bench.h"
+
+#include "bvh.h"
+#include "frustum_culling.h"
+#include "job_system.h"
+#include "occlusion_culling.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+// 1M objects scattered through a block the camera sees about half of:
+// the scalar tests, then the SIMD kernel by thread count, in objects per ns
+BENCHMARK( FrustumCulling ) {
+    const u32 count = 1 << 20;
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution< f32 > position( -500.0f, 500.0f ), size( 0.1f, 2.0f );
+    CullingBounds bounds;
+    bounds.Resize( count );
+    for ( u32 i = 0; i < count; ++i ) {
+        const Float3 extent( size( rng ), size( rng ), size( rng ) );
+        bounds.Set( i, Float3( position( rng ), position( rng ), position( rng ) ), extent, std::sqrt( Vector3Dot( extent, extent ) ) );
+    }
+    const Frustum frustum = MakeFrustum( MatrixMultiply(
+        MatrixLookAtLH( Float3( 0.0f, 0.0f, -500.0f ), Float3( 0.0f, 0.0f, 0.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+        MatrixPerspectiveFovLH( 1.0f, 16.0f / 9.0f, 0.1f, 1000.0f ) ) );
+
+    u32 visible = 0;
+    BenchTiming t = MeasureMs( 10, [ & ] {
+        visible = 0;
+        for ( u32 i = 0; i < count; ++i ) {
+            const Float3 center( bounds.m_centerX[ i ], bounds.m_centerY[ i ], bounds.m_centerZ[ i ] );
+            const Float3 extent( bounds.m_extentX[ i ], bounds.m_extentY[ i ], bounds.m_extentZ[ i ] );
+            visible += IsBoxOutside( frustum, center, extent ) ? 0 : 1;
+        }
+        DoNotOptimize( visible );
+    } );
+    printf( "  %u objects, %u visible\n", count, visible );
+    printf( "  scalar boxes: %.3f ms, %.2f objects/ns\n", t.m_minMs, count / ( t.m_minMs * 1e6 ) );
+
+    FrustumCuller culler;
+    for ( FrustumTest test : { FRUSTUM_TEST_SPHERES, FRUSTUM_TEST_BOXES } ) {
+        t = MeasureMs( 20, [ & ] { culler.Cull( bounds, frustum, test ); } );
+        printf( "  simd (%u lanes) %s: %.3f ms, %.2f objects/ns\n", ( u32 )SIMD_WIDTH, test == FRUSTUM_TEST_BOXES ? "boxes" : "spheres",
+                t.m_minMs, count / ( t.m_minMs * 1e6 ) );
+    }
+
+    const u32 maxThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    for ( u32 threads = 1; threads <= maxThreads; threads *= 2 ) {
+        JobSystem jobs( threads );
+        t = MeasureMs( 20, [ & ] { culler.Cull( bounds, frustum, FRUSTUM_TEST_BOXES, &jobs ); } );
+        printf( "  boxes, %2u threads: %.3f ms, %.2f objects/ns\n", threads, t.m_minMs, count / ( t.m_minMs * 1e6 ) );
+    }
+}
+
+// the same 1M objects as boxes in a BVH: the build by thread count, a refit
+// after every object moved, the frustum query against the flat SIMD pass,
+// and rays into the block
+BENCHMARK( BvhQueries ) {
+    const u32 count = 1 << 20;
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution< f32 > position( -500.0f, 500.0f ), size( 0.1f, 2.0f );
+    std::vector< Aabb > boxes( count );
+    CullingBounds bounds;
+    bounds.Resize( count );
+    for ( u32 i = 0; i < count; ++i ) {
+        const Float3 c( position( rng ), position( rng ), position( rng ) );
+        const Float3 e( size( rng ), size( rng ), size( rng ) );
+        boxes[ i ] = { Float3( c.x - e.x, c.y - e.y, c.z - e.z ), Float3( c.x + e.x, c.y + e.y, c.z + e.z ) };
+        bounds.Set( i, c, e, std::sqrt( Vector3Dot( e, e ) ) );
+    }
+    const Frustum frustum = MakeFrustum( MatrixMultiply(
+        MatrixLookAtLH( Float3( 0.0f, 0.0f, -500.0f ), Float3( 0.0f, 0.0f, 0.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+        MatrixPerspectiveFovLH( 1.0f, 16.0f / 9.0f, 0.1f, 1000.0f ) ) );
+
+    Bvh bvh;
+    const u32 maxThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    for ( u32 threads = 1; threads <= maxThreads; threads *= 2 ) {
+        JobSystem jobs( threads );
+        const BenchTiming t = MeasureMs( 3, [ & ] { bvh.Build( boxes.data(), count, threads > 1 ? &jobs : nullptr ); } );
+        printf( "  build, %2u threads: %.1f ms\n", threads, t.m_minMs );
+    }
+    printf( "  %zu nodes, SAH cost %.1f\n", bvh.GetNodes().size(), bvh.GetCost() );
+
+    for ( Aabb& box : boxes ) {
+        box.m_min.y += 1.0f;
+        box.m_max.y += 1.0f;
+    }
+    BenchTiming t = MeasureMs( 5, [ & ] { bvh.Refit( boxes.data() ); } );
+    printf( "  refit: %.2f ms, SAH cost %.1f\n", t.m_minMs, bvh.GetCost() );
+
+    std::vector< u32 > visible;
+    visible.reserve( count );
+    t = MeasureMs( 10, [ & ] {
+        visible.clear();
+        bvh.CullFrustum( frustum, visible );
+    } );
+    FrustumCuller culler;
+    const BenchTiming flat = MeasureMs( 10, [ & ] { culler.Cull( bounds, frustum ); } );
+    printf( "  frustum: %.3f ms for %zu visible, flat simd %.3f ms\n", t.m_minMs, visible.size(), flat.m_minMs );
+
+    const u32 rays = 100000;
+    std::vector< Float3 > targets( rays );
+    for ( Float3& target : targets )
+        target = Float3( position( rng ), position( rng ), position( rng ) );
+    u32 hits = 0;
+    t = MeasureMs( 3, [ & ] {
+        hits = 0;
+        for ( const Float3& target : targets ) {
+            BvhRayHit hit;
+            hits += bvh.Raycast( Float3( 0.0f, 0.0f, -600.0f ), Float3( target.x, target.y, target.z + 600.0f ), hit ) ? 1 : 0;
+        }
+        DoNotOptimize( hits );
+    } );
+    printf( "  raycast: %.0f rays/ms, %u of %u hit\n", rays / t.m_minMs, hits, rays );
+}
+
+// 256 walls facing a camera that looks over 256k boxes behind them: the
+// occluder rasterization and the pyramid test by thread count, then the
+// scalar test of the same rectangles
+BENCHMARK( HiZOcclusion ) {
+    const u32 count = 1 << 18, walls = 256;
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution< f32 > position( -150.0f, 150.0f ), depth( 30.0f, 300.0f ), size( 0.2f, 2.0f );
+    std::uniform_real_distribution< f32 > wallPosition( -25.0f, 25.0f ), wallDepth( 10.0f, 30.0f ), wallSize( 1.0f, 4.0f );
+    CullingBounds bounds;
+    bounds.Resize( count );
+    for ( u32 i = 0; i < count; ++i )
+        bounds.Set( i, Float3( position( rng ), position( rng ) * 0.5f, depth( rng ) ), Float3( size( rng ), size( rng ), size( rng ) ), 0.0f );
+    const Matrix clip = MatrixMultiply( MatrixLookAtLH( Float3( 0.0f, 0.0f, 0.0f ), Float3( 0.0f, 0.0f, 1.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+                                        MatrixPerspectiveFovLH( 1.0f, 2.0f, 0.5f, 1000.0f ) );
+
+    // a unit square, clockwise from the camera
+    static const Float3 square[] = { Float3( -1.0f, 1.0f, 0.0f ), Float3( 1.0f, 1.0f, 0.0f ), Float3( 1.0f, -1.0f, 0.0f ), Float3( -1.0f, -1.0f, 0.0f ) };
+    static const u32 squareIndices[] = { 0, 1, 2, 0, 2, 3 };
+    std::vector< Matrix > models( walls );
+    for ( Matrix& model : models )
+        model = MatrixMultiply( MatrixScaling( wallSize( rng ) * 2.0f, wallSize( rng ), 1.0f ), MatrixTranslation( wallPosition( rng ), wallPosition( rng ) * 0.5f, wallDepth( rng ) ) );
+
+    HiZBuffer hiz;
+    std::vector< u32 > objects( count );
+    u32 kept = 0;
+    const u32 maxThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    for ( u32 threads = 1; threads <= maxThreads; threads *= 2 ) {
+        JobSystem jobs( threads );
+        JobSystem* pool = threads > 1 ? &jobs : nullptr;
+        const BenchTiming raster = MeasureMs( 20, [ & ] {
+            hiz.Begin( clip );
+            for ( const Matrix& model : models )
+                hiz.AddOccluder( square, sizeof( Float3 ), squareIndices, 6, model );
+            hiz.Finish( pool );
+        } );
+        const BenchTiming cull = MeasureMs( 10, [ & ] {
+            for ( u32 i = 0; i < count; ++i )
+                objects[ i ] = i;
+            kept = hiz.Cull( bounds, objects.data(), count, pool );
+        } );
+        printf( "  %2u threads: rasterize %.3f ms, cull %.3f ms, %.1f objects/us\n", threads, raster.m_minMs, cull.m_minMs, count / ( cull.m_minMs * 1e3 ) );
+    }
+    printf( "  %u occluder triangles, %u of %u objects kept\n", hiz.GetOccluderTriangleCount(), kept, count );
+
+    u32 scalarKept = 0;
+    const BenchTiming t = MeasureMs( 3, [ & ] {
+        scalarKept = 0;
+        for ( u32 i = 0; i < count; ++i ) {
+            const Float3 center( bounds.m_centerX[ i ], bounds.m_centerY[ i ], bounds.m_centerZ[ i ] );
+            const Float3 extent( bounds.m_extentX[ i ], bounds.m_extentY[ i ], bounds.m_extentZ[ i ] );
+            scalarKept += IsBoxOccluded( hiz, clip, center, extent ) ? 0 : 1;
+        }
+        DoNotOptimize( scalarKept );
+    } );
+    printf( "  scalar bounds: %.3f ms, %u kept\n", t.m_minMs, scalarKept );
+}
@@ -0,0 +1,44 @@
+#include "bench.h"
+
+#include "entity_store.h"
+#include "job_system.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// 1M cubes as entities: the rotate system by thread count against the same
+// update over an array of structs, then the instance write of a frame
+BENCHMARK( EntityRotate ) {
+    const u32 count = 1 << 20;
+    CubeFieldScene scene;
+    BenchTiming t = MeasureMs( 1, [ & ] { GenerateCubeField( scene, count, 16.0f / 9.0f ); } );
+    printf( "  %u entities, %u per chunk, generated in %.1f ms\n", count, EntityStore::GetChunkCapacity( CUBE_FIELD_COMPONENTS ), t.m_minMs );
+
+    std::vector< CubeInstance > cubes( count );
+    for ( u32 i = 0; i < count; ++i )
+        cubes[ i ] = GetCube( scene, i );
+    t = MeasureMs( 20, [ & ] {
+        for ( CubeInstance& cube : cubes ) {
+            cube.m_prevAngle = cube.m_angle;
+            cube.m_angle += cube.m_angularSpeed * SIMULATION_STEP;
+            if ( cube.m_angle >= MATH_2PI ) {
+                cube.m_angle -= MATH_2PI;
+                cube.m_prevAngle -= MATH_2PI;
+            }
+        }
+        DoNotOptimize( cubes[ 0 ].m_angle );
+    } );
+    printf( "  array of structs: %.3f ms, %.2f entities/ns\n", t.m_minMs, count / ( t.m_minMs * 1e6 ) );
+
+    const u32 maxThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    for ( u32 threads = 1; threads <= maxThreads; threads *= 2 ) {
+        JobSystem jobs( threads );
+        JobSystem* pool = threads > 1 ? &jobs : nullptr;
+        const BenchTiming rotate = MeasureMs( 20, [ & ] { RotateSystem( scene.m_entities, SIMULATION_STEP, pool ); } );
+        const BenchTiming write = MeasureMs( 5, [ & ] { GetCubeFieldConstants( scene, 0.5f, pool ); } );
+        printf( "  %2u threads: rotate %.3f ms, %.2f entities/ns; instances %.1f ms\n", threads, rotate.m_minMs, count / ( rotate.m_minMs * 1e6 ),
+                write.m_minMs );
+    }
+}
@@ -0,0 +1,50 @@
+#include "bench.h"
+
+#include "job_system.h"
+
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+// cost of one empty job: submit, pop or steal, run, counter decrement
+BENCHMARK( JobOverhead ) {
+    const u32 jobCount = 100000;
+    for ( u32 threads : { 1u, 2u, 4u, 8u } ) {
+        JobSystem jobs( threads );
+        std::vector< JobDecl > decls( 512 );
+        for ( JobDecl& decl : decls )
+            decl.m_function = []( void*, u32, u32 ) {};
+
+        BenchTiming t = MeasureMs( 10, [ & ] {
+            JobCounter counter;
+            for ( u32 submitted = 0; submitted < jobCount; submitted += ( u32 )decls.size() ) {
+                jobs.Run( decls.data(), ( u32 )decls.size(), &counter );
+                jobs.Wait( counter );
+            }
+        } );
+        printf( "  %2u threads: %.1f ns/job\n", threads, t.m_minMs * 1e6 / jobCount );
+    }
+}
+
+// fixed compute-bound ParallelFor, 1 to 64 workers. beyond the hardware
+// thread count the workers oversubscribe the cores.
+BENCHMARK( JobScaling ) {
+    const u32 count = 1 << 16;
+    std::vector< f32 > values( count );
+    f64 baseline = 0.0;
+    for ( u32 threads = 1; threads <= 64; threads *= 2 ) {
+        JobSystem jobs( threads );
+        BenchTiming t = MeasureMs( 10, [ & ] {
+            jobs.ParallelFor( count, [ & ]( u32 i ) {
+                f32 x = ( f32 )i;
+                for ( u32 k = 0; k < 64; ++k )
+                    x = std::sqrt( x * 1.0001f + 1.0f );
+                values[ i ] = x;
+            } );
+        } );
+        DoNotOptimize( values[ count / 2 ] );
+        if ( threads == 1 )
+            baseline = t.m_minMs;
+        printf( "  %2u threads: %.3f ms (%.2fx)\n", threads, t.m_minMs, baseline / t.m_minMs );
+    }
+}
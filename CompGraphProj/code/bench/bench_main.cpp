@@ -0,0 +1,27 @@
+#include "bench.h"
+
+#include <cstring>
+#include <vector>
+
+//
+BenchCase*& BenchRegistry() {
+    static BenchCase* head = nullptr;
+    return head;
+}
+
+// runs every benchmark whose name contains argv[1], or all of them
+int main( int argc, char** argv ) {
+    const char* filter = argc > 1 ? argv[ 1 ] : nullptr;
+
+    std::vector< BenchCase* > benches;
+    for ( BenchCase* bench = BenchRegistry(); bench != nullptr; bench = bench->m_next )
+        benches.insert( benches.begin(), bench );
+
+    for ( BenchCase* bench : benches ) {
+        if ( filter != nullptr && strstr( bench->m_name, filter ) == nullptr )
+            continue;
+        printf( "[%s]\n", bench->m_name );
+        bench->m_func();
+    }
+    return 0;
+}
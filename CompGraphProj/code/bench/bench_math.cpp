@@ -0,0 +1,107 @@
+#include "bench.h"
+
+#include "simd_math.h"
+
+#include <random>
+#include <vector>
+
+#if defined( __has_include )
+#if __has_include( <DirectXMath.h> )
+#include <DirectXMath.h>
+#define BENCH_DIRECTXMATH 1
+#endif
+#endif
+
+// 16k points and 4k matrices through one matrix, small enough to stay in
+// cache, 64 passes per timing: the scalar functions of vecmath.h, the
+// simd_math.h streams and, where its header is found, DirectXMath's streams
+// and XMMatrixMultiply
+BENCHMARK( MathStreams ) {
+    const u32 pointCount = 1 << 14, matrixCount = 1 << 12, passes = 64;
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution< f32 > unit( -1.0f, 1.0f );
+    std::vector< Float3 > points( pointCount );
+    for ( Float3& p : points )
+        p = Float3( unit( rng ) * 10.0f, unit( rng ) * 10.0f, unit( rng ) * 10.0f );
+    std::vector< Matrix > matrices( matrixCount );
+    for ( Matrix& m : matrices )
+        m = MatrixMultiply( MatrixRotationAxis( Float3( unit( rng ), unit( rng ), 1.0f ), unit( rng ) ), MatrixTranslation( unit( rng ), unit( rng ), unit( rng ) ) );
+    const Matrix viewProjection = MatrixMultiply( MatrixLookAtLH( Float3( 0.0f, 5.0f, -20.0f ), Float3( 0.0f, 0.0f, 0.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+                                                  MatrixPerspectiveFovLH( 1.0f, 16.0f / 9.0f, 0.1f, 100.0f ) );
+    std::vector< Float4 > transformed( pointCount );
+    std::vector< Float3 > coords( pointCount );
+    std::vector< Matrix > products( matrixCount );
+
+    const auto report = [ & ]( const char* name, BenchTiming t, u32 count ) {
+        printf( "  %-30s %7.3f ms, %.2f per ns\n", name, t.m_minMs, ( f64 )count * passes / ( t.m_minMs * 1e6 ) );
+    };
+
+    report( "scalar points", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            for ( u32 i = 0; i < pointCount; ++i )
+                transformed[ i ] = TransformPoint( points[ i ], viewProjection );
+            DoNotOptimize( transformed[ 0 ] );
+        }
+    } ), pointCount );
+    report( "Vec3TransformStream", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            Vec3TransformStream( transformed.data(), points.data(), pointCount, viewProjection );
+            DoNotOptimize( transformed[ 0 ] );
+        }
+    } ), pointCount );
+    report( "scalar coords", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            for ( u32 i = 0; i < pointCount; ++i ) {
+                const Float4 h = TransformPoint( points[ i ], viewProjection );
+                coords[ i ] = Float3( h.x / h.w, h.y / h.w, h.z / h.w );
+            }
+            DoNotOptimize( coords[ 0 ] );
+        }
+    } ), pointCount );
+    report( "Vec3TransformCoordStream", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            Vec3TransformCoordStream( coords.data(), points.data(), pointCount, viewProjection );
+            DoNotOptimize( coords[ 0 ] );
+        }
+    } ), pointCount );
+    report( "scalar MatrixMultiply", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            for ( u32 i = 0; i < matrixCount; ++i )
+                products[ i ] = MatrixMultiply( matrices[ i ], viewProjection );
+            DoNotOptimize( products[ 0 ] );
+        }
+    } ), matrixCount );
+    report( "Mat4MultiplyStream", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            Mat4MultiplyStream( products.data(), matrices.data(), matrixCount, viewProjection );
+            DoNotOptimize( products[ 0 ] );
+        }
+    } ), matrixCount );
+
+#if defined( BENCH_DIRECTXMATH )
+    using namespace DirectX;
+    static_assert( sizeof( XMFLOAT3 ) == sizeof( Float3 ) && sizeof( XMFLOAT4 ) == sizeof( Float4 ) && sizeof( XMFLOAT4X4 ) == sizeof( Matrix ), "same layouts" );
+    const XMMATRIX xm = XMLoadFloat4x4( ( const XMFLOAT4X4* )&viewProjection );
+    report( "XMVector3TransformStream", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            XMVector3TransformStream( ( XMFLOAT4* )transformed.data(), sizeof( Float4 ), ( const XMFLOAT3* )points.data(), sizeof( Float3 ), pointCount, xm );
+            DoNotOptimize( transformed[ 0 ] );
+        }
+    } ), pointCount );
+    report( "XMVector3TransformCoordStream", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            XMVector3TransformCoordStream( ( XMFLOAT3* )coords.data(), sizeof( Float3 ), ( const XMFLOAT3* )points.data(), sizeof( Float3 ), pointCount, xm );
+            DoNotOptimize( coords[ 0 ] );
+        }
+    } ), pointCount );
+    report( "XMMatrixMultiply", MeasureMs( 10, [ & ] {
+        for ( u32 pass = 0; pass < passes; ++pass ) {
+            for ( u32 i = 0; i < matrixCount; ++i )
+                XMStoreFloat4x4( ( XMFLOAT4X4* )&products[ i ], XMMatrixMultiply( XMLoadFloat4x4( ( const XMFLOAT4X4* )&matrices[ i ] ), xm ) );
+            DoNotOptimize( products[ 0 ] );
+        }
+    } ), matrixCount );
+#else
+    printf( "  DirectXMath.h not found, skipped\n" );
+#endif
+}
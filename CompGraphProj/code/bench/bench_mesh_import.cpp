@@ -0,0 +1,94 @@
+#include "bench.h"
+
+#include "frame_timing.h"
+#include "job_system.h"
+#include "mesh_import.h"
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+
+static const char* const BenchObjPath = "compgraph_bench_mesh.obj";
+
+// a 4M triangle sphere as OBJ with normals: parse time by thread count, then
+// the first LoadMesh (import and cache write) against the mapped cache
+BENCHMARK( MeshImport ) {
+    MeshData sphere;
+    GenerateSphereMesh( sphere, 1024, 2048 );
+    FILE* file = fopen( BenchObjPath, "wb" );
+    if ( file == nullptr )
+        return;
+    for ( const Vertex& v : sphere.m_vertices )
+        fprintf( file, "v %.6f %.6f %.6f\n", v.m_pos.x, v.m_pos.y, -v.m_pos.z );
+    for ( const Vertex& v : sphere.m_vertices )
+        fprintf( file, "vn %.4f %.4f %.4f\n", v.m_pos.x, v.m_pos.y, -v.m_pos.z );
+    for ( size_t i = 0; i < sphere.m_indices.size(); i += 3 ) {
+        const u32 a = sphere.m_indices[ i ] + 1, b = sphere.m_indices[ i + 1 ] + 1, c = sphere.m_indices[ i + 2 ] + 1;
+        fprintf( file, "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c );
+    }
+    fclose( file );
+
+    MappedFile text;
+    if ( !text.Open( BenchObjPath ) )
+        return;
+    printf( "  %u triangles, %.1f MB of OBJ\n", ( u32 )( sphere.m_indices.size() / 3 ), text.GetSize() / ( 1024.0 * 1024.0 ) );
+    const u32 maxThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    for ( u32 threads = 1; threads <= maxThreads; threads *= 2 ) {
+        JobSystem jobs( threads );
+        MeshData mesh;
+        BenchTiming t = MeasureMs( 3, [ & ] {
+            ImportObj( ( const char* )text.GetData(), text.GetSize(), mesh, &jobs );
+        } );
+        printf( "  parse, %2u threads: %.1f ms (min %.1f)\n", threads, t.m_meanMs, t.m_minMs );
+    }
+    text.Close();
+
+    const std::string cachePath = std::string( BenchObjPath ) + MESH_CACHE_EXTENSION;
+    remove( cachePath.c_str() );
+    JobSystem jobs( maxThreads );
+    const FrameClock::time_point start = FrameClock::now();
+    LoadedMesh imported;
+    LoadMesh( BenchObjPath, imported, &jobs );
+    printf( "  first load: %.1f ms\n", SecondsBetween( start, FrameClock::now() ) * 1000.0 );
+    BenchTiming t = MeasureMs( 5, [ & ] {
+        LoadedMesh cached;
+        LoadMesh( BenchObjPath, cached, &jobs );
+        // touch every page, the mapping alone reads nothing
+        u32 sum = 0;
+        const u8* bytes = ( const u8* )cached.GetMesh().m_vertices;
+        const size_t size = cached.GetMesh().m_vertexCount * sizeof( Vertex ) + cached.GetMesh().m_indexCount * sizeof( u32 );
+        for ( size_t i = 0; i < size; i += 4096 )
+            sum += bytes[ i ];
+        DoNotOptimize( sum );
+    } );
+    printf( "  cached load: %.1f ms (min %.1f)\n", t.m_meanMs, t.m_minMs );
+    remove( BenchObjPath );
+    remove( cachePath.c_str() );
+}
+
+// a 1M triangle sphere in random triangle order, as arbitrary exporters leave it
+BENCHMARK( MeshOptimize ) {
+    MeshData source;
+    GenerateSphereMesh( source, 512, 1024 );
+    std::vector< u32 > order( source.m_indices.size() / 3 );
+    for ( u32 i = 0; i < ( u32 )order.size(); ++i )
+        order[ i ] = i;
+    std::mt19937 rng( 1 );
+    std::shuffle( order.begin(), order.end(), rng );
+    std::vector< u32 > shuffled;
+    shuffled.reserve( source.m_indices.size() );
+    for ( u32 t : order )
+        shuffled.insert( shuffled.end(), source.m_indices.begin() + t * 3, source.m_indices.begin() + t * 3 + 3 );
+    source.m_indices.swap( shuffled );
+
+    MeshOptimizeStats stats;
+    BenchTiming t = MeasureMs( 3, [ & ] {
+        MeshData mesh = source;
+        stats = OptimizeMesh( mesh );
+    } );
+    printf( "  %u triangles: %.1f ms (min %.1f)\n", ( u32 )order.size(), t.m_meanMs, t.m_minMs );
+    printf( "  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", stats.m_before.m_acmr, stats.m_after.m_acmr, stats.m_before.m_atvr, stats.m_after.m_atvr );
+}
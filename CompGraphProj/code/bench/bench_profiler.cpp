@@ -0,0 +1,20 @@
+#include "bench.h"
+
+#include "profiler.h"
+
+// cost of one closed zone: two timestamps and a ring store
+BENCHMARK( ProfilerZone ) {
+    const u32 zones = 1 << 20;
+    BenchTiming t = MeasureMs( 10, [ & ] {
+        for ( u32 i = 0; i < zones; ++i ) {
+            PROFILE_ZONE( "BenchZone" );
+            DoNotOptimize( i );
+        }
+    } );
+    BenchTiming timestamp = MeasureMs( 10, [ & ] {
+        for ( u32 i = 0; i < zones; ++i )
+            DoNotOptimize( ProfilerTimestamp() );
+    } );
+    printf( "  zone:      %.1f ns\n", t.m_minMs * 1e6 / zones );
+    printf( "  timestamp: %.1f ns\n", timestamp.m_minMs * 1e6 / zones );
+}
@@ -0,0 +1,144 @@
+#include "bench.h"
+
+#include "backend_software.h"
+#include "mesh_optimize.h"
+#include "meshlet.h"
+#include "simd.h"
+#include "vertex_stage.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+//
+BENCHMARK( SoftwareCubeFrame ) {
+    const u32 maxThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    for ( u32 threads = 1; threads <= maxThreads; threads *= 2 ) {
+        SoftwareBackend backend;
+        BackendDesc desc;
+        desc.m_width = 1366;
+        desc.m_height = 768;
+        desc.m_threadCount = threads;
+        backend.Initialize( desc );
+        backend.CreateObject( GetCubeMesh() );
+
+        Scene scene;
+        BenchTiming t = MeasureMs( 200, [ & ] {
+            backend.UpdateConstants( Rotate( scene ) );
+            backend.RenderScene();
+        } );
+        printf( "  %2u threads: %.3f ms/frame (min %.3f)\n", threads, t.m_meanMs, t.m_minMs );
+        backend.Release();
+    }
+}
+
+// instanced frame cost as the cube count grows, all cores
+BENCHMARK( SoftwareCubeField ) {
+    for ( u32 cubes = 1000; cubes <= 100000; cubes *= 10 ) {
+        SoftwareBackend backend;
+        BackendDesc desc;
+        desc.m_width = 1366;
+        desc.m_height = 768;
+        backend.Initialize( desc );
+        backend.CreateObject( GetCubeMesh() );
+        backend.CreateInstanceBuffer( cubes );
+
+        CubeFieldScene scene;
+        GenerateCubeField( scene, cubes, 1366.0f / 768.0f );
+        BenchTiming t = MeasureMs( cubes >= 100000 ? 5 : 20, [ & ] {
+            backend.UpdateConstants( AnimateCubeField( scene ) );
+            backend.UpdateInstances( scene.m_instances.data(), cubes );
+            backend.RenderScene();
+        } );
+        printf( "  %6u cubes: %.3f ms/frame (min %.3f)\n", cubes, t.m_meanMs, t.m_minMs );
+        backend.Release();
+    }
+}
+
+//
+BENCHMARK( VertexStage ) {
+    const u32 count = 1 << 20;
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution< f32 > dist( -1.0f, 1.0f );
+    std::vector< Vertex > vertices( count );
+    for ( Vertex& v : vertices )
+        v.m_pos = Float3( dist( rng ), dist( rng ), dist( rng ) );
+
+    PositionStreams in;
+    in.Assign( vertices.data(), count );
+    ClipStreams out;
+    out.Resize( count );
+    const Matrix model = MatrixRotationAxis( Float3( 1, 1, 1 ), 0.5f );
+
+    BenchTiming simd = MeasureMs( 20, [ & ] { RunVertexStage( in, 0, count, model, out ); } );
+    BenchTiming scalar = MeasureMs( 20, [ & ] { RunVertexStageScalar( in, 0, count, model, out ); } );
+    printf( "  simd (%u lanes): %.3f ms, %.1f Mverts/s\n", ( u32 )SIMD_WIDTH, simd.m_minMs, count / simd.m_minMs / 1000.0 );
+    printf( "  scalar:          %.3f ms, %.1f Mverts/s\n", scalar.m_minMs, count / scalar.m_minMs / 1000.0 );
+}
+
+// the vertex stage over the same 1M positions stored as float32, half and
+// snorm16: bytes fetched per vertex against decode cost
+BENCHMARK( QuantizedVertexStage ) {
+    const u32 count = 1 << 20;
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution< f32 > dist( -1.0f, 1.0f );
+    std::vector< Vertex > vertices( count );
+    for ( Vertex& v : vertices )
+        v.m_pos = Float3( dist( rng ), dist( rng ), dist( rng ) );
+    const u32 indices[ 3 ] = {};
+    const Mesh mesh = { vertices.data(), count, indices, 3 };
+
+    ClipStreams out;
+    out.Resize( count );
+    const Matrix model = MatrixRotationAxis( Float3( 1, 1, 1 ), 0.5f );
+    for ( u32 e = 0; e < POSITION_ENCODING_COUNT; ++e ) {
+        QuantizeDesc desc;
+        desc.m_position = ( PositionEncoding )e;
+        QuantizedMesh quantized;
+        QuantizeMesh( mesh, desc, quantized );
+        PositionStreams in;
+        in.Assign( quantized );
+
+        const u32 bytes = desc.m_position == POSITION_FLOAT32 ? 12 : 6;
+        BenchTiming t = MeasureMs( 20, [ & ] { RunVertexStage( in, 0, count, model, out ); } );
+        printf( "  %-8s %2u bytes/vertex: %.3f ms, %.1f Mverts/s\n", GetPositionEncodingName( desc.m_position ), bytes, t.m_minMs, count / t.m_minMs / 1000.0 );
+    }
+}
+
+// the 1M triangle sphere after OptimizeMesh: meshlet build, the culling pass
+// alone, and whole software frames with and without it
+BENCHMARK( ClusterCulling ) {
+    MeshData sphere;
+    GenerateSphereMesh( sphere, 512, 1024 );
+    OptimizeMesh( sphere );
+    MeshletMesh meshlets;
+    BenchTiming build = MeasureMs( 3, [ & ] { BuildMeshlets( sphere.GetMesh(), meshlets ); } );
+    printf( "  build: %u meshlets in %.1f ms\n", ( u32 )meshlets.m_meshlets.size(), build.m_minMs );
+
+    Scene scene;
+    const ClusterCullView view = MakeClusterCullView( GetObjectClipTransform( MatrixTranspose( Rotate( scene ).m_modelMatrix ) ) );
+    JobSystem jobs( 0 );
+    ClusterCuller culler;
+    BenchTiming cull = MeasureMs( 50, [ & ] { DoNotOptimize( culler.Cull( meshlets, sphere.m_indices.data(), view, &jobs ) ); } );
+    const ClusterCullStats& stats = culler.GetStats();
+    printf( "  cull: %.3f ms, %u of %u triangles left (%u backface, %u frustum meshlets)\n", cull.m_minMs, stats.m_visibleTriangles,
+        stats.m_triangles, stats.m_backfaceCulled, stats.m_frustumCulled );
+
+    for ( u32 culling = 0; culling < 2; ++culling ) {
+        SoftwareBackend backend;
+        BackendDesc desc;
+        desc.m_width = 1366;
+        desc.m_height = 768;
+        desc.m_jobs = &jobs;
+        desc.m_clusterCulling = culling == 1;
+        backend.Initialize( desc );
+        backend.CreateObject( sphere.GetMesh() );
+        BenchTiming t = MeasureMs( 10, [ & ] {
+            backend.UpdateConstants( Rotate( scene ) );
+            backend.RenderScene();
+        } );
+        printf( "  frame, %s: %.3f ms (min %.3f)\n", culling ? "culled" : "all   ", t.m_meanMs, t.m_minMs );
+        backend.Release();
+    }
+}
@@ -0,0 +1,70 @@
+#include "bench.h"
+
+#include "job_system.h"
+#include "transform_hierarchy.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+// 500k nodes in 4000 trees of 125: a scalar recompute of every world
+// matrix, then by thread count a frame with 1% of the nodes animated, one
+// where every root moved and one where nothing did
+BENCHMARK( TransformPropagation ) {
+    const u32 trees = 4000, nodesPerTree = 125;
+    TransformHierarchy hierarchy;
+    BenchTiming t = MeasureMs( 1, [ & ] {
+        std::mt19937 rng( 1 );
+        std::uniform_real_distribution< f32 > offset( -1.0f, 1.0f );
+        hierarchy.Clear();
+        for ( u32 tree = 0; tree < trees; ++tree ) {
+            const u32 root = hierarchy.AddNode( TRANSFORM_ROOT, MatrixTranslation( offset( rng ) * 100.0f, 0.0f, offset( rng ) * 100.0f ) );
+            for ( u32 i = 1; i < nodesPerTree; ++i )
+                hierarchy.AddNode( root + ( u32 )( rng() % i ), MatrixTranslation( offset( rng ), offset( rng ), offset( rng ) ) );
+        }
+        hierarchy.Update();
+    } );
+    const u32 count = hierarchy.GetNodeCount();
+    printf( "  %u nodes, built and first update in %.1f ms\n", count, t.m_minMs );
+
+    std::vector< Matrix > world( count );
+    t = MeasureMs( 10, [ & ] {
+        for ( u32 node = 0; node < count; ++node ) {
+            const u32 parent = hierarchy.GetParent( node );
+            world[ node ] = parent != TRANSFORM_ROOT ? MatrixMultiply( hierarchy.GetLocal( node ), world[ parent ] ) : hierarchy.GetLocal( node );
+        }
+        DoNotOptimize( world[ count - 1 ] );
+    } );
+    printf( "  scalar recompute of every node: %.3f ms\n", t.m_minMs );
+
+    std::mt19937 rng( 2 );
+    std::vector< u32 > animated( count / 100 );
+    std::vector< Matrix > locals( animated.size() );
+    for ( u32 i = 0; i < ( u32 )animated.size(); ++i ) {
+        animated[ i ] = ( u32 )( rng() % count );
+        locals[ i ] = hierarchy.GetLocal( animated[ i ] );
+    }
+    f32 angle = 0.0f;
+    u32 updated = 0;
+    const u32 maxThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    for ( u32 threads = 1; threads <= maxThreads; threads *= 2 ) {
+        JobSystem jobs( threads );
+        JobSystem* pool = threads > 1 ? &jobs : nullptr;
+        const BenchTiming frame = MeasureMs( 20, [ & ] {
+            angle += 0.01f;
+            const Matrix spin = MatrixRotationNormal( Float3( 0.0f, 1.0f, 0.0f ), angle );
+            for ( u32 i = 0; i < ( u32 )animated.size(); ++i )
+                hierarchy.SetLocal( animated[ i ], MatrixMultiply( spin, locals[ i ] ) );
+            updated = hierarchy.Update( pool );
+        } );
+        const BenchTiming roots = MeasureMs( 10, [ & ] {
+            for ( u32 root = 0; root < count; root += nodesPerTree )
+                hierarchy.SetLocal( root, hierarchy.GetLocal( root ) );
+            hierarchy.Update( pool );
+        } );
+        const BenchTiming still = MeasureMs( 20, [ & ] { DoNotOptimize( hierarchy.Update( pool ) ); } );
+        printf( "  %2u threads: %u animated, %u updated in %.3f ms; every root %.3f ms; static frame %.4f ms\n", threads, ( u32 )animated.size(), updated,
+                frame.m_minMs, roots.m_minMs, still.m_minMs );
+    }
+}
@@ -0,0 +1,52 @@
+struct VS_OUTPUT {
+    float4 pos : SV_POSITION;
+    float4 color : COLOR0;
+};
+
+#ifdef PER_OBJECT
+// one DrawIndexed per object, constants sub-allocated from the upload ring
+cbuffer ObjectConstants : register(b0) {
+	matrix world;
+	matrix viewProjection;
+	float4 objectColor;
+}
+#else
+cbuffer ConstantBuffer : register(b0) {
+	matrix model;
+	matrix viewProjection;
+}
+#endif
+
+// positions of half / snorm16 meshes are stored in [-1,1] of the mesh bounds,
+// float meshes bind scale 1 and bias 0
+cbuffer MeshConstants : register(b1) {
+	float4 positionScale;
+	float4 positionBias;
+}
+
+// slot 0 is the shared cube, slot 1 steps once per instance
+struct VS_INPUT {
+	float4 pos : POSITION;
+	float4 color : COLOR;
+#ifndef PER_OBJECT
+	float4 world0 : WORLD0;
+	float4 world1 : WORLD1;
+	float4 world2 : WORLD2;
+	float4 world3 : WORLD3;
+	float4 instanceColor : INSTANCECOLOR;
+#endif
+};
+
+VS_OUTPUT main(VS_INPUT input) {
+	VS_OUTPUT output = (VS_OUTPUT)0;
+	float4 pos = input.pos * positionScale + positionBias;
+#ifdef PER_OBJECT
+	output.pos = mul(mul(pos, world), viewProjection);
+	output.color = input.color * objectColor;
+#else
+	float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+	output.pos = mul(mul(pos, world), viewProjection);
+	output.color = input.color * input.instanceColor;
+#endif
+	return output;
+}
\ No newline at end of file
@@ -7,9 +7,16 @@ cbuffer ConstantBuffer : register(b0) {
 	matrix model;
 }
 
+// positions of half / snorm16 meshes are stored in [-1,1] of the mesh bounds,
+// float meshes bind scale 1 and bias 0
+cbuffer MeshConstants : register(b1) {
+	float4 positionScale;
+	float4 positionBias;
+}
+
 VS_OUTPUT main(float4 pos : POSITION, float4 color : COLOR) {
 	VS_OUTPUT output = (VS_OUTPUT)0;
-	output.pos = mul(pos, model);
+	output.pos = mul(pos * positionScale + positionBias, model);
 	output.pos.x = output.pos.x / 1.6f;
 	output.color = color;
 	return output;
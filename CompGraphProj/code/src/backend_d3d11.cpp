@@ -0,0 +1,661 @@
+#include "backend_d3d11.h"
+
+#include "profiler.h"
+#include "shader_reflection_d3d11.h"
+#include "vertex_stage.h"
+
+#include <cstring>
+
+// room for 16k per-object constant blocks, each map covers as many as fit
+constexpr u32 CONSTANT_RING_SIZE = 4 * 1024 * 1024;
+
+// GPU passes of RenderScene, in the order they are closed
+enum GpuPass : u32 { GPU_PASS_CLEAR, GPU_PASS_DRAW, GPU_PASS_PRESENT, GPU_PASS_COUNT };
+static const char* const GpuPassNames[ GPU_PASS_COUNT ] = { "Clear", "Draw", "Present" };
+
+// cbuffer layout of InstancedVertexShader.hlsl compiled with PER_OBJECT
+struct ObjectConstants {
+    Matrix m_world;             // transposed for HLSL
+    Matrix m_viewProjection;    // transposed for HLSL
+    Float4 m_color;
+};
+
+constexpr CBufferField OBJECT_CONSTANTS_FIELDS[] = {
+    CBUFFER_FIELD( ObjectConstants, m_world, "world" ),
+    CBUFFER_FIELD( ObjectConstants, m_viewProjection, "viewProjection" ),
+    CBUFFER_FIELD( ObjectConstants, m_color, "objectColor" ),
+};
+static_assert( IsValidCBufferLayout( OBJECT_CONSTANTS_FIELDS, sizeof( ObjectConstants ) ), "OBJECT_CONSTANTS_FIELDS does not match ObjectConstants" );
+constexpr u32 OBJECT_CONSTANTS_STRIDE = ( sizeof( ObjectConstants ) + UPLOAD_ALIGNMENT - 1 ) & ~( UPLOAD_ALIGNMENT - 1 );
+
+//
+RenderBackend* CreateD3D11Backend() {
+    return new D3D11Backend();
+}
+
+//
+bool D3D11Backend::Initialize( const BackendDesc& desc ) {
+    m_perObjectDraws = desc.m_perObjectDraws;
+    m_clusterCulling = desc.m_clusterCulling;
+    m_jobs = desc.m_jobs;
+    m_present = desc.m_present;
+    // bytecode comes from the pack build_shader_pack writes next to the shaders
+    m_shaderCache.Open( "shaders.pack" );
+    return SUCCEEDED( InitializeD3D11( ( HWND )desc.m_windowHandle, desc.m_width, desc.m_height ) );
+}
+
+//
+bool D3D11Backend::CreateObject( const Mesh& mesh ) {
+    if ( m_clusterCulling )
+        BuildMeshlets( mesh, m_meshlets );
+    return SUCCEEDED( CreateObjectD3D11( mesh.m_vertices, mesh.m_vertexCount, VERTEX_STREAM, GetIdentityMeshConstants(), mesh.m_indices, mesh.m_indexCount ) );
+}
+
+//
+bool D3D11Backend::CreateQuantizedObject( const QuantizedMesh& mesh ) {
+    if ( m_clusterCulling )
+        BuildMeshlets( mesh, m_meshlets );
+    return SUCCEEDED( CreateObjectD3D11( mesh.m_vertices.data(), mesh.m_vertexCount, mesh.GetStream(), mesh.m_constants,
+                                         mesh.m_indices.data(), ( u32 )mesh.m_indices.size() ) );
+}
+
+//
+HRESULT D3D11Backend::InitializeD3D11( HWND hwnd, u32 width, u32 height ) {
+    u32 deviceFlags = 0;
+#ifdef _DEBUG
+    deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+    // create the device, the swap chain is made by the factory of its adapter
+    HRESULT result = D3D11CreateDevice(
+        nullptr,
+        D3D_DRIVER_TYPE_HARDWARE,
+        nullptr,
+        deviceFlags,
+        nullptr,
+        0,
+        D3D11_SDK_VERSION,
+        &m_device,
+        nullptr,
+        &m_context );
+    if ( FAILED( result ) )
+        return result;
+
+    // D3D11.1 context for constant buffer offsets, optional
+    m_context->QueryInterface( __uuidof( ID3D11DeviceContext1 ), ( void** )&m_context1 );
+
+    result = CreateSwapChain( hwnd, width, height );
+    if ( FAILED( result ) )
+        return result;
+
+    // GPU timing is optional, without queries the frame just goes unmeasured
+    if ( FAILED( m_gpuTimer.Initialize( m_device, GpuPassNames, GPU_PASS_COUNT ) ) )
+        m_gpuTimer.Release();
+
+    return CreateRenderTargets( width, height );
+}
+
+//
+HRESULT D3D11Backend::CreateSwapChain( HWND hwnd, u32 width, u32 height ) {
+    IDXGIDevice1* dxgiDevice = nullptr;
+    HRESULT result = m_device->QueryInterface( __uuidof( IDXGIDevice1 ), ( void** )&dxgiDevice );
+    if ( FAILED( result ) )
+        return result;
+
+    IDXGIAdapter* adapter = nullptr;
+    result = dxgiDevice->GetAdapter( &adapter );
+    if ( FAILED( result ) ) {
+        dxgiDevice->Release();
+        return result;
+    }
+
+    IDXGIFactory2* factory = nullptr;
+    result = adapter->GetParent( __uuidof( IDXGIFactory2 ), ( void** )&factory );
+    adapter->Release();
+    if ( FAILED( result ) ) {
+        dxgiDevice->Release();
+        return result;
+    }
+
+    // tearing needs Windows 10 and a driver that supports variable refresh
+    BOOL tearing = FALSE;
+    IDXGIFactory5* factory5 = nullptr;
+    if ( m_present.m_allowTearing && SUCCEEDED( factory->QueryInterface( __uuidof( IDXGIFactory5 ), ( void** )&factory5 ) ) ) {
+        if ( FAILED( factory5->CheckFeatureSupport( DXGI_FEATURE_PRESENT_ALLOW_TEARING, &tearing, sizeof( tearing ) ) ) )
+            tearing = FALSE;
+        factory5->Release();
+    }
+
+    // flip model: the compositor takes our buffers as they are instead of copying them
+    DXGI_SWAP_CHAIN_DESC1 swapChainDesc;
+    memset( &swapChainDesc, 0, sizeof( swapChainDesc ) );
+    swapChainDesc.Width = width;
+    swapChainDesc.Height = height;
+    swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    swapChainDesc.SampleDesc.Count = 1;
+    swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    swapChainDesc.BufferCount = m_present.m_bufferCount < 2 ? 2 : ( m_present.m_bufferCount > 3 ? 3 : m_present.m_bufferCount );
+    swapChainDesc.Scaling = DXGI_SCALING_STRETCH;
+    swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+    swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
+    swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    if ( tearing )
+        swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+
+    result = factory->CreateSwapChainForHwnd( m_device, hwnd, &swapChainDesc, nullptr, nullptr, &m_swapChain );
+    if ( FAILED( result ) ) {
+        // FLIP_DISCARD and tearing need Windows 10, the waitable object 8.1
+        swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+        swapChainDesc.Flags = 0;
+        result = factory->CreateSwapChainForHwnd( m_device, hwnd, &swapChainDesc, nullptr, nullptr, &m_swapChain );
+    }
+    if ( SUCCEEDED( result ) ) {
+        // SDL owns fullscreen switching
+        factory->MakeWindowAssociation( hwnd, DXGI_MWA_NO_ALT_ENTER );
+    }
+    factory->Release();
+    if ( FAILED( result ) ) {
+        dxgiDevice->Release();
+        return result;
+    }
+    m_swapChainFlags = swapChainDesc.Flags;
+    m_tearing = ( swapChainDesc.Flags & DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING ) != 0;
+
+    // bound how many frames the CPU may queue ahead of the display
+    const u32 latency = m_present.m_maxFrameLatency < 1 ? 1 : m_present.m_maxFrameLatency;
+    IDXGISwapChain2* swapChain2 = nullptr;
+    if ( ( m_swapChainFlags & DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT )
+         && SUCCEEDED( m_swapChain->QueryInterface( __uuidof( IDXGISwapChain2 ), ( void** )&swapChain2 ) ) ) {
+        swapChain2->SetMaximumFrameLatency( latency );
+        m_frameLatencyWaitable = swapChain2->GetFrameLatencyWaitableObject();
+        swapChain2->Release();
+    } else {
+        dxgiDevice->SetMaximumFrameLatency( latency );
+    }
+    dxgiDevice->Release();
+    return S_OK;
+}
+
+//
+HRESULT D3D11Backend::CreateRenderTargets( u32 width, u32 height ) {
+    // create our BackBuffer
+    ID3D11Texture2D* backBuffer = nullptr;
+    HRESULT result = m_swapChain->GetBuffer( 0, __uuidof( ID3D11Texture2D ), ( void** )&backBuffer );
+    if ( FAILED( result ) )
+        return result;
+
+    // create our Render Target
+    result = m_device->CreateRenderTargetView( backBuffer, nullptr, &m_renderTargetView );
+    backBuffer->Release();
+    if ( FAILED( result ) )
+        return result;
+
+    // depth buffer, tested with the default depth-stencil state (LESS, write all)
+    result = CreateDepthBuffer( width, height );
+    if ( FAILED( result ) )
+        return result;
+
+    m_viewport.Width = ( f32 )width;
+    m_viewport.Height = ( f32 )height;
+    m_viewport.MinDepth = 0.0f;
+    m_viewport.MaxDepth = 1.0f;
+    m_viewport.TopLeftX = 0;
+    m_viewport.TopLeftY = 0;
+    return S_OK;
+}
+
+//
+void D3D11Backend::ReleaseRenderTargets() {
+    if ( m_context )
+        m_context->OMSetRenderTargets( 0, nullptr, nullptr );
+    if ( m_depthStencilView ) {
+        m_depthStencilView->Release();
+        m_depthStencilView = nullptr;
+    }
+    if ( m_depthBuffer ) {
+        m_depthBuffer->Release();
+        m_depthBuffer = nullptr;
+    }
+    if ( m_renderTargetView ) {
+        m_renderTargetView->Release();
+        m_renderTargetView = nullptr;
+    }
+}
+
+//
+bool D3D11Backend::Resize( u32 width, u32 height ) {
+    if ( m_swapChain == nullptr || width == 0 || height == 0 )
+        return false;
+
+    // every reference to the old buffers has to go before ResizeBuffers
+    ReleaseRenderTargets();
+    m_context->Flush();
+    if ( FAILED( m_swapChain->ResizeBuffers( 0, width, height, DXGI_FORMAT_UNKNOWN, m_swapChainFlags ) ) )
+        return false;
+    return SUCCEEDED( CreateRenderTargets( width, height ) );
+}
+
+//
+void D3D11Backend::WaitForNextFrame() {
+    if ( m_frameLatencyWaitable != nullptr )
+        WaitForSingleObjectEx( m_frameLatencyWaitable, 1000, TRUE );
+}
+
+
+//
+HRESULT D3D11Backend::CreateDepthBuffer( u32 width, u32 height ) {
+    D3D11_TEXTURE2D_DESC depthDesc;
+    memset( &depthDesc, 0, sizeof( depthDesc ) );
+    depthDesc.Width = width;
+    depthDesc.Height = height;
+    depthDesc.MipLevels = 1;
+    depthDesc.ArraySize = 1;
+    depthDesc.Format = DXGI_FORMAT_D32_FLOAT;
+    depthDesc.SampleDesc.Count = 1;
+    depthDesc.Usage = D3D11_USAGE_DEFAULT;
+    depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+    HRESULT result = m_device->CreateTexture2D( &depthDesc, nullptr, &m_depthBuffer );
+    if ( FAILED( result ) )
+        return result;
+
+    return m_device->CreateDepthStencilView( m_depthBuffer, nullptr, &m_depthStencilView );
+}
+
+//
+HRESULT D3D11Backend::CreateConstantRing() {
+    // NO_OVERWRITE maps and offset binds of constant buffers need D3D11.1 driver support
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+    memset( &options, 0, sizeof( options ) );
+    bool offsets = m_context1 != nullptr
+        && SUCCEEDED( m_device->CheckFeatureSupport( D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof( options ) ) )
+        && options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+
+    // without them the ring is a single slot and every upload discards
+    const u32 capacity = offsets ? CONSTANT_RING_SIZE : OBJECT_CONSTANTS_STRIDE;
+
+    D3D11_BUFFER_DESC bd;
+    memset( &bd, 0, sizeof( bd ) );
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+    bd.ByteWidth = capacity;
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    HRESULT result = m_device->CreateBuffer( &bd, nullptr, &m_constantBuffer );
+    if ( FAILED( result ) )
+        return result;
+
+    m_constantRing.Reset( capacity );
+    return S_OK;
+}
+
+//
+u8* D3D11Backend::MapConstants( u32 size, UploadAllocation& allocation ) {
+    if ( !m_constantRing.Allocate( size, allocation ) )
+        return nullptr;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    D3D11_MAP mapType = allocation.m_discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    if ( FAILED( m_context->Map( m_constantBuffer, 0, mapType, 0, &mapped ) ) )
+        return nullptr;
+    return ( u8* )mapped.pData + allocation.m_offset;
+}
+
+//
+void D3D11Backend::BindConstants( u32 slot, u32 offset, u32 size ) {
+    if ( m_context1 != nullptr ) {
+        // offsets and sizes are counted in 16-byte constants
+        u32 firstConstant = offset / 16;
+        u32 numConstants = size / 16;
+        m_context1->VSSetConstantBuffers1( slot, 1, &m_constantBuffer, &firstConstant, &numConstants );
+    } else {
+        m_context->VSSetConstantBuffers( slot, 1, &m_constantBuffer );
+    }
+}
+
+//
+void D3D11Backend::UpdateConstants( const ConstantBuffer& cb ) {
+    m_frameConstants = cb;
+    if ( m_perObjectDraws && m_instanceCount > 0 )
+        return;     // DrawObjects copies the view-projection into every object's block
+
+    u8* dst = MapConstants( sizeof( ConstantBuffer ), m_frameConstantsAllocation );
+    if ( dst == nullptr )
+        return;
+    memcpy( dst, &cb, sizeof( ConstantBuffer ) );
+    m_context->Unmap( m_constantBuffer, 0 );
+}
+
+//
+bool D3D11Backend::CreateInstanceBuffer( u32 maxInstances ) {
+    return SUCCEEDED( CreateInstanceBufferD3D11( maxInstances ) );
+}
+
+//
+HRESULT D3D11Backend::CreateInstanceBufferD3D11( u32 maxInstances ) {
+    if ( maxInstances == 0 )
+        return E_INVALIDARG;
+
+    ShaderBytecode vs;
+    HRESULT result = m_shaderCache.GetBytecode( m_perObjectDraws ? SHADER_PER_OBJECT_VERTEX : SHADER_INSTANCED_VERTEX, vs );
+    if ( FAILED( result ) )
+        return result;
+
+    result = m_device->CreateVertexShader( vs.m_data, vs.m_size, nullptr, &m_instancedVertexShader );
+    if ( FAILED( result ) )
+        return result;
+
+    ShaderReflection reflection;
+    result = ReflectShader( vs, reflection );
+    if ( FAILED( result ) )
+        return result;
+
+    result = GetConstantBufferSlot( reflection, "MeshConstants", MESH_CONSTANTS_FIELDS, ARRAYSIZE( MESH_CONSTANTS_FIELDS ),
+        sizeof( MeshConstants ), m_instancedMeshConstantSlot );
+    if ( FAILED( result ) )
+        return result;
+
+    if ( m_perObjectDraws ) {
+        // per-object draws read only slot 0, their signature matches VertexShader.hlsl's and shares its layout
+        result = GetConstantBufferSlot( reflection, "ObjectConstants", OBJECT_CONSTANTS_FIELDS, ARRAYSIZE( OBJECT_CONSTANTS_FIELDS ),
+            sizeof( ObjectConstants ), m_instancedConstantSlot );
+        if ( SUCCEEDED( result ) )
+            result = m_inputLayouts.GetInputLayout( m_device, vs, reflection, &m_vertexStream, 1, &m_instancedLayout );
+        if ( FAILED( result ) )
+            return result;
+        m_objects.resize( maxInstances );
+        m_maxInstances = maxInstances;
+        m_instanceCount = 0;
+        return S_OK;
+    }
+
+    // slot 0: the mesh, slot 1: one InstanceData per instance
+    result = GetConstantBufferSlot( reflection, "ConstantBuffer", CONSTANT_BUFFER_FIELDS, ARRAYSIZE( CONSTANT_BUFFER_FIELDS ),
+        sizeof( ConstantBuffer ), m_instancedConstantSlot );
+    if ( FAILED( result ) )
+        return result;
+    const VertexStream streams[ 2 ] = { m_vertexStream, INSTANCE_STREAM };
+    result = m_inputLayouts.GetInputLayout( m_device, vs, reflection, streams, 2, &m_instancedLayout );
+    if ( FAILED( result ) )
+        return result;
+
+    // rewritten every frame, so dynamic and mapped with WRITE_DISCARD
+    D3D11_BUFFER_DESC bd;
+    memset( &bd, 0, sizeof( bd ) );
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+    bd.ByteWidth = maxInstances * sizeof( InstanceData );
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    result = m_device->CreateBuffer( &bd, nullptr, &m_instanceBuffer );
+    if ( FAILED( result ) )
+        return result;
+
+    m_maxInstances = maxInstances;
+    m_instanceCount = 0;
+    return S_OK;
+}
+
+//
+void D3D11Backend::UpdateInstances( const InstanceData* instances, u32 count ) {
+    count = count < m_maxInstances ? count : m_maxInstances;
+    if ( m_perObjectDraws ) {
+        memcpy( m_objects.data(), instances, count * sizeof( InstanceData ) );
+        m_instanceCount = count;
+        return;
+    }
+    if ( m_instanceBuffer == nullptr )
+        return;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if ( FAILED( m_context->Map( m_instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped ) ) )
+        return;
+    memcpy( mapped.pData, instances, count * sizeof( InstanceData ) );
+    m_context->Unmap( m_instanceBuffer, 0 );
+    m_instanceCount = count;
+}
+
+
+//
+void D3D11Backend::RenderScene() {
+    PROFILE_ZONE( "RenderScene" );
+    m_gpuTimer.BeginFrame( m_context );
+    f32 ClearColor[ 4 ] = { 0.337f, 0.627f, 0.827f, 1.0f };
+    // flip-model presents unbind the back buffer, so bind it every frame
+    m_context->OMSetRenderTargets( 1, &m_renderTargetView, m_depthStencilView );
+    m_context->RSSetViewports( 1, &m_viewport );
+    m_context->ClearRenderTargetView( m_renderTargetView, ClearColor );
+    m_context->ClearDepthStencilView( m_depthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0 );
+    m_gpuTimer.EndPass( m_context, GPU_PASS_CLEAR );
+    m_context->IASetIndexBuffer( m_indexBuffer, m_indexFormat, 0 );
+    m_context->PSSetShader( m_pixelShader, nullptr, 0 );
+    m_context->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+    if ( m_perObjectDraws && m_instanceCount > 0 ) {
+        DrawObjects();
+    } else if ( m_instanceCount > 0 ) {
+        BindConstants( m_instancedConstantSlot, m_frameConstantsAllocation.m_offset, m_frameConstantsAllocation.m_size );
+        m_context->VSSetConstantBuffers( m_instancedMeshConstantSlot, 1, &m_meshConstantBuffer );
+        ID3D11Buffer* buffers[ 2 ] = { m_vertexBuffer, m_instanceBuffer };
+        u32 strides[ 2 ] = { m_vertexStream.m_stride, INSTANCE_STREAM.m_stride };
+        u32 offsets[ 2 ] = { 0, 0 };
+        m_context->IASetInputLayout( m_instancedLayout );
+        m_context->IASetVertexBuffers( 0, 2, buffers, strides, offsets );
+        m_context->VSSetShader( m_instancedVertexShader, nullptr, 0 );
+        m_context->DrawIndexedInstanced( m_indexCount, m_instanceCount, 0, 0, 0 );
+    } else {
+        u32 stride = m_vertexStream.m_stride;
+        u32 offset = 0;
+        m_context->IASetInputLayout( m_vertexLayout );
+        m_context->IASetVertexBuffers( 0, 1, &m_vertexBuffer, &stride, &offset );
+        m_context->VSSetShader( m_vertexShader, nullptr, 0 );
+        BindConstants( m_vertexConstantSlot, m_frameConstantsAllocation.m_offset, m_frameConstantsAllocation.m_size );
+        m_context->VSSetConstantBuffers( m_meshConstantSlot, 1, &m_meshConstantBuffer );
+        m_context->DrawIndexed( m_meshlets.m_meshlets.empty() ? m_indexCount : CullClusters(), 0, 0 );
+    }
+    m_gpuTimer.EndPass( m_context, GPU_PASS_DRAW );
+
+    // tearing is only allowed for immediate presents
+    PROFILE_ZONE( "Present" );
+    const u32 syncInterval = m_present.m_vsync ? 1 : 0;
+    m_swapChain->Present( syncInterval, syncInterval == 0 && m_tearing ? DXGI_PRESENT_ALLOW_TEARING : 0 );
+    m_gpuTimer.EndPass( m_context, GPU_PASS_PRESENT );
+    m_gpuTimer.EndFrame( m_context );
+}
+
+// one DrawIndexed per object. the constants of as many objects as fit into
+// the ring are written with a single map, then bound by offset.
+void D3D11Backend::DrawObjects() {
+    u32 stride = m_vertexStream.m_stride;
+    u32 offset = 0;
+    m_context->IASetInputLayout( m_instancedLayout );
+    m_context->IASetVertexBuffers( 0, 1, &m_vertexBuffer, &stride, &offset );
+    m_context->VSSetShader( m_instancedVertexShader, nullptr, 0 );
+    m_context->VSSetConstantBuffers( m_instancedMeshConstantSlot, 1, &m_meshConstantBuffer );
+
+    const u32 objectsPerMap = m_constantRing.GetCapacity() / OBJECT_CONSTANTS_STRIDE;
+    for ( u32 first = 0; first < m_instanceCount; first += objectsPerMap ) {
+        const u32 count = m_instanceCount - first < objectsPerMap ? m_instanceCount - first : objectsPerMap;
+
+        UploadAllocation allocation;
+        u8* dst = MapConstants( count * OBJECT_CONSTANTS_STRIDE, allocation );
+        if ( dst == nullptr )
+            return;
+        for ( u32 i = 0; i < count; ++i ) {
+            const InstanceData& object = m_objects[ first + i ];
+            ObjectConstants* constants = ( ObjectConstants* )( dst + i * OBJECT_CONSTANTS_STRIDE );
+            constants->m_world = MatrixTranspose( object.m_modelMatrix );
+            constants->m_viewProjection = m_frameConstants.m_viewProjection;
+            constants->m_color = object.m_color;
+        }
+        m_context->Unmap( m_constantBuffer, 0 );
+
+        for ( u32 i = 0; i < count; ++i ) {
+            BindConstants( m_instancedConstantSlot, allocation.m_offset + i * OBJECT_CONSTANTS_STRIDE, OBJECT_CONSTANTS_STRIDE );
+            m_context->DrawIndexed( m_indexCount, 0, 0 );
+        }
+    }
+}
+
+//
+u32 D3D11Backend::CullClusters() {
+    PROFILE_ZONE( "ClusterCull" );
+    const Matrix model = MatrixTranspose( m_frameConstants.m_modelMatrix );
+    const u32 count = m_culler.Cull( m_meshlets, m_indices.data(), MakeClusterCullView( GetObjectClipTransform( model ) ), m_jobs );
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if ( FAILED( m_context->Map( m_indexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped ) ) )
+        return 0;
+    if ( m_indexFormat == DXGI_FORMAT_R16_UINT ) {
+        PackIndex16( m_culler.GetIndices(), count, m_culledIndices16 );
+        memcpy( mapped.pData, m_culledIndices16.data(), count * sizeof( u16 ) );
+    } else {
+        memcpy( mapped.pData, m_culler.GetIndices(), count * sizeof( u32 ) );
+    }
+    m_context->Unmap( m_indexBuffer, 0 );
+    return count;
+}
+
+//
+void D3D11Backend::Release() {
+    // release the COM objects we created
+    if ( m_context )
+        m_context->ClearState();
+
+    m_gpuTimer.Release();
+
+    // variants compiled this run go into the pack for the next start
+    m_shaderCache.Save();
+    m_shaderCache.Close();
+
+    if ( m_instanceBuffer )
+        m_instanceBuffer->Release();
+    if ( m_instancedVertexShader )
+        m_instancedVertexShader->Release();
+
+    if ( m_constantBuffer )
+        m_constantBuffer->Release();
+    if ( m_indexBuffer )
+        m_indexBuffer->Release();
+
+    if ( m_vertexBuffer )
+        m_vertexBuffer->Release();
+    if ( m_meshConstantBuffer )
+        m_meshConstantBuffer->Release();
+    // m_vertexLayout and m_instancedLayout belong to the cache
+    m_inputLayouts.Release();
+    if ( m_vertexShader )
+        m_vertexShader->Release();
+    if ( m_pixelShader )
+        m_pixelShader->Release();
+
+    ReleaseRenderTargets();
+    if ( m_frameLatencyWaitable )
+        CloseHandle( m_frameLatencyWaitable );
+    if ( m_swapChain )
+        m_swapChain->Release();
+    if ( m_context1 )
+        m_context1->Release();
+    if ( m_context )
+        m_context->Release();
+    if ( m_device )
+        m_device->Release();
+}
+
+//
+HRESULT D3D11Backend::CreateObjectD3D11( const void* vertices, u32 vertexCount, const VertexStream& stream, const MeshConstants& constants,
+                                         const u32* indices, u32 indexCount ) {
+    m_vertexStream = stream;
+
+    // load the vertex shader from the pack, compiled on a miss
+    ShaderBytecode vs;
+    HRESULT result = m_shaderCache.GetBytecode( SHADER_VERTEX, vs );
+    if ( FAILED( result ) )
+        return result;
+
+    // create the vertex shader
+    result = m_device->CreateVertexShader( vs.m_data, vs.m_size, nullptr, &m_vertexShader );
+    if ( FAILED( result ) )
+        return result;
+
+    // the input layout and the cbuffer register come from the shader itself
+    ShaderReflection reflection;
+    result = ReflectShader( vs, reflection );
+    if ( FAILED( result ) )
+        return result;
+    result = GetConstantBufferSlot( reflection, "ConstantBuffer", CONSTANT_BUFFER_FIELDS, ARRAYSIZE( CONSTANT_BUFFER_FIELDS ),
+        sizeof( ConstantBuffer ), m_vertexConstantSlot );
+    if ( SUCCEEDED( result ) )
+        result = GetConstantBufferSlot( reflection, "MeshConstants", MESH_CONSTANTS_FIELDS, ARRAYSIZE( MESH_CONSTANTS_FIELDS ),
+            sizeof( MeshConstants ), m_meshConstantSlot );
+    if ( FAILED( result ) )
+        return result;
+    result = m_inputLayouts.GetInputLayout( m_device, vs, reflection, &m_vertexStream, 1, &m_vertexLayout );
+    if ( FAILED( result ) )
+        return result;
+
+    // load the pixel shader
+    ShaderBytecode ps;
+    result = m_shaderCache.GetBytecode( SHADER_PIXEL, ps );
+    if ( FAILED( result ) )
+        return result;
+
+    // create the pixel shader
+    result = m_device->CreatePixelShader( ps.m_data, ps.m_size, NULL, &m_pixelShader );
+    if ( FAILED( result ) )
+        return result;
+
+    // create the vertex buffer
+    D3D11_BUFFER_DESC bd;
+    memset( &bd, 0, sizeof( bd ) );
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.ByteWidth = vertexCount * stream.m_stride;
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.CPUAccessFlags = 0;
+
+    D3D11_SUBRESOURCE_DATA subData;
+    memset( &subData, 0, sizeof( subData ) );
+    subData.pSysMem = vertices;
+    result = m_device->CreateBuffer( &bd, &subData, &m_vertexBuffer );
+    if ( FAILED( result ) )
+        return result;
+
+    // the dequantization never changes for the object, so it gets its own immutable buffer
+    memset( &bd, 0, sizeof( bd ) );
+    bd.Usage = D3D11_USAGE_IMMUTABLE;
+    bd.ByteWidth = sizeof( MeshConstants );
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+    memset( &subData, 0, sizeof( subData ) );
+    subData.pSysMem = &constants;
+    result = m_device->CreateBuffer( &bd, &subData, &m_meshConstantBuffer );
+    if ( FAILED( result ) )
+        return result;
+
+    // create the index buffer, 16-bit when every vertex fits, which halves its size and fetch bandwidth
+    std::vector< u16 > indices16;
+    const bool index16 = CanUseIndex16( vertexCount );
+    if ( index16 )
+        PackIndex16( indices, indexCount, indices16 );
+    m_indexFormat = index16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+    // cluster culling rewrites it every frame from a CPU copy
+    const bool culled = !m_meshlets.m_meshlets.empty();
+    if ( culled )
+        m_indices.assign( indices, indices + indexCount );
+    memset( &bd, 0, sizeof( bd ) );
+    bd.Usage = culled ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+    bd.ByteWidth = indexCount * ( index16 ? sizeof( u16 ) : sizeof( u32 ) );
+    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    bd.CPUAccessFlags = culled ? D3D11_CPU_ACCESS_WRITE : 0;
+
+    memset( &subData, 0, sizeof( subData ) );
+    subData.pSysMem = index16 ? ( const void* )indices16.data() : ( const void* )indices;
+    result = m_device->CreateBuffer( &bd, &subData, &m_indexBuffer );
+    if ( FAILED( result ) )
+        return result;
+    m_indexCount = indexCount;
+
+    // constants are uploaded through a dynamic ring buffer
+    result = CreateConstantRing();
+    if ( FAILED( result ) )
+        return result;
+
+    return S_OK;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "gpu_timer_d3d11.h"
+#include "mesh_optimize.h"
+#include "meshlet.h"
+#include "render_backend.h"
+#include "shader_cache_d3d11.h"
+#include "shader_reflection_d3d11.h"
+#include "upload_ring.h"
+
+#include <d3d11_1.h>
+#include <dxgi1_5.h>
+
+#include <vector>
+
+class D3D11Backend : public RenderBackend {
+public:
+    const char* GetName() const override { return "d3d11"; }
+
+    bool Initialize( const BackendDesc& desc ) override;
+    bool Resize( u32 width, u32 height ) override;
+    bool CreateObject( const Mesh& mesh ) override;
+    bool CreateQuantizedObject( const QuantizedMesh& mesh ) override;
+    void UpdateConstants( const ConstantBuffer& cb ) override;
+    bool CreateInstanceBuffer( u32 maxInstances ) override;
+    void UpdateInstances( const InstanceData* instances, u32 count ) override;
+    void WaitForNextFrame() override;
+    void RenderScene() override;
+    // GPU time of Clear, Draw and Present, a few frames old
+    const StageTimings& GetStageTimings() const override { return m_gpuTimer.GetTimings(); }
+    void Release() override;
+
+private:
+    HRESULT InitializeD3D11( HWND hwnd, u32 width, u32 height );
+    HRESULT CreateSwapChain( HWND hwnd, u32 width, u32 height );
+    // back buffer view, depth buffer and viewport for the current swap chain size
+    HRESULT CreateRenderTargets( u32 width, u32 height );
+    void ReleaseRenderTargets();
+    // vertices are laid out as stream describes, constants decode their positions
+    HRESULT CreateObjectD3D11( const void* vertices, u32 vertexCount, const VertexStream& stream, const MeshConstants& constants,
+                               const u32* indices, u32 indexCount );
+    HRESULT CreateDepthBuffer( u32 width, u32 height );
+    HRESULT CreateInstanceBufferD3D11( u32 maxInstances );
+    HRESULT CreateConstantRing();
+    // maps size bytes of the constant ring, returns nullptr if the map failed
+    u8* MapConstants( u32 size, UploadAllocation& allocation );
+    void BindConstants( u32 slot, u32 offset, u32 size );
+    void DrawObjects();
+    // culls the object's meshlets into the dynamic index buffer, returns the index count to draw
+    u32 CullClusters();
+
+    ID3D11Device*           m_device = nullptr;
+    ID3D11DeviceContext*    m_context = nullptr;
+    ID3D11DeviceContext1*   m_context1 = nullptr;   // null before Windows 8 / 7 platform update
+    ID3D11Texture2D*        m_depthBuffer = nullptr;
+    ID3D11DepthStencilView* m_depthStencilView = nullptr;
+    D3D11_VIEWPORT          m_viewport = {};
+
+    // flip-model swap chain, see PresentDesc
+    IDXGISwapChain1*        m_swapChain = nullptr;
+    ID3D11RenderTargetView* m_renderTargetView = nullptr;
+    PresentDesc             m_present;
+    u32                     m_swapChainFlags = 0;
+    bool                    m_tearing = false;
+    HANDLE                  m_frameLatencyWaitable = nullptr;   // signaled when a new frame may start
+
+    // input layouts are derived from the shaders by reflection and shared by signature
+    D3D11InputLayoutCache   m_inputLayouts;
+
+    ID3D11Buffer*           m_vertexBuffer = nullptr;
+    VertexStream            m_vertexStream = VERTEX_STREAM; // Vertex or one of the quantized layouts
+    ID3D11InputLayout*      m_vertexLayout = nullptr;
+    u32                     m_vertexConstantSlot = 0;       // register of ConstantBuffer in VertexShader.hlsl
+    // position dequantization of the object, immutable
+    ID3D11Buffer*           m_meshConstantBuffer = nullptr;
+    u32                     m_meshConstantSlot = 0;
+    ID3D11VertexShader*     m_vertexShader = nullptr;
+    ID3D11PixelShader*      m_pixelShader = nullptr;
+
+    ID3D11Buffer*           m_indexBuffer = nullptr;
+    DXGI_FORMAT             m_indexFormat = DXGI_FORMAT_R32_UINT;  // R16_UINT below INDEX16_VERTEX_LIMIT vertices
+    u32                     m_indexCount = 0;
+
+    // BackendDesc::m_clusterCulling: the index buffer is dynamic and rewritten
+    // every frame with the visible meshlets of m_indices
+    bool                    m_clusterCulling = false;
+    JobSystem*              m_jobs = nullptr;
+    MeshletMesh             m_meshlets;
+    ClusterCuller           m_culler;
+    std::vector< u32 >      m_indices;
+    std::vector< u16 >      m_culledIndices16;
+
+    // every constant upload is sub-allocated from this dynamic buffer
+    ID3D11Buffer*           m_constantBuffer = nullptr;
+    UploadRing              m_constantRing;
+    ConstantBuffer          m_frameConstants = {};
+    UploadAllocation        m_frameConstantsAllocation;
+
+    // instancing: per-instance vertex buffer in slot 1 and its own shader/layout
+    ID3D11Buffer*           m_instanceBuffer = nullptr;
+    ID3D11InputLayout*      m_instancedLayout = nullptr;
+    ID3D11VertexShader*     m_instancedVertexShader = nullptr;
+    u32                     m_instancedConstantSlot = 0;
+    u32                     m_instancedMeshConstantSlot = 0;
+    u32                     m_maxInstances = 0;
+    u32                     m_instanceCount = 0;
+
+    // --per-object: same scene as one DrawIndexed per instance with its
+    // constants in the ring, to compare against instancing
+    bool                    m_perObjectDraws = false;
+    std::vector< InstanceData > m_objects;
+
+    D3D11ShaderCache        m_shaderCache;
+    D3D11GpuTimer           m_gpuTimer;
+};
@@ -0,0 +1,235 @@
+#include "backend_software.h"
+
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+
+// vertices per vertex-stage job, a multiple of SIMD_WIDTH
+constexpr u32 VERTEX_BATCH_SIZE = 16 * 1024;
+
+// the instanced vertex stage hands out whole instances, about this many vertices per job
+constexpr u32 INSTANCE_BATCH_VERTICES = 16 * 1024;
+
+//
+RenderBackend* CreateSoftwareBackend() {
+    return new SoftwareBackend();
+}
+
+//
+bool SoftwareBackend::Initialize( const BackendDesc& desc ) {
+    if ( desc.m_width == 0 || desc.m_height == 0 )
+        return false;
+
+    if ( desc.m_jobs != nullptr ) {
+        m_jobs = desc.m_jobs;
+    } else {
+        m_ownJobs.reset( new JobSystem( desc.m_threadCount ) );
+        m_jobs = m_ownJobs.get();
+    }
+    m_presentDesc = desc.m_present;
+    m_clusterCulling = desc.m_clusterCulling;
+    return Resize( desc.m_width, desc.m_height );
+}
+
+//
+bool SoftwareBackend::Resize( u32 width, u32 height ) {
+    if ( width == 0 || height == 0 )
+        return false;
+
+    // queued frames have the old size, drop them along with the buffers
+    m_presentQueue.Reset( m_presentDesc );
+    m_rasterizer.Resize( width, height );
+    m_swapBuffers.resize( m_presentQueue.GetBufferCount() );
+    for ( std::vector< u32 >& buffer : m_swapBuffers )
+        buffer.assign( ( size_t )m_rasterizer.GetPitch() * height, 0 );
+    return true;
+}
+
+//
+bool SoftwareBackend::CreateObject( const Mesh& mesh ) {
+    if ( mesh.m_vertices == nullptr || mesh.m_indices == nullptr )
+        return false;
+
+    m_vertexBuffer.assign( mesh.m_vertices, mesh.m_vertices + mesh.m_vertexCount );
+    m_packedColors.clear();
+    m_positions.Assign( mesh.m_vertices, mesh.m_vertexCount );
+    m_indexBuffer.assign( mesh.m_indices, mesh.m_indices + mesh.m_indexCount );
+    m_clip.Resize( mesh.m_vertexCount );
+    m_meshlets = MeshletMesh();
+    if ( m_clusterCulling )
+        BuildMeshlets( mesh, m_meshlets );
+    return true;
+}
+
+// positions stay 16-bit for the vertex stage, colors RGBA8 for the rasterizer
+bool SoftwareBackend::CreateQuantizedObject( const QuantizedMesh& mesh ) {
+    if ( mesh.m_vertices.size() != ( size_t )mesh.m_vertexCount * mesh.m_stride || mesh.m_indices.empty() )
+        return false;
+
+    m_vertexBuffer.clear();
+    m_packedColors.resize( mesh.m_vertexCount );
+    for ( u32 i = 0; i < mesh.m_vertexCount; ++i )
+        m_packedColors[ i ] = mesh.GetColor( i );
+    m_positions.Assign( mesh );
+    m_indexBuffer = mesh.m_indices;
+    m_clip.Resize( mesh.m_vertexCount );
+    m_meshlets = MeshletMesh();
+    if ( m_clusterCulling )
+        BuildMeshlets( mesh, m_meshlets );
+    return true;
+}
+
+//
+void SoftwareBackend::UpdateConstants( const ConstantBuffer& cb ) {
+    m_constants = cb;
+}
+
+//
+bool SoftwareBackend::CreateInstanceBuffer( u32 maxInstances ) {
+    m_instances.resize( maxInstances );
+    m_instanceTransforms.resize( maxInstances );
+    m_instanceCount = 0;
+    return true;
+}
+
+//
+void SoftwareBackend::UpdateInstances( const InstanceData* instances, u32 count ) {
+    m_instanceCount = std::min( count, ( u32 )m_instances.size() );
+    std::copy( instances, instances + m_instanceCount, m_instances.begin() );
+}
+
+//
+void SoftwareBackend::WaitForNextFrame() {
+    m_presentQueue.WaitForFrame();
+}
+
+//
+void SoftwareBackend::RenderScene() {
+    PROFILE_ZONE( "RenderScene" );
+    m_stageTimings.m_count = 0;
+    m_stageTimings.m_frame++;
+    m_stageStart = FrameClock::now();
+
+    u32* backBuffer = m_swapBuffers[ m_presentQueue.GetBackBufferIndex() ].data();
+    m_rasterizer.BeginFrame( backBuffer, PackUnorm8( Float4( 0.337f, 0.627f, 0.827f, 1.0f ) ) );
+    if ( m_instanceCount > 0 )
+        DrawIndexedInstanced( ( u32 )m_indexBuffer.size(), m_instanceCount );
+    else
+        DrawIndexed( ( u32 )m_indexBuffer.size() );
+    {
+        PROFILE_ZONE( "Rasterize" );
+        m_rasterizer.EndFrame( *m_jobs );
+    }
+    EndStage( "Rasterize" );
+    {
+        PROFILE_ZONE( "Present" );
+        m_presentQueue.Present();
+    }
+    EndStage( "Present" );
+}
+
+//
+void SoftwareBackend::EndStage( const char* name ) {
+    const FrameClock::time_point now = FrameClock::now();
+    m_stageTimings.Add( name, SecondsBetween( m_stageStart, now ) * 1000.0 );
+    m_stageStart = now;
+}
+
+//
+void SoftwareBackend::Release() {
+    m_rasterizer.Resize( 0, 0 );
+    m_swapBuffers.clear();
+    m_jobs = nullptr;
+    m_ownJobs.reset();
+    m_vertexBuffer.clear();
+    m_packedColors.clear();
+    m_positions = PositionStreams();
+    m_indexBuffer.clear();
+    m_meshlets = MeshletMesh();
+    m_culler = ClusterCuller();
+    m_instances.clear();
+    m_instanceTransforms.clear();
+    m_instanceCount = 0;
+    m_clip = ClipStreams();
+}
+
+//
+void SoftwareBackend::DrawIndexed( u32 indexCount ) {
+    static_assert( VERTEX_BATCH_SIZE % SIMD_WIDTH == 0, "vertex batches must start on a SIMD boundary" );
+
+    // the constant buffer holds the transposed model matrix for HLSL
+    const Matrix model = MatrixTranspose( m_constants.m_modelMatrix );
+    const u32* indices = m_indexBuffer.data();
+    if ( !m_meshlets.m_meshlets.empty() ) {
+        {
+            PROFILE_ZONE( "ClusterCull" );
+            indexCount = m_culler.Cull( m_meshlets, indices, MakeClusterCullView( GetObjectClipTransform( model ) ), m_jobs );
+            indices = m_culler.GetIndices();
+        }
+        EndStage( "ClusterCull" );
+    }
+
+    const u32 vertexCount = m_positions.m_count;
+    const u32 batchCount = ( vertexCount + VERTEX_BATCH_SIZE - 1 ) / VERTEX_BATCH_SIZE;
+    {
+        PROFILE_ZONE( "VertexStage" );
+        m_jobs->ParallelFor( batchCount, [ & ]( u32 batch ) {
+            const u32 first = batch * VERTEX_BATCH_SIZE;
+            RunVertexStage( m_positions, first, std::min( VERTEX_BATCH_SIZE, vertexCount - first ), model, m_clip );
+        }, 1 );
+    }
+    EndStage( "VertexStage" );
+
+    RasterDraw draw;
+    draw.m_clip = &m_clip;
+    draw.m_vertices = m_vertexBuffer.data();
+    draw.m_packedColors = m_packedColors.empty() ? nullptr : m_packedColors.data();
+    draw.m_indices = indices;
+    draw.m_indexCount = indexCount;
+    {
+        PROFILE_ZONE( "Binning" );
+        m_rasterizer.SubmitTriangles( draw, *m_jobs );
+    }
+    EndStage( "Binning" );
+}
+
+//
+void SoftwareBackend::DrawIndexedInstanced( u32 indexCount, u32 instanceCount ) {
+    const Matrix viewProjection = MatrixTranspose( m_constants.m_viewProjection );
+    const u32 stride = GetInstanceStride( m_positions );
+    // clip indices and triangle numbers are u32 here and in the rasterizer,
+    // so draw only the instances they can address (and that UpdateInstances
+    // has room for)
+    instanceCount = std::min( { instanceCount, GetMaxInstanceCount( stride, indexCount ), ( u32 )m_instances.size() } );
+    m_clip.Resize( stride * instanceCount );
+
+    const u32 instancesPerBatch = std::max( INSTANCE_BATCH_VERTICES / std::max( stride, 1u ), 1u );
+    const u32 batchCount = ( instanceCount + instancesPerBatch - 1 ) / instancesPerBatch;
+    {
+        PROFILE_ZONE( "VertexStage" );
+        m_jobs->ParallelFor( batchCount, [ & ]( u32 batch ) {
+            const u32 first = batch * instancesPerBatch;
+            const u32 count = std::min( instancesPerBatch, instanceCount - first );
+            for ( u32 i = first; i < first + count; ++i )
+                m_instanceTransforms[ i ] = MatrixMultiply( m_instances[ i ].m_modelMatrix, viewProjection );
+            RunVertexStageInstanced( m_positions, m_instanceTransforms.data(), first, count, m_clip );
+        }, 1 );
+    }
+    EndStage( "VertexStage" );
+
+    RasterDraw draw;
+    draw.m_clip = &m_clip;
+    draw.m_vertices = m_vertexBuffer.data();
+    draw.m_packedColors = m_packedColors.empty() ? nullptr : m_packedColors.data();
+    draw.m_indices = m_indexBuffer.data();
+    draw.m_indexCount = indexCount;
+    draw.m_instanceCount = instanceCount;
+    draw.m_instanceStride = stride;
+    draw.m_instances = m_instances.data();
+    {
+        PROFILE_ZONE( "Binning" );
+        m_rasterizer.SubmitTriangles( draw, *m_jobs );
+    }
+    EndStage( "Binning" );
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "meshlet.h"
+#include "render_backend.h"
+#include "tile_rasterizer.h"
+#include "vertex_stage.h"
+
+#include <memory>
+#include <vector>
+
+// CPU reference of the D3D11 pipeline: same vertex/index data, same constant
+// buffer, same clear color and rasterizer defaults (clockwise front faces,
+// back-face culling, 0 <= z <= w clipping). renders into an RGBA8 framebuffer
+// laid out like DXGI_FORMAT_R8G8B8A8_UNORM. frames go through a PresentQueue
+// over PresentDesc::m_bufferCount such framebuffers, like a flip-model swap chain.
+class SoftwareBackend : public RenderBackend {
+public:
+    const char* GetName() const override { return "software"; }
+
+    bool Initialize( const BackendDesc& desc ) override;
+    bool Resize( u32 width, u32 height ) override;
+    bool CreateObject( const Mesh& mesh ) override;
+    bool CreateQuantizedObject( const QuantizedMesh& mesh ) override;
+    void UpdateConstants( const ConstantBuffer& cb ) override;
+    bool CreateInstanceBuffer( u32 maxInstances ) override;
+    void UpdateInstances( const InstanceData* instances, u32 count ) override;
+    void WaitForNextFrame() override;
+    void RenderScene() override;
+    // VertexStage, Binning, Rasterize and Present of the last RenderScene, CPU time
+    const StageTimings& GetStageTimings() const override { return m_stageTimings; }
+    void Release() override;
+
+    u32 GetWidth() const { return m_rasterizer.GetWidth(); }
+    u32 GetHeight() const { return m_rasterizer.GetHeight(); }
+    // row stride of the framebuffer in pixels
+    u32 GetPitch() const { return m_rasterizer.GetPitch(); }
+    // the buffer the emulated display currently shows
+    const u32* GetFramebuffer() const { return m_swapBuffers[ m_presentQueue.GetFrontBufferIndex() ].data(); }
+    const PresentStats& GetPresentStats() const { return m_presentQueue.GetStats(); }
+    // meshlets of the last frame with BackendDesc::m_clusterCulling
+    const ClusterCullStats& GetClusterCullStats() const { return m_culler.GetStats(); }
+
+private:
+    void DrawIndexed( u32 indexCount );
+    // closes the stage that started at m_stageStart
+    void EndStage( const char* name );
+    void DrawIndexedInstanced( u32 indexCount, u32 instanceCount );
+
+    std::unique_ptr< JobSystem > m_ownJobs;
+    JobSystem*                  m_jobs = nullptr;     // BackendDesc::m_jobs or m_ownJobs
+    TileRasterizer              m_rasterizer;
+    PresentDesc                 m_presentDesc;
+    PresentQueue                m_presentQueue;
+    std::vector< std::vector< u32 > > m_swapBuffers;
+
+    StageTimings                m_stageTimings;
+    FrameClock::time_point      m_stageStart;
+
+    // colors of the object, from the float vertices or RGBA8 for quantized meshes
+    std::vector< Vertex >       m_vertexBuffer;
+    std::vector< u32 >          m_packedColors;
+    PositionStreams             m_positions;
+    std::vector< u32 >          m_indexBuffer;
+    ConstantBuffer              m_constants = {};
+
+    // BackendDesc::m_clusterCulling: the object's meshlets, culled before the vertex stage
+    bool                        m_clusterCulling = false;
+    MeshletMesh                 m_meshlets;
+    ClusterCuller               m_culler;
+
+    std::vector< InstanceData > m_instances;
+    u32                         m_instanceCount = 0;
+    // model * view-projection per instance, filled by the vertex stage jobs
+    std::vector< Matrix >       m_instanceTransforms;
+
+    ClipStreams                 m_clip;
+};
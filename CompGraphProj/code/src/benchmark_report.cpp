@@ -0,0 +1,83 @@
+#include "benchmark_report.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+//
+FrameStats ComputeFrameStats( std::vector< f64 > samples ) {
+    FrameStats stats;
+    if ( samples.empty() )
+        return stats;
+
+    std::sort( samples.begin(), samples.end() );
+    const size_t count = samples.size();
+    auto percentile = [ & ]( f64 p ) {
+        const size_t rank = ( size_t )std::ceil( p / 100.0 * ( f64 )count );
+        return samples[ std::min( std::max( rank, ( size_t )1 ), count ) - 1 ];
+    };
+
+    f64 total = 0.0;
+    for ( f64 sample : samples )
+        total += sample;
+    stats.m_min = samples.front();
+    stats.m_mean = total / ( f64 )count;
+    stats.m_p50 = percentile( 50.0 );
+    stats.m_p95 = percentile( 95.0 );
+    stats.m_p99 = percentile( 99.0 );
+    stats.m_max = samples.back();
+    return stats;
+}
+
+//
+void BenchmarkRecorder::AddFrame( f64 frameMs, const StageTimings& stages ) {
+    m_frameMs.push_back( frameMs );
+    if ( stages.m_frame == 0 || stages.m_frame == m_lastStageFrame )
+        return;
+    m_lastStageFrame = stages.m_frame;
+
+    for ( u32 i = 0; i < stages.m_count; ++i ) {
+        size_t stage = 0;
+        while ( stage < m_stageNames.size() && strcmp( m_stageNames[ stage ], stages.m_names[ i ] ) != 0 )
+            ++stage;
+        if ( stage == m_stageNames.size() ) {
+            m_stageNames.push_back( stages.m_names[ i ] );
+            m_stageMs.emplace_back();
+        }
+        m_stageMs[ stage ].push_back( stages.m_ms[ i ] );
+    }
+}
+
+//
+static void WriteStats( FILE* file, const FrameStats& stats, u32 samples ) {
+    fprintf( file, "{ \"samples\": %u, \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+        samples, stats.m_min, stats.m_mean, stats.m_p50, stats.m_p95, stats.m_p99, stats.m_max );
+}
+
+//
+bool BenchmarkRecorder::WriteJson( const char* path, const BenchmarkInfo& info ) const {
+    FILE* file = path != nullptr ? fopen( path, "wb" ) : stdout;
+    if ( file == nullptr )
+        return false;
+
+    // stage names and the backend name are identifiers, no escaping needed
+    fprintf( file, "{\n" );
+    fprintf( file, "  \"backend\": \"%s\",\n", info.m_backend );
+    fprintf( file, "  \"width\": %u,\n  \"height\": %u,\n", info.m_width, info.m_height );
+    fprintf( file, "  \"cubes\": %u,\n  \"threads\": %u,\n", info.m_cubes, info.m_threads );
+    fprintf( file, "  \"vertex_format\": \"%s\",\n", info.m_vertexFormat );
+    fprintf( file, "  \"warmup_frames\": %u,\n  \"frames\": %u,\n", info.m_warmupFrames, GetFrameCount() );
+    fprintf( file, "  \"frame_ms\": " );
+    WriteStats( file, GetFrameStats(), GetFrameCount() );
+    fprintf( file, ",\n  \"stage_ms\": {" );
+    for ( size_t i = 0; i < m_stageNames.size(); ++i ) {
+        fprintf( file, "%s\n    \"%s\": ", i == 0 ? "" : ",", m_stageNames[ i ] );
+        WriteStats( file, ComputeFrameStats( m_stageMs[ i ] ), ( u32 )m_stageMs[ i ].size() );
+    }
+    fprintf( file, "%s}\n}\n", m_stageNames.empty() ? "" : "\n  " );
+
+    if ( path == nullptr )
+        return fflush( file ) == 0;
+    return fclose( file ) == 0;
+}
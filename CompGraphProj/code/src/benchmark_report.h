@@ -0,0 +1,48 @@
+#pragma once
+
+#include "render_backend.h"
+
+#include <vector>
+
+struct FrameStats {
+    f64 m_min = 0.0;
+    f64 m_mean = 0.0;
+    f64 m_p50 = 0.0;
+    f64 m_p95 = 0.0;
+    f64 m_p99 = 0.0;
+    f64 m_max = 0.0;
+};
+
+// nearest-rank percentiles of the samples, all zero for no samples
+FrameStats ComputeFrameStats( std::vector< f64 > samples );
+
+// what a --benchmark run measured, written next to the numbers
+struct BenchmarkInfo {
+    const char* m_backend = "";
+    u32         m_width = 0;
+    u32         m_height = 0;
+    u32         m_cubes = 0;
+    const char* m_vertexFormat = "float32";
+    u32         m_threads = 0;
+    u32         m_warmupFrames = 0;
+};
+
+// collects frame and stage times of a benchmark run and writes them as JSON
+class BenchmarkRecorder {
+public:
+    // stages are only added once per measured frame, backends that read
+    // timings back late report the same frame several times
+    void AddFrame( f64 frameMs, const StageTimings& stages );
+
+    u32 GetFrameCount() const { return ( u32 )m_frameMs.size(); }
+    FrameStats GetFrameStats() const { return ComputeFrameStats( m_frameMs ); }
+
+    // path nullptr writes to stdout
+    bool WriteJson( const char* path, const BenchmarkInfo& info ) const;
+
+private:
+    std::vector< f64 >                  m_frameMs;
+    std::vector< const char* >          m_stageNames;
+    std::vector< std::vector< f64 > >   m_stageMs;
+    u64                                 m_lastStageFrame = 0;
+};
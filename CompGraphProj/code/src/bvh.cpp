@@ -0,0 +1,487 @@
+#include "bvh.h"
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// objects per job of the per-object passes: centroids, bounds gathers, refits
+constexpr u32 BVH_BATCH_SIZE = 16384;
+// nodes with at least this many objects bin on jobs and build their two
+// subtrees in parallel, smaller ones are built by the job that reaches them
+constexpr u32 BVH_PARALLEL_SIZE = 32768;
+
+//
+static Aabb EmptyAabb() {
+    return { Float3( FLT_MAX, FLT_MAX, FLT_MAX ), Float3( -FLT_MAX, -FLT_MAX, -FLT_MAX ) };
+}
+
+//
+static void Grow( Aabb& box, const Float3& p ) {
+    box.m_min = Float3( std::min( box.m_min.x, p.x ), std::min( box.m_min.y, p.y ), std::min( box.m_min.z, p.z ) );
+    box.m_max = Float3( std::max( box.m_max.x, p.x ), std::max( box.m_max.y, p.y ), std::max( box.m_max.z, p.z ) );
+}
+
+//
+static void Grow( Aabb& box, const Aabb& other ) {
+    Grow( box, other.m_min );
+    Grow( box, other.m_max );
+}
+
+// half the surface area, the factor cancels in every cost ratio
+static f32 HalfArea( const Aabb& box ) {
+    const f32 dx = box.m_max.x - box.m_min.x, dy = box.m_max.y - box.m_min.y, dz = box.m_max.z - box.m_min.z;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+//
+static f32 Axis( const Float3& v, u32 axis ) {
+    return ( &v.x )[ axis ];
+}
+
+//
+static Float3 Centroid( const Aabb& box ) {
+    return Float3( 0.5f * ( box.m_min.x + box.m_max.x ), 0.5f * ( box.m_min.y + box.m_max.y ), 0.5f * ( box.m_min.z + box.m_max.z ) );
+}
+
+// the same rounding in binning and partitioning, so both agree on every object
+static u32 BinIndex( f32 c, f32 lo, f32 scale ) {
+    return std::min( ( u32 )( ( c - lo ) * scale ), BVH_BINS - 1 );
+}
+
+// the box's center and half size, the form the plane tests take
+static void GetCenterExtent( const Float3& min, const Float3& max, Float3& center, Float3& extent ) {
+    center = Float3( 0.5f * ( min.x + max.x ), 0.5f * ( min.y + max.y ), 0.5f * ( min.z + max.z ) );
+    extent = Float3( 0.5f * ( max.x - min.x ), 0.5f * ( max.y - min.y ), 0.5f * ( max.z - min.z ) );
+}
+
+// runs fn( first, last ) over batches of [ 0, count ), on jobs when given
+template< typename Func >
+static void ForEachBatch( u32 count, JobSystem* jobs, const Func& fn ) {
+    const u32 batches = ( count + BVH_BATCH_SIZE - 1 ) / BVH_BATCH_SIZE;
+    auto batch = [ & ]( u32 b ) { fn( b * BVH_BATCH_SIZE, std::min( ( b + 1 ) * BVH_BATCH_SIZE, count ) ); };
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( batches, batch, 1 );
+    } else {
+        for ( u32 b = 0; b < batches; ++b )
+            batch( b );
+    }
+}
+
+//
+void Bvh::Build( const Aabb* bounds, u32 count, JobSystem* jobs ) {
+    m_objectCount = count;
+    m_nodes.clear();
+    m_order.resize( count );
+    m_objectBounds.resize( count );
+    m_cost = m_buildCost = 0.0f;
+    if ( count == 0 )
+        return;
+
+    // references, and the root's boxes as per-batch partial unions
+    m_refs.resize( count );
+    const u32 batches = ( count + BVH_BATCH_SIZE - 1 ) / BVH_BATCH_SIZE;
+    std::vector< Aabb > partial( batches * 2 );
+    ForEachBatch( count, jobs, [ & ]( u32 first, u32 last ) {
+        Aabb box = EmptyAabb(), centroids = EmptyAabb();
+        for ( u32 i = first; i < last; ++i ) {
+            m_refs[ i ] = { bounds[ i ], i };
+            Grow( box, bounds[ i ] );
+            Grow( centroids, Centroid( bounds[ i ] ) );
+        }
+        partial[ first / BVH_BATCH_SIZE * 2 ] = box;
+        partial[ first / BVH_BATCH_SIZE * 2 + 1 ] = centroids;
+    } );
+    Aabb root = EmptyAabb(), centroids = EmptyAabb();
+    for ( u32 b = 0; b < batches; ++b ) {
+        Grow( root, partial[ b * 2 ] );
+        Grow( centroids, partial[ b * 2 + 1 ] );
+    }
+
+    // a binary tree with n leaves has 2n - 1 nodes
+    m_buildNodes.resize( count * 2 - 1 );
+    m_buildNodes[ 0 ].m_min = root.m_min;
+    m_buildNodes[ 0 ].m_max = root.m_max;
+    m_buildNodeCount.store( 1, std::memory_order_relaxed );
+    BuildNode( 0, 0, count, centroids, 0, jobs );
+
+    Flatten();
+    ForEachBatch( count, jobs, [ & ]( u32 first, u32 last ) {
+        for ( u32 i = first; i < last; ++i ) {
+            m_order[ i ] = m_refs[ i ].m_object;
+            m_objectBounds[ i ] = m_refs[ i ].m_bounds;
+        }
+    } );
+    m_cost = m_buildCost = ComputeCost();
+}
+
+// counts and boxes per bin on all three axes
+void Bvh::BinObjects( u32 first, u32 count, const Aabb& centroids, Bin ( &bins )[ 3 ][ BVH_BINS ], JobSystem* jobs ) const {
+    f32 scale[ 3 ];
+    for ( u32 axis = 0; axis < 3; ++axis ) {
+        const f32 extent = Axis( centroids.m_max, axis ) - Axis( centroids.m_min, axis );
+        scale[ axis ] = extent > 0.0f ? ( f32 )BVH_BINS / extent : 0.0f;
+    }
+    auto bin = [ & ]( u32 begin, u32 end, Bin ( &out )[ 3 ][ BVH_BINS ] ) {
+        for ( u32 axis = 0; axis < 3; ++axis ) {
+            for ( Bin& b : out[ axis ] )
+                b = { EmptyAabb(), 0 };
+        }
+        for ( u32 i = begin; i < end; ++i ) {
+            const Aabb& box = m_refs[ i ].m_bounds;
+            const Float3 c = Centroid( box );
+            for ( u32 axis = 0; axis < 3; ++axis ) {
+                Bin& b = out[ axis ][ BinIndex( Axis( c, axis ), Axis( centroids.m_min, axis ), scale[ axis ] ) ];
+                Grow( b.m_bounds, box );
+                b.m_count++;
+            }
+        }
+    };
+
+    if ( jobs == nullptr || count < BVH_PARALLEL_SIZE ) {
+        bin( first, first + count, bins );
+        return;
+    }
+    struct Bins {
+        Bin m_bins[ 3 ][ BVH_BINS ];
+    };
+    const u32 batches = ( count + BVH_BATCH_SIZE - 1 ) / BVH_BATCH_SIZE;
+    std::vector< Bins > partial( batches );
+    jobs->ParallelFor( batches, [ & ]( u32 b ) {
+        const u32 begin = first + b * BVH_BATCH_SIZE;
+        bin( begin, std::min( begin + BVH_BATCH_SIZE, first + count ), partial[ b ].m_bins );
+    }, 1 );
+    for ( u32 axis = 0; axis < 3; ++axis ) {
+        for ( u32 k = 0; k < BVH_BINS; ++k ) {
+            Bin& out = bins[ axis ][ k ];
+            out = { EmptyAabb(), 0 };
+            for ( u32 b = 0; b < batches; ++b ) {
+                const Bin& in = partial[ b ].m_bins[ axis ][ k ];
+                if ( in.m_count == 0 )
+                    continue;
+                Grow( out.m_bounds, in.m_bounds );
+                out.m_count += in.m_count;
+            }
+        }
+    }
+}
+
+// splits at the bin boundary with the lowest SAH cost over the three axes, or
+// makes a leaf when that is cheaper. objects with one shared centroid cannot
+// be binned apart and are halved in order.
+void Bvh::BuildNode( u32 node, u32 first, u32 count, const Aabb& centroids, u32 depth, JobSystem* jobs ) {
+    BvhNode& n = m_buildNodes[ node ];
+    if ( count <= 1 || depth + 1 >= BVH_MAX_DEPTH ) {
+        n.m_first = first;
+        n.m_count = count;
+        return;
+    }
+
+    Bin bins[ 3 ][ BVH_BINS ];
+    BinObjects( first, count, centroids, bins, jobs );
+
+    f32 bestCost = FLT_MAX;
+    u32 bestAxis = 3, bestSplit = 0;
+    for ( u32 axis = 0; axis < 3; ++axis ) {
+        if ( Axis( centroids.m_max, axis ) <= Axis( centroids.m_min, axis ) )
+            continue;
+        // left-to-right sums of count and area, then the right sides backwards
+        f32 leftCost[ BVH_BINS - 1 ];
+        Aabb box = EmptyAabb();
+        u32 objects = 0;
+        for ( u32 k = 0; k + 1 < BVH_BINS; ++k ) {
+            const Bin& b = bins[ axis ][ k ];
+            if ( b.m_count > 0 )
+                Grow( box, b.m_bounds );
+            objects += b.m_count;
+            leftCost[ k ] = objects > 0 ? HalfArea( box ) * ( f32 )objects : -1.0f;
+        }
+        box = EmptyAabb();
+        objects = 0;
+        for ( u32 k = BVH_BINS - 1; k > 0; --k ) {
+            const Bin& b = bins[ axis ][ k ];
+            if ( b.m_count > 0 )
+                Grow( box, b.m_bounds );
+            objects += b.m_count;
+            if ( objects == 0 || objects == count || leftCost[ k - 1 ] < 0.0f )
+                continue;
+            const f32 cost = leftCost[ k - 1 ] + HalfArea( box ) * ( f32 )objects;
+            if ( cost < bestCost ) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = k - 1;
+            }
+        }
+    }
+
+    Aabb left = EmptyAabb(), right = EmptyAabb(), leftCentroids = EmptyAabb(), rightCentroids = EmptyAabb();
+    u32 leftCount = 0;
+    if ( bestAxis < 3 ) {
+        const f32 area = HalfArea( { n.m_min, n.m_max } );
+        const f32 splitCost = BVH_TRAVERSAL_COST + ( area > 0.0f ? bestCost / area : ( f32 )count );
+        if ( splitCost >= ( f32 )count && count <= BVH_MAX_LEAF_SIZE ) {
+            n.m_first = first;
+            n.m_count = count;
+            return;
+        }
+        for ( u32 k = 0; k < BVH_BINS; ++k ) {
+            const Bin& b = bins[ bestAxis ][ k ];
+            if ( b.m_count == 0 )
+                continue;
+            Grow( k <= bestSplit ? left : right, b.m_bounds );
+            leftCount += k <= bestSplit ? b.m_count : 0;
+        }
+        const f32 lo = Axis( centroids.m_min, bestAxis );
+        const f32 scale = ( f32 )BVH_BINS / ( Axis( centroids.m_max, bestAxis ) - lo );
+        std::partition( m_refs.begin() + first, m_refs.begin() + first + count, [ & ]( const BuildRef& ref ) {
+            return BinIndex( Axis( Centroid( ref.m_bounds ), bestAxis ), lo, scale ) <= bestSplit;
+        } );
+        for ( u32 i = first; i < first + count; ++i )
+            Grow( i < first + leftCount ? leftCentroids : rightCentroids, Centroid( m_refs[ i ].m_bounds ) );
+    } else {
+        if ( count <= BVH_MAX_LEAF_SIZE ) {
+            n.m_first = first;
+            n.m_count = count;
+            return;
+        }
+        leftCount = count / 2;
+        for ( u32 i = first; i < first + count; ++i )
+            Grow( i < first + leftCount ? left : right, m_refs[ i ].m_bounds );
+        leftCentroids = rightCentroids = centroids;
+    }
+
+    const u32 children = m_buildNodeCount.fetch_add( 2, std::memory_order_relaxed );
+    n.m_first = children;
+    n.m_count = 0;
+    m_buildNodes[ children ].m_min = left.m_min;
+    m_buildNodes[ children ].m_max = left.m_max;
+    m_buildNodes[ children + 1 ].m_min = right.m_min;
+    m_buildNodes[ children + 1 ].m_max = right.m_max;
+
+    auto child = [ & ]( u32 side ) {
+        if ( side == 0 )
+            BuildNode( children, first, leftCount, leftCentroids, depth + 1, jobs );
+        else
+            BuildNode( children + 1, first + leftCount, count - leftCount, rightCentroids, depth + 1, jobs );
+    };
+    if ( jobs != nullptr && count >= BVH_PARALLEL_SIZE ) {
+        jobs->ParallelFor( 2, child, 1 );
+    } else {
+        child( 0 );
+        child( 1 );
+    }
+}
+
+// depth-first copy of the build nodes: the left child is written right after
+// its parent, the right child's index is patched in once it is reached
+void Bvh::Flatten() {
+    struct Entry {
+        u32 m_buildNode;
+        u32 m_parent;       // flattened parent waiting for its right child, or BVH_NONE
+    };
+    m_nodes.clear();
+    m_nodes.reserve( m_buildNodeCount.load( std::memory_order_relaxed ) );
+    std::vector< Entry > stack;
+    stack.push_back( { 0, BVH_NONE } );
+    while ( !stack.empty() ) {
+        const Entry entry = stack.back();
+        stack.pop_back();
+        const u32 index = ( u32 )m_nodes.size();
+        if ( entry.m_parent != BVH_NONE )
+            m_nodes[ entry.m_parent ].m_first = index;
+        const BvhNode& node = m_buildNodes[ entry.m_buildNode ];
+        m_nodes.push_back( node );
+        if ( node.m_count == 0 ) {
+            stack.push_back( { node.m_first + 1, index } );
+            stack.push_back( { node.m_first, BVH_NONE } );
+        }
+    }
+}
+
+// the sum of every node's area times its cost, relative to the root's area
+f32 Bvh::ComputeCost() const {
+    if ( m_nodes.empty() )
+        return 0.0f;
+    f64 cost = 0.0;
+    for ( const BvhNode& node : m_nodes )
+        cost += ( f64 )HalfArea( { node.m_min, node.m_max } ) * ( node.m_count > 0 ? ( f64 )node.m_count : ( f64 )BVH_TRAVERSAL_COST );
+    const f32 root = HalfArea( { m_nodes[ 0 ].m_min, m_nodes[ 0 ].m_max } );
+    return root > 0.0f ? ( f32 )( cost / root ) : 0.0f;
+}
+
+// children come after their parent, so one backward pass over the inner
+// nodes sees both children finished. the leaves go first, on jobs.
+void Bvh::Refit( const Aabb* bounds, JobSystem* jobs ) {
+    if ( m_nodes.empty() )
+        return;
+    ForEachBatch( m_objectCount, jobs, [ & ]( u32 first, u32 last ) {
+        for ( u32 i = first; i < last; ++i )
+            m_objectBounds[ i ] = bounds[ m_order[ i ] ];
+    } );
+    ForEachBatch( ( u32 )m_nodes.size(), jobs, [ & ]( u32 first, u32 last ) {
+        for ( u32 i = first; i < last; ++i ) {
+            BvhNode& node = m_nodes[ i ];
+            if ( node.m_count == 0 )
+                continue;
+            Aabb box = EmptyAabb();
+            for ( u32 k = node.m_first; k < node.m_first + node.m_count; ++k )
+                Grow( box, m_objectBounds[ k ] );
+            node.m_min = box.m_min;
+            node.m_max = box.m_max;
+        }
+    } );
+    for ( u32 i = ( u32 )m_nodes.size(); i-- > 0; ) {
+        BvhNode& node = m_nodes[ i ];
+        if ( node.m_count > 0 )
+            continue;
+        Aabb box = { m_nodes[ i + 1 ].m_min, m_nodes[ i + 1 ].m_max };
+        Grow( box, Aabb{ m_nodes[ node.m_first ].m_min, m_nodes[ node.m_first ].m_max } );
+        node.m_min = box.m_min;
+        node.m_max = box.m_max;
+    }
+    m_cost = ComputeCost();
+}
+
+//
+bool Bvh::Update( const Aabb* bounds, JobSystem* jobs ) {
+    Refit( bounds, jobs );
+    if ( m_cost <= m_buildCost * BVH_REBUILD_RATIO )
+        return false;
+    Build( bounds, m_objectCount, jobs );
+    return true;
+}
+
+// false when the box is outside one of the planes still in the mask, clears
+// the planes it is entirely inside of: the box's children are inside them too
+static bool ClassifyBox( const Frustum& frustum, const Float3& center, const Float3& extent, u32& planes ) {
+    for ( u32 p = 0; p < 6; ++p ) {
+        if ( ( planes & ( 1u << p ) ) == 0 )
+            continue;
+        const Float4& plane = frustum.m_planes[ p ];
+        const f32 d = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+        const f32 r = extent.x * std::fabs( plane.x ) + extent.y * std::fabs( plane.y ) + extent.z * std::fabs( plane.z );
+        if ( d + r < 0.0f )
+            return false;
+        if ( d - r >= 0.0f )
+            planes &= ~( 1u << p );
+    }
+    return true;
+}
+
+//
+template< bool Occlusion >
+u32 Bvh::Cull( const Frustum& frustum, const Matrix* clip, const OcclusionTest* occlusion, std::vector< u32 >& visible ) const {
+    struct Entry {
+        u32 m_node;
+        u32 m_planes;       // the planes the parent is not entirely inside of
+    };
+    if ( m_nodes.empty() )
+        return 0;
+    const size_t start = visible.size();
+    Entry stack[ BVH_MAX_DEPTH + 1 ];
+    u32 top = 0;
+    stack[ top++ ] = { 0, 0x3f };
+    while ( top > 0 ) {
+        const Entry entry = stack[ --top ];
+        const BvhNode& node = m_nodes[ entry.m_node ];
+        u32 planes = entry.m_planes;
+        Float3 center, extent;
+        GetCenterExtent( node.m_min, node.m_max, center, extent );
+        if ( !ClassifyBox( frustum, center, extent, planes ) )
+            continue;
+        if ( Occlusion && IsBoxOccluded( *occlusion, *clip, center, extent ) )
+            continue;
+
+        if ( node.m_count == 0 ) {
+            stack[ top++ ] = { node.m_first, planes };
+            stack[ top++ ] = { entry.m_node + 1, planes };
+            continue;
+        }
+        for ( u32 i = node.m_first; i < node.m_first + node.m_count; ++i ) {
+            if ( planes != 0 || Occlusion ) {
+                u32 objectPlanes = planes;
+                GetCenterExtent( m_objectBounds[ i ].m_min, m_objectBounds[ i ].m_max, center, extent );
+                if ( !ClassifyBox( frustum, center, extent, objectPlanes ) )
+                    continue;
+                if ( Occlusion && IsBoxOccluded( *occlusion, *clip, center, extent ) )
+                    continue;
+            }
+            visible.push_back( m_order[ i ] );
+        }
+    }
+    return ( u32 )( visible.size() - start );
+}
+
+//
+u32 Bvh::CullFrustum( const Frustum& frustum, std::vector< u32 >& visible ) const {
+    return Cull< false >( frustum, nullptr, nullptr, visible );
+}
+
+//
+u32 Bvh::CullOccluded( const Frustum& frustum, const Matrix& clip, const OcclusionTest& occlusion, std::vector< u32 >& visible ) const {
+    return Cull< true >( frustum, &clip, &occlusion, visible );
+}
+
+// slab test, the entry distance or FLT_MAX for a miss
+static f32 IntersectBox( const Float3& min, const Float3& max, const Float3& origin, const Float3& invDirection, f32 maxT ) {
+    f32 tMin = 0.0f, tMax = maxT;
+    for ( u32 axis = 0; axis < 3; ++axis ) {
+        const f32 t0 = ( Axis( min, axis ) - Axis( origin, axis ) ) * Axis( invDirection, axis );
+        const f32 t1 = ( Axis( max, axis ) - Axis( origin, axis ) ) * Axis( invDirection, axis );
+        tMin = std::max( tMin, std::min( t0, t1 ) );
+        tMax = std::min( tMax, std::max( t0, t1 ) );
+    }
+    return tMin <= tMax ? tMin : FLT_MAX;
+}
+
+// nearer child first; subtrees that start beyond the closest hit so far are skipped
+bool Bvh::Raycast( const Float3& origin, const Float3& direction, BvhRayHit& hit, f32 maxT, const BvhRayTest* test ) const {
+    struct Entry {
+        u32 m_node;
+        f32 m_t;            // where the ray enters the node
+    };
+    hit = BvhRayHit();
+    if ( m_nodes.empty() )
+        return false;
+    const Float3 invDirection( 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z );
+    f32 closest = maxT;
+    Entry stack[ BVH_MAX_DEPTH + 1 ];
+    u32 top = 0;
+    const f32 rootT = IntersectBox( m_nodes[ 0 ].m_min, m_nodes[ 0 ].m_max, origin, invDirection, closest );
+    if ( rootT != FLT_MAX )
+        stack[ top++ ] = { 0, rootT };
+    while ( top > 0 ) {
+        const Entry entry = stack[ --top ];
+        if ( entry.m_t > closest )
+            continue;
+        const BvhNode& node = m_nodes[ entry.m_node ];
+        if ( node.m_count == 0 ) {
+            const u32 a = entry.m_node + 1, b = node.m_first;
+            f32 tA = IntersectBox( m_nodes[ a ].m_min, m_nodes[ a ].m_max, origin, invDirection, closest );
+            f32 tB = IntersectBox( m_nodes[ b ].m_min, m_nodes[ b ].m_max, origin, invDirection, closest );
+            const bool swap = tB < tA;
+            if ( swap )
+                std::swap( tA, tB );
+            if ( tB != FLT_MAX )
+                stack[ top++ ] = { swap ? a : b, tB };
+            if ( tA != FLT_MAX )
+                stack[ top++ ] = { swap ? b : a, tA };
+            continue;
+        }
+        for ( u32 i = node.m_first; i < node.m_first + node.m_count; ++i ) {
+            f32 t = IntersectBox( m_objectBounds[ i ].m_min, m_objectBounds[ i ].m_max, origin, invDirection, closest );
+            if ( t == FLT_MAX )
+                continue;
+            if ( test != nullptr ) {
+                t = closest;
+                if ( !test->Intersect( m_order[ i ], origin, direction, t ) || t >= closest )
+                    continue;
+            }
+            closest = t;
+            hit.m_object = m_order[ i ];
+            hit.m_t = t;
+        }
+    }
+    return hit.m_object != BVH_NONE;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "frustum_culling.h"
+#include "types.h"
+#include "vecmath.h"
+
+#include <atomic>
+#include <vector>
+
+class JobSystem;
+
+// bounding volume hierarchy over scene objects, each given by its world-space
+// box. built top-down with the surface area heuristic on binned centroids;
+// large nodes bin on jobs and their two subtrees are built in parallel. the
+// result is flattened depth-first into 32-byte nodes: a node's left child
+// follows it, so traversal walks the array mostly forward and a subtree's
+// objects are one contiguous run of the primitive order.
+//
+// objects that move keep the tree and only refit its boxes; once the refitted
+// tree's SAH cost has grown by BVH_REBUILD_RATIO it is rebuilt.
+
+struct Aabb {
+    Float3  m_min;
+    Float3  m_max;
+};
+
+constexpr u32 BVH_BINS = 16;
+constexpr u32 BVH_MAX_LEAF_SIZE = 8;
+// deeper nodes become leaves whatever their size, bounds the traversal stacks
+constexpr u32 BVH_MAX_DEPTH = 64;
+// cost of visiting a node relative to testing one object
+constexpr f32 BVH_TRAVERSAL_COST = 1.0f;
+constexpr f32 BVH_REBUILD_RATIO = 1.5f;
+constexpr u32 BVH_NONE = ~0u;
+
+struct BvhNode {
+    Float3  m_min;
+    u32     m_first;    // leaf: first object in the primitive order, inner node: the right child
+    Float3  m_max;
+    u32     m_count;    // objects of a leaf, 0 for inner nodes
+};
+static_assert( sizeof( BvhNode ) == 32, "two nodes per cache line" );
+
+// exact intersection with one object for ray picks, e.g. against its
+// triangles; without one the ray hits the objects' boxes
+class BvhRayTest {
+public:
+    virtual ~BvhRayTest() = default;
+    // on a hit closer than t, sets t and returns true
+    virtual bool Intersect( u32 object, const Float3& origin, const Float3& direction, f32& t ) const = 0;
+};
+
+struct BvhRayHit {
+    u32 m_object = BVH_NONE;
+    f32 m_t = 0.0f;         // along the ray direction
+};
+
+class Bvh {
+public:
+    void Build( const Aabb* bounds, u32 count, JobSystem* jobs = nullptr );
+    // the same objects moved: recomputes the node boxes bottom-up
+    void Refit( const Aabb* bounds, JobSystem* jobs = nullptr );
+    // refits, or rebuilds once the tree has degraded. true when rebuilt.
+    bool Update( const Aabb* bounds, JobSystem* jobs = nullptr );
+
+    // appends the objects inside the frustum to visible in tree order and
+    // returns their number. subtrees entirely inside skip the remaining tests.
+    u32 CullFrustum( const Frustum& frustum, std::vector< u32 >& visible ) const;
+    // the same, also skipping nodes and objects whose box is occluded under clip
+    u32 CullOccluded( const Frustum& frustum, const Matrix& clip, const OcclusionTest& occlusion, std::vector< u32 >& visible ) const;
+    // nearest object along the ray within maxT, direction need not be unit length
+    bool Raycast( const Float3& origin, const Float3& direction, BvhRayHit& hit, f32 maxT = 1e30f, const BvhRayTest* test = nullptr ) const;
+
+    u32 GetObjectCount() const { return m_objectCount; }
+    const std::vector< BvhNode >& GetNodes() const { return m_nodes; }
+    // object index per position of the leaves' ranges
+    const std::vector< u32 >& GetPrimitiveOrder() const { return m_order; }
+    // SAH cost: expected node visits and object tests of a random ray hitting the root
+    f32 GetCost() const { return m_cost; }
+    f32 GetBuildCost() const { return m_buildCost; }
+
+private:
+    struct Bin {
+        Aabb    m_bounds;
+        u32     m_count;
+    };
+    // an object with its box, partitioned in place so binning reads memory in order
+    struct BuildRef {
+        Aabb    m_bounds;
+        u32     m_object;
+    };
+
+    void BuildNode( u32 node, u32 first, u32 count, const Aabb& centroids, u32 depth, JobSystem* jobs );
+    void BinObjects( u32 first, u32 count, const Aabb& centroids, Bin ( &bins )[ 3 ][ BVH_BINS ], JobSystem* jobs ) const;
+    void Flatten();
+    f32 ComputeCost() const;
+    template< bool Occlusion >
+    u32 Cull( const Frustum& frustum, const Matrix* clip, const OcclusionTest* occlusion, std::vector< u32 >& visible ) const;
+
+    std::vector< BvhNode >  m_nodes;            // flattened, root first
+    std::vector< u32 >      m_order;
+    std::vector< Aabb >     m_objectBounds;     // in primitive order, for the leaf tests
+    u32                     m_objectCount = 0;
+    f32                     m_cost = 0.0f;
+    f32                     m_buildCost = 0.0f;
+
+    // build state: nodes with both children side by side, in allocation order
+    std::vector< BvhNode >  m_buildNodes;
+    std::vector< BuildRef > m_refs;
+    std::atomic< u32 >      m_buildNodeCount{ 0 };
+};
@@ -0,0 +1,190 @@
+#include "entity_store.h"
+
+#include <algorithm>
+
+//
+u32 EntityStore::GetChunkCapacity( u32 components ) {
+    u32 streams = 0;
+    for ( u32 s = 0; s < ECS_STREAM_COUNT; ++s )
+        streams += ( ECS_STREAM_COMPONENTS[ s ] & components ) != 0 ? 1 : 0;
+    const u32 rows = ECS_CHUNK_BYTES / ( ( u32 )sizeof( f32 ) * std::max( streams, 1u ) );
+    return std::max( rows / ECS_CHUNK_ROWS_ALIGN * ECS_CHUNK_ROWS_ALIGN, ECS_CHUNK_ROWS_ALIGN );
+}
+
+// the archetype of exactly components, added on first use
+u32 EntityStore::GetArchetype( u32 components ) {
+    for ( u32 a = 0; a < ( u32 )m_archetypes.size(); ++a ) {
+        if ( m_archetypes[ a ].m_components == components )
+            return a;
+    }
+    Archetype archetype;
+    archetype.m_components = components;
+    archetype.m_capacity = GetChunkCapacity( components );
+    for ( u32 s = 0; s < ECS_STREAM_COUNT; ++s )
+        archetype.m_offsets[ s ] = ( ECS_STREAM_COMPONENTS[ s ] & components ) != 0 ? archetype.m_capacity * archetype.m_streamCount++ : ~0u;
+    m_archetypes.push_back( std::move( archetype ) );
+    return ( u32 )m_archetypes.size() - 1;
+}
+
+//
+const EntityStore::Archetype* EntityStore::FindArchetype( u32 components ) const {
+    for ( const Archetype& archetype : m_archetypes ) {
+        if ( archetype.m_components == components )
+            return &archetype;
+    }
+    return nullptr;
+}
+
+// appends a zeroed row for slot to the archetype's last chunk, starting a
+// new chunk when it is full
+void EntityStore::AddRow( u32 slot, u32 archetypeIndex ) {
+    Archetype& archetype = m_archetypes[ archetypeIndex ];
+    if ( archetype.m_chunks.empty() || archetype.m_chunks.back().m_count == archetype.m_capacity ) {
+        EcsChunk chunk;
+        chunk.m_data.resize( ( size_t )archetype.m_capacity * archetype.m_streamCount );
+        chunk.m_entities.resize( archetype.m_capacity );
+        std::copy( archetype.m_offsets, archetype.m_offsets + ECS_STREAM_COUNT, chunk.m_offsets );
+        chunk.m_first = ( u32 )archetype.m_chunks.size() * archetype.m_capacity;
+        archetype.m_chunks.push_back( std::move( chunk ) );
+    }
+    EcsChunk& chunk = archetype.m_chunks.back();
+    const u32 row = chunk.m_count++;
+    // rows left behind by RemoveRow keep their old fields
+    for ( u32 s = 0; s < archetype.m_streamCount; ++s )
+        chunk.m_data[ ( size_t )s * archetype.m_capacity + row ] = 0.0f;
+    chunk.m_entities[ row ] = slot;
+    archetype.m_count++;
+
+    Slot& record = m_slots[ slot ];
+    record.m_archetype = archetypeIndex;
+    record.m_chunk = ( u32 )archetype.m_chunks.size() - 1;
+    record.m_row = row;
+}
+
+// moves the archetype's last row into the hole and drops the last chunk once it is empty
+void EntityStore::RemoveRow( u32 archetypeIndex, u32 chunkIndex, u32 row ) {
+    Archetype& archetype = m_archetypes[ archetypeIndex ];
+    EcsChunk& last = archetype.m_chunks.back();
+    const u32 lastRow = last.m_count - 1;
+    EcsChunk& chunk = archetype.m_chunks[ chunkIndex ];
+    if ( &chunk != &last || row != lastRow ) {
+        for ( u32 s = 0; s < archetype.m_streamCount; ++s )
+            chunk.m_data[ ( size_t )s * archetype.m_capacity + row ] = last.m_data[ ( size_t )s * archetype.m_capacity + lastRow ];
+        const u32 moved = last.m_entities[ lastRow ];
+        chunk.m_entities[ row ] = moved;
+        m_slots[ moved ].m_chunk = chunkIndex;
+        m_slots[ moved ].m_row = row;
+    }
+    last.m_count--;
+    archetype.m_count--;
+    if ( last.m_count == 0 )
+        archetype.m_chunks.pop_back();
+}
+
+//
+const EntityStore::Slot* EntityStore::FindSlot( Entity entity ) const {
+    if ( entity.m_index >= m_slots.size() )
+        return nullptr;
+    const Slot& slot = m_slots[ entity.m_index ];
+    return slot.m_alive && slot.m_generation == entity.m_generation ? &slot : nullptr;
+}
+
+//
+Entity EntityStore::Create( u32 components ) {
+    u32 slot;
+    if ( !m_freeSlots.empty() ) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        slot = ( u32 )m_slots.size();
+        m_slots.emplace_back();
+    }
+    m_slots[ slot ].m_alive = true;
+    AddRow( slot, GetArchetype( components ) );
+    return { slot, m_slots[ slot ].m_generation };
+}
+
+// the slot's generation moves on, so the old handle no longer finds it
+bool EntityStore::Destroy( Entity entity ) {
+    const Slot* slot = FindSlot( entity );
+    if ( slot == nullptr )
+        return false;
+    RemoveRow( slot->m_archetype, slot->m_chunk, slot->m_row );
+    m_slots[ entity.m_index ].m_alive = false;
+    m_slots[ entity.m_index ].m_generation++;
+    m_freeSlots.push_back( entity.m_index );
+    return true;
+}
+
+//
+bool EntityStore::IsAlive( Entity entity ) const {
+    return FindSlot( entity ) != nullptr;
+}
+
+//
+bool EntityStore::SetComponents( Entity entity, u32 components ) {
+    const Slot* slot = FindSlot( entity );
+    if ( slot == nullptr )
+        return false;
+    const u32 from = slot->m_archetype, fromChunk = slot->m_chunk, fromRow = slot->m_row;
+    if ( m_archetypes[ from ].m_components == components )
+        return true;
+
+    const u32 to = GetArchetype( components );
+    AddRow( entity.m_index, to );
+    const Archetype& source = m_archetypes[ from ];
+    const Archetype& target = m_archetypes[ to ];
+    const EcsChunk& src = source.m_chunks[ fromChunk ];
+    EcsChunk& dst = m_archetypes[ to ].m_chunks[ slot->m_chunk ];
+    for ( u32 s = 0; s < ECS_STREAM_COUNT; ++s ) {
+        if ( source.m_offsets[ s ] != ~0u && target.m_offsets[ s ] != ~0u )
+            dst.m_data[ target.m_offsets[ s ] + slot->m_row ] = src.m_data[ source.m_offsets[ s ] + fromRow ];
+    }
+    RemoveRow( from, fromChunk, fromRow );
+    return true;
+}
+
+//
+u32 EntityStore::GetComponents( Entity entity ) const {
+    const Slot* slot = FindSlot( entity );
+    return slot != nullptr ? m_archetypes[ slot->m_archetype ].m_components : 0;
+}
+
+//
+f32* EntityStore::Get( Entity entity, EcsStream stream ) {
+    const Slot* slot = FindSlot( entity );
+    if ( slot == nullptr )
+        return nullptr;
+    f32* data = m_archetypes[ slot->m_archetype ].m_chunks[ slot->m_chunk ].Get( stream );
+    return data != nullptr ? data + slot->m_row : nullptr;
+}
+
+//
+u32 EntityStore::GetCount( u32 components ) const {
+    u32 count = 0;
+    for ( const Archetype& archetype : m_archetypes )
+        count += ( archetype.m_components & components ) == components ? archetype.m_count : 0;
+    return count;
+}
+
+//
+EcsChunk* EntityStore::FindChunk( u32 components, u32 ordinal, u32& row ) {
+    return const_cast< EcsChunk* >( static_cast< const EntityStore* >( this )->FindChunk( components, ordinal, row ) );
+}
+
+//
+const EcsChunk* EntityStore::FindChunk( u32 components, u32 ordinal, u32& row ) const {
+    const Archetype* archetype = FindArchetype( components );
+    if ( archetype == nullptr || ordinal >= archetype->m_count )
+        return nullptr;
+    row = ordinal % archetype->m_capacity;
+    return &archetype->m_chunks[ ordinal / archetype->m_capacity ];
+}
+
+// drops every entity. handles from before must not be used again, they
+// may find the entities created after.
+void EntityStore::Clear() {
+    m_archetypes.clear();
+    m_slots.clear();
+    m_freeSlots.clear();
+}
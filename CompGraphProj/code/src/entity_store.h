@@ -0,0 +1,170 @@
+#pragma once
+
+#include "job_system.h"
+#include "simd.h"
+#include "types.h"
+
+#include <vector>
+
+// archetype entity-component storage. every distinct set of components is
+// an archetype whose entities live in fixed-size chunks, one contiguous
+// array per component field (stream) inside each chunk. a system walks the
+// chunks of every archetype that has its components and reads each stream
+// front to back, SIMD_WIDTH entities at a time, with chunks spread over the
+// job system.
+//
+// chunks stay packed: an entity that is destroyed or changes its components
+// is replaced by the archetype's last one, so rows [ 0, count ) of every
+// chunk are live and only the last chunk is partly filled.
+
+// one bit per component
+enum EcsComponent : u32 {
+    ECS_TRANSFORM   = 1 << 0,   // position, uniform scale and a rotation about a unit axis
+    ECS_SPIN        = 1 << 1,   // turns the transform's angle at a fixed speed
+    ECS_BOUNDS      = 1 << 2,   // bounding sphere radius about the position
+    ECS_MESH        = 1 << 3,   // index of the mesh to draw, u32
+    ECS_MATERIAL    = 1 << 4,   // color
+};
+
+// the fields of every component, 4 bytes per entity each
+enum EcsStream : u32 {
+    ECS_POSITION_X, ECS_POSITION_Y, ECS_POSITION_Z,
+    ECS_SCALE,
+    ECS_AXIS_X, ECS_AXIS_Y, ECS_AXIS_Z,
+    ECS_ANGLE,
+    ECS_PREV_ANGLE,             // angle before the last step, for interpolation
+    ECS_ANGULAR_SPEED,          // radians per second
+    ECS_RADIUS,
+    ECS_MESH_INDEX,
+    ECS_COLOR_R, ECS_COLOR_G, ECS_COLOR_B, ECS_COLOR_A,
+    ECS_STREAM_COUNT
+};
+
+// the component each stream belongs to
+constexpr u32 ECS_STREAM_COMPONENTS[ ECS_STREAM_COUNT ] = {
+    ECS_TRANSFORM, ECS_TRANSFORM, ECS_TRANSFORM, ECS_TRANSFORM,
+    ECS_TRANSFORM, ECS_TRANSFORM, ECS_TRANSFORM, ECS_TRANSFORM,
+    ECS_SPIN, ECS_SPIN,
+    ECS_BOUNDS,
+    ECS_MESH,
+    ECS_MATERIAL, ECS_MATERIAL, ECS_MATERIAL, ECS_MATERIAL,
+};
+
+// bytes of stream data per chunk; the row count is rounded down to a
+// multiple of ECS_CHUNK_ROWS_ALIGN so SIMD passes can run to the next
+// multiple of SIMD_WIDTH past the last entity without leaving the chunk
+constexpr u32 ECS_CHUNK_BYTES = 16 * 1024;
+constexpr u32 ECS_CHUNK_ROWS_ALIGN = 16;
+static_assert( ECS_CHUNK_ROWS_ALIGN % SIMD_WIDTH == 0, "chunk rows end on a SIMD group" );
+
+// chunks per job in ForEachChunk
+constexpr u32 ECS_CHUNK_BATCH = 4;
+
+// index into the store's entity slots and the slot's generation when it
+// was created, so handles of destroyed entities are recognized
+struct Entity {
+    u32 m_index = ~0u;
+    u32 m_generation = 0;
+};
+
+// the rows of one chunk
+class EcsChunk {
+public:
+    u32 GetCount() const { return m_count; }
+    // the archetype's ordinal of row 0
+    u32 GetFirst() const { return m_first; }
+    // nullptr when the archetype does not have the stream's component
+    f32* Get( EcsStream stream ) { return m_offsets[ stream ] != ~0u ? m_data.data() + m_offsets[ stream ] : nullptr; }
+    const f32* Get( EcsStream stream ) const { return m_offsets[ stream ] != ~0u ? m_data.data() + m_offsets[ stream ] : nullptr; }
+    u32* GetU32( EcsStream stream ) { return ( u32* )Get( stream ); }
+    const u32* GetU32( EcsStream stream ) const { return ( const u32* )Get( stream ); }
+    // the entity slot of every row
+    const u32* GetEntities() const { return m_entities.data(); }
+
+private:
+    friend class EntityStore;
+
+    std::vector< f32 >  m_data;         // capacity floats per stream, one stream after the other
+    std::vector< u32 >  m_entities;
+    u32                 m_offsets[ ECS_STREAM_COUNT ];  // the archetype's, ~0u for absent streams
+    u32                 m_count = 0;
+    u32                 m_first = 0;
+};
+
+class EntityStore {
+public:
+    // an entity with components, every field 0
+    Entity Create( u32 components );
+    // false for handles of destroyed entities
+    bool Destroy( Entity entity );
+    bool IsAlive( Entity entity ) const;
+
+    // moves the entity to the archetype of components, keeping the fields
+    // of the components it had and zeroing the new ones
+    bool SetComponents( Entity entity, u32 components );
+    u32 GetComponents( Entity entity ) const;
+    // the entity's field, nullptr when it is not alive or lacks the component
+    f32* Get( Entity entity, EcsStream stream );
+    u32* GetU32( Entity entity, EcsStream stream ) { return ( u32* )Get( entity, stream ); }
+
+    // entities that have at least components
+    u32 GetCount( u32 components ) const;
+    // rows per chunk of the archetype of exactly components
+    static u32 GetChunkCapacity( u32 components );
+    // the chunk holding the archetype ordinal of exactly components, and
+    // the row in it; nullptr past the end
+    EcsChunk* FindChunk( u32 components, u32 ordinal, u32& row );
+    const EcsChunk* FindChunk( u32 components, u32 ordinal, u32& row ) const;
+
+    // calls fn( EcsChunk& ) for every chunk of every archetype with at least
+    // components, ECS_CHUNK_BATCH chunks per job when jobs are given. chunks
+    // of one archetype may run concurrently, so fn must only touch its own.
+    template< typename Func >
+    void ForEachChunk( u32 components, JobSystem* jobs, const Func& fn );
+
+    void Clear();
+
+private:
+    struct Archetype {
+        u32                     m_components = 0;
+        u32                     m_offsets[ ECS_STREAM_COUNT ];
+        u32                     m_streamCount = 0;
+        u32                     m_capacity = 0;
+        u32                     m_count = 0;
+        std::vector< EcsChunk > m_chunks;
+    };
+    struct Slot {
+        u32 m_archetype = 0;
+        u32 m_chunk = 0;
+        u32 m_row = 0;
+        u32 m_generation = 0;
+        bool m_alive = false;
+    };
+
+    u32 GetArchetype( u32 components );
+    const Archetype* FindArchetype( u32 components ) const;
+    void AddRow( u32 slot, u32 archetype );
+    void RemoveRow( u32 archetype, u32 chunk, u32 row );
+    const Slot* FindSlot( Entity entity ) const;
+
+    std::vector< Archetype >    m_archetypes;
+    std::vector< Slot >         m_slots;
+    std::vector< u32 >          m_freeSlots;
+};
+
+//
+template< typename Func >
+void EntityStore::ForEachChunk( u32 components, JobSystem* jobs, const Func& fn ) {
+    for ( Archetype& archetype : m_archetypes ) {
+        if ( ( archetype.m_components & components ) != components || archetype.m_count == 0 )
+            continue;
+        EcsChunk* chunks = archetype.m_chunks.data();
+        const u32 chunkCount = ( u32 )archetype.m_chunks.size();
+        if ( jobs != nullptr ) {
+            jobs->ParallelFor( chunkCount, [ & ]( u32 c ) { fn( chunks[ c ] ); }, ECS_CHUNK_BATCH );
+        } else {
+            for ( u32 c = 0; c < chunkCount; ++c )
+                fn( chunks[ c ] );
+        }
+    }
+}
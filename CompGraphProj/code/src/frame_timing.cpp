@@ -0,0 +1,59 @@
+#include "frame_timing.h"
+
+#include <thread>
+
+// sleeps can overshoot by the scheduler quantum, the rest is spun
+constexpr f64 SPIN_SECONDS = 0.002;
+
+//
+FixedTimestep::FixedTimestep( f64 step, u32 maxStepsPerFrame )
+    : m_step( step ), m_maxStepsPerFrame( maxStepsPerFrame ) {
+}
+
+//
+u32 FixedTimestep::Advance( f64 frameSeconds ) {
+    if ( frameSeconds > 0.0 )
+        m_accumulator += frameSeconds;
+
+    u32 steps = 0;
+    while ( m_accumulator >= m_step && steps < m_maxStepsPerFrame ) {
+        m_accumulator -= m_step;
+        ++steps;
+    }
+    // too far behind, keep only the fraction of a step
+    if ( m_accumulator >= m_step )
+        m_accumulator = m_accumulator - m_step * ( f64 )( u64 )( m_accumulator / m_step );
+    return steps;
+}
+
+//
+void FrameLimiter::SetTargetFps( f64 fps ) {
+    m_period = fps > 0.0 ? 1.0 / fps : 0.0;
+    m_started = false;
+}
+
+//
+void FrameLimiter::Wait() {
+    if ( m_period <= 0.0 )
+        return;
+
+    const FrameClock::time_point now = FrameClock::now();
+    const FrameClock::duration period = std::chrono::duration_cast< FrameClock::duration >( std::chrono::duration< f64 >( m_period ) );
+    if ( !m_started ) {
+        m_deadline = now;
+        m_started = true;
+    }
+
+    m_deadline += period;
+    // a frame that ran more than a period late starts a new schedule instead of rushing to catch up
+    if ( m_deadline < now ) {
+        m_deadline = now;
+        return;
+    }
+
+    const FrameClock::duration spin = std::chrono::duration_cast< FrameClock::duration >( std::chrono::duration< f64 >( SPIN_SECONDS ) );
+    if ( m_deadline - now > spin )
+        std::this_thread::sleep_until( m_deadline - spin );
+    while ( FrameClock::now() < m_deadline )
+        std::this_thread::yield();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "types.h"
+
+#include <chrono>
+
+using FrameClock = std::chrono::steady_clock;
+
+// seconds between two clock samples
+inline f64 SecondsBetween( FrameClock::time_point from, FrameClock::time_point to ) {
+    return std::chrono::duration< f64 >( to - from ).count();
+}
+
+// accumulates real frame time and turns it into a whole number of fixed
+// simulation steps. whatever is left over becomes the interpolation factor
+// between the last two simulated states.
+class FixedTimestep {
+public:
+    explicit FixedTimestep( f64 step, u32 maxStepsPerFrame = 8 );
+
+    // adds frameSeconds and returns how many steps to simulate. after a long
+    // stall at most maxStepsPerFrame steps run and the rest of the backlog is
+    // dropped instead of snowballing.
+    u32 Advance( f64 frameSeconds );
+
+    f64 GetStep() const { return m_step; }
+    // how far the current frame is between the previous and the last step, in [0, 1)
+    f32 GetAlpha() const { return ( f32 )( m_accumulator / m_step ); }
+
+private:
+    f64 m_step;
+    f64 m_accumulator = 0.0;
+    u32 m_maxStepsPerFrame;
+};
+
+// caps the frame rate by sleeping until fixed frame boundaries. deadlines are
+// advanced by exactly one period so pacing does not drift with the frame cost.
+class FrameLimiter {
+public:
+    // fps of 0 disables the cap
+    void SetTargetFps( f64 fps );
+    f64 GetTargetFps() const { return m_period > 0.0 ? 1.0 / m_period : 0.0; }
+
+    // returns at the next frame boundary
+    void Wait();
+
+private:
+    f64                     m_period = 0.0;
+    FrameClock::time_point  m_deadline;
+    bool                    m_started = false;
+};
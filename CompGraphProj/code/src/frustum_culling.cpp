@@ -0,0 +1,201 @@
+#include "frustum_culling.h"
+
+#include "job_system.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// objects per culling job, a multiple of SIMD_WIDTH. large enough that a job
+// is a few microseconds of work, small enough to balance 1M objects.
+constexpr u32 FRUSTUM_BATCH_SIZE = 16384;
+static_assert( FRUSTUM_BATCH_SIZE % SIMD_WIDTH == 0, "culling batches must start on a SIMD group" );
+
+// Gribb-Hartmann: every clip-space bound is a plane in the space of p, made of
+// the matrix columns, e.g. x >= -w is dot( ( p, 1 ), column 3 + column 0 ) >= 0
+Frustum MakeFrustum( const Matrix& clip ) {
+    const f32* r[ 4 ] = { &clip.r[ 0 ].x, &clip.r[ 1 ].x, &clip.r[ 2 ].x, &clip.r[ 3 ].x };
+    // column index and sign per plane, the w column is added to all but near
+    const u32 columns[ 6 ] = { 0, 0, 1, 1, 2, 2 };
+    const f32 signs[ 6 ] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f };
+    const f32 addW[ 6 ] = { 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+
+    Frustum frustum;
+    for ( u32 i = 0; i < 6; ++i ) {
+        f32 plane[ 4 ];
+        for ( u32 k = 0; k < 4; ++k )
+            plane[ k ] = addW[ i ] * r[ k ][ 3 ] + signs[ i ] * r[ k ][ columns[ i ] ];
+        const f32 length = std::sqrt( plane[ 0 ] * plane[ 0 ] + plane[ 1 ] * plane[ 1 ] + plane[ 2 ] * plane[ 2 ] );
+        const f32 scale = length > 0.0f ? 1.0f / length : 0.0f;
+        frustum.m_planes[ i ] = Float4( plane[ 0 ] * scale, plane[ 1 ] * scale, plane[ 2 ] * scale, plane[ 3 ] * scale );
+    }
+    return frustum;
+}
+
+// the same arithmetic in the same order as the SIMD kernel, so both agree
+bool IsSphereOutside( const Frustum& frustum, const Float3& center, f32 radius ) {
+    for ( const Float4& plane : frustum.m_planes ) {
+        const f32 d = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+        if ( d + radius < 0.0f )
+            return true;
+    }
+    return false;
+}
+
+// the box reaches dot( |n|, extent ) towards the plane from its center
+bool IsBoxOutside( const Frustum& frustum, const Float3& center, const Float3& extent ) {
+    for ( const Float4& plane : frustum.m_planes ) {
+        const f32 d = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+        const f32 r = extent.x * std::fabs( plane.x ) + extent.y * std::fabs( plane.y ) + extent.z * std::fabs( plane.z );
+        if ( d + r < 0.0f )
+            return true;
+    }
+    return false;
+}
+
+// projects the 8 corners
+bool GetScreenBounds( const Matrix& clip, const Float3& center, const Float3& extent, Float4& rect, f32& minDepth ) {
+    rect = Float4( 1.0f, 1.0f, -1.0f, -1.0f );
+    minDepth = 1.0f;
+    for ( u32 corner = 0; corner < 8; ++corner ) {
+        const Float3 p( center.x + ( corner & 1 ? extent.x : -extent.x ),
+                        center.y + ( corner & 2 ? extent.y : -extent.y ),
+                        center.z + ( corner & 4 ? extent.z : -extent.z ) );
+        const Float4 c = TransformPoint( p, clip );
+        if ( c.w <= 1e-6f )
+            return false;
+        const f32 invW = 1.0f / c.w;
+        rect = Float4( std::min( rect.x, c.x * invW ), std::min( rect.y, c.y * invW ), std::max( rect.z, c.x * invW ), std::max( rect.w, c.y * invW ) );
+        minDepth = std::min( minDepth, c.z * invW );
+    }
+    minDepth = std::max( minDepth, 0.0f );
+    return true;
+}
+
+//
+bool IsBoxOccluded( const OcclusionTest& occlusion, const Matrix& clip, const Float3& center, const Float3& extent ) {
+    Float4 rect;
+    f32 minDepth;
+    return GetScreenBounds( clip, center, extent, rect, minDepth ) && occlusion.IsOccluded( rect, minDepth );
+}
+
+//
+void CullingBounds::Resize( u32 count ) {
+    const size_t padded = ( count + SIMD_WIDTH - 1 ) / SIMD_WIDTH * SIMD_WIDTH;
+    for ( std::vector< f32 >* v : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ, &m_radius } )
+        v->resize( padded, 0.0f );
+    m_count = count;
+}
+
+//
+void CullingBounds::Set( u32 i, const Float3& center, const Float3& extent, f32 radius ) {
+    m_centerX[ i ] = center.x;
+    m_centerY[ i ] = center.y;
+    m_centerZ[ i ] = center.z;
+    m_extentX[ i ] = extent.x;
+    m_extentY[ i ] = extent.y;
+    m_extentZ[ i ] = extent.z;
+    m_radius[ i ] = radius;
+}
+
+// one SIMD group per iteration: the lanes outside any plane are culled and
+// the others appended to out without branches, every lane writes its index
+// and only the visible ones advance the count
+template< bool Boxes >
+static u32 CullGroups( const CullingBounds& bounds, u32 first, u32 last, const Frustum& frustum, u32* out ) {
+    vf32 nx[ 6 ], ny[ 6 ], nz[ 6 ], nw[ 6 ], ax[ 6 ], ay[ 6 ], az[ 6 ];
+    for ( u32 p = 0; p < 6; ++p ) {
+        const Float4& plane = frustum.m_planes[ p ];
+        nx[ p ] = Splat( plane.x );
+        ny[ p ] = Splat( plane.y );
+        nz[ p ] = Splat( plane.z );
+        nw[ p ] = Splat( plane.w );
+        ax[ p ] = Splat( std::fabs( plane.x ) );
+        ay[ p ] = Splat( std::fabs( plane.y ) );
+        az[ p ] = Splat( std::fabs( plane.z ) );
+    }
+    const vf32 zero = Splat( 0.0f );
+
+    u32 count = 0;
+    for ( u32 i = first; i < last; i += SIMD_WIDTH ) {
+        const vf32 cx = Load( bounds.m_centerX.data() + i );
+        const vf32 cy = Load( bounds.m_centerY.data() + i );
+        const vf32 cz = Load( bounds.m_centerZ.data() + i );
+        vf32 ex = zero, ey = zero, ez = zero, radius = zero;
+        if ( Boxes ) {
+            ex = Load( bounds.m_extentX.data() + i );
+            ey = Load( bounds.m_extentY.data() + i );
+            ez = Load( bounds.m_extentZ.data() + i );
+        } else {
+            radius = Load( bounds.m_radius.data() + i );
+        }
+
+        vf32 outside = zero;    // all bits clear, no lane culled yet
+        for ( u32 p = 0; p < 6; ++p ) {
+            const vf32 d = cx * nx[ p ] + cy * ny[ p ] + cz * nz[ p ] + nw[ p ];
+            const vf32 r = Boxes ? ex * ax[ p ] + ey * ay[ p ] + ez * az[ p ] : radius;
+            outside = outside | CmpLt( d + r, zero );
+        }
+
+        u32 visible = ~MoveMask( outside ) & ( ( 1u << SIMD_WIDTH ) - 1 );
+        if ( last - i < SIMD_WIDTH )
+            visible &= ( 1u << ( last - i ) ) - 1;
+        for ( u32 lane = 0; lane < SIMD_WIDTH; ++lane ) {
+            out[ count ] = i + lane;
+            count += ( visible >> lane ) & 1;
+        }
+    }
+    return count;
+}
+
+//
+u32 CullBounds( const CullingBounds& bounds, u32 first, u32 last, const Frustum& frustum, FrustumTest test, u32* out ) {
+    if ( test == FRUSTUM_TEST_BOXES )
+        return CullGroups< true >( bounds, first, last, frustum, out );
+    return CullGroups< false >( bounds, first, last, frustum, out );
+}
+
+// every batch writes its list at its own first object, then the lists are
+// moved together behind each other, both passes on jobs
+u32 FrustumCuller::Cull( const CullingBounds& bounds, const Frustum& frustum, FrustumTest test, JobSystem* jobs ) {
+    const u32 count = bounds.m_count;
+    const u32 batchCount = ( count + FRUSTUM_BATCH_SIZE - 1 ) / FRUSTUM_BATCH_SIZE;
+    const size_t padded = ( count + SIMD_WIDTH - 1 ) / SIMD_WIDTH * SIMD_WIDTH;
+    if ( m_batchVisible.size() < padded )
+        m_batchVisible.resize( padded );
+    if ( m_visible.size() < count )
+        m_visible.resize( count );
+    m_offsets.resize( batchCount + 1 );
+
+    auto cull = [ & ]( u32 batch ) {
+        const u32 first = batch * FRUSTUM_BATCH_SIZE;
+        const u32 last = std::min( first + FRUSTUM_BATCH_SIZE, count );
+        m_offsets[ batch + 1 ] = CullBounds( bounds, first, last, frustum, test, m_batchVisible.data() + first );
+    };
+    auto compact = [ & ]( u32 batch ) {
+        const u32 visible = m_offsets[ batch + 1 ] - m_offsets[ batch ];
+        memcpy( m_visible.data() + m_offsets[ batch ], m_batchVisible.data() + batch * FRUSTUM_BATCH_SIZE, visible * sizeof( u32 ) );
+    };
+
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( batchCount, cull, 1 );
+    } else {
+        for ( u32 batch = 0; batch < batchCount; ++batch )
+            cull( batch );
+    }
+
+    // counts to offsets
+    m_offsets[ 0 ] = 0;
+    for ( u32 batch = 0; batch < batchCount; ++batch )
+        m_offsets[ batch + 1 ] += m_offsets[ batch ];
+
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( batchCount, compact, 1 );
+    } else {
+        for ( u32 batch = 0; batch < batchCount; ++batch )
+            compact( batch );
+    }
+    m_visibleCount = m_offsets[ batchCount ];
+    return m_visibleCount;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "types.h"
+#include "vecmath.h"
+
+#include <vector>
+
+class JobSystem;
+
+// object-level frustum and occlusion culling. the bounds of every object
+// live in separate arrays per component, so one SIMD register holds the same
+// component of SIMD_WIDTH objects (8 with AVX2, 4 with SSE2) and the six
+// plane tests run on all of them at once. the result is a compact list of the visible
+// objects' indices in ascending order, ready to be turned into draws or
+// instances.
+
+// the six planes of a view volume, normalized, inside >= 0:
+// dot( plane.xyz, p ) + plane.w is the signed distance of p
+struct Frustum {
+    Float4  m_planes[ 6 ];      // left, right, bottom, top, near, far
+};
+
+// the planes of clip = ( p, 1 ) * clip in the space of p, with D3D's 0 <= z <= w.
+// a view-projection matrix gives them in world space.
+Frustum MakeFrustum( const Matrix& clip );
+
+// conservative tests, true when the volume is entirely outside one plane
+bool IsSphereOutside( const Frustum& frustum, const Float3& center, f32 radius );
+bool IsBoxOutside( const Frustum& frustum, const Float3& center, const Float3& extent );
+
+// screen-space visibility of bounds that survived the frustum test, e.g.
+// against a depth buffer of the occluders. rect is the bounds' NDC rectangle
+// (min x, min y, max x, max y) and minDepth its nearest z / w. called from
+// culling jobs concurrently.
+class OcclusionTest {
+public:
+    virtual ~OcclusionTest() = default;
+    // true only when everything in rect is known to be in front of minDepth
+    virtual bool IsOccluded( const Float4& rect, f32 minDepth ) const = 0;
+};
+
+// NDC rectangle and nearest depth of a box under clip, false when the box
+// reaches behind the camera and has no finite rectangle
+bool GetScreenBounds( const Matrix& clip, const Float3& center, const Float3& extent, Float4& rect, f32& minDepth );
+// boxes without a screen rectangle are never occluded
+bool IsBoxOccluded( const OcclusionTest& occlusion, const Matrix& clip, const Float3& center, const Float3& extent );
+
+// an axis-aligned box and a bounding sphere about the same center per object.
+// the arrays are padded to a multiple of SIMD_WIDTH; the padding is loaded
+// but never reported.
+struct CullingBounds {
+    std::vector< f32 >  m_centerX, m_centerY, m_centerZ;
+    std::vector< f32 >  m_extentX, m_extentY, m_extentZ;    // box half size
+    std::vector< f32 >  m_radius;
+    u32                 m_count = 0;
+
+    void Resize( u32 count );
+    void Set( u32 i, const Float3& center, const Float3& extent, f32 radius );
+    // a box that holds the sphere
+    void SetSphere( u32 i, const Float3& center, f32 radius ) { Set( i, center, Float3( radius, radius, radius ), radius ); }
+};
+
+enum FrustumTest {
+    FRUSTUM_TEST_SPHERES,   // 3 multiply-adds per plane
+    FRUSTUM_TEST_BOXES,     // 3 more per plane, tighter for long or flat objects
+};
+
+// one pass over the bounds per call. the buffers are kept across calls, so
+// per-frame culling does not allocate.
+class FrustumCuller {
+public:
+    // returns the number of visible objects, split over jobs when given
+    u32 Cull( const CullingBounds& bounds, const Frustum& frustum, FrustumTest test = FRUSTUM_TEST_BOXES, JobSystem* jobs = nullptr );
+
+    const u32* GetVisible() const { return m_visible.data(); }
+    u32 GetVisibleCount() const { return m_visibleCount; }
+
+private:
+    std::vector< u32 >  m_batchVisible;     // every batch's list at its first object
+    std::vector< u32 >  m_offsets;          // first output index per batch
+    std::vector< u32 >  m_visible;
+    u32                 m_visibleCount = 0;
+};
+
+// the SIMD kernel on objects [ first, last ), first a multiple of SIMD_WIDTH.
+// writes the visible indices to out, which needs room for last - first
+// rounded up to SIMD_WIDTH, and returns their number.
+u32 CullBounds( const CullingBounds& bounds, u32 first, u32 last, const Frustum& frustum, FrustumTest test, u32* out );
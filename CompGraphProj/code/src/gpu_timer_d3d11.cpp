@@ -0,0 +1,129 @@
+#include "gpu_timer_d3d11.h"
+
+//
+HRESULT D3D11GpuTimer::Initialize( ID3D11Device* device, const char* const* passNames, u32 passCount ) {
+    m_passCount = passCount < MAX_PASSES ? passCount : MAX_PASSES;
+    for ( u32 i = 0; i < m_passCount; ++i )
+        m_passNames[ i ] = passNames[ i ];
+
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+    for ( FrameQueries& frame : m_frames ) {
+        HRESULT result = device->CreateQuery( &disjointDesc, &frame.m_disjoint );
+        if ( FAILED( result ) )
+            return result;
+        for ( u32 i = 0; i <= m_passCount; ++i ) {
+            result = device->CreateQuery( &timestampDesc, &frame.m_timestamps[ i ] );
+            if ( FAILED( result ) )
+                return result;
+        }
+    }
+
+    // GPU passes go on their own timeline next to the CPU threads
+    if ( m_track == nullptr )
+        m_track = ProfilerCreateTrack( "GPU" );
+    m_profilerTicksPerSecond = ProfilerTicksPerSecond();
+    return S_OK;
+}
+
+//
+void D3D11GpuTimer::Release() {
+    for ( FrameQueries& frame : m_frames ) {
+        if ( frame.m_disjoint )
+            frame.m_disjoint->Release();
+        for ( ID3D11Query*& timestamp : frame.m_timestamps ) {
+            if ( timestamp )
+                timestamp->Release();
+            timestamp = nullptr;
+        }
+        frame = FrameQueries();
+    }
+    m_current = 0;
+    m_oldest = 0;
+    m_recording = false;
+}
+
+//
+void D3D11GpuTimer::BeginFrame( ID3D11DeviceContext* context ) {
+    m_frameCount++;
+    m_recording = false;
+    if ( m_frames[ 0 ].m_disjoint == nullptr )
+        return;
+
+    Collect( context );
+
+    // all FRAMES_IN_FLIGHT sets still in flight: skip this frame instead of waiting
+    FrameQueries& frame = m_frames[ m_current ];
+    if ( frame.m_pending )
+        return;
+
+    frame.m_cpuBegin = ProfilerTimestamp();
+    frame.m_frame = m_frameCount;
+    context->Begin( frame.m_disjoint );
+    context->End( frame.m_timestamps[ 0 ] );
+    m_recording = true;
+}
+
+//
+void D3D11GpuTimer::EndPass( ID3D11DeviceContext* context, u32 pass ) {
+    if ( m_recording && pass < m_passCount )
+        context->End( m_frames[ m_current ].m_timestamps[ pass + 1 ] );
+}
+
+//
+void D3D11GpuTimer::EndFrame( ID3D11DeviceContext* context ) {
+    if ( !m_recording )
+        return;
+
+    FrameQueries& frame = m_frames[ m_current ];
+    context->End( frame.m_disjoint );
+    frame.m_pending = true;
+    m_current = ( m_current + 1 ) % FRAMES_IN_FLIGHT;
+    m_recording = false;
+}
+
+//
+void D3D11GpuTimer::Collect( ID3D11DeviceContext* context ) {
+    while ( m_frames[ m_oldest ].m_pending ) {
+        if ( !Resolve( context, m_frames[ m_oldest ] ) )
+            return;
+        m_frames[ m_oldest ].m_pending = false;
+        m_oldest = ( m_oldest + 1 ) % FRAMES_IN_FLIGHT;
+    }
+}
+
+//
+bool D3D11GpuTimer::Resolve( ID3D11DeviceContext* context, FrameQueries& frame ) {
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+    if ( context->GetData( frame.m_disjoint, &disjoint, sizeof( disjoint ), D3D11_ASYNC_GETDATA_DONOTFLUSH ) != S_OK )
+        return false;
+
+    u64 timestamps[ MAX_PASSES + 1 ];
+    for ( u32 i = 0; i <= m_passCount; ++i ) {
+        if ( context->GetData( frame.m_timestamps[ i ], &timestamps[ i ], sizeof( u64 ), D3D11_ASYNC_GETDATA_DONOTFLUSH ) != S_OK )
+            return false;
+    }
+
+    // the GPU clock changed frequency mid-frame, the numbers are meaningless
+    if ( disjoint.Disjoint || disjoint.Frequency == 0 )
+        return true;
+
+    StageTimings timings;
+    timings.m_frame = frame.m_frame;
+    const f64 toMs = 1000.0 / ( f64 )disjoint.Frequency;
+    for ( u32 i = 0; i < m_passCount; ++i )
+        timings.Add( m_passNames[ i ], ( f64 )( timestamps[ i + 1 ] - timestamps[ i ] ) * toMs );
+    m_timings = timings;
+
+    // D3D11 cannot correlate the two clocks, so the GPU frame is placed at its
+    // CPU submit time (or after the previous GPU frame) with GPU-measured durations
+    const f64 toTicks = m_profilerTicksPerSecond / ( f64 )disjoint.Frequency;
+    u64 begin = frame.m_cpuBegin > m_lastGpuEnd ? frame.m_cpuBegin : m_lastGpuEnd;
+    for ( u32 i = 0; i < m_passCount; ++i ) {
+        const u64 end = begin + ( u64 )( ( f64 )( timestamps[ i + 1 ] - timestamps[ i ] ) * toTicks );
+        ProfilerRecord( m_track, m_passNames[ i ], begin, end );
+        begin = end;
+    }
+    m_lastGpuEnd = begin;
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "profiler.h"
+#include "render_backend.h"
+
+#include <d3d11.h>
+
+// per-pass GPU time from D3D11 timestamp queries. every frame brackets its
+// passes with a TIMESTAMP_DISJOINT query; results are polled without flushing
+// and read FRAMES_IN_FLIGHT frames later at the earliest, so the CPU never
+// waits on the GPU. frames whose queries are still busy go unmeasured.
+class D3D11GpuTimer {
+public:
+    static constexpr u32 MAX_PASSES = 4;
+    static constexpr u32 FRAMES_IN_FLIGHT = 4;
+
+    // passNames are string literals, one per EndPass call of a frame
+    HRESULT Initialize( ID3D11Device* device, const char* const* passNames, u32 passCount );
+    void Release();
+
+    void BeginFrame( ID3D11DeviceContext* context );
+    // closes pass index, passes run back to back in index order
+    void EndPass( ID3D11DeviceContext* context, u32 pass );
+    void EndFrame( ID3D11DeviceContext* context );
+
+    // GPU milliseconds per pass of the newest frame read back
+    const StageTimings& GetTimings() const { return m_timings; }
+
+private:
+    struct FrameQueries {
+        ID3D11Query*    m_disjoint = nullptr;
+        ID3D11Query*    m_timestamps[ MAX_PASSES + 1 ] = {};
+        u64             m_cpuBegin = 0;     // profiler ticks when the frame was submitted
+        u64             m_frame = 0;
+        bool            m_pending = false;
+    };
+
+    // reads back finished frames, oldest first, and stops at the first busy one
+    void Collect( ID3D11DeviceContext* context );
+    bool Resolve( ID3D11DeviceContext* context, FrameQueries& frame );
+
+    FrameQueries        m_frames[ FRAMES_IN_FLIGHT ];
+    const char*         m_passNames[ MAX_PASSES ] = {};
+    u32                 m_passCount = 0;
+    u32                 m_current = 0;
+    u32                 m_oldest = 0;
+    bool                m_recording = false;
+    u64                 m_frameCount = 0;
+
+    StageTimings        m_timings;
+    ProfileTrack*       m_track = nullptr;
+    f64                 m_profilerTicksPerSecond = 0.0;
+    u64                 m_lastGpuEnd = 0;
+};
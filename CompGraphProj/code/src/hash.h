@@ -0,0 +1,29 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <cstring>
+
+// 64-bit FNV-1a, for cache keys that are written to disk and must not depend
+// on the platform or the standard library
+constexpr u64 HASH_SEED = 0xcbf29ce484222325ull;
+constexpr u64 HASH_PRIME = 0x100000001b3ull;
+
+inline u64 HashBytes( u64 hash, const void* data, size_t size ) {
+    const u8* bytes = ( const u8* )data;
+    for ( size_t i = 0; i < size; ++i ) {
+        hash ^= bytes[ i ];
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
+
+// strings are hashed with their terminator, so "a" + "bc" differs from "ab" + "c"
+inline u64 HashString( u64 hash, const char* text ) {
+    return HashBytes( hash, text != nullptr ? text : "", text != nullptr ? strlen( text ) + 1 : 1 );
+}
+
+inline u64 HashU32( u64 hash, u32 value ) {
+    return HashBytes( hash, &value, sizeof( value ) );
+}
@@ -0,0 +1,255 @@
+#include "job_system.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// rounds an idle worker polls the deques before it goes to sleep
+constexpr u32 IDLE_SPIN_ROUNDS = 64;
+
+struct WorkerBinding {
+    const JobSystem*    m_system = nullptr;
+    u32                 m_index = 0;
+};
+static thread_local WorkerBinding t_worker;
+
+//
+static void PinThread( std::thread::native_handle_type thread, u32 cpu ) {
+#ifdef _WIN32
+    SetThreadAffinityMask( ( HANDLE )thread, ( DWORD_PTR )1 << ( cpu % ( 8 * sizeof( DWORD_PTR ) ) ) );
+#else
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CPU_SET( cpu % CPU_SETSIZE, &set );
+    pthread_setaffinity_np( thread, sizeof( set ), &set );
+#endif
+}
+
+//
+static std::thread::native_handle_type GetCurrentThreadHandle() {
+#ifdef _WIN32
+    return GetCurrentThread();
+#else
+    return pthread_self();
+#endif
+}
+
+//
+u32 JobCounter::Lock() {
+    for ( ;; ) {
+        u32 value = m_value.load( std::memory_order_relaxed );
+        if ( ( value & LOCKED ) == 0
+             && m_value.compare_exchange_weak( value, value | LOCKED, std::memory_order_acquire, std::memory_order_relaxed ) )
+            return value;
+        std::this_thread::yield();
+    }
+}
+
+//
+JobSystem::JobSystem( u32 threadCount, bool pinThreads ) {
+    const u32 hardwareThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    m_workerCount = threadCount != 0 ? threadCount : hardwareThreads;
+    m_workers.reset( new Worker[ m_workerCount ] );
+    for ( u32 i = 0; i < m_workerCount; ++i )
+        m_workers[ i ].m_random = 0x9E3779B9u * ( i + 1 );
+
+    m_ownerThread = std::this_thread::get_id();
+    if ( pinThreads )
+        PinThread( GetCurrentThreadHandle(), 0 );
+
+    m_threads.reserve( m_workerCount - 1 );
+    for ( u32 i = 1; i < m_workerCount; ++i ) {
+        m_threads.emplace_back( &JobSystem::WorkerMain, this, i );
+        if ( pinThreads )
+            PinThread( m_threads.back().native_handle(), i % hardwareThreads );
+    }
+}
+
+//
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard< std::mutex > lock( m_sleepMutex );
+        m_quit.store( true );
+    }
+    m_wake.notify_all();
+    for ( std::thread& thread : m_threads )
+        thread.join();
+}
+
+//
+u32 JobSystem::GetWorkerIndex() const {
+    if ( t_worker.m_system == this )
+        return t_worker.m_index;
+    return std::this_thread::get_id() == m_ownerThread ? 0 : m_workerCount;
+}
+
+//
+void JobSystem::WorkerMain( u32 index ) {
+    t_worker.m_system = this;
+    t_worker.m_index = index;
+
+    char name[ 32 ];
+    snprintf( name, sizeof( name ), "worker %u", index );
+    ProfilerSetThreadName( name );
+
+    u32 idleRounds = 0;
+    while ( !m_quit.load( std::memory_order_relaxed ) ) {
+        if ( Job* job = FindJob( index ) ) {
+            Execute( job );
+            idleRounds = 0;
+            continue;
+        }
+        if ( ++idleRounds < IDLE_SPIN_ROUNDS ) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock< std::mutex > lock( m_sleepMutex );
+        m_sleepingWorkers.fetch_add( 1 );
+        m_wake.wait( lock, [ this ] { return m_quit.load() || m_queuedJobs.load() > 0; } );
+        m_sleepingWorkers.fetch_sub( 1 );
+        idleRounds = 0;
+    }
+}
+
+//
+void JobSystem::Wake( u32 jobCount ) {
+    if ( m_sleepingWorkers.load() == 0 )
+        return;
+
+    // taking the mutex orders the notify after a sleeper's predicate check
+    { std::lock_guard< std::mutex > lock( m_sleepMutex ); }
+    if ( jobCount > 1 )
+        m_wake.notify_all();
+    else
+        m_wake.notify_one();
+}
+
+//
+void JobSystem::Submit( u32 worker, const JobDecl& decl, JobCounter* counter ) {
+    if ( worker < m_workerCount ) {
+        Worker& owner = m_workers[ worker ];
+        Job& job = owner.m_jobs[ owner.m_nextJob++ & ( JOBS_PER_WORKER - 1 ) ];
+        if ( !job.m_busy.load( std::memory_order_acquire ) ) {
+            job.m_decl = decl;
+            job.m_counter = counter;
+            job.m_busy.store( true, std::memory_order_relaxed );
+            m_queuedJobs.fetch_add( 1 );
+            if ( owner.m_deque.Push( &job ) )
+                return;
+            m_queuedJobs.fetch_sub( 1 );
+            job.m_busy.store( false, std::memory_order_relaxed );
+        }
+    }
+
+    // not a worker, or its queue is full: run it here
+    decl.m_function( decl.m_data, decl.m_begin, decl.m_end );
+    Finish( counter );
+}
+
+//
+JobSystem::Job* JobSystem::FindJob( u32 worker ) {
+    Worker& self = m_workers[ worker ];
+    Job* job = self.m_deque.Pop();
+    if ( job == nullptr && m_workerCount > 1 ) {
+        // start at a random victim so thieves spread over the workers
+        self.m_random ^= self.m_random << 13;
+        self.m_random ^= self.m_random >> 17;
+        self.m_random ^= self.m_random << 5;
+        const u32 first = self.m_random % m_workerCount;
+        for ( u32 i = 0; i < m_workerCount && job == nullptr; ++i ) {
+            const u32 victim = ( first + i ) % m_workerCount;
+            if ( victim != worker )
+                job = m_workers[ victim ].m_deque.Steal();
+        }
+    }
+    if ( job != nullptr )
+        m_queuedJobs.fetch_sub( 1 );
+    return job;
+}
+
+//
+void JobSystem::Execute( Job* job ) {
+    // copy out and free the slot first, the job may submit more work
+    const JobDecl decl = job->m_decl;
+    JobCounter* counter = job->m_counter;
+    job->m_busy.store( false, std::memory_order_release );
+
+    decl.m_function( decl.m_data, decl.m_begin, decl.m_end );
+    Finish( counter );
+}
+
+//
+void JobSystem::Finish( JobCounter* counter ) {
+    if ( counter == nullptr )
+        return;
+
+    std::vector< JobCounter::Continuation > released;
+    const u32 value = counter->Lock();
+    if ( value == 1 )
+        released.swap( counter->m_continuations );
+    counter->Unlock( value - 1 );
+
+    const u32 worker = GetWorkerIndex();
+    for ( const JobCounter::Continuation& continuation : released )
+        Submit( worker, continuation.m_job, continuation.m_counter );
+    Wake( ( u32 )released.size() );
+}
+
+//
+void JobSystem::Run( const JobDecl* jobs, u32 count, JobCounter* counter ) {
+    if ( count == 0 )
+        return;
+    if ( counter != nullptr )
+        counter->Unlock( counter->Lock() + count );
+
+    const u32 worker = GetWorkerIndex();
+    for ( u32 i = 0; i < count; ++i )
+        Submit( worker, jobs[ i ], counter );
+    Wake( count );
+}
+
+//
+void JobSystem::RunAfter( JobCounter& dependency, const JobDecl* jobs, u32 count, JobCounter* counter ) {
+    if ( count == 0 )
+        return;
+    if ( counter != nullptr )
+        counter->Unlock( counter->Lock() + count );
+
+    const u32 value = dependency.Lock();
+    if ( value != 0 ) {
+        for ( u32 i = 0; i < count; ++i )
+            dependency.m_continuations.push_back( { jobs[ i ], counter } );
+        dependency.Unlock( value );
+        return;
+    }
+    dependency.Unlock( value );
+
+    const u32 worker = GetWorkerIndex();
+    for ( u32 i = 0; i < count; ++i )
+        Submit( worker, jobs[ i ], counter );
+    Wake( count );
+}
+
+//
+void JobSystem::Wait( JobCounter& counter ) {
+    const u32 worker = GetWorkerIndex();
+    while ( !counter.IsDone() ) {
+        Job* job = worker < m_workerCount ? FindJob( worker ) : nullptr;
+        if ( job != nullptr )
+            Execute( job );
+        else
+            std::this_thread::yield();
+    }
+}
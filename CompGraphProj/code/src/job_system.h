@@ -0,0 +1,219 @@
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a job is one call of m_function( m_data, m_begin, m_end )
+using JobFunction = void ( * )( void* data, u32 begin, u32 end );
+
+struct JobDecl {
+    JobFunction m_function = nullptr;
+    void*       m_data = nullptr;
+    u32         m_begin = 0;
+    u32         m_end = 1;
+};
+
+// counts unfinished jobs. Wait() on it, or make other jobs depend on it with
+// JobSystem::RunAfter. a counter must outlive every job that references it.
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter( const JobCounter& ) = delete;
+    JobCounter& operator=( const JobCounter& ) = delete;
+
+    bool IsDone() const { return m_value.load( std::memory_order_acquire ) == 0; }
+
+private:
+    friend class JobSystem;
+
+    struct Continuation {
+        JobDecl     m_job;
+        JobCounter* m_counter;
+    };
+
+    // the top bit of m_value locks m_continuations. the store that unlocks is
+    // the last access of a finishing job, so a waiter that sees zero may
+    // destroy the counter right away.
+    static constexpr u32 LOCKED = 0x80000000u;
+
+    u32 Lock();
+    void Unlock( u32 value ) { m_value.store( value, std::memory_order_release ); }
+
+    std::atomic< u32 >          m_value{ 0 };
+    // jobs released when the count drops to zero
+    std::vector< Continuation > m_continuations;
+};
+
+// Chase-Lev work-stealing deque of job pointers. the owning worker pushes and
+// pops at the bottom, every other worker steals from the top.
+template< typename T, u32 Capacity >
+class WorkStealingDeque {
+    static_assert( ( Capacity & ( Capacity - 1 ) ) == 0, "capacity must be a power of two" );
+
+public:
+    // owner only, false when full
+    bool Push( T* item ) {
+        const i64 bottom = m_bottom.load( std::memory_order_relaxed );
+        const i64 top = m_top.load( std::memory_order_acquire );
+        if ( bottom - top >= ( i64 )Capacity )
+            return false;
+        m_items[ bottom & ( Capacity - 1 ) ].store( item, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+        m_bottom.store( bottom + 1, std::memory_order_relaxed );
+        return true;
+    }
+
+    // owner only, newest item first
+    T* Pop() {
+        const i64 bottom = m_bottom.load( std::memory_order_relaxed ) - 1;
+        m_bottom.store( bottom, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        i64 top = m_top.load( std::memory_order_relaxed );
+        if ( top > bottom ) {
+            m_bottom.store( bottom + 1, std::memory_order_relaxed );
+            return nullptr;
+        }
+
+        T* item = m_items[ bottom & ( Capacity - 1 ) ].load( std::memory_order_relaxed );
+        if ( top == bottom ) {
+            // last item, race the thieves for it
+            if ( !m_top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+                item = nullptr;
+            m_bottom.store( bottom + 1, std::memory_order_relaxed );
+        }
+        return item;
+    }
+
+    // any thread, oldest item first
+    T* Steal() {
+        i64 top = m_top.load( std::memory_order_acquire );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        const i64 bottom = m_bottom.load( std::memory_order_acquire );
+        if ( top >= bottom )
+            return nullptr;
+
+        T* item = m_items[ top & ( Capacity - 1 ) ].load( std::memory_order_relaxed );
+        if ( !m_top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+            return nullptr;
+        return item;
+    }
+
+private:
+    alignas( 64 ) std::atomic< i64 > m_top{ 0 };
+    alignas( 64 ) std::atomic< i64 > m_bottom{ 0 };
+    std::atomic< T* >               m_items[ Capacity ] = {};
+};
+
+// work-stealing job system. every worker owns a deque; jobs are pushed to the
+// submitting worker's deque and idle workers steal from the others. the thread
+// that created the system is worker 0 and runs jobs while it waits, so a
+// system created with one thread runs everything inline. jobs may submit and
+// wait on further jobs. threads that are not workers run their jobs inline.
+class JobSystem {
+public:
+    // threadCount includes the calling thread, 0 means one per hardware thread.
+    // pinThreads binds worker i to hardware thread i.
+    explicit JobSystem( u32 threadCount = 0, bool pinThreads = false );
+    ~JobSystem();
+
+    JobSystem( const JobSystem& ) = delete;
+    JobSystem& operator=( const JobSystem& ) = delete;
+
+    u32 GetThreadCount() const { return m_workerCount; }
+    // index of the calling worker, GetThreadCount() for threads outside the system
+    u32 GetWorkerIndex() const;
+
+    // queues count jobs; counter, when given, is incremented now and decremented as each job finishes
+    void Run( const JobDecl* jobs, u32 count, JobCounter* counter );
+    // queues the jobs once dependency reaches zero, right away if it already has
+    void RunAfter( JobCounter& dependency, const JobDecl* jobs, u32 count, JobCounter* counter );
+    // runs queued jobs until counter reaches zero
+    void Wait( JobCounter& counter );
+
+    // calls fn( index ) for every index in [0, count) and returns once all calls finished.
+    // batchSize indices go to one job, 0 picks a size that gives every worker a few jobs.
+    template< typename Func >
+    void ParallelFor( u32 count, const Func& fn, u32 batchSize = 0 );
+
+private:
+    struct Job {
+        JobDecl             m_decl;
+        JobCounter*         m_counter = nullptr;
+        std::atomic< bool > m_busy{ false };
+    };
+
+    static constexpr u32 JOBS_PER_WORKER = 1024;
+
+    struct alignas( 64 ) Worker {
+        WorkStealingDeque< Job, JOBS_PER_WORKER > m_deque;
+        // slots are handed out round-robin and freed when their job starts
+        Job         m_jobs[ JOBS_PER_WORKER ];
+        u32         m_nextJob = 0;
+        u32         m_random = 1;
+    };
+
+    void WorkerMain( u32 index );
+    void Submit( u32 worker, const JobDecl& decl, JobCounter* counter );
+    // pops from the worker's own deque or steals from another one
+    Job* FindJob( u32 worker );
+    void Execute( Job* job );
+    void Finish( JobCounter* counter );
+    void Wake( u32 jobCount );
+
+    u32                             m_workerCount = 1;
+    std::unique_ptr< Worker[] >     m_workers;
+    std::vector< std::thread >      m_threads;
+    std::thread::id                 m_ownerThread;
+
+    // idle workers sleep until m_queuedJobs is non-zero
+    std::atomic< i32 >              m_queuedJobs{ 0 };
+    std::atomic< u32 >              m_sleepingWorkers{ 0 };
+    std::atomic< bool >             m_quit{ false };
+    std::mutex                      m_sleepMutex;
+    std::condition_variable         m_wake;
+};
+
+//
+template< typename Func >
+void JobSystem::ParallelFor( u32 count, const Func& fn, u32 batchSize ) {
+    if ( count == 0 )
+        return;
+    if ( batchSize == 0 )
+        batchSize = count > m_workerCount * 4 ? count / ( m_workerCount * 4 ) : 1;
+
+    // nothing to share, skip the queues
+    if ( m_workerCount == 1 || count <= batchSize || GetWorkerIndex() == m_workerCount ) {
+        for ( u32 i = 0; i < count; ++i )
+            fn( i );
+        return;
+    }
+
+    const JobFunction function = []( void* data, u32 begin, u32 end ) {
+        const Func& body = *( const Func* )data;
+        for ( u32 i = begin; i < end; ++i )
+            body( i );
+    };
+
+    // submitted in slices so a large count never needs more job slots than a worker has
+    JobCounter counter;
+    JobDecl decls[ 64 ];
+    u32 next = 0;
+    while ( next < count ) {
+        u32 declCount = 0;
+        for ( ; declCount < 64 && next < count; ++declCount ) {
+            decls[ declCount ].m_function = function;
+            decls[ declCount ].m_data = ( void* )&fn;
+            decls[ declCount ].m_begin = next;
+            decls[ declCount ].m_end = count - next > batchSize ? next + batchSize : count;
+            next = decls[ declCount ].m_end;
+        }
+        Run( decls, declCount, &counter );
+    }
+    Wait( counter );
+}
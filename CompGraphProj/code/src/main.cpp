@@ -1,53 +1,360 @@
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifndef COMPGRAPH_HEADLESS
 #include <SDL.h>
 #include <SDL_syswm.h>
+#endif
 
-#include <d3d11.h>
-#include <d3dcompiler.h>
+#include "backend_software.h"
+#include "benchmark_report.h"
+#include "frame_timing.h"
+#include "mesh_import.h"
+#include "profiler.h"
+#include "render_backend.h"
+#include "scene.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const u32 Width = 1366;
+const u32 Height = 768;
+
+struct AppOptions {
+    bool    m_software = false;     // --software: render on the CPU
+    bool    m_headless = false;     // --headless: no window, software backend only
+    u32     m_frames = 1000;        // --frames N: frame count for headless runs
+    u32     m_threads = 0;          // --threads N: job system workers, 0 = all cores
+    bool    m_pin = false;          // --pin: bind each worker to one hardware thread
+    u32     m_cubes = 0;            // --cubes N: instanced field of N cubes instead of the single cube
+    PositionEncoding m_vertexFormat = POSITION_FLOAT32;    // --vertex-format float32|half|snorm16: quantize the cube at load
+    const char* m_meshPath = nullptr;   // --mesh FILE: .obj, .gltf, .glb or quantize_mesh output drawn instead of the cube
+    bool    m_perObject = false;    // --per-object: D3D11 draws the cubes one by one instead of instanced
+    bool    m_clusterCull = false;  // --cluster-cull: draw only the meshlets of the object that can be visible
+    bool    m_frustumCull = false;  // --frustum-cull: draw only the cubes of --cubes inside the view
+    bool    m_bvh = false;          // --bvh: frustum cull the cubes through a BVH over their boxes
+    bool    m_occlusionCull = false;    // --occlusion-cull: skip the cubes hidden behind the nearest ones
+    bool    m_vsync = false;        // --vsync: present on vertical blank
+    u32     m_buffers = 2;          // --buffers N: swap chain buffers, 2 or 3
+    u32     m_latency = 1;          // --latency N: frames queued ahead of the display
+    bool    m_tearing = false;      // --tearing: D3D11 immediate presents may tear
+    u32     m_fpsCap = 0;           // --fps N: frame cap for windowed runs, 0 = uncapped
+    const char* m_tracePath = nullptr;  // --trace FILE: write a Chrome trace on exit, F9 writes one any time
+    bool    m_benchmark = false;    // --benchmark: --frames fixed steps without vsync, then a JSON report
+    u32     m_warmup = 10;          // --warmup N: benchmark frames run before measuring
+    const char* m_jsonPath = nullptr;   // --json FILE: benchmark report file, stdout by default
+};
 
-#include <DirectXMath.h>
+// what the frame loop animates: the single rotating cube or an instanced cube field
+struct AppScene {
+    Scene           m_cube;
+    CubeFieldScene  m_field;
+    bool            m_instanced = false;
+    PositionEncoding m_vertexFormat = POSITION_FLOAT32;    // of the object's positions
+};
 
-using u8 = uint8_t;
-using u16 = uint16_t;
-using i16 = int16_t;
-using u32 = uint32_t;
-using i32 = int32_t;
-using f32 = float;
-using f64 = double;
+//
+static AppOptions ParseOptions( i32 argc, char** argv ) {
+    AppOptions options;
+    for ( i32 i = 1; i < argc; ++i ) {
+        if ( strcmp( argv[ i ], "--software" ) == 0 )
+            options.m_software = true;
+        else if ( strcmp( argv[ i ], "--headless" ) == 0 )
+            options.m_headless = true;
+        else if ( strcmp( argv[ i ], "--frames" ) == 0 && i + 1 < argc )
+            options.m_frames = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+        else if ( strcmp( argv[ i ], "--threads" ) == 0 && i + 1 < argc )
+            options.m_threads = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+        else if ( strcmp( argv[ i ], "--pin" ) == 0 )
+            options.m_pin = true;
+        else if ( strcmp( argv[ i ], "--per-object" ) == 0 )
+            options.m_perObject = true;
+        else if ( strcmp( argv[ i ], "--cluster-cull" ) == 0 )
+            options.m_clusterCull = true;
+        else if ( strcmp( argv[ i ], "--frustum-cull" ) == 0 )
+            options.m_frustumCull = true;
+        else if ( strcmp( argv[ i ], "--bvh" ) == 0 )
+            options.m_bvh = true;
+        else if ( strcmp( argv[ i ], "--occlusion-cull" ) == 0 )
+            options.m_occlusionCull = true;
+        else if ( strcmp( argv[ i ], "--cubes" ) == 0 && i + 1 < argc )
+            options.m_cubes = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+        else if ( strcmp( argv[ i ], "--vertex-format" ) == 0 && i + 1 < argc ) {
+            if ( !ParsePositionEncoding( argv[ ++i ], options.m_vertexFormat ) )
+                printf( "unknown vertex format %s, using float32\n", argv[ i ] );
+        } else if ( strcmp( argv[ i ], "--mesh" ) == 0 && i + 1 < argc )
+            options.m_meshPath = argv[ ++i ];
+        else if ( strcmp( argv[ i ], "--vsync" ) == 0 )
+            options.m_vsync = true;
+        else if ( strcmp( argv[ i ], "--fps" ) == 0 && i + 1 < argc )
+            options.m_fpsCap = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+        else if ( strcmp( argv[ i ], "--buffers" ) == 0 && i + 1 < argc )
+            options.m_buffers = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+        else if ( strcmp( argv[ i ], "--latency" ) == 0 && i + 1 < argc )
+            options.m_latency = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+        else if ( strcmp( argv[ i ], "--tearing" ) == 0 )
+            options.m_tearing = true;
+        else if ( strcmp( argv[ i ], "--trace" ) == 0 && i + 1 < argc )
+            options.m_tracePath = argv[ ++i ];
+        else if ( strcmp( argv[ i ], "--benchmark" ) == 0 )
+            options.m_benchmark = true;
+        else if ( strcmp( argv[ i ], "--warmup" ) == 0 && i + 1 < argc )
+            options.m_warmup = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+        else if ( strcmp( argv[ i ], "--json" ) == 0 && i + 1 < argc )
+            options.m_jsonPath = argv[ ++i ];
+    }
 
-struct Vertex {
-    DirectX::XMFLOAT3 m_pos;
-    DirectX::XMFLOAT4 m_color;
-};
+#ifndef COMPGRAPH_HAS_D3D11
+    options.m_software = true;
+#endif
+#ifdef COMPGRAPH_HEADLESS
+    options.m_headless = true;
+#endif
+    if ( options.m_headless )
+        options.m_software = true;
+
+    // benchmarks measure the renderer, not the display: no vsync, no cap, and
+    // no window for the software backend
+    if ( options.m_benchmark ) {
+        options.m_vsync = false;
+        options.m_fpsCap = 0;
+        if ( options.m_software )
+            options.m_headless = true;
+    }
+    return options;
+}
 
-struct ConstantBuffer
-{
-    DirectX::XMMATRIX m_modelMatrix;
-};
+//
+static PresentDesc GetPresentDesc( const AppOptions& options ) {
+    PresentDesc present;
+    present.m_bufferCount = options.m_buffers;
+    present.m_maxFrameLatency = options.m_latency;
+    present.m_vsync = options.m_vsync;
+    present.m_allowTearing = options.m_tearing;
+    return present;
+}
+
+// .obj, .gltf and .glb go through the mesh cache and are fitted into the cube's
+// box, then quantized like the cube when --vertex-format asks for it
+static bool CreateImportedObject( AppScene& scene, const AppOptions& options, RenderBackend& backend, JobSystem& jobs ) {
+    const FrameClock::time_point start = FrameClock::now();
+    LoadedMesh mesh;
+    if ( !LoadMesh( options.m_meshPath, mesh, &jobs ) ) {
+        printf( "could not load mesh %s\n", options.m_meshPath );
+        return false;
+    }
+    printf( "%s: %u vertices, %u triangles, %s in %.1f ms\n", options.m_meshPath, mesh.GetMesh().m_vertexCount, mesh.GetMesh().m_indexCount / 3,
+        mesh.IsMapped() ? "cached" : "imported", SecondsBetween( start, FrameClock::now() ) * 1000.0 );
+    scene.m_cube.m_objectTransform = GetFitTransform( mesh.GetBoundsMin(), mesh.GetBoundsMax() );
+
+    if ( options.m_vertexFormat == POSITION_FLOAT32 )
+        return backend.CreateObject( mesh.GetMesh() );
+    QuantizeDesc quantize;
+    quantize.m_position = options.m_vertexFormat;
+    QuantizedMesh quantized;
+    QuantizeMesh( mesh.GetMesh(), quantize, quantized );
+    scene.m_vertexFormat = quantized.m_position;
+    return backend.CreateQuantizedObject( quantized );
+}
+
+// uploads the object, the cube by default, and for --cubes the instance buffer
+static bool CreateAppScene( AppScene& scene, const AppOptions& options, RenderBackend& backend, JobSystem& jobs, f32 aspect ) {
+    if ( options.m_meshPath != nullptr && strstr( options.m_meshPath, ".cgqm" ) == nullptr ) {
+        if ( !CreateImportedObject( scene, options, backend, jobs ) )
+            return false;
+    } else if ( options.m_meshPath != nullptr ) {
+        QuantizedMesh mesh;
+        if ( !ReadQuantizedMesh( options.m_meshPath, mesh ) ) {
+            printf( "could not read mesh %s\n", options.m_meshPath );
+            return false;
+        }
+        if ( !backend.CreateQuantizedObject( mesh ) )
+            return false;
+        scene.m_vertexFormat = mesh.m_position;
+    } else if ( options.m_vertexFormat != POSITION_FLOAT32 ) {
+        QuantizeDesc quantize;
+        quantize.m_position = options.m_vertexFormat;
+        QuantizedMesh mesh;
+        QuantizeMesh( GetCubeMesh(), quantize, mesh );
+        if ( !backend.CreateQuantizedObject( mesh ) )
+            return false;
+        scene.m_vertexFormat = mesh.m_position;
+    } else if ( !backend.CreateObject( GetCubeMesh() ) ) {
+        return false;
+    }
+
+    scene.m_instanced = options.m_cubes > 0;
+    if ( scene.m_instanced ) {
+        GenerateCubeField( scene.m_field, options.m_cubes, aspect );
+        if ( options.m_bvh )
+            scene.m_field.m_culling = CUBE_FIELD_CULL_BVH;
+        else if ( options.m_frustumCull )
+            scene.m_field.m_culling = CUBE_FIELD_CULL_FRUSTUM;
+        scene.m_field.m_occlusionCulling = options.m_occlusionCull;
+        if ( !backend.CreateInstanceBuffer( options.m_cubes ) )
+            return false;
+    }
+    return true;
+}
 
-ID3D11Device*           d3d11Device = nullptr;
-ID3D11DeviceContext*    d3d11DeviceContext = nullptr;
-IDXGISwapChain*         swapChain = nullptr;
-ID3D11RenderTargetView* renderTargetView = nullptr;
+// one fixed simulation step
+static void UpdateAppScene( AppScene& scene, f32 dt, JobSystem& jobs ) {
+    if ( scene.m_instanced )
+        UpdateCubeField( scene.m_field, dt, &jobs );
+    else
+        UpdateScene( scene.m_cube, dt );
+}
 
-ID3D11Buffer*           vertexBuffer = nullptr;
-ID3D11InputLayout*      vertexLayout = nullptr;
-ID3D11VertexShader*     vertexShader = nullptr;
-ID3D11PixelShader*      pixelShader = nullptr;
+// uploads the render state interpolated alpha of the way into the last step
+static void UploadAppScene( AppScene& scene, RenderBackend& backend, f32 alpha, JobSystem& jobs ) {
+    if ( scene.m_instanced ) {
+        backend.UpdateConstants( GetCubeFieldConstants( scene.m_field, alpha, &jobs ) );
+        backend.UpdateInstances( scene.m_field.m_instances.data(), scene.m_field.m_instanceCount );
+    } else {
+        backend.UpdateConstants( GetSceneConstants( scene.m_cube, alpha ) );
+    }
+}
 
-ID3D11Buffer*           indexBuffer = nullptr;
-ID3D11Buffer*           constantBuffer = nullptr;
+// dumps the profiler rings to --trace, or to compgraph_trace.json
+static void WriteTrace( const AppOptions& options ) {
+    const char* path = options.m_tracePath != nullptr ? options.m_tracePath : "compgraph_trace.json";
+    if ( ProfilerWriteChromeTrace( path ) )
+        printf( "trace written to %s\n", path );
+    else
+        printf( "could not write trace to %s\n", path );
+}
 
-DirectX::XMMATRIX       objProjection;
-f32                     angle = 0.0f;
+// writes the --benchmark report to --json or stdout
+static bool WriteBenchmark( const AppOptions& options, const AppScene& scene, const BenchmarkRecorder& recorder, const RenderBackend& backend,
+                            const BackendDesc& desc, u32 threads ) {
+    BenchmarkInfo info;
+    info.m_backend = backend.GetName();
+    info.m_width = desc.m_width;
+    info.m_height = desc.m_height;
+    info.m_cubes = options.m_cubes;
+    info.m_vertexFormat = GetPositionEncodingName( scene.m_vertexFormat );
+    info.m_threads = threads;
+    info.m_warmupFrames = options.m_warmup;
+    if ( recorder.WriteJson( options.m_jsonPath, info ) )
+        return true;
+    printf( "could not write benchmark report to %s\n", options.m_jsonPath );
+    return false;
+}
+
+// renders a fixed number of frames into the software framebuffer, no window involved
+static i32 RunHeadless( const AppOptions& options ) {
+    JobSystem jobs( options.m_threads, options.m_pin );
+    SoftwareBackend backend;
+
+    BackendDesc desc;
+    desc.m_width = Width;
+    desc.m_height = Height;
+    desc.m_jobs = &jobs;
+    desc.m_clusterCulling = options.m_clusterCull;
+    desc.m_present = GetPresentDesc( options );
+    if ( !backend.Initialize( desc ) )
+        return EXIT_FAILURE;
+
+    AppScene scene;
+    if ( !CreateAppScene( scene, options, backend, jobs, ( f32 )Width / ( f32 )Height ) )
+        return EXIT_FAILURE;
 
-HRESULT InitializeD3D11( HWND hwnd, u32 width, u32 height );
-void ReleaseD3D11();
-void RenderScene();
-HRESULT CreateObject();
-void Rotate();
+    // exactly one simulation step per frame, so headless output does not depend on timing
+    BenchmarkRecorder recorder;
+    const u32 warmup = options.m_benchmark ? options.m_warmup : 0;
+    for ( u32 frame = 0; frame < warmup; ++frame ) {
+        backend.WaitForNextFrame();
+        UpdateAppScene( scene, SIMULATION_STEP, jobs );
+        UploadAppScene( scene, backend, 1.0f, jobs );
+        backend.RenderScene();
+    }
+
+    StageTimings stageTotals;
+    FrameClock::time_point start = FrameClock::now();
+    for ( u32 frame = 0; frame < options.m_frames; ++frame ) {
+        PROFILE_ZONE( "Frame" );
+        const FrameClock::time_point frameStart = FrameClock::now();
+        {
+            PROFILE_ZONE( "WaitForNextFrame" );
+            backend.WaitForNextFrame();
+        }
+        {
+            PROFILE_ZONE( "Update" );
+            UpdateAppScene( scene, SIMULATION_STEP, jobs );
+        }
+        {
+            PROFILE_ZONE( "Upload" );
+            UploadAppScene( scene, backend, 1.0f, jobs );
+        }
+        backend.RenderScene();
+
+        const StageTimings& stages = backend.GetStageTimings();
+        recorder.AddFrame( SecondsBetween( frameStart, FrameClock::now() ) * 1000.0, stages );
+        for ( u32 i = 0; i < stages.m_count; ++i ) {
+            if ( i == stageTotals.m_count )
+                stageTotals.Add( stages.m_names[ i ], 0.0 );
+            stageTotals.m_ms[ i ] += stages.m_ms[ i ];
+        }
+    }
+    f64 seconds = SecondsBetween( start, FrameClock::now() );
+    if ( options.m_benchmark ) {
+        const bool written = WriteBenchmark( options, scene, recorder, backend, desc, jobs.GetThreadCount() );
+        backend.Release();
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    printf( "%u frames, %.3f ms/frame\n", options.m_frames, options.m_frames ? seconds * 1000.0 / options.m_frames : 0.0 );
+    for ( u32 i = 0; i < stageTotals.m_count && options.m_frames > 0; ++i )
+        printf( "  %-12s %.3f ms\n", stageTotals.m_names[ i ], stageTotals.m_ms[ i ] / options.m_frames );
+    if ( options.m_clusterCull && !scene.m_instanced ) {
+        const ClusterCullStats& cull = backend.GetClusterCullStats();
+        printf( "cluster culling, last frame: %u of %u triangles drawn, %u meshlets: %u backface, %u frustum, %u occlusion culled\n",
+            cull.m_visibleTriangles, cull.m_triangles, cull.m_meshlets, cull.m_backfaceCulled, cull.m_frustumCulled, cull.m_occlusionCulled );
+    }
+    if ( scene.m_instanced && scene.m_field.m_culling != CUBE_FIELD_CULL_NONE )
+        printf( "frustum culling, last frame: %u of %u cubes drawn\n", scene.m_field.m_instanceCount, scene.m_field.m_cubeCount );
+    if ( scene.m_instanced && scene.m_field.m_culling == CUBE_FIELD_CULL_BVH ) {
+        const Bvh& bvh = scene.m_field.m_bvh;
+        printf( "bvh: %u nodes, SAH cost %.2f, %.2f when built\n", ( u32 )bvh.GetNodes().size(), bvh.GetCost(), bvh.GetBuildCost() );
+    }
+    if ( scene.m_instanced && scene.m_field.m_occlusionCulling ) {
+        printf( "occlusion culling, last frame: %u of %u cubes drawn, %u occluded by %u occluder triangles\n", scene.m_field.m_instanceCount,
+            scene.m_field.m_cubeCount, scene.m_field.m_occludedCount, scene.m_field.m_hiz.GetOccluderTriangleCount() );
+    }
+    if ( options.m_vsync ) {
+        const PresentStats& stats = backend.GetPresentStats();
+        printf( "%llu frames shown, latency %.3f ms average, %.3f ms max\n",
+            ( unsigned long long )stats.m_framesShown, stats.GetAverageLatency() * 1000.0, stats.m_maxLatency * 1000.0 );
+    }
+    if ( options.m_tracePath != nullptr )
+        WriteTrace( options );
+
+    backend.Release();
+    return EXIT_SUCCESS;
+}
+
+#ifndef COMPGRAPH_HEADLESS
+
+// copies the software framebuffer into the window surface
+static void PresentSoftwareFrame( SDL_Window* window, const SoftwareBackend& backend ) {
+    SDL_Surface* frame = SDL_CreateRGBSurfaceFrom(
+        ( void* )backend.GetFramebuffer(),
+        backend.GetWidth(), backend.GetHeight(), 32, backend.GetPitch() * sizeof( u32 ),
+        0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000 );
+    if ( frame == nullptr )
+        return;
+
+    SDL_Surface* windowSurface = SDL_GetWindowSurface( window );
+    if ( windowSurface != nullptr ) {
+        SDL_BlitScaled( frame, nullptr, windowSurface, nullptr );
+        SDL_UpdateWindowSurface( window );
+    }
+    SDL_FreeSurface( frame );
+}
 
 //
-i32 CALLBACK WinMain( HINSTANCE /*hInstance*/, HINSTANCE, LPSTR /*lpCmdLine*/, i32 /*nCmdShow*/ ) {
+static i32 RunWindowed( const AppOptions& options ) {
 
     // the window we'll be rendering to
     SDL_Window* window = nullptr;
@@ -64,305 +371,200 @@ i32 CALLBACK WinMain( HINSTANCE /*hInstance*/, HINSTANCE, LPSTR /*lpCmdLine*/, i
     /*SDL_DisplayMode displayMode;
     SDL_GetDesktopDisplayMode(0, &displayMode);*/
 
-    const u32 Width = 1366;
-    const u32 Height = 768;
+    const bool useSoftware = options.m_software;
 
     window = SDL_CreateWindow(
-        "D3D11 Test",
+        useSoftware ? "Software Test" : "D3D11 Test",
         SDL_WINDOWPOS_UNDEFINED,
         SDL_WINDOWPOS_UNDEFINED,
         Width, Height,
         SDL_WINDOW_SHOWN |
+        SDL_WINDOW_RESIZABLE |
         SDL_WINDOW_FULLSCREEN_DESKTOP );
     if ( window == nullptr ) {
         //printf("Window could not be created! SDL_Error: %s\n", SDL_GetError());
         return EXIT_FAILURE;
     }
 
+    // fullscreen desktop windows take the display size, not the requested one
+    i32 windowWidth = 0, windowHeight = 0;
+    SDL_GetWindowSize( window, &windowWidth, &windowHeight );
+
+    // simulation and the software renderer share one job system
+    JobSystem jobs( options.m_threads, options.m_pin );
+
+    BackendDesc desc;
+    desc.m_width = ( u32 )windowWidth;
+    desc.m_height = ( u32 )windowHeight;
+    desc.m_jobs = &jobs;
+    desc.m_perObjectDraws = options.m_perObject;
+    desc.m_clusterCulling = options.m_clusterCull;
+    desc.m_present = GetPresentDesc( options );
+
+    // the software backend flips on emulated vertical blanks at the display rate
+    SDL_DisplayMode mode;
+    if ( SDL_GetWindowDisplayMode( window, &mode ) == 0 && mode.refresh_rate > 0 )
+        desc.m_present.m_refreshRate = mode.refresh_rate;
+
+#ifdef COMPGRAPH_HAS_D3D11
     SDL_SysWMinfo wmInfo;
     SDL_VERSION( &wmInfo.version );
     SDL_GetWindowWMInfo( window, &wmInfo );
-    if ( FAILED( InitializeD3D11( wmInfo.info.win.window, Width, Height ) ) )
+    desc.m_windowHandle = wmInfo.info.win.window;
+
+    RenderBackend* backend = useSoftware ? CreateSoftwareBackend() : CreateD3D11Backend();
+#else
+    RenderBackend* backend = CreateSoftwareBackend();
+#endif
+
+    if ( !backend->Initialize( desc ) )
         return EXIT_FAILURE;
 
-    if ( FAILED( CreateObject() ) )
+    AppScene scene;
+    if ( !CreateAppScene( scene, options, *backend, jobs, ( f32 )windowWidth / ( f32 )windowHeight ) )
         return EXIT_FAILURE;
 
+    // --vsync pacing comes from WaitForNextFrame: the D3D11 swap chain's
+    // waitable object, or the software present queue's emulated vertical blanks
+    FrameLimiter limiter;
+    limiter.SetTargetFps( options.m_fpsCap );
+
+    FixedTimestep timestep( SIMULATION_STEP );
+    FrameClock::time_point lastTime = FrameClock::now();
     bool quit = false;
 
+    // --benchmark steps the simulation once per frame and quits after the measured frames
+    BenchmarkRecorder recorder;
+    u32 benchmarkFrame = 0;
+
     // while application is running
     while ( !quit ) {
-        SDL_Event e;
+        PROFILE_ZONE( "Frame" );
+        const FrameClock::time_point frameStart = FrameClock::now();
+
+        // wait before sampling input and time, so they are as fresh as possible when the frame is shown
+        {
+            PROFILE_ZONE( "WaitForNextFrame" );
+            backend->WaitForNextFrame();
+        }
 
         // handle events on queue
-        while ( SDL_PollEvent( &e ) ) {
-            switch ( e.type ) {
-            case SDL_KEYUP:
-                switch ( e.key.keysym.sym ) {
-                case SDLK_F11:
-                    if ( SDL_GetWindowFlags( window ) & SDL_WINDOW_FULLSCREEN_DESKTOP )
-                        SDL_SetWindowFullscreen( window, 0 );
-                    else
-                        SDL_SetWindowFullscreen( window, SDL_WINDOW_FULLSCREEN_DESKTOP );
+        {
+            PROFILE_ZONE( "Events" );
+            SDL_Event e;
+            while ( SDL_PollEvent( &e ) ) {
+                switch ( e.type ) {
+                case SDL_KEYUP:
+                    switch ( e.key.keysym.sym ) {
+                    case SDLK_F11:
+                        if ( SDL_GetWindowFlags( window ) & SDL_WINDOW_FULLSCREEN_DESKTOP )
+                            SDL_SetWindowFullscreen( window, 0 );
+                        else
+                            SDL_SetWindowFullscreen( window, SDL_WINDOW_FULLSCREEN_DESKTOP );
+                        break;
+                    case SDLK_F9:
+                        WriteTrace( options );
+                        break;
+                    case SDLK_ESCAPE:
+                        quit = true;
+                        break;
+                    }
+                    break;
+                case SDL_MOUSEBUTTONUP:
+                    // left click marks the cube under the cursor white
+                    if ( e.button.button == SDL_BUTTON_LEFT && scene.m_instanced ) {
+                        i32 width = 0, height = 0;
+                        SDL_GetWindowSize( window, &width, &height );
+                        const f32 x = 2.0f * ( ( f32 )e.button.x + 0.5f ) / ( f32 )width - 1.0f;
+                        const f32 y = 1.0f - 2.0f * ( ( f32 )e.button.y + 0.5f ) / ( f32 )height;
+                        const u32 cube = PickCube( scene.m_field, x, y, &jobs );
+                        if ( cube != BVH_NONE ) {
+                            SetCubeColor( scene.m_field, cube, Float4( 1.0f, 1.0f, 1.0f, 1.0f ) );
+                            printf( "picked cube %u\n", cube );
+                        }
+                    }
                     break;
-                case SDLK_ESCAPE:
+                case SDL_WINDOWEVENT:
+                    if ( e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED && e.window.data1 > 0 && e.window.data2 > 0 ) {
+                        backend->Resize( ( u32 )e.window.data1, ( u32 )e.window.data2 );
+                        if ( scene.m_instanced )
+                            SetCubeFieldAspect( scene.m_field, ( f32 )e.window.data1 / ( f32 )e.window.data2 );
+                    }
+                    break;
+                case SDL_QUIT:
                     quit = true;
                     break;
                 }
-                break;
-            case SDL_QUIT:
-                quit = true;
-                break;
             }
         }
-        Rotate();
-        RenderScene();
+
+        FrameClock::time_point now = FrameClock::now();
+        u32 steps = options.m_benchmark ? 1 : timestep.Advance( SecondsBetween( lastTime, now ) );
+        lastTime = now;
+        {
+            PROFILE_ZONE( "Update" );
+            for ( u32 step = 0; step < steps; ++step )
+                UpdateAppScene( scene, ( f32 )timestep.GetStep(), jobs );
+        }
+        {
+            PROFILE_ZONE( "Upload" );
+            UploadAppScene( scene, *backend, options.m_benchmark ? 1.0f : timestep.GetAlpha(), jobs );
+        }
+        backend->RenderScene();
+        if ( useSoftware ) {
+            PROFILE_ZONE( "Blit" );
+            PresentSoftwareFrame( window, *static_cast< SoftwareBackend* >( backend ) );
+        }
+        {
+            PROFILE_ZONE( "FrameLimiter" );
+            limiter.Wait();
+        }
+
+        if ( options.m_benchmark ) {
+            if ( benchmarkFrame >= options.m_warmup )
+                recorder.AddFrame( SecondsBetween( frameStart, FrameClock::now() ) * 1000.0, backend->GetStageTimings() );
+            if ( ++benchmarkFrame >= options.m_warmup + options.m_frames )
+                quit = true;
+        }
     }
+    i32 result = EXIT_SUCCESS;
+    if ( options.m_benchmark && !WriteBenchmark( options, scene, recorder, *backend, desc, jobs.GetThreadCount() ) )
+        result = EXIT_FAILURE;
+    if ( options.m_tracePath != nullptr )
+        WriteTrace( options );
 
     // destroy window
-    ReleaseD3D11();
+    backend->Release();
+    delete backend;
     SDL_DestroyWindow( window );
 
     // quit SDL subsystems
     SDL_Quit();
 
-    return EXIT_SUCCESS;
+    return result;
 }
 
+#endif
 
 //
-HRESULT InitializeD3D11( HWND hwnd, u32 width, u32 height ) {
-    u32 deviceFlags = 0;
-#ifdef _DEBUG
-    deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+static i32 RunApp( i32 argc, char** argv ) {
+    AppOptions options = ParseOptions( argc, argv );
+    ProfilerSetThreadName( "main" );
+#ifndef COMPGRAPH_HEADLESS
+    if ( !options.m_headless )
+        return RunWindowed( options );
 #endif
-
-    // describe our Buffer
-    DXGI_SWAP_CHAIN_DESC swapChainDesc;
-    memset( &swapChainDesc, 0, sizeof( swapChainDesc ) );
-    swapChainDesc.BufferCount = 1;
-    swapChainDesc.BufferDesc.Width = width;
-    swapChainDesc.BufferDesc.Height = height;
-    swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    swapChainDesc.BufferDesc.RefreshRate.Numerator = 60;
-    swapChainDesc.BufferDesc.RefreshRate.Denominator = 1;
-    swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    swapChainDesc.OutputWindow = hwnd;
-    swapChainDesc.SampleDesc.Count = 1;
-    swapChainDesc.SampleDesc.Quality = 0;
-    swapChainDesc.Windowed = true;
-
-    // create our SwapChain
-    HRESULT result = D3D11CreateDeviceAndSwapChain(
-        nullptr,
-        D3D_DRIVER_TYPE_HARDWARE,
-        nullptr,
-        deviceFlags,
-        nullptr,
-        0,
-        D3D11_SDK_VERSION,
-        &swapChainDesc,
-        &swapChain,
-        &d3d11Device,
-        nullptr,
-        &d3d11DeviceContext );
-    if ( FAILED( result ) )
-        return result;
-
-    // create our BackBuffer
-    ID3D11Texture2D* backBuffer = nullptr;
-    result = swapChain->GetBuffer( 0, __uuidof( ID3D11Texture2D ), ( void** )&backBuffer );
-    if ( FAILED( result ) )
-        return result;
-
-    // create our Render Target
-    result = d3d11Device->CreateRenderTargetView( backBuffer, nullptr, &renderTargetView );
-    backBuffer->Release();
-    if ( FAILED( result ) )
-        return result;
-
-    // set our Render Target
-    d3d11DeviceContext->OMSetRenderTargets( 1, &renderTargetView, nullptr );
-
-    D3D11_VIEWPORT vp;
-    vp.Width = ( f32 )width;
-    vp.Height = ( f32 )height;
-    vp.MinDepth = 0.0f;
-    vp.MaxDepth = 1.0f;
-    vp.TopLeftX = 0;
-    vp.TopLeftY = 0;
-    d3d11DeviceContext->RSSetViewports( 1, &vp );
-
-    return S_OK;
+    return RunHeadless( options );
 }
 
-
+#ifdef _WIN32
 //
-void RenderScene() {
-    f32 ClearColor[ 4 ] = { 0.337f, 0.627f, 0.827f, 1.0f };
-    d3d11DeviceContext->ClearRenderTargetView( renderTargetView, ClearColor );
-    d3d11DeviceContext->IASetInputLayout( vertexLayout );
-    u32 stride = sizeof( Vertex );
-    u32 offset = 0;
-    d3d11DeviceContext->IASetVertexBuffers( 0, 1, &vertexBuffer, &stride, &offset );
-    d3d11DeviceContext->IASetIndexBuffer( indexBuffer, DXGI_FORMAT_R32_UINT, 0 );
-    d3d11DeviceContext->VSSetShader( vertexShader, nullptr, 0 );
-    d3d11DeviceContext->PSSetShader( pixelShader, nullptr, 0 );
-    d3d11DeviceContext->VSSetConstantBuffers( 0, 1, &constantBuffer );
-    d3d11DeviceContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
-    d3d11DeviceContext->DrawIndexed( 36, 0, 0 );
-    swapChain->Present( 0, 0 );
+i32 CALLBACK WinMain( HINSTANCE /*hInstance*/, HINSTANCE, LPSTR /*lpCmdLine*/, i32 /*nCmdShow*/ ) {
+    return RunApp( __argc, __argv );
 }
-
-
+#else
 //
-void ReleaseD3D11() {
-    // release the COM objects we created
-    if ( d3d11DeviceContext )
-        d3d11DeviceContext->ClearState();
-
-    if ( constantBuffer )
-        constantBuffer->Release();
-    if ( indexBuffer )
-        indexBuffer->Release();
-
-    if ( vertexBuffer )
-        vertexBuffer->Release();
-    if ( vertexLayout )
-        vertexLayout->Release();
-    if ( vertexShader )
-        vertexShader->Release();
-    if ( pixelShader )
-        pixelShader->Release();
-
-    if ( renderTargetView )
-        renderTargetView->Release();
-    if ( swapChain )
-        swapChain->Release();
-    if ( d3d11DeviceContext )
-        d3d11DeviceContext->Release();
-    if ( d3d11Device )
-        d3d11Device->Release();
+int main( int argc, char** argv ) {
+    return RunApp( argc, argv );
 }
-
-//
-HRESULT CreateObject() {
-
-    u32 compileFlags = 0;;
-#ifdef _DEBUG
-    compileFlags |= D3DCOMPILE_DEBUG;
 #endif
-
-    //   
-    ID3DBlob* vsBlob = nullptr;
-    HRESULT result = D3DCompileFromFile( L"VertexShader.hlsl", nullptr, nullptr, "main", "vs_5_0", compileFlags, 0, &vsBlob, nullptr );
-    if ( FAILED( result ) )
-        return result;
-
-    //   
-    result = d3d11Device->CreateVertexShader( vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &vertexShader );
-    if ( FAILED( result ) )
-        return result;
-
-    D3D11_INPUT_ELEMENT_DESC layout[] = {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-    };
-    u32 numElements = ARRAYSIZE( layout );
-    result = d3d11Device->CreateInputLayout( layout, numElements, vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &vertexLayout );
-    vsBlob->Release();
-    if ( FAILED( result ) )
-        return result;
-
-    //   
-    ID3DBlob* psBlob = nullptr;
-    result = D3DCompileFromFile( L"PixelShader.hlsl", nullptr, nullptr, "main", "ps_5_0", compileFlags, 0, &psBlob, nullptr );
-    if ( FAILED( result ) )
-        return result;
-
-    //   
-    result = d3d11Device->CreatePixelShader( psBlob->GetBufferPointer(), psBlob->GetBufferSize(), NULL, &pixelShader );
-    psBlob->Release();
-    if ( FAILED( result ) )
-        return result;
-
-    //   
-    Vertex vertices[] = {
-        { DirectX::XMFLOAT3( -0.50f, -0.50f, 0.50f ), DirectX::XMFLOAT4( 1.0f, 1.0f, 1.0f, 1.0f ) },
-        { DirectX::XMFLOAT3( -0.50f, 0.50f, 0.50f ), DirectX::XMFLOAT4( 1.0f, 0.0f, 0.0f, 1.0f ) },
-        { DirectX::XMFLOAT3( 0.50f, -0.50f, 0.50f ), DirectX::XMFLOAT4( 0.0f, 1.0f, 0.0f, 1.0f ) },
-        { DirectX::XMFLOAT3( 0.50f, 0.50f, 0.50f ), DirectX::XMFLOAT4( 0.0f, 0.0f, 1.0f, 1.0f ) },
-
-        { DirectX::XMFLOAT3( -0.50f, -0.50f, -0.50f ), DirectX::XMFLOAT4( 0.0f, 0.0f, 0.0f, 1.0f ) },
-        { DirectX::XMFLOAT3( -0.50f, 0.50f, -0.50f ), DirectX::XMFLOAT4( 1.0f, 1.0f, 0.0f, 1.0f ) },
-        { DirectX::XMFLOAT3( 0.50f, -0.50f, -0.50f ), DirectX::XMFLOAT4( 0.0f, 1.0f, 1.0f, 1.0f ) },
-        { DirectX::XMFLOAT3( 0.50f, 0.50f, -0.50f ), DirectX::XMFLOAT4( 1.0f, 0.0f, 1.0f, 1.0f ) },
-    };
-    D3D11_BUFFER_DESC bd;
-    memset( &bd, 0, sizeof( bd ) );
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof( vertices );
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bd.CPUAccessFlags = 0;
-
-    D3D11_SUBRESOURCE_DATA subData;
-    memset( &subData, 0, sizeof( subData ) );
-    subData.pSysMem = vertices;
-    result = d3d11Device->CreateBuffer( &bd, &subData, &vertexBuffer );
-    if ( FAILED( result ) )
-        return result;
-
-    //   
-    u32 indices[] = {
-        0, 1, 2,
-        1, 3, 2,
-
-        5, 0, 4,
-        5, 1, 0,
-
-        6, 7, 4,
-        4, 7, 5,
-
-        2, 3, 6,
-        3, 7, 6,
-
-        5, 3, 1,
-        5, 7, 3,
-
-        0, 2, 6,
-        6, 4, 0,
-    };
-    memset( &bd, 0, sizeof( bd ) );
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof( indices );
-    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    bd.CPUAccessFlags = 0;
-
-    memset( &subData, 0, sizeof( subData ) );
-    subData.pSysMem = indices;
-    result = d3d11Device->CreateBuffer( &bd, &subData, &indexBuffer );
-    if ( FAILED( result ) )
-        return result;
-
-    //   
-    memset( &bd, 0, sizeof( bd ) );
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof( ConstantBuffer );
-    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    bd.CPUAccessFlags = 0;
-    result = d3d11Device->CreateBuffer( &bd, nullptr, &constantBuffer );
-    if ( FAILED( result ) )
-        return result;
-
-    return S_OK;
-}
-
-void Rotate() {
-    angle += 0.001f;
-    DirectX::XMFLOAT3 pos( 1, 1, 1 );
-    DirectX::XMVECTOR normal = DirectX::XMLoadFloat3( &pos );
-    objProjection = DirectX::XMMatrixRotationAxis( normal, angle );
-    ConstantBuffer cb;
-    cb.m_modelMatrix = XMMatrixTranspose( objProjection );
-    d3d11DeviceContext->UpdateSubresource( constantBuffer, 0, nullptr, &cb, 0, 0 );
-}
\ No newline at end of file
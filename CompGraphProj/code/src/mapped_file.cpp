@@ -0,0 +1,85 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+//
+bool MappedFile::Open( const char* path ) {
+    Close();
+    HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if ( file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if ( GetFileSizeEx( file, &size ) && size.QuadPart > 0 )
+        mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    const void* view = mapping != nullptr ? MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+    if ( view == nullptr ) {
+        if ( mapping != nullptr )
+            CloseHandle( mapping );
+        CloseHandle( file );
+        return false;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_data = ( const u8* )view;
+    m_size = ( size_t )size.QuadPart;
+    return true;
+}
+
+//
+void MappedFile::Close() {
+    if ( m_data != nullptr )
+        UnmapViewOfFile( m_data );
+    if ( m_mapping != nullptr )
+        CloseHandle( m_mapping );
+    if ( m_file != nullptr )
+        CloseHandle( m_file );
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+}
+
+#else
+
+//
+bool MappedFile::Open( const char* path ) {
+    Close();
+    const int file = open( path, O_RDONLY );
+    if ( file < 0 )
+        return false;
+
+    // the mapping keeps its own reference, the descriptor is not needed afterwards
+    struct stat info;
+    void* view = MAP_FAILED;
+    if ( fstat( file, &info ) == 0 && info.st_size > 0 )
+        view = mmap( nullptr, ( size_t )info.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+    close( file );
+    if ( view == MAP_FAILED )
+        return false;
+
+    m_data = ( const u8* )view;
+    m_size = ( size_t )info.st_size;
+    return true;
+}
+
+//
+void MappedFile::Close() {
+    if ( m_data != nullptr )
+        munmap( ( void* )m_data, m_size );
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+
+// read-only memory mapping of a whole file, the file is read in by the page
+// cache on first touch instead of being copied into a buffer
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    // false if the file does not exist, is empty or cannot be mapped
+    bool Open( const char* path );
+    void Close();
+
+    bool IsOpen() const { return m_data != nullptr; }
+    const u8* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    const u8*   m_data = nullptr;
+    size_t      m_size = 0;
+#ifdef _WIN32
+    void*       m_file = nullptr;
+    void*       m_mapping = nullptr;
+#endif
+};
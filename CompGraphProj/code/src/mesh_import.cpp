@@ -0,0 +1,1297 @@
+#include "mesh_import.h"
+
+#include "hash.h"
+#include "job_system.h"
+#include "mesh_optimize.h"
+#include "vertex_quantization.h"
+
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+static constexpr u32 INVALID_INDEX = ~0u;
+
+// OBJ text is handed to the jobs in chunks of about this many bytes
+static constexpr size_t OBJ_CHUNK_SIZE = 1 << 20;
+// vertices per job when converting glTF attributes
+static constexpr u32 VERTEX_BLOCK_SIZE = 1 << 14;
+
+// runs fn( begin, end ) over [0, count) in blocks of blockSize, on the jobs when given
+template< typename Func >
+static void ForBlocks( JobSystem* jobs, u32 count, u32 blockSize, const Func& fn ) {
+    const u32 blockCount = ( count + blockSize - 1 ) / blockSize;
+    const auto block = [ & ]( u32 index ) {
+        const u32 begin = index * blockSize;
+        fn( begin, count - begin < blockSize ? count : begin + blockSize );
+    };
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( blockCount, block, 1 );
+    } else {
+        for ( u32 i = 0; i < blockCount; ++i )
+            block( i );
+    }
+}
+
+// murmur3's 64-bit finalizer, spreads index pairs over the table
+static u64 MixHash( u64 key ) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+// power of two with at most half of the slots in use
+static u32 GetTableSize( size_t entries ) {
+    u32 size = 64;
+    while ( size < entries * 2 )
+        size *= 2;
+    return size;
+}
+
+// open addressing map from 64-bit keys to the order they were first inserted in
+class KeyIndexMap {
+public:
+    explicit KeyIndexMap( size_t expected = 0 ) : m_table( GetTableSize( expected ), INVALID_INDEX ) { m_keys.reserve( expected ); }
+
+    // the index of key, which is the next one if key is new
+    u32 Insert( u64 key ) {
+        const u32 mask = ( u32 )m_table.size() - 1;
+        u32 slot = ( u32 )MixHash( key ) & mask;
+        while ( m_table[ slot ] != INVALID_INDEX ) {
+            if ( m_keys[ m_table[ slot ] ] == key )
+                return m_table[ slot ];
+            slot = ( slot + 1 ) & mask;
+        }
+        const u32 index = ( u32 )m_keys.size();
+        m_keys.push_back( key );
+        m_table[ slot ] = index;
+        if ( m_keys.size() * 2 > m_table.size() )
+            Grow();
+        return index;
+    }
+
+    const std::vector< u64 >& GetKeys() const { return m_keys; }
+    u32 GetCount() const { return ( u32 )m_keys.size(); }
+
+private:
+    void Grow() {
+        m_table.assign( m_table.size() * 2, INVALID_INDEX );
+        const u32 mask = ( u32 )m_table.size() - 1;
+        for ( u32 i = 0; i < ( u32 )m_keys.size(); ++i ) {
+            u32 slot = ( u32 )MixHash( m_keys[ i ] ) & mask;
+            while ( m_table[ slot ] != INVALID_INDEX )
+                slot = ( slot + 1 ) & mask;
+            m_table[ slot ] = i;
+        }
+    }
+
+    std::vector< u32 > m_table;
+    std::vector< u64 > m_keys;
+};
+
+// 0.5 + 0.5 * n like GenerateSphereMesh
+static Float4 GetNormalColor( const Float3& n ) {
+    return Float4( 0.5f + 0.5f * n.x, 0.5f + 0.5f * n.y, 0.5f + 0.5f * n.z, 1.0f );
+}
+
+// colors every vertex by the normals of the faces around it
+static void ColorByFaceNormals( Vertex* vertices, u32 vertexCount, const u32* indices, u32 indexCount ) {
+    std::vector< Float3 > normals;
+    ComputeVertexNormals( Mesh{ vertices, vertexCount, indices, indexCount }, normals );
+    for ( u32 i = 0; i < vertexCount; ++i )
+        vertices[ i ].m_color = GetNormalColor( normals[ i ] );
+}
+
+static bool IsBlank( char c ) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* SkipBlanks( const char* p, const char* end ) {
+    while ( p < end && IsBlank( *p ) )
+        ++p;
+    return p;
+}
+
+// from_chars does not take the leading '+' some exporters write
+static bool ParseFloat( const char*& p, const char* end, f32& value ) {
+    p = SkipBlanks( p, end );
+    if ( p < end && *p == '+' )
+        ++p;
+    const std::from_chars_result result = std::from_chars( p, end, value );
+    if ( result.ec != std::errc() )
+        return false;
+    p = result.ptr;
+    return true;
+}
+
+//
+static bool ParseInt( const char*& p, const char* end, i64& value ) {
+    if ( p < end && *p == '+' )
+        ++p;
+    const std::from_chars_result result = std::from_chars( p, end, value );
+    if ( result.ec != std::errc() )
+        return false;
+    p = result.ptr;
+    return true;
+}
+
+enum ObjLine : u32 {
+    OBJ_LINE_OTHER,
+    OBJ_LINE_POSITION,
+    OBJ_LINE_NORMAL,
+    OBJ_LINE_FACE,
+};
+
+// the keyword of the line starting at p, p moves past it
+static ObjLine GetObjLine( const char*& p, const char* end ) {
+    p = SkipBlanks( p, end );
+    if ( end - p >= 2 && p[ 0 ] == 'v' && IsBlank( p[ 1 ] ) ) {
+        p += 2;
+        return OBJ_LINE_POSITION;
+    }
+    if ( end - p >= 3 && p[ 0 ] == 'v' && p[ 1 ] == 'n' && IsBlank( p[ 2 ] ) ) {
+        p += 3;
+        return OBJ_LINE_NORMAL;
+    }
+    if ( end - p >= 2 && p[ 0 ] == 'f' && IsBlank( p[ 1 ] ) ) {
+        p += 2;
+        return OBJ_LINE_FACE;
+    }
+    return OBJ_LINE_OTHER;
+}
+
+struct ObjCorner {
+    u32 m_position;
+    u32 m_normal;       // INVALID_INDEX without one
+
+    u64 GetKey() const { return ( u64 )m_position | ( ( u64 )m_normal << 32 ); }
+};
+
+struct ObjChunk {
+    const char*                 m_begin = nullptr;
+    const char*                 m_end = nullptr;
+    u32                         m_positionBase = 0;     // positions and normals of the chunks before
+    u32                         m_normalBase = 0;
+    u32                         m_positionCount = 0;
+    u32                         m_normalCount = 0;
+    // corners are deduplicated within the chunk first, which keeps the
+    // table small and leaves only the chunk's distinct corners to merge
+    KeyIndexMap                 m_corners;
+    std::vector< u32 >          m_indices;              // into m_corners, three per triangle
+    std::vector< u32 >          m_remap;                // m_corners to mesh vertices
+    std::vector< Float3 >       m_colors;               // per position of the chunk, empty without colors
+    bool                        m_missingNormals = false;
+    bool                        m_failed = false;
+};
+
+// counts the positions and normals, which fixes where the chunk's go
+static void CountObjChunk( ObjChunk& chunk ) {
+    for ( const char* line = chunk.m_begin; line < chunk.m_end; ) {
+        const char* eol = ( const char* )memchr( line, '\n', chunk.m_end - line );
+        eol = eol != nullptr ? eol : chunk.m_end;
+        const ObjLine type = GetObjLine( line, eol );
+        chunk.m_positionCount += type == OBJ_LINE_POSITION ? 1 : 0;
+        chunk.m_normalCount += type == OBJ_LINE_NORMAL ? 1 : 0;
+        line = eol + 1;
+    }
+}
+
+// 1-based or negative (relative to the end of the list so far) to 0-based
+static bool ResolveObjIndex( i64 index, u32 countSoFar, u32 total, u32& resolved ) {
+    const i64 value = index > 0 ? index - 1 : ( i64 )countSoFar + index;
+    if ( index == 0 || value < 0 || value >= ( i64 )total )
+        return false;
+    resolved = ( u32 )value;
+    return true;
+}
+
+// one corner of a face: v, v/vt, v//vn or v/vt/vn
+static bool ParseObjCorner( const char*& p, const char* end, const ObjChunk& chunk, u32 positionCount, u32 normalCount,
+                            u32 localPositions, u32 localNormals, ObjCorner& corner ) {
+    i64 index;
+    if ( !ParseInt( p, end, index ) ||
+         !ResolveObjIndex( index, chunk.m_positionBase + localPositions, positionCount, corner.m_position ) )
+        return false;
+    corner.m_normal = INVALID_INDEX;
+    if ( p == end || *p != '/' )
+        return true;
+    ++p;
+    // the uv index is checked for syntax only
+    if ( p < end && *p != '/' && !ParseInt( p, end, index ) )
+        return false;
+    if ( p == end || *p != '/' )
+        return true;
+    ++p;
+    return ParseInt( p, end, index ) &&
+           ResolveObjIndex( index, chunk.m_normalBase + localNormals, normalCount, corner.m_normal );
+}
+
+// writes the chunk's positions and normals at their bases and triangulates its faces
+static void ParseObjChunk( ObjChunk& chunk, Float3* positions, u32 positionCount, Float3* normals, u32 normalCount ) {
+    u32 localPositions = 0;
+    u32 localNormals = 0;
+    for ( const char* line = chunk.m_begin; line < chunk.m_end && !chunk.m_failed; ) {
+        const char* eol = ( const char* )memchr( line, '\n', chunk.m_end - line );
+        eol = eol != nullptr ? eol : chunk.m_end;
+        const char* p = line;
+        line = eol + 1;
+
+        const ObjLine type = GetObjLine( p, eol );
+        if ( type == OBJ_LINE_POSITION ) {
+            // x y z, an optional w, then optional r g b
+            f32 values[ 7 ];
+            u32 count = 0;
+            while ( count < 7 && SkipBlanks( p, eol ) < eol && ParseFloat( p, eol, values[ count ] ) )
+                ++count;
+            if ( count < 3 || SkipBlanks( p, eol ) != eol ) {
+                chunk.m_failed = true;
+                break;
+            }
+            positions[ chunk.m_positionBase + localPositions ] = Float3( values[ 0 ], values[ 1 ], -values[ 2 ] );
+            if ( count >= 6 ) {
+                chunk.m_colors.resize( chunk.m_positionCount, Float3( 1.0f, 1.0f, 1.0f ) );
+                chunk.m_colors[ localPositions ] = Float3( values[ count - 3 ], values[ count - 2 ], values[ count - 1 ] );
+            }
+            ++localPositions;
+        } else if ( type == OBJ_LINE_NORMAL ) {
+            f32 x, y, z;
+            if ( !ParseFloat( p, eol, x ) || !ParseFloat( p, eol, y ) || !ParseFloat( p, eol, z ) ) {
+                chunk.m_failed = true;
+                break;
+            }
+            normals[ chunk.m_normalBase + localNormals ] = Vector3Normalize( Float3( x, y, -z ) );
+            ++localNormals;
+        } else if ( type == OBJ_LINE_FACE ) {
+            // fan around the first corner
+            u32 first = 0, previous = 0;
+            u32 count = 0;
+            for ( p = SkipBlanks( p, eol ); p < eol; p = SkipBlanks( p, eol ) ) {
+                ObjCorner corner;
+                if ( !ParseObjCorner( p, eol, chunk, positionCount, normalCount, localPositions, localNormals, corner ) ||
+                     ( p < eol && !IsBlank( *p ) ) ) {
+                    chunk.m_failed = true;
+                    break;
+                }
+                chunk.m_missingNormals |= corner.m_normal == INVALID_INDEX;
+                const u32 index = chunk.m_corners.Insert( corner.GetKey() );
+                if ( count >= 2 ) {
+                    chunk.m_indices.push_back( first );
+                    chunk.m_indices.push_back( previous );
+                    chunk.m_indices.push_back( index );
+                }
+                first = count == 0 ? index : first;
+                previous = index;
+                ++count;
+            }
+        }
+    }
+}
+
+//
+bool ImportObj( const char* text, size_t size, MeshData& mesh, JobSystem* jobs ) {
+    mesh.m_vertices.clear();
+    mesh.m_indices.clear();
+
+    // chunks end after a line break, so no line is split
+    std::vector< ObjChunk > chunks;
+    for ( size_t begin = 0; begin < size; ) {
+        size_t end = begin + OBJ_CHUNK_SIZE < size ? begin + OBJ_CHUNK_SIZE : size;
+        const char* eol = end < size ? ( const char* )memchr( text + end, '\n', size - end ) : nullptr;
+        end = eol != nullptr ? ( size_t )( eol - text ) + 1 : size;
+        ObjChunk chunk;
+        chunk.m_begin = text + begin;
+        chunk.m_end = text + end;
+        chunks.push_back( std::move( chunk ) );
+        begin = end;
+    }
+    const u32 chunkCount = ( u32 )chunks.size();
+
+    ForBlocks( jobs, chunkCount, 1, [ & ]( u32 begin, u32 ) { CountObjChunk( chunks[ begin ] ); } );
+    u64 positionCount = 0, normalCount = 0;
+    for ( ObjChunk& chunk : chunks ) {
+        chunk.m_positionBase = ( u32 )positionCount;
+        chunk.m_normalBase = ( u32 )normalCount;
+        positionCount += chunk.m_positionCount;
+        normalCount += chunk.m_normalCount;
+    }
+    if ( positionCount >= INVALID_INDEX || normalCount >= INVALID_INDEX )
+        return false;
+
+    std::vector< Float3 > positions( ( size_t )positionCount );
+    std::vector< Float3 > normals( ( size_t )normalCount );
+    ForBlocks( jobs, chunkCount, 1, [ & ]( u32 begin, u32 ) {
+        ParseObjChunk( chunks[ begin ], positions.data(), ( u32 )positionCount, normals.data(), ( u32 )normalCount );
+    } );
+
+    size_t indexCount = 0;
+    bool hasColors = false, missingNormals = false;
+    std::vector< size_t > indexBases( chunkCount );
+    for ( u32 i = 0; i < chunkCount; ++i ) {
+        if ( chunks[ i ].m_failed )
+            return false;
+        indexBases[ i ] = indexCount;
+        indexCount += chunks[ i ].m_indices.size();
+        hasColors |= !chunks[ i ].m_colors.empty();
+        missingNormals |= chunks[ i ].m_missingNormals;
+    }
+    if ( indexCount == 0 || indexCount >= INVALID_INDEX )
+        return false;
+
+    // one vertex per distinct position / normal pair in first-use order: the
+    // chunks' distinct corners merge in chunk order, then the indices remap in parallel
+    KeyIndexMap vertices( ( size_t )positionCount );
+    for ( ObjChunk& chunk : chunks ) {
+        chunk.m_remap.resize( chunk.m_corners.GetCount() );
+        for ( u32 i = 0; i < chunk.m_corners.GetCount(); ++i )
+            chunk.m_remap[ i ] = vertices.Insert( chunk.m_corners.GetKeys()[ i ] );
+    }
+    mesh.m_indices.resize( indexCount );
+    ForBlocks( jobs, chunkCount, 1, [ & ]( u32 begin, u32 ) {
+        const ObjChunk& chunk = chunks[ begin ];
+        u32* out = &mesh.m_indices[ indexBases[ begin ] ];
+        for ( size_t i = 0; i < chunk.m_indices.size(); ++i )
+            out[ i ] = chunk.m_remap[ chunk.m_indices[ i ] ];
+    } );
+    const std::vector< u64 >& keys = vertices.GetKeys();
+
+    // vertex colors win, then normals when every corner has one
+    std::vector< Float3 > colors;
+    if ( hasColors ) {
+        colors.reserve( ( size_t )positionCount );
+        for ( const ObjChunk& chunk : chunks ) {
+            if ( chunk.m_colors.empty() )
+                colors.insert( colors.end(), chunk.m_positionCount, Float3( 1.0f, 1.0f, 1.0f ) );
+            else
+                colors.insert( colors.end(), chunk.m_colors.begin(), chunk.m_colors.end() );
+        }
+    }
+    const bool normalColors = !hasColors && !missingNormals;
+    mesh.m_vertices.resize( keys.size() );
+    ForBlocks( jobs, ( u32 )keys.size(), VERTEX_BLOCK_SIZE, [ & ]( u32 begin, u32 end ) {
+        for ( u32 i = begin; i < end; ++i ) {
+            const u32 position = ( u32 )keys[ i ];
+            Vertex& v = mesh.m_vertices[ i ];
+            v.m_pos = positions[ position ];
+            if ( hasColors ) {
+                const Float3& c = colors[ position ];
+                v.m_color = Float4( c.x, c.y, c.z, 1.0f );
+            } else if ( normalColors ) {
+                v.m_color = GetNormalColor( normals[ ( u32 )( keys[ i ] >> 32 ) ] );
+            }
+        }
+    } );
+    if ( !hasColors && !normalColors )
+        ColorByFaceNormals( mesh.m_vertices.data(), ( u32 )mesh.m_vertices.size(), mesh.m_indices.data(), ( u32 )mesh.m_indices.size() );
+    return true;
+}
+
+// --- glTF -------------------------------------------------------------------
+
+enum JsonType : u32 {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+};
+
+struct JsonValue {
+    JsonType    m_type = JSON_NULL;
+    f64         m_number = 0.0;         // bools are 0 or 1
+    const char* m_string = nullptr;     // raw text between the quotes, escapes not decoded
+    u32         m_length = 0;
+    u32         m_first = 0;            // arrays and objects: JsonDocument members [ m_first, m_first + m_count )
+    u32         m_count = 0;
+};
+
+struct JsonMember {
+    const char* m_key = nullptr;        // null in arrays
+    u32         m_keyLength = 0;
+    u32         m_value = 0;
+};
+
+// just enough JSON for glTF: a tree of values over the source text
+class JsonDocument {
+public:
+    bool Parse( const char* text, size_t size );
+
+    const JsonValue& GetRoot() const { return m_values[ 0 ]; }
+    // null if value is not an object or has no such member
+    const JsonValue* Find( const JsonValue& value, const char* key ) const;
+    // null if value is not an array or too short
+    const JsonValue* At( const JsonValue& value, u32 index ) const;
+
+private:
+    static constexpr u32 MAX_DEPTH = 64;
+
+    bool ParseValue( u32 depth, u32& index );
+    bool ParseString( const char*& string, u32& length );
+    void SkipWhitespace();
+
+    const char*                 m_cursor = nullptr;
+    const char*                 m_end = nullptr;
+    std::vector< JsonValue >    m_values;
+    std::vector< JsonMember >   m_members;
+};
+
+//
+bool JsonDocument::Parse( const char* text, size_t size ) {
+    m_cursor = text;
+    m_end = text + size;
+    m_values.clear();
+    m_members.clear();
+    u32 root;
+    if ( !ParseValue( 0, root ) )
+        return false;
+    SkipWhitespace();
+    return m_cursor == m_end;
+}
+
+//
+void JsonDocument::SkipWhitespace() {
+    while ( m_cursor < m_end && ( *m_cursor == ' ' || *m_cursor == '\t' || *m_cursor == '\r' || *m_cursor == '\n' ) )
+        ++m_cursor;
+}
+
+//
+bool JsonDocument::ParseString( const char*& string, u32& length ) {
+    if ( m_cursor == m_end || *m_cursor != '"' )
+        return false;
+    string = ++m_cursor;
+    while ( m_cursor < m_end && *m_cursor != '"' )
+        m_cursor += *m_cursor == '\\' ? 2 : 1;
+    if ( m_cursor >= m_end )
+        return false;
+    length = ( u32 )( m_cursor++ - string );
+    return true;
+}
+
+//
+bool JsonDocument::ParseValue( u32 depth, u32& index ) {
+    SkipWhitespace();
+    if ( m_cursor == m_end || depth > MAX_DEPTH )
+        return false;
+
+    index = ( u32 )m_values.size();
+    m_values.emplace_back();
+    JsonValue value;
+    const char c = *m_cursor;
+    if ( c == '{' || c == '[' ) {
+        const bool object = c == '{';
+        const char close = object ? '}' : ']';
+        value.m_type = object ? JSON_OBJECT : JSON_ARRAY;
+        ++m_cursor;
+        // members of nested values are appended while parsing, so collect this level first
+        std::vector< JsonMember > members;
+        SkipWhitespace();
+        if ( m_cursor < m_end && *m_cursor == close ) {
+            ++m_cursor;
+        } else {
+            for ( ;; ) {
+                JsonMember member;
+                if ( object ) {
+                    SkipWhitespace();
+                    if ( !ParseString( member.m_key, member.m_keyLength ) )
+                        return false;
+                    SkipWhitespace();
+                    if ( m_cursor == m_end || *m_cursor++ != ':' )
+                        return false;
+                }
+                if ( !ParseValue( depth + 1, member.m_value ) )
+                    return false;
+                members.push_back( member );
+                SkipWhitespace();
+                if ( m_cursor == m_end )
+                    return false;
+                const char separator = *m_cursor++;
+                if ( separator == close )
+                    break;
+                if ( separator != ',' )
+                    return false;
+            }
+        }
+        value.m_first = ( u32 )m_members.size();
+        value.m_count = ( u32 )members.size();
+        m_members.insert( m_members.end(), members.begin(), members.end() );
+    } else if ( c == '"' ) {
+        value.m_type = JSON_STRING;
+        if ( !ParseString( value.m_string, value.m_length ) )
+            return false;
+    } else if ( m_end - m_cursor >= 4 && memcmp( m_cursor, "true", 4 ) == 0 ) {
+        value.m_type = JSON_BOOL;
+        value.m_number = 1.0;
+        m_cursor += 4;
+    } else if ( m_end - m_cursor >= 5 && memcmp( m_cursor, "false", 5 ) == 0 ) {
+        value.m_type = JSON_BOOL;
+        m_cursor += 5;
+    } else if ( m_end - m_cursor >= 4 && memcmp( m_cursor, "null", 4 ) == 0 ) {
+        m_cursor += 4;
+    } else {
+        value.m_type = JSON_NUMBER;
+        const std::from_chars_result result = std::from_chars( m_cursor, m_end, value.m_number );
+        if ( result.ec != std::errc() )
+            return false;
+        m_cursor = result.ptr;
+    }
+    m_values[ index ] = value;
+    return true;
+}
+
+//
+const JsonValue* JsonDocument::Find( const JsonValue& value, const char* key ) const {
+    if ( value.m_type != JSON_OBJECT )
+        return nullptr;
+    const size_t length = strlen( key );
+    for ( u32 i = 0; i < value.m_count; ++i ) {
+        const JsonMember& member = m_members[ value.m_first + i ];
+        if ( member.m_keyLength == length && memcmp( member.m_key, key, length ) == 0 )
+            return &m_values[ member.m_value ];
+    }
+    return nullptr;
+}
+
+//
+const JsonValue* JsonDocument::At( const JsonValue& value, u32 index ) const {
+    if ( value.m_type != JSON_ARRAY || index >= value.m_count )
+        return nullptr;
+    return &m_values[ m_members[ value.m_first + index ].m_value ];
+}
+
+// decodes the escapes glTF uris may contain, \uXXXX beyond ASCII becomes '?'
+static std::string GetJsonString( const JsonValue& value ) {
+    std::string text;
+    for ( u32 i = 0; i < value.m_length; ++i ) {
+        char c = value.m_string[ i ];
+        if ( c == '\\' && i + 1 < value.m_length ) {
+            c = value.m_string[ ++i ];
+            if ( c == 'n' )
+                c = '\n';
+            else if ( c == 't' )
+                c = '\t';
+            else if ( c == 'r' )
+                c = '\r';
+            else if ( c == 'b' )
+                c = '\b';
+            else if ( c == 'f' )
+                c = '\f';
+            else if ( c == 'u' && i + 4 < value.m_length ) {
+                u32 code = 0;
+                std::from_chars( value.m_string + i + 1, value.m_string + i + 5, code, 16 );
+                c = code < 0x80 ? ( char )code : '?';
+                i += 4;
+            }
+        }
+        text += c;
+    }
+    return text;
+}
+
+static f64 GetNumber( const JsonDocument& json, const JsonValue& object, const char* key, f64 fallback ) {
+    const JsonValue* value = json.Find( object, key );
+    return value != nullptr && value->m_type == JSON_NUMBER ? value->m_number : fallback;
+}
+
+// a missing member reads as fallback. false unless the value is an integer
+// in [0,max], checked before the conversion so NaN and huge values never reach it
+static bool GetInteger( const JsonDocument& json, const JsonValue& object, const char* key, f64 fallback, f64 max, u64& out ) {
+    const f64 value = GetNumber( json, object, key, fallback );
+    if ( !( value >= 0.0 && value <= max ) || value != ( f64 )( u64 )value )
+        return false;
+    out = ( u64 )value;
+    return true;
+}
+
+// false unless value is a non-negative integer below 2^32 - 1
+static bool ToIndex( f64 value, u32& index ) {
+    if ( !( value >= 0.0 && value < 4294967295.0 ) || value != ( f64 )( u32 )value )
+        return false;
+    index = ( u32 )value;
+    return true;
+}
+
+// false unless the member is a non-negative integer
+static bool GetIndex( const JsonDocument& json, const JsonValue& object, const char* key, u32& index ) {
+    return ToIndex( GetNumber( json, object, key, -1.0 ), index );
+}
+
+// count floats of an array member into out, false if it is missing or shorter
+static bool GetFloats( const JsonDocument& json, const JsonValue& object, const char* key, f32* out, u32 count ) {
+    const JsonValue* array = json.Find( object, key );
+    if ( array == nullptr || array->m_type != JSON_ARRAY || array->m_count < count )
+        return false;
+    for ( u32 i = 0; i < count; ++i ) {
+        const JsonValue* value = json.At( *array, i );
+        out[ i ] = value->m_type == JSON_NUMBER ? ( f32 )value->m_number : 0.0f;
+    }
+    return true;
+}
+
+//
+static bool DecodeBase64( const char* text, size_t length, std::vector< u8 >& out ) {
+    out.clear();
+    out.reserve( length / 4 * 3 );
+    u32 bits = 0, bitCount = 0;
+    for ( size_t i = 0; i < length && text[ i ] != '='; ++i ) {
+        const char c = text[ i ];
+        u32 value;
+        if ( c >= 'A' && c <= 'Z' )
+            value = ( u32 )( c - 'A' );
+        else if ( c >= 'a' && c <= 'z' )
+            value = ( u32 )( c - 'a' ) + 26;
+        else if ( c >= '0' && c <= '9' )
+            value = ( u32 )( c - '0' ) + 52;
+        else if ( c == '+' || c == '-' )
+            value = 62;
+        else if ( c == '/' || c == '_' )
+            value = 63;
+        else
+            return false;
+        bits = ( bits << 6 ) | value;
+        bitCount += 6;
+        if ( bitCount >= 8 ) {
+            bitCount -= 8;
+            out.push_back( ( u8 )( bits >> bitCount ) );
+        }
+    }
+    return true;
+}
+
+struct GltfBuffer {
+    const u8*   m_data = nullptr;
+    size_t      m_size = 0;
+};
+
+// an accessor resolved to memory, bounds already checked
+struct GltfAccessor {
+    const u8*   m_data = nullptr;
+    u32         m_count = 0;
+    u32         m_stride = 0;
+    u32         m_componentType = 0;
+    u32         m_components = 0;
+    bool        m_normalized = false;
+};
+
+enum GltfComponentType : u32 {
+    GLTF_BYTE = 5120,
+    GLTF_UNSIGNED_BYTE = 5121,
+    GLTF_SHORT = 5122,
+    GLTF_UNSIGNED_SHORT = 5123,
+    GLTF_UNSIGNED_INT = 5125,
+    GLTF_FLOAT = 5126,
+};
+
+static constexpr u32 GLTF_TRIANGLES = 4;
+static constexpr u32 GLB_MAGIC = 0x46546C67;        // "glTF"
+static constexpr u32 GLB_CHUNK_JSON = 0x4E4F534A;
+static constexpr u32 GLB_CHUNK_BIN = 0x004E4942;
+
+static u32 GetComponentSize( u32 componentType ) {
+    switch ( componentType ) {
+    case GLTF_BYTE:
+    case GLTF_UNSIGNED_BYTE:
+        return 1;
+    case GLTF_SHORT:
+    case GLTF_UNSIGNED_SHORT:
+        return 2;
+    case GLTF_UNSIGNED_INT:
+    case GLTF_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static u32 GetComponentCount( const JsonValue& type ) {
+    static const char* const names[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+    for ( u32 i = 0; i < 4; ++i ) {
+        if ( type.m_type == JSON_STRING && type.m_length == strlen( names[ i ] ) && memcmp( type.m_string, names[ i ], type.m_length ) == 0 )
+            return i + 1;
+    }
+    return 0;
+}
+
+struct GltfFile {
+    JsonDocument                                m_json;
+    std::vector< GltfBuffer >                   m_buffers;
+    std::vector< std::vector< u8 > >            m_decoded;      // data uri buffers
+    std::vector< std::unique_ptr< MappedFile > > m_files;       // external buffers
+};
+
+// buffers come from the .glb BIN chunk, data uris or files next to the .gltf
+static bool LoadGltfBuffers( GltfFile& file, const u8* bin, size_t binSize, const char* directory ) {
+    const JsonValue* buffers = file.m_json.Find( file.m_json.GetRoot(), "buffers" );
+    const u32 count = buffers != nullptr && buffers->m_type == JSON_ARRAY ? buffers->m_count : 0;
+    file.m_buffers.resize( count );
+    file.m_decoded.resize( count );
+    for ( u32 i = 0; i < count; ++i ) {
+        const JsonValue& buffer = *file.m_json.At( *buffers, i );
+        const f64 byteLength = GetNumber( file.m_json, buffer, "byteLength", -1.0 );
+        const JsonValue* uri = file.m_json.Find( buffer, "uri" );
+        GltfBuffer& out = file.m_buffers[ i ];
+        if ( uri == nullptr || uri->m_type != JSON_STRING ) {
+            if ( i != 0 || bin == nullptr )
+                return false;
+            out.m_data = bin;
+            out.m_size = binSize;
+        } else {
+            const std::string path = GetJsonString( *uri );
+            if ( path.compare( 0, 5, "data:" ) == 0 ) {
+                const size_t comma = path.find( ";base64," );
+                if ( comma == std::string::npos || !DecodeBase64( path.c_str() + comma + 8, path.size() - comma - 8, file.m_decoded[ i ] ) )
+                    return false;
+                out.m_data = file.m_decoded[ i ].data();
+                out.m_size = file.m_decoded[ i ].size();
+            } else {
+                std::unique_ptr< MappedFile > mapped( new MappedFile );
+                const std::string fullPath = directory != nullptr && directory[ 0 ] != '\0' ? std::string( directory ) + "/" + path : path;
+                if ( !mapped->Open( fullPath.c_str() ) )
+                    return false;
+                out.m_data = mapped->GetData();
+                out.m_size = mapped->GetSize();
+                file.m_files.push_back( std::move( mapped ) );
+            }
+        }
+        // the BIN chunk may be padded past byteLength
+        if ( !( byteLength >= 0.0 && byteLength <= ( f64 )out.m_size ) )
+            return false;
+        out.m_size = ( size_t )byteLength;
+    }
+    return true;
+}
+
+//
+static bool GetAccessor( const GltfFile& file, u32 index, GltfAccessor& accessor ) {
+    const JsonDocument& json = file.m_json;
+    const JsonValue* accessors = json.Find( json.GetRoot(), "accessors" );
+    const JsonValue* object = accessors != nullptr ? json.At( *accessors, index ) : nullptr;
+    if ( object == nullptr || json.Find( *object, "sparse" ) != nullptr )
+        return false;
+    u32 viewIndex, bufferIndex;
+    const JsonValue* views = json.Find( json.GetRoot(), "bufferViews" );
+    const JsonValue* type = json.Find( *object, "type" );
+    if ( !GetIndex( json, *object, "bufferView", viewIndex ) || views == nullptr || json.At( *views, viewIndex ) == nullptr || type == nullptr )
+        return false;
+    const JsonValue& view = *json.At( *views, viewIndex );
+    if ( !GetIndex( json, view, "buffer", bufferIndex ) || bufferIndex >= file.m_buffers.size() )
+        return false;
+
+    // offsets and lengths up to 2^53, where doubles stop being exact, so the
+    // sums below cannot wrap; byteStride is at most 252 in glTF
+    u64 componentType, count, stride, viewOffset, viewLength, offset;
+    if ( !GetInteger( json, *object, "componentType", 0.0, 4294967295.0, componentType ) || !GetInteger( json, *object, "count", 0.0, 4294967295.0, count ) ||
+         !GetInteger( json, view, "byteStride", 0.0, 252.0, stride ) || !GetInteger( json, view, "byteOffset", 0.0, 9007199254740992.0, viewOffset ) ||
+         !GetInteger( json, view, "byteLength", 0.0, 9007199254740992.0, viewLength ) || !GetInteger( json, *object, "byteOffset", 0.0, 9007199254740992.0, offset ) )
+        return false;
+    accessor.m_componentType = ( u32 )componentType;
+    accessor.m_components = GetComponentCount( *type );
+    accessor.m_count = ( u32 )count;
+    const JsonValue* normalized = json.Find( *object, "normalized" );
+    accessor.m_normalized = normalized != nullptr && normalized->m_number != 0.0;
+    const u32 elementSize = GetComponentSize( accessor.m_componentType ) * accessor.m_components;
+    if ( elementSize == 0 || accessor.m_count == 0 )
+        return false;
+    accessor.m_stride = stride != 0 ? ( u32 )stride : elementSize;
+
+    const GltfBuffer& buffer = file.m_buffers[ bufferIndex ];
+    if ( viewOffset + viewLength > buffer.m_size || offset + ( u64 )accessor.m_stride * ( accessor.m_count - 1 ) + elementSize > viewLength )
+        return false;
+    accessor.m_data = buffer.m_data + viewOffset + offset;
+    return true;
+}
+
+// element i as floats, normalized integers mapped to [0,1] or [-1,1]; missing components stay as given
+static void ReadElement( const GltfAccessor& accessor, u32 i, f32* out ) {
+    const u8* element = accessor.m_data + ( size_t )i * accessor.m_stride;
+    const u32 count = accessor.m_components < 4 ? accessor.m_components : 4;
+    for ( u32 c = 0; c < count; ++c ) {
+        f32 value;
+        switch ( accessor.m_componentType ) {
+        case GLTF_FLOAT:
+            memcpy( &value, element + c * 4, 4 );
+            break;
+        case GLTF_UNSIGNED_BYTE:
+            value = accessor.m_normalized ? element[ c ] * ( 1.0f / 255.0f ) : ( f32 )element[ c ];
+            break;
+        case GLTF_BYTE: {
+            const f32 v = ( f32 )( i8 )element[ c ];
+            value = accessor.m_normalized ? ( v < -127.0f ? -1.0f : v * ( 1.0f / 127.0f ) ) : v;
+            break;
+        }
+        case GLTF_UNSIGNED_SHORT: {
+            u16 v;
+            memcpy( &v, element + c * 2, 2 );
+            value = accessor.m_normalized ? v * ( 1.0f / 65535.0f ) : ( f32 )v;
+            break;
+        }
+        case GLTF_SHORT: {
+            i16 v;
+            memcpy( &v, element + c * 2, 2 );
+            value = accessor.m_normalized ? ( v < -32767 ? -1.0f : v * ( 1.0f / 32767.0f ) ) : ( f32 )v;
+            break;
+        }
+        default: {
+            u32 v;
+            memcpy( &v, element + c * 4, 4 );
+            value = ( f32 )v;
+            break;
+        }
+        }
+        out[ c ] = value;
+    }
+}
+
+//
+static u32 ReadIndex( const GltfAccessor& accessor, u32 i ) {
+    const u8* element = accessor.m_data + ( size_t )i * accessor.m_stride;
+    if ( accessor.m_componentType == GLTF_UNSIGNED_BYTE )
+        return element[ 0 ];
+    if ( accessor.m_componentType == GLTF_UNSIGNED_SHORT ) {
+        u16 index;
+        memcpy( &index, element, 2 );
+        return index;
+    }
+    u32 index;
+    memcpy( &index, element, 4 );
+    return index;
+}
+
+// glTF matrices are column-major for column vectors, which is the row-major
+// layout of the same transform for row vectors
+static Matrix GetNodeTransform( const JsonDocument& json, const JsonValue& node ) {
+    f32 m[ 16 ];
+    if ( GetFloats( json, node, "matrix", m, 16 ) ) {
+        Matrix matrix;
+        for ( u32 i = 0; i < 4; ++i )
+            matrix.r[ i ] = Float4( m[ i * 4 ], m[ i * 4 + 1 ], m[ i * 4 + 2 ], m[ i * 4 + 3 ] );
+        return matrix;
+    }
+
+    f32 t[ 3 ] = { 0.0f, 0.0f, 0.0f }, r[ 4 ] = { 0.0f, 0.0f, 0.0f, 1.0f }, s[ 3 ] = { 1.0f, 1.0f, 1.0f };
+    GetFloats( json, node, "translation", t, 3 );
+    GetFloats( json, node, "rotation", r, 4 );
+    GetFloats( json, node, "scale", s, 3 );
+
+    // unit quaternion x y z w to the transposed rotation matrix
+    const f32 x = r[ 0 ], y = r[ 1 ], z = r[ 2 ], w = r[ 3 ];
+    Matrix rotation = MatrixIdentity();
+    rotation.r[ 0 ] = Float4( 1.0f - 2.0f * ( y * y + z * z ), 2.0f * ( x * y + z * w ), 2.0f * ( x * z - y * w ), 0.0f );
+    rotation.r[ 1 ] = Float4( 2.0f * ( x * y - z * w ), 1.0f - 2.0f * ( x * x + z * z ), 2.0f * ( y * z + x * w ), 0.0f );
+    rotation.r[ 2 ] = Float4( 2.0f * ( x * z + y * w ), 2.0f * ( y * z - x * w ), 1.0f - 2.0f * ( x * x + y * y ), 0.0f );
+    return MatrixMultiply( MatrixMultiply( MatrixScaling( s[ 0 ], s[ 1 ], s[ 2 ] ), rotation ), MatrixTranslation( t[ 0 ], t[ 1 ], t[ 2 ] ) );
+}
+
+// one triangle primitive under one node
+struct GltfDraw {
+    Matrix          m_transform;
+    GltfAccessor    m_positions;
+    GltfAccessor    m_normals;          // m_data null if absent, as for the two below
+    GltfAccessor    m_colors;
+    GltfAccessor    m_indices;
+    u32             m_vertexBase = 0;
+    u32             m_indexBase = 0;
+    u32             m_indexCount = 0;
+};
+
+// appends a draw for every triangle primitive of the mesh
+static bool AddGltfMesh( const GltfFile& file, u32 meshIndex, const Matrix& transform, std::vector< GltfDraw >& draws ) {
+    const JsonDocument& json = file.m_json;
+    const JsonValue* meshes = json.Find( json.GetRoot(), "meshes" );
+    const JsonValue* mesh = meshes != nullptr ? json.At( *meshes, meshIndex ) : nullptr;
+    const JsonValue* primitives = mesh != nullptr ? json.Find( *mesh, "primitives" ) : nullptr;
+    if ( primitives == nullptr || primitives->m_type != JSON_ARRAY )
+        return false;
+
+    for ( u32 i = 0; i < primitives->m_count; ++i ) {
+        const JsonValue& primitive = *json.At( *primitives, i );
+        const JsonValue* attributes = json.Find( primitive, "attributes" );
+        u32 position, normal, color, indices;
+        if ( GetNumber( json, primitive, "mode", GLTF_TRIANGLES ) != GLTF_TRIANGLES )
+            continue;
+        GltfDraw draw;
+        draw.m_transform = transform;
+        if ( attributes == nullptr || !GetIndex( json, *attributes, "POSITION", position ) ||
+             !GetAccessor( file, position, draw.m_positions ) || draw.m_positions.m_components != 3 )
+            return false;
+        if ( GetIndex( json, *attributes, "NORMAL", normal ) && !GetAccessor( file, normal, draw.m_normals ) )
+            return false;
+        if ( GetIndex( json, *attributes, "COLOR_0", color ) && !GetAccessor( file, color, draw.m_colors ) )
+            return false;
+        if ( GetIndex( json, primitive, "indices", indices ) ) {
+            if ( !GetAccessor( file, indices, draw.m_indices ) || draw.m_indices.m_components != 1 || draw.m_indices.m_componentType == GLTF_FLOAT )
+                return false;
+            draw.m_indexCount = draw.m_indices.m_count;
+        } else {
+            draw.m_indexCount = draw.m_positions.m_count;
+        }
+        if ( draw.m_normals.m_data != nullptr && draw.m_normals.m_count != draw.m_positions.m_count )
+            return false;
+        if ( draw.m_colors.m_data != nullptr && draw.m_colors.m_count != draw.m_positions.m_count )
+            return false;
+        draw.m_indexCount -= draw.m_indexCount % 3;
+        draws.push_back( draw );
+    }
+    return true;
+}
+
+// walks the node tree from the roots of the default scene
+static bool CollectGltfDraws( const GltfFile& file, std::vector< GltfDraw >& draws ) {
+    const JsonDocument& json = file.m_json;
+    const JsonValue& root = json.GetRoot();
+    const JsonValue* scenes = json.Find( root, "scenes" );
+    const JsonValue* nodes = json.Find( root, "nodes" );
+    u32 sceneIndex = 0;
+    GetIndex( json, root, "scene", sceneIndex );
+    const JsonValue* scene = scenes != nullptr ? json.At( *scenes, sceneIndex ) : nullptr;
+
+    // no scene: every mesh once, untransformed
+    if ( scene == nullptr ) {
+        const JsonValue* meshes = json.Find( root, "meshes" );
+        const u32 count = meshes != nullptr && meshes->m_type == JSON_ARRAY ? meshes->m_count : 0;
+        for ( u32 i = 0; i < count; ++i ) {
+            if ( !AddGltfMesh( file, i, MatrixIdentity(), draws ) )
+                return false;
+        }
+        return true;
+    }
+
+    struct Pending {
+        u32     m_node;
+        u32     m_depth;
+        Matrix  m_parent;
+    };
+    std::vector< Pending > stack;
+    const JsonValue* roots = json.Find( *scene, "nodes" );
+    for ( u32 i = 0; roots != nullptr && i < roots->m_count; ++i ) {
+        const JsonValue* node = json.At( *roots, i );
+        u32 index;
+        if ( node == nullptr || node->m_type != JSON_NUMBER || !ToIndex( node->m_number, index ) )
+            return false;
+        stack.push_back( { index, 0, MatrixIdentity() } );
+    }
+    // the depth bound stops cycles, which valid files do not have
+    const u32 nodeCount = nodes != nullptr && nodes->m_type == JSON_ARRAY ? nodes->m_count : 0;
+    while ( !stack.empty() ) {
+        const Pending pending = stack.back();
+        stack.pop_back();
+        const JsonValue* node = nodes != nullptr ? json.At( *nodes, pending.m_node ) : nullptr;
+        if ( node == nullptr || pending.m_depth > nodeCount )
+            return false;
+        const Matrix world = MatrixMultiply( GetNodeTransform( json, *node ), pending.m_parent );
+        u32 mesh;
+        if ( GetIndex( json, *node, "mesh", mesh ) && !AddGltfMesh( file, mesh, world, draws ) )
+            return false;
+        const JsonValue* children = json.Find( *node, "children" );
+        for ( u32 i = 0; children != nullptr && i < children->m_count; ++i ) {
+            const JsonValue* child = json.At( *children, i );
+            u32 index;
+            if ( child == nullptr || child->m_type != JSON_NUMBER || !ToIndex( child->m_number, index ) )
+                return false;
+            stack.push_back( { index, pending.m_depth + 1, world } );
+        }
+    }
+    return true;
+}
+
+// writes the draw's vertices and indices at its bases, false on an out-of-range index
+static bool ConvertGltfDraw( const GltfDraw& draw, MeshData& mesh, JobSystem* jobs ) {
+    const Matrix& m = draw.m_transform;
+    const Float3 r0( m.r[ 0 ].x, m.r[ 0 ].y, m.r[ 0 ].z );
+    const Float3 r1( m.r[ 1 ].x, m.r[ 1 ].y, m.r[ 1 ].z );
+    const Float3 r2( m.r[ 2 ].x, m.r[ 2 ].y, m.r[ 2 ].z );
+    // normals go through the cofactor matrix, the inverse transpose up to the determinant
+    const Float3 c0 = Vector3Cross( r1, r2 ), c1 = Vector3Cross( r2, r0 ), c2 = Vector3Cross( r0, r1 );
+    const f32 determinant = Vector3Dot( r0, c0 );
+    const f32 normalSign = determinant < 0.0f ? -1.0f : 1.0f;
+    const bool colored = draw.m_colors.m_data != nullptr || draw.m_normals.m_data != nullptr;
+
+    ForBlocks( jobs, draw.m_positions.m_count, VERTEX_BLOCK_SIZE, [ & ]( u32 begin, u32 end ) {
+        for ( u32 i = begin; i < end; ++i ) {
+            f32 p[ 3 ];
+            ReadElement( draw.m_positions, i, p );
+            const Float4 world = TransformPoint( Float3( p[ 0 ], p[ 1 ], p[ 2 ] ), m );
+            Vertex& v = mesh.m_vertices[ draw.m_vertexBase + i ];
+            v.m_pos = Float3( world.x, world.y, -world.z );
+            if ( draw.m_colors.m_data != nullptr ) {
+                f32 c[ 4 ] = { 1.0f, 1.0f, 1.0f, 1.0f };
+                ReadElement( draw.m_colors, i, c );
+                v.m_color = Float4( c[ 0 ], c[ 1 ], c[ 2 ], c[ 3 ] );
+            } else if ( draw.m_normals.m_data != nullptr ) {
+                f32 n[ 3 ] = { 0.0f, 0.0f, 0.0f };
+                ReadElement( draw.m_normals, i, n );
+                const Float3 normal = Vector3Normalize( Float3(
+                    ( n[ 0 ] * c0.x + n[ 1 ] * c1.x + n[ 2 ] * c2.x ) * normalSign,
+                    ( n[ 0 ] * c0.y + n[ 1 ] * c1.y + n[ 2 ] * c2.y ) * normalSign,
+                    ( n[ 0 ] * c0.z + n[ 1 ] * c1.z + n[ 2 ] * c2.z ) * normalSign ) );
+                v.m_color = GetNormalColor( Float3( normal.x, normal.y, -normal.z ) );
+            }
+        }
+    } );
+
+    // a mirroring transform turns the winding around
+    std::atomic< bool > valid{ true };
+    const bool flip = determinant < 0.0f;
+    ForBlocks( jobs, draw.m_indexCount / 3, VERTEX_BLOCK_SIZE, [ & ]( u32 begin, u32 end ) {
+        u32* out = &mesh.m_indices[ draw.m_indexBase ];
+        for ( u32 t = begin; t < end; ++t ) {
+            for ( u32 k = 0; k < 3; ++k ) {
+                const u32 corner = t * 3 + ( flip && k > 0 ? 3 - k : k );
+                const u32 index = draw.m_indices.m_data != nullptr ? ReadIndex( draw.m_indices, corner ) : corner;
+                if ( index >= draw.m_positions.m_count )
+                    valid = false;
+                out[ t * 3 + k ] = index;
+            }
+        }
+    } );
+    if ( !valid )
+        return false;
+
+    // colored by the faces before the indices are rebased
+    if ( !colored )
+        ColorByFaceNormals( &mesh.m_vertices[ draw.m_vertexBase ], draw.m_positions.m_count, &mesh.m_indices[ draw.m_indexBase ], draw.m_indexCount );
+    for ( u32 i = 0; i < draw.m_indexCount; ++i )
+        mesh.m_indices[ draw.m_indexBase + i ] += draw.m_vertexBase;
+    return true;
+}
+
+//
+bool ImportGltf( const u8* data, size_t size, const char* directory, MeshData& mesh, JobSystem* jobs ) {
+    mesh.m_vertices.clear();
+    mesh.m_indices.clear();
+
+    // .glb: 12-byte header, then the JSON chunk and an optional BIN chunk
+    const char* text = ( const char* )data;
+    size_t textSize = size;
+    const u8* bin = nullptr;
+    size_t binSize = 0;
+    u32 header[ 3 ];
+    if ( size >= sizeof( header ) && memcmp( data, &GLB_MAGIC, 4 ) == 0 ) {
+        memcpy( header, data, sizeof( header ) );
+        if ( header[ 1 ] != 2 || header[ 2 ] > size )
+            return false;
+        size = header[ 2 ];
+        textSize = 0;
+        for ( size_t offset = sizeof( header ); offset + 8 <= size; ) {
+            u32 chunk[ 2 ];
+            memcpy( chunk, data + offset, sizeof( chunk ) );
+            offset += sizeof( chunk );
+            if ( chunk[ 0 ] > size - offset )
+                return false;
+            if ( chunk[ 1 ] == GLB_CHUNK_JSON && textSize == 0 ) {
+                text = ( const char* )data + offset;
+                textSize = chunk[ 0 ];
+            } else if ( chunk[ 1 ] == GLB_CHUNK_BIN && bin == nullptr ) {
+                bin = data + offset;
+                binSize = chunk[ 0 ];
+            }
+            offset += ( chunk[ 0 ] + 3 ) & ~3u;
+        }
+        if ( textSize == 0 )
+            return false;
+    }
+
+    GltfFile file;
+    std::vector< GltfDraw > draws;
+    if ( !file.m_json.Parse( text, textSize ) || !LoadGltfBuffers( file, bin, binSize, directory ) || !CollectGltfDraws( file, draws ) )
+        return false;
+
+    u64 vertexCount = 0, indexCount = 0;
+    for ( GltfDraw& draw : draws ) {
+        draw.m_vertexBase = ( u32 )vertexCount;
+        draw.m_indexBase = ( u32 )indexCount;
+        vertexCount += draw.m_positions.m_count;
+        indexCount += draw.m_indexCount;
+    }
+    if ( indexCount == 0 || vertexCount >= INVALID_INDEX || indexCount >= INVALID_INDEX )
+        return false;
+
+    mesh.m_vertices.resize( ( size_t )vertexCount );
+    mesh.m_indices.resize( ( size_t )indexCount );
+    for ( const GltfDraw& draw : draws ) {
+        if ( !ConvertGltfDraw( draw, mesh, jobs ) )
+            return false;
+    }
+    // vertices repeated within and across primitives merge
+    DeduplicateVertices( mesh );
+    return true;
+}
+
+// case-insensitive suffix test
+static bool HasExtension( const char* path, const char* extension ) {
+    const size_t length = strlen( path ), extensionLength = strlen( extension );
+    if ( length < extensionLength )
+        return false;
+    for ( size_t i = 0; i < extensionLength; ++i ) {
+        if ( tolower( ( unsigned char )path[ length - extensionLength + i ] ) != extension[ i ] )
+            return false;
+    }
+    return true;
+}
+
+//
+bool ImportMeshFile( const char* path, MeshData& mesh, JobSystem* jobs ) {
+    MappedFile file;
+    if ( !file.Open( path ) )
+        return false;
+    if ( HasExtension( path, ".obj" ) )
+        return ImportObj( ( const char* )file.GetData(), file.GetSize(), mesh, jobs );
+    if ( HasExtension( path, ".gltf" ) || HasExtension( path, ".glb" ) ) {
+        const char* slash = strrchr( path, '/' );
+        const char* backslash = strrchr( path, '\\' );
+        slash = backslash != nullptr && ( slash == nullptr || backslash > slash ) ? backslash : slash;
+        const std::string directory = slash != nullptr ? std::string( path, slash ) : std::string();
+        return ImportGltf( file.GetData(), file.GetSize(), directory.c_str(), mesh, jobs );
+    }
+    return false;
+}
+
+// word-wise mix of the vertex bytes, FNV-1a byte by byte is too slow for millions of vertices
+static u64 HashVertex( const Vertex& v ) {
+    u32 words[ sizeof( Vertex ) / 4 ];
+    memcpy( words, &v, sizeof( words ) );
+    u64 hash = HASH_SEED;
+    for ( u32 word : words )
+        hash = MixHash( hash ^ word );
+    return hash;
+}
+
+//
+void DeduplicateVertices( MeshData& mesh ) {
+    const u32 vertexCount = ( u32 )mesh.m_vertices.size();
+    std::vector< u32 > table( GetTableSize( vertexCount ), INVALID_INDEX );
+    std::vector< u32 > remap( vertexCount );
+    const u32 mask = ( u32 )table.size() - 1;
+    u32 unique = 0;
+    for ( u32 i = 0; i < vertexCount; ++i ) {
+        const Vertex& v = mesh.m_vertices[ i ];
+        u32 slot = ( u32 )HashVertex( v ) & mask;
+        while ( table[ slot ] != INVALID_INDEX && memcmp( &mesh.m_vertices[ table[ slot ] ], &v, sizeof( Vertex ) ) != 0 )
+            slot = ( slot + 1 ) & mask;
+        if ( table[ slot ] == INVALID_INDEX ) {
+            // unique <= i, so compacting never overwrites a vertex still to be read
+            mesh.m_vertices[ unique ] = v;
+            table[ slot ] = unique++;
+        }
+        remap[ i ] = table[ slot ];
+    }
+    mesh.m_vertices.resize( unique );
+    for ( u32& index : mesh.m_indices )
+        index = index < vertexCount ? remap[ index ] : index;
+}
+
+//
+bool GetSourceStamp( const char* path, u64& size, i64& time ) {
+    std::error_code error;
+    const std::uintmax_t fileSize = std::filesystem::file_size( path, error );
+    if ( error )
+        return false;
+    const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time( path, error );
+    if ( error )
+        return false;
+    size = ( u64 )fileSize;
+    time = ( i64 )writeTime.time_since_epoch().count();
+    return true;
+}
+
+//
+static void ComputeBounds( const Mesh& mesh, Float3& boundsMin, Float3& boundsMax ) {
+    boundsMin = boundsMax = mesh.m_vertexCount > 0 ? mesh.m_vertices[ 0 ].m_pos : Float3( 0.0f, 0.0f, 0.0f );
+    for ( u32 i = 1; i < mesh.m_vertexCount; ++i ) {
+        const Float3& p = mesh.m_vertices[ i ].m_pos;
+        boundsMin = Float3( p.x < boundsMin.x ? p.x : boundsMin.x, p.y < boundsMin.y ? p.y : boundsMin.y, p.z < boundsMin.z ? p.z : boundsMin.z );
+        boundsMax = Float3( p.x > boundsMax.x ? p.x : boundsMax.x, p.y > boundsMax.y ? p.y : boundsMax.y, p.z > boundsMax.z ? p.z : boundsMax.z );
+    }
+}
+
+//
+bool WriteMeshCache( const char* path, const Mesh& mesh, u64 sourceSize, i64 sourceTime ) {
+    MeshCacheHeader header;
+    memset( &header, 0, sizeof( header ) );
+    header.m_magic = MESH_CACHE_MAGIC;
+    header.m_version = MESH_CACHE_VERSION;
+    header.m_vertexCount = mesh.m_vertexCount;
+    header.m_indexCount = mesh.m_indexCount;
+    header.m_sourceSize = sourceSize;
+    header.m_sourceTime = sourceTime;
+    ComputeBounds( mesh, header.m_boundsMin, header.m_boundsMax );
+
+    FILE* file = fopen( path, "wb" );
+    if ( file == nullptr )
+        return false;
+    bool written = fwrite( &header, sizeof( header ), 1, file ) == 1;
+    written = written && fwrite( mesh.m_vertices, sizeof( Vertex ), mesh.m_vertexCount, file ) == mesh.m_vertexCount;
+    written = written && fwrite( mesh.m_indices, sizeof( u32 ), mesh.m_indexCount, file ) == mesh.m_indexCount;
+    return fclose( file ) == 0 && written;
+}
+
+// nothing is copied: the mesh points into the mapping
+bool LoadedMesh::OpenCache( const char* path, u64 sourceSize, i64 sourceTime ) {
+    if ( !m_file.Open( path ) || m_file.GetSize() < sizeof( MeshCacheHeader ) ) {
+        m_file.Close();
+        return false;
+    }
+    MeshCacheHeader header;
+    memcpy( &header, m_file.GetData(), sizeof( header ) );
+    const u64 vertexBytes = ( u64 )header.m_vertexCount * sizeof( Vertex );
+    const u64 indexBytes = ( u64 )header.m_indexCount * sizeof( u32 );
+    if ( header.m_magic != MESH_CACHE_MAGIC || header.m_version != MESH_CACHE_VERSION ||
+         header.m_sourceSize != sourceSize || header.m_sourceTime != sourceTime ||
+         sizeof( header ) + vertexBytes + indexBytes != m_file.GetSize() ) {
+        m_file.Close();
+        return false;
+    }
+
+    const u8* data = m_file.GetData() + sizeof( header );
+    m_data = MeshData();
+    m_mesh.m_vertices = ( const Vertex* )data;
+    m_mesh.m_vertexCount = header.m_vertexCount;
+    m_mesh.m_indices = ( const u32* )( data + vertexBytes );
+    m_mesh.m_indexCount = header.m_indexCount;
+    m_boundsMin = header.m_boundsMin;
+    m_boundsMax = header.m_boundsMax;
+    return true;
+}
+
+//
+void LoadedMesh::Assign( MeshData&& data ) {
+    m_file.Close();
+    m_data = std::move( data );
+    m_mesh = m_data.GetMesh();
+    ComputeBounds( m_mesh, m_boundsMin, m_boundsMax );
+}
+
+//
+bool LoadMesh( const char* path, LoadedMesh& mesh, JobSystem* jobs ) {
+    u64 size;
+    i64 time;
+    if ( !GetSourceStamp( path, size, time ) )
+        return false;
+    const std::string cachePath = std::string( path ) + MESH_CACHE_EXTENSION;
+    if ( mesh.OpenCache( cachePath.c_str(), size, time ) )
+        return true;
+
+    MeshData data;
+    if ( !ImportMeshFile( path, data, jobs ) )
+        return false;
+    OptimizeMesh( data );
+    mesh.Assign( std::move( data ) );
+    WriteMeshCache( cachePath.c_str(), mesh.GetMesh(), size, time );
+    return true;
+}
+
+//
+Matrix GetFitTransform( const Float3& boundsMin, const Float3& boundsMax ) {
+    const Float3 extent( boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z );
+    f32 largest = extent.x > extent.y ? extent.x : extent.y;
+    largest = extent.z > largest ? extent.z : largest;
+    const f32 scale = largest > 0.0f ? 1.0f / largest : 1.0f;
+    const Matrix center = MatrixTranslation( -0.5f * ( boundsMin.x + boundsMax.x ), -0.5f * ( boundsMin.y + boundsMax.y ), -0.5f * ( boundsMin.z + boundsMax.z ) );
+    return MatrixMultiply( center, MatrixScaling( scale, scale, scale ) );
+}
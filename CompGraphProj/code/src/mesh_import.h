@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "scene.h"
+
+#include <cstddef>
+
+class JobSystem;
+
+// mesh loaders for Wavefront OBJ and glTF 2.0 (.gltf with external or data
+// uri buffers, .glb). both formats are right-handed with counter-clockwise
+// front faces; negating z turns them into the left-handed, clockwise
+// convention of the renderer without touching the indices.
+//
+// Vertex has no normal or uv, so normals only color the mesh like the sphere
+// (0.5 + 0.5 * n) and uvs are skipped. vertex colors win over normals, meshes
+// without either are colored by computed normals.
+
+// the text is split at line breaks into chunks parsed on the jobs. corners
+// are deduplicated on their position and normal index, faces with more than
+// three corners are fanned. false on syntax errors and out-of-range indices.
+bool ImportObj( const char* text, size_t size, MeshData& mesh, JobSystem* jobs = nullptr );
+
+// triangle primitives of the default scene with their node transforms, or of
+// every mesh when there is no scene. directory resolves relative buffer uris.
+bool ImportGltf( const u8* data, size_t size, const char* directory, MeshData& mesh, JobSystem* jobs = nullptr );
+
+// picks the loader by extension: .obj, .gltf or .glb
+bool ImportMeshFile( const char* path, MeshData& mesh, JobSystem* jobs = nullptr );
+
+// merges vertices with the same bytes and remaps the indices, keeps first-use order
+void DeduplicateVertices( MeshData& mesh );
+
+// runtime cache of imported meshes after OptimizeMesh: MeshCacheHeader, the
+// Vertex array and the u32 indices, written next to the source as path +
+// MESH_CACHE_EXTENSION. it is valid while the source keeps the size and
+// modification time it was built from.
+constexpr u32 MESH_CACHE_MAGIC = 0x434D4743;    // "CGMC"
+constexpr u32 MESH_CACHE_VERSION = 2;           // 2: optimized index and vertex order
+constexpr const char* MESH_CACHE_EXTENSION = ".cgmesh";
+
+struct MeshCacheHeader {
+    u32     m_magic;
+    u32     m_version;
+    u32     m_vertexCount;
+    u32     m_indexCount;
+    u64     m_sourceSize;
+    i64     m_sourceTime;
+    Float3  m_boundsMin;
+    Float3  m_boundsMax;
+};
+static_assert( sizeof( MeshCacheHeader ) % alignof( Vertex ) == 0, "vertices after the header must stay aligned" );
+
+// size and modification time of a file, false if it does not exist
+bool GetSourceStamp( const char* path, u64& size, i64& time );
+
+bool WriteMeshCache( const char* path, const Mesh& mesh, u64 sourceSize, i64 sourceTime );
+
+// an imported mesh, either owned or a view into the mapped cache file
+class LoadedMesh {
+public:
+    // false on a missing file, another version, a stale stamp or sizes that do not add up
+    bool OpenCache( const char* path, u64 sourceSize, i64 sourceTime );
+    // takes the geometry over and computes its bounds
+    void Assign( MeshData&& data );
+
+    const Mesh& GetMesh() const { return m_mesh; }
+    const Float3& GetBoundsMin() const { return m_boundsMin; }
+    const Float3& GetBoundsMax() const { return m_boundsMax; }
+    bool IsMapped() const { return m_file.IsOpen(); }
+
+private:
+    MeshData    m_data;
+    MappedFile  m_file;
+    Mesh        m_mesh;
+    Float3      m_boundsMin = Float3( 0.0f, 0.0f, 0.0f );
+    Float3      m_boundsMax = Float3( 0.0f, 0.0f, 0.0f );
+};
+
+// maps the cache of path when it is current, otherwise imports and optimizes
+// the source and rewrites the cache. a cache that cannot be written only costs
+// the next run.
+bool LoadMesh( const char* path, LoadedMesh& mesh, JobSystem* jobs = nullptr );
+
+// scale and translation that fit the bounds into the unit cube around the origin
+Matrix GetFitTransform( const Float3& boundsMin, const Float3& boundsMax );
@@ -0,0 +1,254 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+
+static constexpr u32 INVALID_INDEX = ~0u;
+
+// FIFO cache by time stamps: a vertex is cached while fewer than cacheSize
+// vertices were loaded after it. time starts past cacheSize so stamp 0 misses.
+struct VertexCacheSim {
+    std::vector< u32 >  m_stamps;
+    u32                 m_time;
+    u32                 m_cacheSize;
+
+    VertexCacheSim( u32 vertexCount, u32 cacheSize ) : m_stamps( vertexCount, 0 ), m_time( cacheSize + 1 ), m_cacheSize( cacheSize ) {}
+
+    // true on a miss, which loads the vertex
+    bool Load( u32 vertex ) {
+        if ( m_time - m_stamps[ vertex ] <= m_cacheSize )
+            return false;
+        m_stamps[ vertex ] = m_time++;
+        return true;
+    }
+
+    void Flush() {
+        m_time += m_cacheSize + 1;
+    }
+};
+
+//
+VertexCacheStats AnalyzeVertexCache( const u32* indices, u32 indexCount, u32 vertexCount, u32 cacheSize ) {
+    VertexCacheStats stats;
+    if ( indexCount < 3 || vertexCount == 0 )
+        return stats;
+    VertexCacheSim cache( vertexCount, cacheSize );
+    u32 misses = 0;
+    for ( u32 i = 0; i < indexCount; ++i )
+        misses += cache.Load( indices[ i ] ) ? 1 : 0;
+    stats.m_acmr = ( f32 )misses / ( f32 )( indexCount / 3 );
+    stats.m_atvr = ( f32 )misses / ( f32 )vertexCount;
+    return stats;
+}
+
+// Tipsify: fans around one vertex at a time and moves on to the neighbor that
+// is still cached and has few triangles left, so it is used up before it is
+// evicted. dead ends continue at a recently used vertex, then in input order.
+void OptimizeVertexCache( const u32* indices, u32 indexCount, u32 vertexCount, std::vector< u32 >& out,
+                          std::vector< u32 >* clusters, u32 cacheSize ) {
+    const u32 triangleCount = indexCount / 3;
+    out.clear();
+    out.reserve( triangleCount * 3 );
+    if ( clusters != nullptr )
+        clusters->clear();
+    if ( triangleCount == 0 )
+        return;
+
+    // triangles around every vertex, and how many of them are not emitted yet
+    std::vector< u32 > live( vertexCount, 0 );
+    for ( u32 i = 0; i < triangleCount * 3; ++i )
+        live[ indices[ i ] ]++;
+    std::vector< u32 > offsets( vertexCount + 1, 0 );
+    for ( u32 v = 0; v < vertexCount; ++v )
+        offsets[ v + 1 ] = offsets[ v ] + live[ v ];
+    std::vector< u32 > adjacency( triangleCount * 3 );
+    {
+        std::vector< u32 > cursor( offsets.begin(), offsets.end() - 1 );
+        for ( u32 i = 0; i < triangleCount * 3; ++i )
+            adjacency[ cursor[ indices[ i ] ]++ ] = i / 3;
+    }
+
+    std::vector< u32 > stamps( vertexCount, 0 );
+    u32 time = cacheSize + 1;
+    std::vector< u8 > emitted( triangleCount, 0 );
+    std::vector< u32 > deadEnds;
+    std::vector< u32 > candidates;
+    u32 scan = 0;
+    while ( scan < vertexCount && live[ scan ] == 0 )
+        ++scan;
+
+    u32 fan = scan;
+    bool cold = true;
+    while ( fan != INVALID_INDEX ) {
+        if ( cold && clusters != nullptr )
+            clusters->push_back( ( u32 )out.size() );
+        cold = false;
+
+        candidates.clear();
+        for ( u32 k = offsets[ fan ]; k < offsets[ fan + 1 ]; ++k ) {
+            const u32 triangle = adjacency[ k ];
+            if ( emitted[ triangle ] )
+                continue;
+            emitted[ triangle ] = 1;
+            for ( u32 c = 0; c < 3; ++c ) {
+                const u32 v = indices[ triangle * 3 + c ];
+                out.push_back( v );
+                deadEnds.push_back( v );
+                candidates.push_back( v );
+                live[ v ]--;
+                if ( time - stamps[ v ] > cacheSize )
+                    stamps[ v ] = time++;
+            }
+        }
+
+        // prefer the oldest cached vertex whose remaining fan still fits in the cache
+        u32 next = INVALID_INDEX;
+        i64 bestPriority = -1;
+        for ( u32 v : candidates ) {
+            if ( live[ v ] == 0 )
+                continue;
+            const u32 age = time - stamps[ v ];
+            const i64 priority = age + 2 * live[ v ] <= cacheSize ? ( i64 )age : 0;
+            if ( priority > bestPriority ) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+        if ( next == INVALID_INDEX ) {
+            while ( !deadEnds.empty() && next == INVALID_INDEX ) {
+                const u32 v = deadEnds.back();
+                deadEnds.pop_back();
+                next = live[ v ] > 0 ? v : INVALID_INDEX;
+            }
+            while ( next == INVALID_INDEX && scan < vertexCount ) {
+                next = live[ scan ] > 0 ? scan : INVALID_INDEX;
+                ++scan;
+            }
+            cold = true;
+        }
+        fan = next;
+    }
+}
+
+struct OverdrawCluster {
+    u32 m_begin;        // first triangle
+    u32 m_end;
+    f32 m_sortKey;
+};
+
+// splits the clusters where the cache restarts cheaply, then draws them in
+// order of how far they face away from the mesh center (Sander et al.'s
+// linear-time approximation of the view-independent overdraw order)
+void OptimizeOverdraw( std::vector< u32 >& indices, const std::vector< u32 >& clusters, const Vertex* vertices, u32 vertexCount,
+                       f32 threshold, u32 cacheSize ) {
+    const u32 triangleCount = ( u32 )indices.size() / 3;
+    if ( triangleCount == 0 )
+        return;
+
+    std::vector< OverdrawCluster > runs;
+    VertexCacheSim cache( vertexCount, cacheSize );
+    for ( size_t c = 0; c < ( clusters.empty() ? 1 : clusters.size() ); ++c ) {
+        const u32 begin = clusters.empty() ? 0 : clusters[ c ] / 3;
+        const u32 end = c + 1 < clusters.size() ? clusters[ c + 1 ] / 3 : triangleCount;
+
+        // the cluster's own ACMR from a cold cache
+        u32 misses = 0;
+        cache.Flush();
+        for ( u32 i = begin * 3; i < end * 3; ++i )
+            misses += cache.Load( indices[ i ] ) ? 1 : 0;
+        const f32 target = threshold * ( f32 )misses / ( f32 )( end - begin );
+
+        // cut once the run so far is about as efficient as the whole cluster
+        cache.Flush();
+        u32 runBegin = begin, runMisses = 0;
+        for ( u32 t = begin; t < end; ++t ) {
+            for ( u32 k = 0; k < 3; ++k )
+                runMisses += cache.Load( indices[ t * 3 + k ] ) ? 1 : 0;
+            if ( t + 1 < end && ( f32 )runMisses <= target * ( f32 )( t + 1 - runBegin ) ) {
+                runs.push_back( { runBegin, t + 1, 0.0f } );
+                runBegin = t + 1;
+                runMisses = 0;
+                cache.Flush();
+            }
+        }
+        runs.push_back( { runBegin, end, 0.0f } );
+    }
+
+    // area-weighted centroid and normal of each run and of the whole mesh
+    std::vector< Float3 > centroids( runs.size() ), normals( runs.size() );
+    Float3 meshCentroid( 0.0f, 0.0f, 0.0f );
+    f32 meshArea = 0.0f;
+    for ( size_t r = 0; r < runs.size(); ++r ) {
+        Float3 centroid( 0.0f, 0.0f, 0.0f ), normal( 0.0f, 0.0f, 0.0f );
+        f32 area = 0.0f;
+        for ( u32 t = runs[ r ].m_begin; t < runs[ r ].m_end; ++t ) {
+            const Float3& p0 = vertices[ indices[ t * 3 ] ].m_pos;
+            const Float3& p1 = vertices[ indices[ t * 3 + 1 ] ].m_pos;
+            const Float3& p2 = vertices[ indices[ t * 3 + 2 ] ].m_pos;
+            // clockwise front faces, like ComputeVertexNormals
+            const Float3 n = Vector3Cross( Float3( p1.x - p0.x, p1.y - p0.y, p1.z - p0.z ), Float3( p2.x - p0.x, p2.y - p0.y, p2.z - p0.z ) );
+            const f32 a = std::sqrt( Vector3Dot( n, n ) );
+            centroid = Float3( centroid.x + ( p0.x + p1.x + p2.x ) * a, centroid.y + ( p0.y + p1.y + p2.y ) * a, centroid.z + ( p0.z + p1.z + p2.z ) * a );
+            normal = Float3( normal.x + n.x, normal.y + n.y, normal.z + n.z );
+            area += a;
+        }
+        meshCentroid = Float3( meshCentroid.x + centroid.x, meshCentroid.y + centroid.y, meshCentroid.z + centroid.z );
+        meshArea += area;
+        const f32 scale = area > 0.0f ? 1.0f / ( 3.0f * area ) : 0.0f;
+        centroids[ r ] = Float3( centroid.x * scale, centroid.y * scale, centroid.z * scale );
+        normals[ r ] = Vector3Normalize( normal );
+    }
+    const f32 meshScale = meshArea > 0.0f ? 1.0f / ( 3.0f * meshArea ) : 0.0f;
+    meshCentroid = Float3( meshCentroid.x * meshScale, meshCentroid.y * meshScale, meshCentroid.z * meshScale );
+    for ( size_t r = 0; r < runs.size(); ++r ) {
+        const Float3 offset( centroids[ r ].x - meshCentroid.x, centroids[ r ].y - meshCentroid.y, centroids[ r ].z - meshCentroid.z );
+        runs[ r ].m_sortKey = Vector3Dot( offset, normals[ r ] );
+    }
+
+    // outermost first
+    std::stable_sort( runs.begin(), runs.end(), []( const OverdrawCluster& a, const OverdrawCluster& b ) { return a.m_sortKey > b.m_sortKey; } );
+    std::vector< u32 > sorted;
+    sorted.reserve( triangleCount * 3 );
+    for ( const OverdrawCluster& run : runs )
+        sorted.insert( sorted.end(), indices.begin() + run.m_begin * 3, indices.begin() + run.m_end * 3 );
+    indices.swap( sorted );
+}
+
+//
+void OptimizeVertexFetch( MeshData& mesh ) {
+    std::vector< u32 > remap( mesh.m_vertices.size(), INVALID_INDEX );
+    u32 next = 0;
+    for ( u32& index : mesh.m_indices ) {
+        if ( remap[ index ] == INVALID_INDEX )
+            remap[ index ] = next++;
+        index = remap[ index ];
+    }
+    std::vector< Vertex > vertices( next );
+    for ( size_t v = 0; v < mesh.m_vertices.size(); ++v ) {
+        if ( remap[ v ] != INVALID_INDEX )
+            vertices[ remap[ v ] ] = mesh.m_vertices[ v ];
+    }
+    mesh.m_vertices.swap( vertices );
+}
+
+//
+MeshOptimizeStats OptimizeMesh( MeshData& mesh, f32 overdrawThreshold ) {
+    MeshOptimizeStats stats;
+    const u32 vertexCount = ( u32 )mesh.m_vertices.size();
+    stats.m_before = AnalyzeVertexCache( mesh.m_indices.data(), ( u32 )mesh.m_indices.size(), vertexCount );
+
+    std::vector< u32 > indices, clusters;
+    OptimizeVertexCache( mesh.m_indices.data(), ( u32 )mesh.m_indices.size(), vertexCount, indices, &clusters );
+    OptimizeOverdraw( indices, clusters, mesh.m_vertices.data(), vertexCount, overdrawThreshold );
+    mesh.m_indices.swap( indices );
+    OptimizeVertexFetch( mesh );
+
+    stats.m_after = AnalyzeVertexCache( mesh.m_indices.data(), ( u32 )mesh.m_indices.size(), ( u32 )mesh.m_vertices.size() );
+    return stats;
+}
+
+//
+void PackIndex16( const u32* indices, u32 indexCount, std::vector< u16 >& out ) {
+    out.resize( indexCount );
+    for ( u32 i = 0; i < indexCount; ++i )
+        out[ i ] = ( u16 )indices[ i ];
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "scene.h"
+
+#include <vector>
+
+// index and vertex order optimization for triangle lists, run once at import:
+//
+//   1. OptimizeVertexCache: Tipsify (Sander et al. 2007) reorders triangles so
+//      consecutive ones share vertices that are still in the post-transform cache
+//   2. OptimizeOverdraw: cuts that order into clusters where the cache restarts
+//      anyway or costs little, and sorts the clusters outside-in, so the faces
+//      most likely in front are drawn first and the depth test rejects the rest
+//   3. OptimizeVertexFetch: renumbers the vertices in first-use order, so the
+//      vertex buffer is read front to back
+//
+// ACMR is transformed vertices per triangle, 0.5 at best for large regular
+// meshes and 3 without any reuse. ATVR is transformed vertices per vertex, 1
+// at best.
+
+// FIFO size the optimizer targets and the statistics simulate. smaller than
+// what current GPUs have, which keeps the order good on all of them.
+constexpr u32 VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+    f32 m_acmr = 0.0f;
+    f32 m_atvr = 0.0f;
+};
+
+VertexCacheStats AnalyzeVertexCache( const u32* indices, u32 indexCount, u32 vertexCount, u32 cacheSize = VERTEX_CACHE_SIZE );
+
+// out receives the triangles of indices in cache-friendly order. clusters, when
+// given, receives the first index of every run that starts with a cold cache.
+void OptimizeVertexCache( const u32* indices, u32 indexCount, u32 vertexCount, std::vector< u32 >& out,
+                          std::vector< u32 >* clusters = nullptr, u32 cacheSize = VERTEX_CACHE_SIZE );
+
+// reorders the clusters of a cache-optimized index list. a cluster is split
+// further where its ACMR so far is within threshold of the whole cluster's, so
+// 1.05 gives up at most about 5% of the cache efficiency for a finer sort.
+void OptimizeOverdraw( std::vector< u32 >& indices, const std::vector< u32 >& clusters, const Vertex* vertices, u32 vertexCount,
+                       f32 threshold = 1.05f, u32 cacheSize = VERTEX_CACHE_SIZE );
+
+// moves the vertices into first-use order and remaps the indices, drops unused ones
+void OptimizeVertexFetch( MeshData& mesh );
+
+struct MeshOptimizeStats {
+    VertexCacheStats m_before;
+    VertexCacheStats m_after;
+};
+
+// all three passes
+MeshOptimizeStats OptimizeMesh( MeshData& mesh, f32 overdrawThreshold = 1.05f );
+
+// 16-bit indices address this many vertices
+constexpr u32 INDEX16_VERTEX_LIMIT = 65536;
+
+inline bool CanUseIndex16( u32 vertexCount ) {
+    return vertexCount <= INDEX16_VERTEX_LIMIT;
+}
+
+// for index buffers of meshes that pass CanUseIndex16
+void PackIndex16( const u32* indices, u32 indexCount, std::vector< u16 >& out );
@@ -0,0 +1,260 @@
+#include "meshlet.h"
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <cstring>
+
+// meshlets per culling job
+constexpr u32 CULL_BATCH_SIZE = 256;
+
+// faces within about this many radians of edge-on are never culled by the
+// cone, the rasterizer may still snap them to a sliver of front-facing area
+constexpr f32 CONE_MARGIN = 1e-3f;
+
+//
+static Float3 Subtract( const Float3& a, const Float3& b ) {
+    return Float3( a.x - b.x, a.y - b.y, a.z - b.z );
+}
+
+// unit normal of a clockwise front face, zero for degenerate triangles
+static Float3 GetFaceNormal( const Float3& p0, const Float3& p1, const Float3& p2 ) {
+    const Float3 n = Vector3Cross( Subtract( p1, p0 ), Subtract( p2, p0 ) );
+    const f32 length = std::sqrt( Vector3Dot( n, n ) );
+    return length > 0.0f ? Float3( n.x / length, n.y / length, n.z / length ) : Float3( 0.0f, 0.0f, 0.0f );
+}
+
+// sphere around the bounding box and the cone of the face normals
+static MeshletBounds ComputeMeshletBounds( const Meshlet& meshlet, const u32* indices, const Float3* positions ) {
+    const u32* first = indices + meshlet.m_firstIndex;
+    const u32 indexCount = meshlet.m_triangleCount * 3;
+    Float3 boundsMin = positions[ first[ 0 ] ], boundsMax = boundsMin;
+    for ( u32 i = 1; i < indexCount; ++i ) {
+        const Float3& p = positions[ first[ i ] ];
+        boundsMin = Float3( std::min( boundsMin.x, p.x ), std::min( boundsMin.y, p.y ), std::min( boundsMin.z, p.z ) );
+        boundsMax = Float3( std::max( boundsMax.x, p.x ), std::max( boundsMax.y, p.y ), std::max( boundsMax.z, p.z ) );
+    }
+
+    MeshletBounds bounds;
+    bounds.m_center = Float3( ( boundsMin.x + boundsMax.x ) * 0.5f, ( boundsMin.y + boundsMax.y ) * 0.5f, ( boundsMin.z + boundsMax.z ) * 0.5f );
+    f32 radius2 = 0.0f;
+    for ( u32 i = 0; i < indexCount; ++i ) {
+        const Float3 d = Subtract( positions[ first[ i ] ], bounds.m_center );
+        radius2 = std::max( radius2, Vector3Dot( d, d ) );
+    }
+    bounds.m_radius = std::sqrt( radius2 );
+
+    Float3 sum( 0.0f, 0.0f, 0.0f );
+    for ( u32 i = 0; i < indexCount; i += 3 ) {
+        const Float3 n = GetFaceNormal( positions[ first[ i ] ], positions[ first[ i + 1 ] ], positions[ first[ i + 2 ] ] );
+        sum = Float3( sum.x + n.x, sum.y + n.y, sum.z + n.z );
+    }
+    bounds.m_coneAxis = Float3( 0.0f, 0.0f, 0.0f );
+    bounds.m_coneCutoff = MESHLET_NO_CONE;
+    if ( Vector3Dot( sum, sum ) == 0.0f )
+        return bounds;
+
+    // the widest normal sets the half angle, degenerate faces draw nothing either way
+    const Float3 axis = Vector3Normalize( sum );
+    f32 minDot = 1.0f;
+    for ( u32 i = 0; i < indexCount; i += 3 ) {
+        const Float3 n = GetFaceNormal( positions[ first[ i ] ], positions[ first[ i + 1 ] ], positions[ first[ i + 2 ] ] );
+        if ( Vector3Dot( n, n ) > 0.0f )
+            minDot = std::min( minDot, Vector3Dot( n, axis ) );
+    }
+    bounds.m_coneAxis = axis;
+    if ( minDot > 0.0f )
+        bounds.m_coneCutoff = std::min( std::sqrt( std::max( 1.0f - minDot * minDot, 0.0f ) ) + CONE_MARGIN, MESHLET_NO_CONE );
+    return bounds;
+}
+
+//
+void BuildMeshlets( const u32* indices, u32 indexCount, const Float3* positions, u32 vertexCount, MeshletMesh& out,
+                    u32 maxVertices, u32 maxTriangles ) {
+    const u32 triangleCount = indexCount / 3;
+    out.m_meshlets.clear();
+    out.m_bounds.clear();
+    out.m_indexCount = triangleCount * 3;
+    if ( triangleCount == 0 )
+        return;
+
+    // the meshlet that last took each vertex
+    std::vector< u32 > owner( vertexCount, ~0u );
+    Meshlet meshlet = { 0, 0, 0 };
+    Float3 normalSum( 0.0f, 0.0f, 0.0f );
+    for ( u32 t = 0; t < triangleCount; ++t ) {
+        const u32 a = indices[ t * 3 ], b = indices[ t * 3 + 1 ], c = indices[ t * 3 + 2 ];
+        const Float3 n = GetFaceNormal( positions[ a ], positions[ b ], positions[ c ] );
+
+        u32 id = ( u32 )out.m_meshlets.size();
+        u32 added = ( owner[ a ] != id ? 1 : 0 ) + ( owner[ b ] != id && b != a ? 1 : 0 ) + ( owner[ c ] != id && c != a && c != b ? 1 : 0 );
+        const bool spread = Vector3Dot( n, n ) > 0.0f && Vector3Dot( normalSum, normalSum ) > 0.0f &&
+                            Vector3Dot( n, Vector3Normalize( normalSum ) ) < MESHLET_NORMAL_SPREAD;
+        if ( meshlet.m_triangleCount > 0 && ( meshlet.m_vertexCount + added > maxVertices || meshlet.m_triangleCount == maxTriangles || spread ) ) {
+            out.m_meshlets.push_back( meshlet );
+            out.m_bounds.push_back( ComputeMeshletBounds( meshlet, indices, positions ) );
+            meshlet = { t * 3, 0, 0 };
+            normalSum = Float3( 0.0f, 0.0f, 0.0f );
+            id++;
+            added = 1 + ( b != a ? 1 : 0 ) + ( c != a && c != b ? 1 : 0 );
+        }
+
+        owner[ a ] = owner[ b ] = owner[ c ] = id;
+        meshlet.m_triangleCount++;
+        meshlet.m_vertexCount += added;
+        normalSum = Float3( normalSum.x + n.x, normalSum.y + n.y, normalSum.z + n.z );
+    }
+    out.m_meshlets.push_back( meshlet );
+    out.m_bounds.push_back( ComputeMeshletBounds( meshlet, indices, positions ) );
+}
+
+//
+void BuildMeshlets( const Mesh& mesh, MeshletMesh& out ) {
+    std::vector< Float3 > positions( mesh.m_vertexCount );
+    for ( u32 i = 0; i < mesh.m_vertexCount; ++i )
+        positions[ i ] = mesh.m_vertices[ i ].m_pos;
+    BuildMeshlets( mesh.m_indices, mesh.m_indexCount, positions.data(), mesh.m_vertexCount, out );
+}
+
+//
+void BuildMeshlets( const QuantizedMesh& mesh, MeshletMesh& out ) {
+    std::vector< Float3 > positions( mesh.m_vertexCount );
+    for ( u32 i = 0; i < mesh.m_vertexCount; ++i )
+        positions[ i ] = mesh.GetPosition( i );
+    BuildMeshlets( mesh.m_indices.data(), ( u32 )mesh.m_indices.size(), positions.data(), mesh.m_vertexCount, out );
+}
+
+// column c of a row-vector matrix, the clip coordinate it produces as a plane
+static Float4 GetColumn( const Matrix& m, u32 c ) {
+    const f32* r0 = &m.r[ 0 ].x;
+    const f32* r1 = &m.r[ 1 ].x;
+    const f32* r2 = &m.r[ 2 ].x;
+    const f32* r3 = &m.r[ 3 ].x;
+    return Float4( r0[ c ], r1[ c ], r2[ c ], r3[ c ] );
+}
+
+// the 4d cross product: dot( Cross4( a, b, c ), d ) = det( a; b; c; d )
+static Float4 Cross4( const Float4& a, const Float4& b, const Float4& c ) {
+    auto det3 = []( f32 a0, f32 a1, f32 a2, f32 b0, f32 b1, f32 b2, f32 c0, f32 c1, f32 c2 ) {
+        return a0 * ( b1 * c2 - b2 * c1 ) - a1 * ( b0 * c2 - b2 * c0 ) + a2 * ( b0 * c1 - b1 * c0 );
+    };
+    return Float4( -det3( a.y, a.z, a.w, b.y, b.z, b.w, c.y, c.z, c.w ),
+                    det3( a.x, a.z, a.w, b.x, b.z, b.w, c.x, c.z, c.w ),
+                   -det3( a.x, a.y, a.w, b.x, b.y, b.w, c.x, c.y, c.w ),
+                    det3( a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z ) );
+}
+
+// the camera is the point the projection maps to x = y = w = 0; a triangle's
+// screen winding is the sign of det( xyw of its corners ), which for points
+// on the triangle's plane becomes the side of that plane the camera is on.
+ClusterCullView MakeClusterCullView( const Matrix& clip, const OcclusionTest* occlusion ) {
+    ClusterCullView view;
+    view.m_clip = clip;
+    view.m_occlusion = occlusion;
+    view.m_frustum = MakeFrustum( clip );
+    view.m_camera = Cross4( GetColumn( clip, 0 ), GetColumn( clip, 1 ), GetColumn( clip, 3 ) );
+    return view;
+}
+
+//
+bool IsOutsideFrustum( const MeshletBounds& bounds, const ClusterCullView& view ) {
+    return IsSphereOutside( view.m_frustum, bounds.m_center, bounds.m_radius );
+}
+
+// every face is back facing when dot( n, v( p ) ) > 0 for all its normals n
+// and points p, with v( p ) = p * cw - camera.xyz. normals are within the
+// cone's half angle a of the axis, so it is enough for every v( p ) to be
+// within 90 degrees - a of the axis: dot( v, axis ) > sin( a ) * |v|. over
+// the sphere v( p ) is v( center ) off by at most |cw| * radius.
+bool IsBackfacing( const MeshletBounds& bounds, const ClusterCullView& view ) {
+    if ( bounds.m_coneCutoff >= 1.0f )
+        return false;
+    const Float4& camera = view.m_camera;
+    const Float3 v( bounds.m_center.x * camera.w - camera.x, bounds.m_center.y * camera.w - camera.y, bounds.m_center.z * camera.w - camera.z );
+    const f32 spread = std::fabs( camera.w ) * bounds.m_radius;
+    return Vector3Dot( v, bounds.m_coneAxis ) > bounds.m_coneCutoff * std::sqrt( Vector3Dot( v, v ) ) + spread * ( 1.0f + bounds.m_coneCutoff );
+}
+
+// the sphere's bounding box against the occluders
+bool IsOccluded( const MeshletBounds& bounds, const ClusterCullView& view ) {
+    if ( view.m_occlusion == nullptr )
+        return false;
+    const Float3 extent( bounds.m_radius, bounds.m_radius, bounds.m_radius );
+    return IsBoxOccluded( *view.m_occlusion, view.m_clip, bounds.m_center, extent );
+}
+
+//
+u32 ClusterCuller::Cull( const MeshletMesh& meshlets, const u32* indices, const ClusterCullView& view, JobSystem* jobs ) {
+    const u32 meshletCount = ( u32 )meshlets.m_meshlets.size();
+    const u32 batchCount = ( meshletCount + CULL_BATCH_SIZE - 1 ) / CULL_BATCH_SIZE;
+    m_visible.resize( meshletCount );
+    m_offsets.resize( batchCount + 1 );
+    m_batchStats.resize( batchCount );
+    if ( m_indices.size() < meshlets.m_indexCount )
+        m_indices.resize( meshlets.m_indexCount );
+
+    // tests, cheapest and most selective first
+    auto test = [ & ]( u32 batch ) {
+        ClusterCullStats stats;
+        const u32 first = batch * CULL_BATCH_SIZE;
+        const u32 last = std::min( first + CULL_BATCH_SIZE, meshletCount );
+        for ( u32 m = first; m < last; ++m ) {
+            const MeshletBounds& bounds = meshlets.m_bounds[ m ];
+            const u32 triangles = meshlets.m_meshlets[ m ].m_triangleCount;
+            stats.m_triangles += triangles;
+            u8 visible = 0;
+            if ( IsBackfacing( bounds, view ) )
+                stats.m_backfaceCulled++;
+            else if ( IsOutsideFrustum( bounds, view ) )
+                stats.m_frustumCulled++;
+            else if ( IsOccluded( bounds, view ) )
+                stats.m_occlusionCulled++;
+            else
+                visible = 1;
+            m_visible[ m ] = visible;
+            stats.m_visibleTriangles += visible ? triangles : 0;
+        }
+        stats.m_meshlets = last - first;
+        m_batchStats[ batch ] = stats;
+    };
+    auto compact = [ & ]( u32 batch ) {
+        u32* out = m_indices.data() + m_offsets[ batch ];
+        const u32 last = std::min( ( batch + 1 ) * CULL_BATCH_SIZE, meshletCount );
+        for ( u32 m = batch * CULL_BATCH_SIZE; m < last; ++m ) {
+            if ( !m_visible[ m ] )
+                continue;
+            const Meshlet& meshlet = meshlets.m_meshlets[ m ];
+            memcpy( out, indices + meshlet.m_firstIndex, meshlet.m_triangleCount * 3 * sizeof( u32 ) );
+            out += meshlet.m_triangleCount * 3;
+        }
+    };
+
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( batchCount, test, 1 );
+    } else {
+        for ( u32 batch = 0; batch < batchCount; ++batch )
+            test( batch );
+    }
+
+    m_stats = ClusterCullStats();
+    m_offsets[ 0 ] = 0;
+    for ( u32 batch = 0; batch < batchCount; ++batch ) {
+        const ClusterCullStats& stats = m_batchStats[ batch ];
+        m_offsets[ batch + 1 ] = m_offsets[ batch ] + stats.m_visibleTriangles * 3;
+        m_stats.m_meshlets += stats.m_meshlets;
+        m_stats.m_frustumCulled += stats.m_frustumCulled;
+        m_stats.m_backfaceCulled += stats.m_backfaceCulled;
+        m_stats.m_occlusionCulled += stats.m_occlusionCulled;
+        m_stats.m_triangles += stats.m_triangles;
+        m_stats.m_visibleTriangles += stats.m_visibleTriangles;
+    }
+
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( batchCount, compact, 1 );
+    } else {
+        for ( u32 batch = 0; batch < batchCount; ++batch )
+            compact( batch );
+    }
+    m_indexCount = m_offsets[ batchCount ];
+    return m_indexCount;
+}
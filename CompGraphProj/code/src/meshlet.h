@@ -0,0 +1,109 @@
+#pragma once
+
+#include "frustum_culling.h"
+#include "scene.h"
+#include "vertex_quantization.h"
+
+#include <vector>
+
+class JobSystem;
+
+// cluster decomposition and per-cluster culling. a meshlet is a run of
+// consecutive triangles of the index buffer with at most MESHLET_MAX_VERTICES
+// distinct vertices, the limits mesh shaders use. since meshlets are ranges of
+// the existing index order, culling compacts the surviving ranges into an
+// index stream for one DrawIndexed and keeps the order OptimizeMesh chose;
+// the image stays the same, only the triangles that could not contribute a
+// pixel are gone.
+//
+// every meshlet has a bounding sphere for the frustum and occlusion tests and
+// a normal cone for the backface test: when the camera sees the back of every
+// triangle of the cone, the whole meshlet is skipped.
+
+constexpr u32 MESHLET_MAX_VERTICES = 64;
+constexpr u32 MESHLET_MAX_TRIANGLES = 124;
+
+// a meshlet is also closed when a triangle would spread its normals wider
+// than this, the cosine to the normals so far. keeps the cones of curved
+// meshes narrow and the faces of boxy ones apart.
+constexpr f32 MESHLET_NORMAL_SPREAD = 0.5f;
+
+// a cutoff above 1 never culls, e.g. for meshlets with normals in every direction
+constexpr f32 MESHLET_NO_CONE = 2.0f;
+
+struct Meshlet {
+    u32 m_firstIndex;       // of the mesh's index buffer, a multiple of 3
+    u32 m_triangleCount;
+    u32 m_vertexCount;      // distinct vertices
+};
+
+struct MeshletBounds {
+    Float3  m_center;       // bounding sphere, model space
+    f32     m_radius;
+    Float3  m_coneAxis;     // average front-facing normal
+    f32     m_coneCutoff;   // sine of the cone's half angle, MESHLET_NO_CONE for none
+};
+
+// meshlets and their bounds as separate arrays, the culling reads only bounds
+struct MeshletMesh {
+    std::vector< Meshlet >          m_meshlets;
+    std::vector< MeshletBounds >    m_bounds;
+    u32                             m_indexCount = 0;
+};
+
+// scans the triangles in index order, best after OptimizeMesh, whose cache
+// order keeps neighbors together
+void BuildMeshlets( const u32* indices, u32 indexCount, const Float3* positions, u32 vertexCount, MeshletMesh& out,
+                    u32 maxVertices = MESHLET_MAX_VERTICES, u32 maxTriangles = MESHLET_MAX_TRIANGLES );
+void BuildMeshlets( const Mesh& mesh, MeshletMesh& out );
+// on the dequantized positions, the ones the vertex shader sees
+void BuildMeshlets( const QuantizedMesh& mesh, MeshletMesh& out );
+
+// the camera as the culling tests see it, derived from the model-space to
+// clip-space matrix so orthographic and perspective projections work alike
+struct ClusterCullView {
+    Matrix  m_clip;                 // row vectors, clip = ( p, 1 ) * m_clip
+    Frustum m_frustum;              // in model space
+    // homogeneous camera position in model space, w = 0 for orthographic
+    // projections. a face with normal n is back facing when
+    // dot( n, p * m_camera.w - m_camera.xyz ) > 0 for a point p on it.
+    Float4  m_camera;
+    const OcclusionTest* m_occlusion = nullptr;
+};
+
+ClusterCullView MakeClusterCullView( const Matrix& clip, const OcclusionTest* occlusion = nullptr );
+
+struct ClusterCullStats {
+    u32 m_meshlets = 0;
+    u32 m_frustumCulled = 0;
+    u32 m_backfaceCulled = 0;
+    u32 m_occlusionCulled = 0;
+    u32 m_triangles = 0;
+    u32 m_visibleTriangles = 0;
+};
+
+// culls the meshlets of one mesh per call and compacts the index ranges of
+// the visible ones, in order, into an index stream for DrawIndexed. the
+// buffers are kept across calls, so per-frame culling does not allocate.
+class ClusterCuller {
+public:
+    // returns the number of indices written, split over jobs when given
+    u32 Cull( const MeshletMesh& meshlets, const u32* indices, const ClusterCullView& view, JobSystem* jobs = nullptr );
+
+    const u32* GetIndices() const { return m_indices.data(); }
+    u32 GetIndexCount() const { return m_indexCount; }
+    const ClusterCullStats& GetStats() const { return m_stats; }
+
+private:
+    std::vector< u8 >               m_visible;      // per meshlet
+    std::vector< u32 >              m_offsets;      // first output index per batch
+    std::vector< ClusterCullStats > m_batchStats;
+    std::vector< u32 >              m_indices;
+    u32                             m_indexCount = 0;
+    ClusterCullStats                m_stats;
+};
+
+// the three tests on their own, true when the meshlet can be skipped
+bool IsOutsideFrustum( const MeshletBounds& bounds, const ClusterCullView& view );
+bool IsBackfacing( const MeshletBounds& bounds, const ClusterCullView& view );
+bool IsOccluded( const MeshletBounds& bounds, const ClusterCullView& view );
@@ -0,0 +1,421 @@
+#include "occlusion_culling.h"
+
+#include "job_system.h"
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+static_assert( HIZ_WIDTH % SIMD_WIDTH == 0, "rows are rasterized in whole SIMD groups" );
+static_assert( HIZ_HEIGHT % HIZ_BAND_HEIGHT == 0, "bands cover the buffer" );
+static_assert( ( HIZ_WIDTH >> ( HIZ_LEVELS - 1 ) ) >= 1 && ( HIZ_HEIGHT >> ( HIZ_LEVELS - 1 ) ) >= 1, "too many levels" );
+
+// occluder triangles reaching further than this times w off screen are
+// dropped, which keeps the float edge functions exact enough
+constexpr f32 HIZ_GUARD_BAND = 8.0f;
+
+// objects per culling job, a multiple of SIMD_WIDTH
+constexpr u32 HIZ_CULL_BATCH = 1024;
+static_assert( HIZ_CULL_BATCH % SIMD_WIDTH == 0, "culling batches start on a SIMD group" );
+
+// triangles of an occluder searched for neighbors to merge with at once, and
+// how far in z / w the neighbor's far corner may lie off the triangle's plane
+constexpr u32 HIZ_MERGE_TRIANGLES = 64;
+constexpr f32 HIZ_MERGE_DEPTH = 1e-3f;
+
+// boxes reaching closer to the camera plane than this w are never culled
+constexpr f32 HIZ_MIN_W = 1e-6f;
+
+//
+void HiZBuffer::Begin( const Matrix& viewProjection ) {
+    if ( m_depth.empty() ) {
+        u32 size = 0;
+        for ( u32 level = 0; level < HIZ_LEVELS; ++level ) {
+            m_levelOffsets[ level ] = size;
+            size += ( HIZ_WIDTH >> level ) * ( HIZ_HEIGHT >> level );
+        }
+        m_depth.resize( size );
+    }
+    m_viewProjection = viewProjection;
+    m_occluders.clear();
+    m_triangles.clear();
+    m_triangleCount = 0;
+}
+
+//
+void HiZBuffer::AddOccluder( const Float3* positions, u32 stride, const u32* indices, u32 indexCount, const Matrix& model ) {
+    const u32 first = m_occluders.empty() ? 0 : m_occluders.back().m_firstTriangle + m_occluders.back().m_triangleCount;
+    m_occluders.push_back( { ( const u8* )positions, stride, indices, indexCount / 3, model, first } );
+}
+
+// the screen position of a triangle, false when it is back facing or
+// crosses the near plane
+bool HiZBuffer::ProjectTriangle( const Float4 clip[ 3 ], ScreenTriangle& tri ) {
+    for ( u32 i = 0; i < 3; ++i ) {
+        const Float4& c = clip[ i ];
+        if ( !( c.z >= 0.0f && c.w > 0.0f ) || std::fabs( c.x ) > HIZ_GUARD_BAND * c.w || std::fabs( c.y ) > HIZ_GUARD_BAND * c.w )
+            return false;
+        const f32 invW = 1.0f / c.w;
+        tri.m_x[ i ] = ( c.x * invW * 0.5f + 0.5f ) * ( f32 )HIZ_WIDTH;
+        tri.m_y[ i ] = ( 0.5f - c.y * invW * 0.5f ) * ( f32 )HIZ_HEIGHT;
+        tri.m_z[ i ] = c.z * invW;
+    }
+    // clockwise triangles are front facing, as in TileRasterizer
+    const f32 area = ( tri.m_x[ 1 ] - tri.m_x[ 0 ] ) * ( tri.m_y[ 2 ] - tri.m_y[ 0 ] ) - ( tri.m_y[ 1 ] - tri.m_y[ 0 ] ) * ( tri.m_x[ 2 ] - tri.m_x[ 0 ] );
+    return area > 0.0f;
+}
+
+// the edge from a to b with the inside, E >= 0, on its clockwise side. at
+// the pixel center the edge function is at most half of |dx| + |dy| above its
+// lowest corner.
+static void SetEdge( f32 xa, f32 ya, f32 xb, f32 yb, f32 edge[ 3 ] ) {
+    const f32 stepX = -( yb - ya ), stepY = xb - xa;
+    const f32 c = -stepX * xa - stepY * ya;
+    edge[ 0 ] = c + 0.5f * ( stepX + stepY ) - 0.5f * ( std::fabs( stepX ) + std::fabs( stepY ) );
+    edge[ 1 ] = stepX;
+    edge[ 2 ] = stepY;
+}
+
+// the depth plane of tri, as z at pixel ( 0, 0 ) and its steps
+static void GetDepthPlane( const f32 x[ 3 ], const f32 y[ 3 ], const f32 z[ 3 ], f32& z0, f32& ddx, f32& ddy ) {
+    const f32 dx1 = x[ 1 ] - x[ 0 ], dy1 = y[ 1 ] - y[ 0 ];
+    const f32 dx2 = x[ 2 ] - x[ 0 ], dy2 = y[ 2 ] - y[ 0 ];
+    const f32 invArea = 1.0f / ( dx1 * dy2 - dy1 * dx2 );
+    const f32 dz1 = z[ 1 ] - z[ 0 ], dz2 = z[ 2 ] - z[ 0 ];
+    ddx = ( dz1 * dy2 - dz2 * dy1 ) * invArea;
+    ddy = ( dz2 * dx1 - dz1 * dx2 ) * invArea;
+    z0 = z[ 0 ] - ddx * x[ 0 ] - ddy * y[ 0 ];
+}
+
+// the planes of the pixels entirely inside tri, or inside the quad it makes
+// with neighbor across its edge sharedEdge, whose other corner is
+// neighborCorner. false when no whole pixel is covered.
+//
+// the quad is the four outer edges; where it is not convex they cover less
+// than both triangles, never more. its depth is tri's plane raised by how far
+// the neighbor's corner lies behind it, which bounds the neighbor everywhere.
+bool HiZBuffer::SetupTriangle( const ScreenTriangle& tri, const ScreenTriangle* neighbor, u32 sharedEdge, u32 neighborCorner, Triangle& out ) {
+    f32 minX = std::min( { tri.m_x[ 0 ], tri.m_x[ 1 ], tri.m_x[ 2 ] } ), maxX = std::max( { tri.m_x[ 0 ], tri.m_x[ 1 ], tri.m_x[ 2 ] } );
+    f32 minY = std::min( { tri.m_y[ 0 ], tri.m_y[ 1 ], tri.m_y[ 2 ] } ), maxY = std::max( { tri.m_y[ 0 ], tri.m_y[ 1 ], tri.m_y[ 2 ] } );
+    f32 maxDepth = std::max( { tri.m_z[ 0 ], tri.m_z[ 1 ], tri.m_z[ 2 ] } );
+    f32 z0, ddx, ddy;
+    GetDepthPlane( tri.m_x, tri.m_y, tri.m_z, z0, ddx, ddy );
+    f32 slack = 0.5f * ( std::fabs( ddx ) + std::fabs( ddy ) );
+
+    // edge e is opposite corner e
+    u32 edgeCount = 0;
+    for ( u32 e = 0; e < 3; ++e ) {
+        if ( neighbor != nullptr && e == sharedEdge )
+            continue;
+        const u32 a = ( e + 1 ) % 3, b = ( e + 2 ) % 3;
+        SetEdge( tri.m_x[ a ], tri.m_y[ a ], tri.m_x[ b ], tri.m_y[ b ], out.m_edges[ edgeCount++ ] );
+    }
+    if ( neighbor != nullptr ) {
+        for ( u32 e = 0; e < 3; ++e ) {
+            if ( e == neighborCorner )
+                continue;
+            const u32 a = ( e + 1 ) % 3, b = ( e + 2 ) % 3;
+            SetEdge( neighbor->m_x[ a ], neighbor->m_y[ a ], neighbor->m_x[ b ], neighbor->m_y[ b ], out.m_edges[ edgeCount++ ] );
+        }
+        const f32 x = neighbor->m_x[ neighborCorner ], y = neighbor->m_y[ neighborCorner ], z = neighbor->m_z[ neighborCorner ];
+        minX = std::min( minX, x );
+        maxX = std::max( maxX, x );
+        minY = std::min( minY, y );
+        maxY = std::max( maxY, y );
+        maxDepth = std::max( maxDepth, z );
+        slack += std::max( z - ( z0 + ddx * x + ddy * y ), 0.0f );
+    } else {
+        // always inside
+        out.m_edges[ 3 ][ 0 ] = out.m_edges[ 3 ][ 1 ] = out.m_edges[ 3 ][ 2 ] = 0.0f;
+    }
+
+    // pixel px spans [ px, px + 1 ), so only the pixels between the rounded-in bounds can be covered
+    out.m_minX = std::max( ( i32 )std::ceil( minX ), 0 );
+    out.m_minY = std::max( ( i32 )std::ceil( minY ), 0 );
+    out.m_maxX = std::min( ( i32 )std::floor( maxX ) - 1, ( i32 )HIZ_WIDTH - 1 );
+    out.m_maxY = std::min( ( i32 )std::floor( maxY ) - 1, ( i32 )HIZ_HEIGHT - 1 );
+    if ( out.m_minX > out.m_maxX || out.m_minY > out.m_maxY )
+        return false;
+
+    // z / w is linear in screen space; its farthest point in a pixel is at a corner
+    out.m_depth[ 0 ] = z0 + 0.5f * ( ddx + ddy ) + slack;
+    out.m_depth[ 1 ] = ddx;
+    out.m_depth[ 2 ] = ddy;
+    out.m_maxDepth = maxDepth;
+    out.m_sourceCount = neighbor != nullptr ? 2 : 1;
+    return true;
+}
+
+// projects the occluder's triangles and merges every front face with the
+// neighbor across one of its edges that lies nearest its plane, looking for
+// neighbors among HIZ_MERGE_TRIANGLES at a time
+void HiZBuffer::SetupOccluder( const Occluder& occluder ) {
+    const Matrix clip = MatrixMultiply( occluder.m_model, m_viewProjection );
+    ScreenTriangle screen[ HIZ_MERGE_TRIANGLES ];
+    bool pending[ HIZ_MERGE_TRIANGLES ];
+    for ( u32 first = 0; first < occluder.m_triangleCount; first += HIZ_MERGE_TRIANGLES ) {
+        const u32 count = std::min( occluder.m_triangleCount - first, HIZ_MERGE_TRIANGLES );
+        for ( u32 t = 0; t < count; ++t ) {
+            const u32* index = occluder.m_indices + ( first + t ) * 3;
+            Float4 corners[ 3 ];
+            for ( u32 i = 0; i < 3; ++i ) {
+                corners[ i ] = TransformPoint( *( const Float3* )( occluder.m_positions + ( size_t )index[ i ] * occluder.m_stride ), clip );
+                screen[ t ].m_indices[ i ] = index[ i ];
+            }
+            pending[ t ] = ProjectTriangle( corners, screen[ t ] );
+            m_triangles[ occluder.m_firstTriangle + first + t ].m_minX = 1;
+            m_triangles[ occluder.m_firstTriangle + first + t ].m_maxX = 0;
+        }
+
+        for ( u32 t = 0; t < count; ++t ) {
+            if ( !pending[ t ] )
+                continue;
+            pending[ t ] = false;
+            const ScreenTriangle& tri = screen[ t ];
+            f32 z0, ddx, ddy;
+            GetDepthPlane( tri.m_x, tri.m_y, tri.m_z, z0, ddx, ddy );
+
+            // a neighbor runs the shared edge the other way
+            u32 best = count, bestEdge = 0, bestCorner = 0;
+            f32 bestOffset = HIZ_MERGE_DEPTH;
+            for ( u32 n = t + 1; n < count; ++n ) {
+                if ( !pending[ n ] )
+                    continue;
+                for ( u32 e = 0; e < 3; ++e ) {
+                    const u32 a = tri.m_indices[ ( e + 1 ) % 3 ], b = tri.m_indices[ ( e + 2 ) % 3 ];
+                    for ( u32 k = 0; k < 3; ++k ) {
+                        if ( screen[ n ].m_indices[ ( k + 1 ) % 3 ] != b || screen[ n ].m_indices[ ( k + 2 ) % 3 ] != a )
+                            continue;
+                        const f32 offset = std::fabs( screen[ n ].m_z[ k ] - ( z0 + ddx * screen[ n ].m_x[ k ] + ddy * screen[ n ].m_y[ k ] ) );
+                        if ( offset <= bestOffset ) {
+                            best = n;
+                            bestEdge = e;
+                            bestCorner = k;
+                            bestOffset = offset;
+                        }
+                    }
+                }
+            }
+            const ScreenTriangle* neighbor = best < count ? &screen[ best ] : nullptr;
+            if ( neighbor != nullptr )
+                pending[ best ] = false;
+            Triangle& out = m_triangles[ occluder.m_firstTriangle + first + t ];
+            if ( !SetupTriangle( tri, neighbor, bestEdge, bestCorner, out ) ) {
+                out.m_minX = 1;
+                out.m_maxX = 0;
+            }
+        }
+    }
+}
+
+// clears the band's rows, keeps the nearest depth of every triangle over
+// them, SIMD_WIDTH pixels of a row at a time, then reduces the band into the
+// levels whose rows it holds entirely
+void HiZBuffer::RasterizeBand( u32 band ) {
+    const i32 firstRow = ( i32 )( band * HIZ_BAND_HEIGHT ), lastRow = firstRow + ( i32 )HIZ_BAND_HEIGHT - 1;
+    f32* depth = m_depth.data();
+    std::fill( depth + firstRow * HIZ_WIDTH, depth + ( lastRow + 1 ) * HIZ_WIDTH, 1.0f );
+
+    const vf32 laneF = ToFloat( LaneIndex() );
+    const vf32 zero = Splat( 0.0f );
+    for ( const Triangle& tri : m_triangles ) {
+        const i32 y0 = std::max( tri.m_minY, firstRow ), y1 = std::min( tri.m_maxY, lastRow );
+        if ( y0 > y1 || tri.m_minX > tri.m_maxX )
+            continue;
+        const i32 x0 = tri.m_minX & ~( i32 )( SIMD_WIDTH - 1 );
+        const vf32 stepX0 = Splat( tri.m_edges[ 0 ][ 1 ] ), stepX1 = Splat( tri.m_edges[ 1 ][ 1 ] ), stepX2 = Splat( tri.m_edges[ 2 ][ 1 ] );
+        const vf32 stepX3 = Splat( tri.m_edges[ 3 ][ 1 ] );
+        const vf32 depthX = Splat( tri.m_depth[ 1 ] ), maxDepth = Splat( tri.m_maxDepth );
+        for ( i32 py = y0; py <= y1; ++py ) {
+            const vf32 row0 = Splat( tri.m_edges[ 0 ][ 0 ] + tri.m_edges[ 0 ][ 2 ] * ( f32 )py );
+            const vf32 row1 = Splat( tri.m_edges[ 1 ][ 0 ] + tri.m_edges[ 1 ][ 2 ] * ( f32 )py );
+            const vf32 row2 = Splat( tri.m_edges[ 2 ][ 0 ] + tri.m_edges[ 2 ][ 2 ] * ( f32 )py );
+            const vf32 row3 = Splat( tri.m_edges[ 3 ][ 0 ] + tri.m_edges[ 3 ][ 2 ] * ( f32 )py );
+            const vf32 rowDepth = Splat( tri.m_depth[ 0 ] + tri.m_depth[ 2 ] * ( f32 )py );
+            f32* row = depth + py * HIZ_WIDTH;
+            for ( i32 px = x0; px <= tri.m_maxX; px += SIMD_WIDTH ) {
+                const vf32 x = Splat( ( f32 )px ) + laneF;
+                const vf32 inside = CmpGe( MulAdd( stepX0, x, row0 ), zero ) & CmpGe( MulAdd( stepX1, x, row1 ), zero ) &
+                                    CmpGe( MulAdd( stepX2, x, row2 ), zero ) & CmpGe( MulAdd( stepX3, x, row3 ), zero );
+                if ( MoveMask( inside ) == 0 )
+                    continue;
+                const vf32 z = Min( MulAdd( depthX, x, rowDepth ), maxDepth );
+                const vf32 stored = Load( row + px );
+                Store( row + px, Select( inside, Min( z, stored ), stored ) );
+            }
+        }
+    }
+
+    for ( u32 level = 1; ( HIZ_BAND_HEIGHT >> level ) > 0 && level < HIZ_LEVELS; ++level )
+        BuildLevel( level, ( u32 )firstRow >> level, ( u32 )( lastRow + 1 ) >> level );
+}
+
+// the farthest of the 2x2 texels below, rows [ firstRow, lastRow ) of level
+void HiZBuffer::BuildLevel( u32 level, u32 firstRow, u32 lastRow ) {
+    const u32 width = HIZ_WIDTH >> level;
+    const f32* src = m_depth.data() + m_levelOffsets[ level - 1 ];
+    f32* dst = m_depth.data() + m_levelOffsets[ level ];
+    for ( u32 y = firstRow; y < lastRow; ++y ) {
+        const f32* top = src + 2 * y * ( 2 * width );
+        const f32* bottom = top + 2 * width;
+        for ( u32 x = 0; x < width; ++x )
+            dst[ y * width + x ] = std::max( std::max( top[ 2 * x ], top[ 2 * x + 1 ] ), std::max( bottom[ 2 * x ], bottom[ 2 * x + 1 ] ) );
+    }
+}
+
+// triangle setup per occluder and rasterization per band, both on jobs
+void HiZBuffer::Finish( JobSystem* jobs ) {
+    PROFILE_ZONE( "RasterizeOccluders" );
+    const u32 occluderCount = ( u32 )m_occluders.size();
+    m_triangles.resize( occluderCount > 0 ? m_occluders.back().m_firstTriangle + m_occluders.back().m_triangleCount : 0 );
+
+    auto setup = [ & ]( u32 o ) { SetupOccluder( m_occluders[ o ] ); };
+    const u32 bandCount = HIZ_HEIGHT / HIZ_BAND_HEIGHT;
+    auto rasterize = [ & ]( u32 band ) { RasterizeBand( band ); };
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( occluderCount, setup, 16 );
+        jobs->ParallelFor( bandCount, rasterize, 1 );
+    } else {
+        for ( u32 o = 0; o < occluderCount; ++o )
+            setup( o );
+        for ( u32 band = 0; band < bandCount; ++band )
+            rasterize( band );
+    }
+
+    // the small levels that span several bands
+    for ( u32 level = 1; level < HIZ_LEVELS; ++level ) {
+        if ( ( HIZ_BAND_HEIGHT >> level ) == 0 )
+            BuildLevel( level, 0, HIZ_HEIGHT >> level );
+    }
+    m_triangleCount = 0;
+    for ( const Triangle& tri : m_triangles )
+        m_triangleCount += tri.m_minX <= tri.m_maxX ? tri.m_sourceCount : 0;
+}
+
+// the pixels the rectangle touches at the first level where they span at
+// most HIZ_MAX_TEXELS texels a side; parts off screen cannot be seen anyway
+bool HiZBuffer::IsOccluded( const Float4& rect, f32 minDepth ) const {
+    const f32 x0 = ( rect.x * 0.5f + 0.5f ) * ( f32 )HIZ_WIDTH, x1 = ( rect.z * 0.5f + 0.5f ) * ( f32 )HIZ_WIDTH;
+    const f32 y0 = ( 0.5f - rect.w * 0.5f ) * ( f32 )HIZ_HEIGHT, y1 = ( 0.5f - rect.y * 0.5f ) * ( f32 )HIZ_HEIGHT;
+    if ( !( x1 >= 0.0f && y1 >= 0.0f && x0 < ( f32 )HIZ_WIDTH && y0 < ( f32 )HIZ_HEIGHT && x0 <= x1 && y0 <= y1 ) )
+        return false;
+    u32 minX = ( u32 )std::max( x0, 0.0f ), maxX = ( u32 )std::min( x1, ( f32 )( HIZ_WIDTH - 1 ) );
+    u32 minY = ( u32 )std::max( y0, 0.0f ), maxY = ( u32 )std::min( y1, ( f32 )( HIZ_HEIGHT - 1 ) );
+    u32 level = 0;
+    while ( level + 1 < HIZ_LEVELS && ( maxX - minX >= HIZ_MAX_TEXELS || maxY - minY >= HIZ_MAX_TEXELS ) ) {
+        ++level;
+        minX >>= 1;
+        maxX >>= 1;
+        minY >>= 1;
+        maxY >>= 1;
+    }
+
+    const u32 width = HIZ_WIDTH >> level;
+    const f32* depth = GetLevel( level );
+    for ( u32 y = minY; y <= maxY; ++y ) {
+        for ( u32 x = minX; x <= maxX; ++x ) {
+            if ( depth[ y * width + x ] >= minDepth )
+                return false;
+        }
+    }
+    return true;
+}
+
+// the screen bounds of SIMD_WIDTH boxes at a time, then the texel reads per object
+u32 HiZBuffer::CullBatch( const CullingBounds& bounds, u32* objects, u32 count ) const {
+    const Matrix& m = m_viewProjection;
+    vf32 axes[ 3 ][ 4 ], origin[ 4 ];
+    for ( u32 c = 0; c < 4; ++c ) {
+        for ( u32 r = 0; r < 3; ++r )
+            axes[ r ][ c ] = Splat( ( &m.r[ r ].x )[ c ] );
+        origin[ c ] = Splat( ( &m.r[ 3 ].x )[ c ] );
+    }
+    const vf32 zero = Splat( 0.0f ), one = Splat( 1.0f ), minW = Splat( HIZ_MIN_W );
+
+    u32 kept = 0;
+    for ( u32 i = 0; i < count; i += SIMD_WIDTH ) {
+        const u32 lanes = std::min( count - i, ( u32 )SIMD_WIDTH );
+        alignas( 32 ) f32 box[ 6 ][ SIMD_WIDTH ];
+        for ( u32 lane = 0; lane < SIMD_WIDTH; ++lane ) {
+            const u32 object = objects[ i + std::min( lane, lanes - 1 ) ];
+            box[ 0 ][ lane ] = bounds.m_centerX[ object ];
+            box[ 1 ][ lane ] = bounds.m_centerY[ object ];
+            box[ 2 ][ lane ] = bounds.m_centerZ[ object ];
+            box[ 3 ][ lane ] = bounds.m_extentX[ object ];
+            box[ 4 ][ lane ] = bounds.m_extentY[ object ];
+            box[ 5 ][ lane ] = bounds.m_extentZ[ object ];
+        }
+
+        // what the low and high side of every axis adds to each clip component
+        vf32 side[ 3 ][ 2 ][ 4 ];
+        for ( u32 r = 0; r < 3; ++r ) {
+            const vf32 center = Load( box[ r ] ), extent = Load( box[ 3 + r ] );
+            const vf32 lo = center - extent, hi = center + extent;
+            for ( u32 c = 0; c < 4; ++c ) {
+                side[ r ][ 0 ][ c ] = lo * axes[ r ][ c ];
+                side[ r ][ 1 ][ c ] = hi * axes[ r ][ c ];
+            }
+        }
+
+        // x / w, y / w and z / w are at their extremes over the box at its
+        // corners, as in GetScreenBounds
+        vf32 minX = one, minY = one, maxX = zero - one, maxY = zero - one, minZ = one, nearW = Splat( FLT_MAX );
+        for ( u32 corner = 0; corner < 8; ++corner ) {
+            vf32 clip[ 4 ];
+            for ( u32 c = 0; c < 4; ++c )
+                clip[ c ] = side[ 0 ][ corner & 1 ][ c ] + side[ 1 ][ ( corner >> 1 ) & 1 ][ c ] + side[ 2 ][ corner >> 2 ][ c ] + origin[ c ];
+            const vf32 invW = one / clip[ 3 ];
+            const vf32 x = clip[ 0 ] * invW, y = clip[ 1 ] * invW;
+            minX = Min( minX, x );
+            maxX = Max( maxX, x );
+            minY = Min( minY, y );
+            maxY = Max( maxY, y );
+            minZ = Min( minZ, clip[ 2 ] * invW );
+            nearW = Min( nearW, clip[ 3 ] );
+        }
+
+        alignas( 32 ) f32 rect[ 5 ][ SIMD_WIDTH ];
+        Store( rect[ 0 ], minX );
+        Store( rect[ 1 ], minY );
+        Store( rect[ 2 ], maxX );
+        Store( rect[ 3 ], maxY );
+        Store( rect[ 4 ], Max( minZ, zero ) );
+        const u32 inFront = MoveMask( CmpGt( nearW, minW ) );
+
+        for ( u32 lane = 0; lane < lanes; ++lane ) {
+            const u32 object = objects[ i + lane ];
+            const bool hidden = ( ( inFront >> lane ) & 1 ) != 0 &&
+                                IsOccluded( Float4( rect[ 0 ][ lane ], rect[ 1 ][ lane ], rect[ 2 ][ lane ], rect[ 3 ][ lane ] ), rect[ 4 ][ lane ] );
+            objects[ kept ] = object;
+            kept += hidden ? 0 : 1;
+        }
+    }
+    return kept;
+}
+
+// every batch compacts its own range, then the ranges are moved together
+u32 HiZBuffer::Cull( const CullingBounds& bounds, u32* objects, u32 count, JobSystem* jobs ) {
+    PROFILE_ZONE( "OcclusionCull" );
+    const u32 batchCount = ( count + HIZ_CULL_BATCH - 1 ) / HIZ_CULL_BATCH;
+    m_batchCounts.resize( batchCount );
+    auto cull = [ & ]( u32 batch ) {
+        const u32 first = batch * HIZ_CULL_BATCH;
+        m_batchCounts[ batch ] = CullBatch( bounds, objects + first, std::min( HIZ_CULL_BATCH, count - first ) );
+    };
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( batchCount, cull, 1 );
+    } else {
+        for ( u32 batch = 0; batch < batchCount; ++batch )
+            cull( batch );
+    }
+
+    u32 kept = 0;
+    for ( u32 batch = 0; batch < batchCount; ++batch ) {
+        memmove( objects + kept, objects + batch * HIZ_CULL_BATCH, m_batchCounts[ batch ] * sizeof( u32 ) );
+        kept += m_batchCounts[ batch ];
+    }
+    return kept;
+}
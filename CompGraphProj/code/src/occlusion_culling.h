@@ -0,0 +1,95 @@
+#pragma once
+
+#include "frustum_culling.h"
+#include "types.h"
+#include "vecmath.h"
+
+#include <vector>
+
+class JobSystem;
+
+// software hierarchical-Z occlusion culling. a few selected occluders, e.g.
+// the objects nearest the camera, are rasterized depth only into a small
+// buffer, and a mip pyramid keeps the farthest depth of every 2x2 texels of
+// the level below. an object's screen rectangle then needs at most
+// HIZ_MAX_TEXELS x HIZ_MAX_TEXELS reads of the level where it is that small:
+// when all of them are nearer than the object's nearest point, it is hidden.
+//
+// both the coverage and the depth are conservative. a pixel takes an
+// occluder's depth only when the triangle covers all of it, and the farthest
+// depth the triangle reaches inside the pixel, so culling never removes an
+// object that would have put a pixel on screen. front-facing neighbors of an
+// occluder are rasterized as one quad so that their shared edge leaves no gap.
+
+constexpr u32 HIZ_WIDTH = 256;
+constexpr u32 HIZ_HEIGHT = 128;
+// 256x128 down to 2x1
+constexpr u32 HIZ_LEVELS = 8;
+constexpr u32 HIZ_MAX_TEXELS = 4;
+// rows per rasterization job, which also builds the levels that stay inside them
+constexpr u32 HIZ_BAND_HEIGHT = 16;
+
+class HiZBuffer : public OcclusionTest {
+public:
+    // clears the depth to 1 and drops the last frame's occluders.
+    // viewProjection maps world space to clip space for everything after.
+    void Begin( const Matrix& viewProjection );
+    // queues the front faces (clockwise, like the rasterizer) of indexed
+    // triangles under model. position i is stride bytes after position i - 1,
+    // e.g. &vertices[ 0 ].m_pos and sizeof( Vertex ). the geometry is read in Finish.
+    void AddOccluder( const Float3* positions, u32 stride, const u32* indices, u32 indexCount, const Matrix& model );
+    // sets up and rasterizes the occluders in bands of rows, then builds the pyramid
+    void Finish( JobSystem* jobs = nullptr );
+
+    bool IsOccluded( const Float4& rect, f32 minDepth ) const override;
+
+    // keeps the objects whose box in bounds is not occluded, in order, at the
+    // front of objects and returns their number. the rectangles are
+    // GetScreenBounds's, computed for SIMD_WIDTH objects at once.
+    u32 Cull( const CullingBounds& bounds, u32* objects, u32 count, JobSystem* jobs = nullptr );
+
+    // level 0 is HIZ_WIDTH x HIZ_HEIGHT, every level half the size of the one before
+    const f32* GetLevel( u32 level ) const { return m_depth.data() + m_levelOffsets[ level ]; }
+    // front-facing triangles that reached the buffer in the last Finish
+    u32 GetOccluderTriangleCount() const { return m_triangleCount; }
+
+private:
+    struct Occluder {
+        const u8*   m_positions;
+        u32         m_stride;
+        const u32*  m_indices;
+        u32         m_triangleCount;
+        Matrix      m_model;
+        u32         m_firstTriangle;
+    };
+    // a front-facing triangle in pixels and the occluder's indices of its corners
+    struct ScreenTriangle {
+        f32 m_x[ 3 ], m_y[ 3 ], m_z[ 3 ];
+        u32 m_indices[ 3 ];
+    };
+    // screen-space planes, evaluated at pixel centers as c + dx * x + dy * y.
+    // one triangle, or two sharing an edge merged into a quad: covering a
+    // whole pixel each, they would miss the pixels along that edge.
+    struct Triangle {
+        f32 m_edges[ 4 ][ 3 ];  // c, dx, dy; >= 0 only where the whole pixel is inside
+        f32 m_depth[ 3 ];       // the farthest z / w inside the pixel
+        f32 m_maxDepth;
+        i32 m_minX, m_minY, m_maxX, m_maxY;     // fully covered pixels, m_minX > m_maxX when none
+        u32 m_sourceCount;      // 2 for a quad
+    };
+
+    static bool ProjectTriangle( const Float4 clip[ 3 ], ScreenTriangle& tri );
+    static bool SetupTriangle( const ScreenTriangle& tri, const ScreenTriangle* neighbor, u32 sharedEdge, u32 neighborCorner, Triangle& out );
+    void SetupOccluder( const Occluder& occluder );
+    void RasterizeBand( u32 band );
+    void BuildLevel( u32 level, u32 firstRow, u32 lastRow );
+    u32 CullBatch( const CullingBounds& bounds, u32* objects, u32 count ) const;
+
+    Matrix                  m_viewProjection = MatrixIdentity();
+    std::vector< Occluder > m_occluders;
+    std::vector< Triangle > m_triangles;
+    u32                     m_triangleCount = 0;
+    std::vector< f32 >      m_depth;        // every level's rows, level 0 first
+    u32                     m_levelOffsets[ HIZ_LEVELS ] = {};
+    std::vector< u32 >      m_batchCounts;
+};
@@ -0,0 +1,92 @@
+#include "present_queue.h"
+
+#include <algorithm>
+#include <thread>
+
+//
+void PresentQueue::Reset( const PresentDesc& desc ) {
+    m_bufferCount = std::min( std::max( desc.m_bufferCount, 2u ), MAX_BUFFERS );
+    // one buffer is on screen and one is being rendered, the rest can queue
+    m_queueLimit = std::min( std::max( desc.m_maxFrameLatency, 1u ), m_bufferCount - 1 );
+    m_vsync = desc.m_vsync;
+    const f64 rate = desc.m_refreshRate > 0.0 ? desc.m_refreshRate : 60.0;
+    m_refreshPeriod = std::chrono::duration_cast< FrameClock::duration >( std::chrono::duration< f64 >( 1.0 / rate ) );
+
+    m_epoch = FrameClock::now();
+    m_lastRetire = m_epoch;
+    m_frameStart = m_epoch;
+    m_frontBuffer = 0;
+    m_backBuffer = 1;
+    m_queuedCount = 0;
+    m_stats = PresentStats();
+}
+
+//
+FrameClock::time_point PresentQueue::NextVBlank( FrameClock::time_point now ) const {
+    const i64 elapsed = ( now - m_epoch ) / m_refreshPeriod;
+    return m_epoch + m_refreshPeriod * ( elapsed + 1 );
+}
+
+//
+void PresentQueue::Show( u32 buffer, FrameClock::time_point frameStart, FrameClock::time_point shownAt ) {
+    m_frontBuffer = buffer;
+    const f64 latency = SecondsBetween( frameStart, shownAt );
+    m_stats.m_framesShown++;
+    m_stats.m_totalLatency += latency;
+    m_stats.m_maxLatency = std::max( m_stats.m_maxLatency, latency );
+}
+
+//
+void PresentQueue::Retire( FrameClock::time_point now ) {
+    // every vertical blank since the last call flips at most one queued frame
+    FrameClock::time_point vblank = NextVBlank( m_lastRetire );
+    while ( m_queuedCount > 0 && vblank <= now ) {
+        Show( m_queued[ 0 ], m_queuedStart[ 0 ], vblank );
+        for ( u32 i = 1; i < m_queuedCount; ++i ) {
+            m_queued[ i - 1 ] = m_queued[ i ];
+            m_queuedStart[ i - 1 ] = m_queuedStart[ i ];
+        }
+        m_queuedCount--;
+        vblank += m_refreshPeriod;
+    }
+    m_lastRetire = now;
+}
+
+//
+void PresentQueue::WaitForFrame() {
+    FrameClock::time_point now = FrameClock::now();
+    Retire( now );
+    while ( m_queuedCount >= m_queueLimit ) {
+        std::this_thread::sleep_until( NextVBlank( now ) );
+        now = FrameClock::now();
+        Retire( now );
+    }
+
+    // render into a buffer that is neither on screen nor waiting for a flip
+    for ( u32 buffer = 0; buffer < m_bufferCount; ++buffer ) {
+        bool used = buffer == m_frontBuffer;
+        for ( u32 i = 0; i < m_queuedCount; ++i )
+            used = used || m_queued[ i ] == buffer;
+        if ( !used ) {
+            m_backBuffer = buffer;
+            break;
+        }
+    }
+    m_frameStart = now;
+}
+
+//
+void PresentQueue::Present() {
+    const FrameClock::time_point now = FrameClock::now();
+    if ( !m_vsync ) {
+        Show( m_backBuffer, m_frameStart, now );
+        return;
+    }
+
+    Retire( now );
+    if ( m_queuedCount + 1 >= m_bufferCount )
+        return;     // no WaitForFrame since the last present, the back buffer is already queued
+    m_queued[ m_queuedCount ] = m_backBuffer;
+    m_queuedStart[ m_queuedCount ] = m_frameStart;
+    m_queuedCount++;
+}
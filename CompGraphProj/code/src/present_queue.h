@@ -0,0 +1,68 @@
+#pragma once
+
+#include "frame_timing.h"
+
+// presentation policy shared by the backends. D3D11 maps it onto a
+// flip-model swap chain, the software backend emulates it with PresentQueue.
+struct PresentDesc {
+    u32     m_bufferCount = 2;          // swap chain buffers including the one on screen, 2 or 3
+    u32     m_maxFrameLatency = 1;      // frames the CPU may queue ahead of the display
+    bool    m_vsync = false;            // flip on vertical blank, otherwise present immediately
+    bool    m_allowTearing = false;     // D3D11: immediate presents may tear on variable refresh displays
+    f64     m_refreshRate = 60.0;       // software: vertical blank rate of the emulated display
+};
+
+struct PresentStats {
+    u64     m_framesShown = 0;
+    f64     m_totalLatency = 0.0;       // seconds from WaitForFrame returning to the frame reaching the screen
+    f64     m_maxLatency = 0.0;
+
+    f64 GetAverageLatency() const { return m_framesShown ? m_totalLatency / ( f64 )m_framesShown : 0.0; }
+};
+
+// CPU model of an N-buffered flip queue. with vsync one queued frame is
+// flipped to the screen per emulated vertical blank; without it every
+// present flips immediately. WaitForFrame blocks like the waitable object of
+// a DXGI swap chain while the queue is full, which is what bounds latency.
+class PresentQueue {
+public:
+    void Reset( const PresentDesc& desc );
+
+    u32 GetBufferCount() const { return m_bufferCount; }
+    // buffer to render the next frame into, never the one on screen or a queued one
+    u32 GetBackBufferIndex() const { return m_backBuffer; }
+    // buffer on screen as of the last WaitForFrame or Present
+    u32 GetFrontBufferIndex() const { return m_frontBuffer; }
+    u32 GetQueuedFrames() const { return m_queuedCount; }
+    const PresentStats& GetStats() const { return m_stats; }
+
+    // returns once the back buffer may be rendered, starts the latency clock of the frame
+    void WaitForFrame();
+    // queues the back buffer. every Present has to follow a WaitForFrame.
+    void Present();
+
+private:
+    // flips queued frames for every vertical blank up to now
+    void Retire( FrameClock::time_point now );
+    FrameClock::time_point NextVBlank( FrameClock::time_point now ) const;
+    void Show( u32 buffer, FrameClock::time_point frameStart, FrameClock::time_point shownAt );
+
+    static constexpr u32 MAX_BUFFERS = 3;
+
+    u32                     m_bufferCount = 2;
+    u32                     m_queueLimit = 1;
+    bool                    m_vsync = false;
+    FrameClock::duration    m_refreshPeriod{};
+    FrameClock::time_point  m_epoch;            // vertical blanks happen at m_epoch + k * period
+    FrameClock::time_point  m_lastRetire;
+
+    u32                     m_frontBuffer = 0;
+    u32                     m_backBuffer = 1;
+    // queued frames in present order
+    u32                     m_queued[ MAX_BUFFERS ] = {};
+    FrameClock::time_point  m_queuedStart[ MAX_BUFFERS ];
+    u32                     m_queuedCount = 0;
+    FrameClock::time_point  m_frameStart;
+
+    PresentStats            m_stats;
+};
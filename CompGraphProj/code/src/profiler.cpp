@@ -0,0 +1,211 @@
+#include "profiler.h"
+
+#include "frame_timing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 16k zones per thread, a few seconds of frames at the usual zone density
+constexpr u32 EVENTS_PER_THREAD = 1 << 14;
+
+// ring of one thread or of a track created with ProfilerCreateTrack
+struct ProfileTrack {
+    std::atomic< u64 >  m_head{ 0 };            // events ever written, the newest is m_head - 1
+    std::atomic< bool > m_inUse{ true };        // cleared when the owning thread exits, tracks stay in use
+    u32                 m_threadId = 0;
+    char                m_name[ 32 ] = {};
+    ProfileEvent        m_events[ EVENTS_PER_THREAD ];
+};
+
+struct ProfilerState {
+    std::mutex                  m_mutex;
+    // never freed, the ring of an exited thread goes to the next new one
+    std::vector< ProfileTrack* >  m_rings;
+    u32                         m_nextThreadId = 0;
+    u64                         m_startTicks = ProfilerTimestamp();
+    FrameClock::time_point      m_startTime = FrameClock::now();
+};
+
+// leaked on purpose so threads still running at exit never see it destroyed
+static ProfilerState& GetProfilerState() {
+    static ProfilerState* state = new ProfilerState();
+    return *state;
+}
+
+// the fast path only reads the plain pointer, the owner hands the ring back on thread exit
+struct TrackOwner {
+    ProfileTrack* m_ring = nullptr;
+    ~TrackOwner() {
+        if ( m_ring != nullptr )
+            m_ring->m_inUse.store( false, std::memory_order_release );
+    }
+};
+static thread_local ProfileTrack* t_track = nullptr;
+static thread_local TrackOwner t_trackOwner;
+
+//
+static ProfileTrack* AcquireThreadTrack() {
+    ProfilerState& state = GetProfilerState();
+    std::lock_guard< std::mutex > lock( state.m_mutex );
+
+    ProfileTrack* ring = nullptr;
+    for ( ProfileTrack* candidate : state.m_rings ) {
+        if ( !candidate->m_inUse.load( std::memory_order_acquire ) ) {
+            ring = candidate;
+            ring->m_inUse.store( true, std::memory_order_relaxed );
+            ring->m_head.store( 0, std::memory_order_relaxed );
+            ring->m_name[ 0 ] = '\0';
+            break;
+        }
+    }
+    if ( ring == nullptr ) {
+        ring = new ProfileTrack();
+        state.m_rings.push_back( ring );
+    }
+    ring->m_threadId = state.m_nextThreadId++;
+
+    t_track = ring;
+    t_trackOwner.m_ring = ring;
+    return ring;
+}
+
+//
+void ProfilerRecord( const char* name, u64 begin, u64 end ) {
+    ProfileTrack* ring = t_track;
+    if ( ring == nullptr )
+        ring = AcquireThreadTrack();
+    ProfilerRecord( ring, name, begin, end );
+}
+
+//
+ProfileTrack* ProfilerCreateTrack( const char* name ) {
+    ProfilerState& state = GetProfilerState();
+    std::lock_guard< std::mutex > lock( state.m_mutex );
+    ProfileTrack* track = new ProfileTrack();
+    track->m_threadId = state.m_nextThreadId++;
+    const size_t length = std::min( strlen( name ), sizeof( track->m_name ) - 1 );
+    memcpy( track->m_name, name, length );
+    state.m_rings.push_back( track );
+    return track;
+}
+
+//
+void ProfilerRecord( ProfileTrack* ring, const char* name, u64 begin, u64 end ) {
+    const u64 head = ring->m_head.load( std::memory_order_relaxed );
+    ProfileEvent& event = ring->m_events[ head & ( EVENTS_PER_THREAD - 1 ) ];
+    event.m_name = name;
+    event.m_begin = begin;
+    event.m_end = end;
+    ring->m_head.store( head + 1, std::memory_order_release );
+}
+
+//
+void ProfilerSetThreadName( const char* name ) {
+    ProfileTrack* ring = t_track != nullptr ? t_track : AcquireThreadTrack();
+    std::lock_guard< std::mutex > lock( GetProfilerState().m_mutex );
+    const size_t length = std::min( strlen( name ), sizeof( ring->m_name ) - 1 );
+    memcpy( ring->m_name, name, length );
+    ring->m_name[ length ] = '\0';
+}
+
+//
+f64 ProfilerTicksPerSecond() {
+#ifdef PROFILER_RDTSC
+    // the invariant TSC runs at a fixed rate; measure it over at least 20 ms
+    ProfilerState& state = GetProfilerState();
+    f64 seconds = SecondsBetween( state.m_startTime, FrameClock::now() );
+    if ( seconds < 0.02 ) {
+        std::this_thread::sleep_for( std::chrono::duration< f64 >( 0.02 - seconds ) );
+    }
+    const u64 ticks = ProfilerTimestamp();
+    seconds = SecondsBetween( state.m_startTime, FrameClock::now() );
+    return ( f64 )( ticks - state.m_startTicks ) / seconds;
+#else
+    return ( f64 )std::chrono::steady_clock::period::den / ( f64 )std::chrono::steady_clock::period::num;
+#endif
+}
+
+//
+static void WriteJsonString( FILE* file, const char* text ) {
+    fputc( '"', file );
+    for ( const char* c = text; *c != '\0'; ++c ) {
+        if ( *c == '"' || *c == '\\' )
+            fputc( '\\', file );
+        if ( ( u8 )*c >= 0x20 )
+            fputc( *c, file );
+    }
+    fputc( '"', file );
+}
+
+struct ThreadSnapshot {
+    u32                         m_threadId;
+    char                        m_name[ 32 ];
+    std::vector< ProfileEvent > m_events;
+};
+
+//
+bool ProfilerWriteChromeTrace( const char* path ) {
+    const f64 ticksPerSecond = ProfilerTicksPerSecond();
+    ProfilerState& state = GetProfilerState();
+
+    // copy the rings first, the owners keep recording meanwhile
+    std::vector< ThreadSnapshot > threads;
+    {
+        std::lock_guard< std::mutex > lock( state.m_mutex );
+        for ( ProfileTrack* ring : state.m_rings ) {
+            ThreadSnapshot snapshot;
+            snapshot.m_threadId = ring->m_threadId;
+            memcpy( snapshot.m_name, ring->m_name, sizeof( snapshot.m_name ) );
+
+            const u64 head = ring->m_head.load( std::memory_order_acquire );
+            const u64 count = std::min< u64 >( head, EVENTS_PER_THREAD );
+            for ( u64 i = head - count; i < head; ++i )
+                snapshot.m_events.push_back( ring->m_events[ i & ( EVENTS_PER_THREAD - 1 ) ] );
+
+            // events the owner wrapped over while we copied are torn, drop them
+            const u64 written = ring->m_head.load( std::memory_order_acquire ) - head;
+            const size_t torn = ( size_t )std::min< u64 >( written, snapshot.m_events.size() );
+            snapshot.m_events.erase( snapshot.m_events.begin(), snapshot.m_events.begin() + torn );
+            threads.push_back( std::move( snapshot ) );
+        }
+    }
+
+    u64 base = ~0ull;
+    for ( const ThreadSnapshot& thread : threads ) {
+        for ( const ProfileEvent& event : thread.m_events )
+            base = std::min( base, event.m_begin );
+    }
+
+    FILE* file = fopen( path, "wb" );
+    if ( file == nullptr )
+        return false;
+
+    // complete ("X") events in microseconds since the oldest recorded zone
+    const f64 toMicroseconds = 1e6 / ticksPerSecond;
+    bool first = true;
+    fprintf( file, "{\"traceEvents\":[\n" );
+    for ( const ThreadSnapshot& thread : threads ) {
+        if ( thread.m_name[ 0 ] != '\0' ) {
+            fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", thread.m_threadId );
+            WriteJsonString( file, thread.m_name );
+            fprintf( file, "}}" );
+            first = false;
+        }
+        for ( const ProfileEvent& event : thread.m_events ) {
+            fprintf( file, "%s{\"name\":", first ? "" : ",\n" );
+            WriteJsonString( file, event.m_name );
+            fprintf( file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                thread.m_threadId,
+                ( f64 )( event.m_begin - base ) * toMicroseconds,
+                ( f64 )( event.m_end - event.m_begin ) * toMicroseconds );
+            first = false;
+        }
+    }
+    fprintf( file, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+    return fclose( file ) == 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "types.h"
+
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#include <intrin.h>
+#define PROFILER_RDTSC 1
+#elif defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#define PROFILER_RDTSC 1
+#else
+#include <chrono>
+#endif
+
+// always-on CPU instrumentation. every thread that closes a zone gets its own
+// ring of the most recent events, written without locks or allocations, so a
+// zone costs two timestamp reads and one store. the rings are dumped as a
+// Chrome trace_event JSON (chrome://tracing, ui.perfetto.dev) on request.
+// defining COMPGRAPH_NO_PROFILER compiles the zones out.
+
+struct ProfileEvent {
+    const char* m_name;     // string literal, never copied
+    u64         m_begin;
+    u64         m_end;
+};
+
+// raw timestamp in profiler ticks, see ProfilerTicksPerSecond
+inline u64 ProfilerTimestamp() {
+#ifdef PROFILER_RDTSC
+    return __rdtsc();
+#else
+    return ( u64 )std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// tick rate, calibrated against the steady clock since the first zone
+f64 ProfilerTicksPerSecond();
+
+// appends a finished zone to the calling thread's ring
+void ProfilerRecord( const char* name, u64 begin, u64 end );
+
+// label of the calling thread in the trace, copied
+void ProfilerSetThreadName( const char* name );
+
+// a named timeline that is not a thread, e.g. GPU passes. tracks live until
+// exit and take events from one thread at a time, in any time order.
+struct ProfileTrack;
+ProfileTrack* ProfilerCreateTrack( const char* name );
+void ProfilerRecord( ProfileTrack* track, const char* name, u64 begin, u64 end );
+
+// writes every thread's ring as Chrome trace_event JSON, false if the file could not be written
+bool ProfilerWriteChromeTrace( const char* path );
+
+// times its own lifetime
+class ProfileZone {
+public:
+    explicit ProfileZone( const char* name ) : m_name( name ), m_begin( ProfilerTimestamp() ) {}
+    ~ProfileZone() { ProfilerRecord( m_name, m_begin, ProfilerTimestamp() ); }
+
+    ProfileZone( const ProfileZone& ) = delete;
+    ProfileZone& operator=( const ProfileZone& ) = delete;
+
+private:
+    const char* m_name;
+    u64         m_begin;
+};
+
+#define PROFILE_CONCAT_INNER( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_INNER( a, b )
+
+#ifndef COMPGRAPH_NO_PROFILER
+// times the rest of the enclosing scope, name must be a string literal
+#define PROFILE_ZONE( name ) ProfileZone PROFILE_CONCAT( profileZone, __LINE__ )( name )
+#else
+#define PROFILE_ZONE( name ) ( void )0
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "job_system.h"
+#include "present_queue.h"
+#include "scene.h"
+#include "vertex_quantization.h"
+
+// the D3D11 backend is built on Windows unless the build opts out of it
+#if defined( _WIN32 ) && !defined( COMPGRAPH_NO_D3D11 )
+#define COMPGRAPH_HAS_D3D11 1
+#endif
+
+struct BackendDesc {
+    void*   m_windowHandle = nullptr;   // HWND for D3D11, ignored by headless backends
+    u32     m_width = 0;
+    u32     m_height = 0;
+    u32     m_threadCount = 0;          // workers including the caller of the software backend's own job system, 0 = one per core; only used when m_jobs is null
+    JobSystem* m_jobs = nullptr;        // shared job system for software rendering and cluster culling, takes precedence over m_threadCount
+    bool    m_perObjectDraws = false;   // D3D11: draw instances one by one with ring-allocated constants
+    bool    m_clusterCulling = false;   // cull the meshlets of a single object on the CPU every frame, see meshlet.h
+    PresentDesc m_present;
+};
+
+// per-pass durations of the most recent frame that has been measured. the
+// D3D11 backend reports GPU time read back a few frames late, the software
+// backend the CPU time of its stages in the frame just rendered.
+struct StageTimings {
+    static constexpr u32 MAX_STAGES = 8;
+
+    const char* m_names[ MAX_STAGES ] = {};
+    f64         m_ms[ MAX_STAGES ] = {};
+    u32         m_count = 0;
+    u64         m_frame = 0;            // 1-based index of the measured frame, 0 = nothing measured yet
+
+    void Add( const char* name, f64 ms ) {
+        if ( m_count < MAX_STAGES ) {
+            m_names[ m_count ] = name;
+            m_ms[ m_count ] = ms;
+            m_count++;
+        }
+    }
+};
+
+// everything the frame loop needs from a renderer. the D3D11 and software
+// backends implement the same calls so the scene code never branches on them.
+class RenderBackend {
+public:
+    virtual ~RenderBackend() = default;
+
+    virtual const char* GetName() const = 0;
+
+    virtual bool Initialize( const BackendDesc& desc ) = 0;
+    // resizes the back buffers, e.g. on SDL_WINDOWEVENT_SIZE_CHANGED
+    virtual bool Resize( u32 width, u32 height ) = 0;
+    virtual bool CreateObject( const Mesh& mesh ) = 0;
+    // same object from a compact vertex buffer, see vertex_quantization.h
+    virtual bool CreateQuantizedObject( const QuantizedMesh& mesh ) = 0;
+    virtual void UpdateConstants( const ConstantBuffer& cb ) = 0;
+    // reserves room for maxInstances instances. once UpdateInstances has
+    // uploaded a non-zero count, RenderScene draws the object once per
+    // instance with DrawIndexedInstanced and the view-projection constants.
+    virtual bool CreateInstanceBuffer( u32 maxInstances ) = 0;
+    virtual void UpdateInstances( const InstanceData* instances, u32 count ) = 0;
+    // blocks until the presentation queue has room for another frame. called
+    // before the frame's CPU work so input-to-display latency stays bounded.
+    virtual void WaitForNextFrame() = 0;
+    // renders and presents one frame
+    virtual void RenderScene() = 0;
+    virtual const StageTimings& GetStageTimings() const = 0;
+    virtual void Release() = 0;
+};
+
+RenderBackend* CreateSoftwareBackend();
+#ifdef COMPGRAPH_HAS_D3D11
+RenderBackend* CreateD3D11Backend();
+#endif
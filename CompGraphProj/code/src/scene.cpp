@@ -0,0 +1,481 @@
+#include "scene.h"
+
+#include "job_system.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+static const Vertex cubeVertices[] = {
+    { Float3( -0.50f, -0.50f, 0.50f ), Float4( 1.0f, 1.0f, 1.0f, 1.0f ) },
+    { Float3( -0.50f, 0.50f, 0.50f ), Float4( 1.0f, 0.0f, 0.0f, 1.0f ) },
+    { Float3( 0.50f, -0.50f, 0.50f ), Float4( 0.0f, 1.0f, 0.0f, 1.0f ) },
+    { Float3( 0.50f, 0.50f, 0.50f ), Float4( 0.0f, 0.0f, 1.0f, 1.0f ) },
+
+    { Float3( -0.50f, -0.50f, -0.50f ), Float4( 0.0f, 0.0f, 0.0f, 1.0f ) },
+    { Float3( -0.50f, 0.50f, -0.50f ), Float4( 1.0f, 1.0f, 0.0f, 1.0f ) },
+    { Float3( 0.50f, -0.50f, -0.50f ), Float4( 0.0f, 1.0f, 1.0f, 1.0f ) },
+    { Float3( 0.50f, 0.50f, -0.50f ), Float4( 1.0f, 0.0f, 1.0f, 1.0f ) },
+};
+
+static const u32 cubeIndices[] = {
+    0, 1, 2,
+    1, 3, 2,
+
+    5, 0, 4,
+    5, 1, 0,
+
+    6, 7, 4,
+    4, 7, 5,
+
+    2, 3, 6,
+    3, 7, 6,
+
+    5, 3, 1,
+    5, 7, 3,
+
+    0, 2, 6,
+    6, 4, 0,
+};
+
+//
+const Mesh& GetCubeMesh() {
+    static const Mesh cube = {
+        cubeVertices, ( u32 )( sizeof( cubeVertices ) / sizeof( cubeVertices[ 0 ] ) ),
+        cubeIndices, ( u32 )( sizeof( cubeIndices ) / sizeof( cubeIndices[ 0 ] ) ),
+    };
+    return cube;
+}
+
+//
+void GenerateSphereMesh( MeshData& mesh, u32 rings, u32 segments ) {
+    rings = rings < 2 ? 2 : rings;
+    segments = segments < 3 ? 3 : segments;
+
+    // ScalarSinCos rather than the C library, so the mesh is the same everywhere
+    mesh.m_vertices.resize( ( rings + 1 ) * ( segments + 1 ) );
+    for ( u32 ring = 0; ring <= rings; ++ring ) {
+        f32 sinTheta, cosTheta;
+        ScalarSinCos( &sinTheta, &cosTheta, MATH_PI * ( f32 )ring / ( f32 )rings );
+        for ( u32 segment = 0; segment <= segments; ++segment ) {
+            f32 sinPhi, cosPhi;
+            ScalarSinCos( &sinPhi, &cosPhi, MATH_2PI * ( f32 )segment / ( f32 )segments );
+            const Float3 n( sinTheta * cosPhi, cosTheta, sinTheta * sinPhi );
+            Vertex& v = mesh.m_vertices[ ring * ( segments + 1 ) + segment ];
+            v.m_pos = n;
+            v.m_color = Float4( 0.5f + 0.5f * n.x, 0.5f + 0.5f * n.y, 0.5f + 0.5f * n.z, 1.0f );
+        }
+    }
+
+    mesh.m_indices.clear();
+    mesh.m_indices.reserve( rings * segments * 6 );
+    for ( u32 ring = 0; ring < rings; ++ring ) {
+        for ( u32 segment = 0; segment < segments; ++segment ) {
+            const u32 i0 = ring * ( segments + 1 ) + segment;
+            const u32 i1 = i0 + segments + 1;
+            const u32 quad[ 6 ] = { i0, i0 + 1, i1, i0 + 1, i1 + 1, i1 };
+            mesh.m_indices.insert( mesh.m_indices.end(), quad, quad + 6 );
+        }
+    }
+}
+
+// radians per second of the single cube
+constexpr f32 CUBE_ANGULAR_SPEED = 0.6f;
+
+// keeps angles in [0, 2pi) without breaking interpolation across the wrap
+static void WrapAngle( f32& angle, f32& prevAngle ) {
+    if ( angle >= MATH_2PI ) {
+        angle -= MATH_2PI;
+        prevAngle -= MATH_2PI;
+    }
+}
+
+//
+void UpdateScene( Scene& scene, f32 dt ) {
+    scene.m_prevAngle = scene.m_angle;
+    scene.m_angle += CUBE_ANGULAR_SPEED * dt;
+    WrapAngle( scene.m_angle, scene.m_prevAngle );
+}
+
+//
+ConstantBuffer GetSceneConstants( Scene& scene, f32 alpha ) {
+    const f32 angle = scene.m_prevAngle + ( scene.m_angle - scene.m_prevAngle ) * alpha;
+    Float3 axis( 1, 1, 1 );
+    scene.m_objProjection = MatrixMultiply( scene.m_objectTransform, MatrixRotationAxis( axis, angle ) );
+    ConstantBuffer cb;
+    cb.m_modelMatrix = MatrixTranspose( scene.m_objProjection );
+    cb.m_viewProjection = MatrixIdentity();
+    return cb;
+}
+
+//
+ConstantBuffer Rotate( Scene& scene ) {
+    UpdateScene( scene, SIMULATION_STEP );
+    return GetSceneConstants( scene, 1.0f );
+}
+
+// xorshift32, so the generated field is the same with every standard library
+static u32 NextRandom( u32& state ) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static f32 RandomRange( u32& state, f32 lo, f32 hi ) {
+    return lo + ( hi - lo ) * ( f32 )( NextRandom( state ) >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+// radius of the sphere through the corners of the unit cube
+constexpr f32 CUBE_BOUNDING_RADIUS = 0.8660254f;
+
+// the cube's fields in row of its chunk
+static void WriteCube( EcsChunk& chunk, u32 row, const CubeInstance& cube ) {
+    chunk.Get( ECS_POSITION_X )[ row ] = cube.m_position.x;
+    chunk.Get( ECS_POSITION_Y )[ row ] = cube.m_position.y;
+    chunk.Get( ECS_POSITION_Z )[ row ] = cube.m_position.z;
+    chunk.Get( ECS_SCALE )[ row ] = cube.m_scale;
+    chunk.Get( ECS_AXIS_X )[ row ] = cube.m_axis.x;
+    chunk.Get( ECS_AXIS_Y )[ row ] = cube.m_axis.y;
+    chunk.Get( ECS_AXIS_Z )[ row ] = cube.m_axis.z;
+    chunk.Get( ECS_ANGLE )[ row ] = cube.m_angle;
+    chunk.Get( ECS_PREV_ANGLE )[ row ] = cube.m_prevAngle;
+    chunk.Get( ECS_ANGULAR_SPEED )[ row ] = cube.m_angularSpeed;
+    chunk.Get( ECS_RADIUS )[ row ] = CUBE_BOUNDING_RADIUS * cube.m_scale;
+    chunk.GetU32( ECS_MESH_INDEX )[ row ] = 0;
+    chunk.Get( ECS_COLOR_R )[ row ] = cube.m_color.x;
+    chunk.Get( ECS_COLOR_G )[ row ] = cube.m_color.y;
+    chunk.Get( ECS_COLOR_B )[ row ] = cube.m_color.z;
+    chunk.Get( ECS_COLOR_A )[ row ] = cube.m_color.w;
+}
+
+//
+static CubeInstance ReadCube( const EcsChunk& chunk, u32 row ) {
+    CubeInstance cube;
+    cube.m_position = Float3( chunk.Get( ECS_POSITION_X )[ row ], chunk.Get( ECS_POSITION_Y )[ row ], chunk.Get( ECS_POSITION_Z )[ row ] );
+    cube.m_axis = Float3( chunk.Get( ECS_AXIS_X )[ row ], chunk.Get( ECS_AXIS_Y )[ row ], chunk.Get( ECS_AXIS_Z )[ row ] );
+    cube.m_scale = chunk.Get( ECS_SCALE )[ row ];
+    cube.m_angle = chunk.Get( ECS_ANGLE )[ row ];
+    cube.m_prevAngle = chunk.Get( ECS_PREV_ANGLE )[ row ];
+    cube.m_angularSpeed = chunk.Get( ECS_ANGULAR_SPEED )[ row ];
+    cube.m_color = Float4( chunk.Get( ECS_COLOR_R )[ row ], chunk.Get( ECS_COLOR_G )[ row ], chunk.Get( ECS_COLOR_B )[ row ], chunk.Get( ECS_COLOR_A )[ row ] );
+    return cube;
+}
+
+//
+CubeInstance GetCube( const CubeFieldScene& scene, u32 cube ) {
+    u32 row;
+    const EcsChunk& chunk = *scene.m_entities.FindChunk( CUBE_FIELD_COMPONENTS, cube, row );
+    return ReadCube( chunk, row );
+}
+
+//
+void SetCubeColor( CubeFieldScene& scene, u32 cube, const Float4& color ) {
+    u32 row;
+    EcsChunk& chunk = *scene.m_entities.FindChunk( CUBE_FIELD_COMPONENTS, cube, row );
+    chunk.Get( ECS_COLOR_R )[ row ] = color.x;
+    chunk.Get( ECS_COLOR_G )[ row ] = color.y;
+    chunk.Get( ECS_COLOR_B )[ row ] = color.z;
+    chunk.Get( ECS_COLOR_A )[ row ] = color.w;
+}
+
+//
+void GenerateCubeField( CubeFieldScene& scene, u32 count, f32 aspect, u32 seed ) {
+    u32 state = seed != 0 ? seed : 1;
+
+    // smallest cube-shaped grid that holds every instance
+    u32 side = 1;
+    while ( side * side * side < count )
+        ++side;
+    const f32 spacing = 2.0f;
+    const f32 origin = -0.5f * spacing * ( f32 )( side - 1 );
+
+    // the entities first, so every chunk is allocated once
+    scene.m_entities.Clear();
+    for ( u32 i = 0; i < count; ++i )
+        scene.m_entities.Create( CUBE_FIELD_COMPONENTS );
+    scene.m_cubeCount = count;
+    scene.m_bounds.Resize( count );
+    for ( u32 i = 0; i < count; ++i ) {
+        CubeInstance cube;
+        const u32 gx = i % side, gy = ( i / side ) % side, gz = i / ( side * side );
+        cube.m_position = Float3(
+            origin + spacing * ( f32 )gx + RandomRange( state, -0.3f, 0.3f ),
+            origin + spacing * ( f32 )gy + RandomRange( state, -0.3f, 0.3f ),
+            origin + spacing * ( f32 )gz + RandomRange( state, -0.3f, 0.3f ) );
+        cube.m_axis = Vector3Normalize( Float3( RandomRange( state, -1.0f, 1.0f ), RandomRange( state, -1.0f, 1.0f ), RandomRange( state, 0.1f, 1.0f ) ) );
+        cube.m_scale = RandomRange( state, 0.6f, 0.9f );
+        cube.m_angle = RandomRange( state, 0.0f, MATH_2PI );
+        cube.m_prevAngle = cube.m_angle;
+        cube.m_angularSpeed = RandomRange( state, 0.25f, 1.2f );
+        cube.m_color = Float4( RandomRange( state, 0.4f, 1.0f ), RandomRange( state, 0.4f, 1.0f ), RandomRange( state, 0.4f, 1.0f ), 1.0f );
+        u32 row;
+        EcsChunk& chunk = *scene.m_entities.FindChunk( CUBE_FIELD_COMPONENTS, i, row );
+        WriteCube( chunk, row, cube );
+        // a sphere through the corners of the unit cube holds it at every angle
+        scene.m_bounds.SetSphere( i, cube.m_position, CUBE_BOUNDING_RADIUS * cube.m_scale );
+    }
+    scene.m_instances.resize( count );
+    scene.m_instanceCount = count;
+    scene.m_occluders.clear();
+
+    scene.m_extent = 0.5f * spacing * ( f32 )side + 1.0f;
+    SetCubeFieldAspect( scene, aspect );
+}
+
+// vertical field of view of the cube field camera
+constexpr f32 CUBE_FIELD_FOV = MATH_PI / 3.0f;
+
+//
+void SetCubeFieldAspect( CubeFieldScene& scene, f32 aspect ) {
+    // look at the block from above and in front, far enough to fit it in a 60 degree frustum
+    const f32 extent = scene.m_extent;
+    scene.m_eye = Float3( 0.5f * extent, 0.8f * extent, -2.2f * extent );
+    scene.m_aspect = aspect;
+    scene.m_view = MatrixLookAtLH( scene.m_eye, Float3( 0.0f, 0.0f, 0.0f ), Float3( 0.0f, 1.0f, 0.0f ) );
+    const Matrix projection = MatrixPerspectiveFovLH( CUBE_FIELD_FOV, aspect, 0.1f, 6.0f * extent );
+    scene.m_viewProjection = MatrixMultiply( scene.m_view, projection );
+}
+
+// cubes per job when the field is updated on a job system
+constexpr u32 CUBE_FIELD_BATCH = 4096;
+
+// runs fn over indices [ 0, count ), on the job system when one is given
+template< typename Func >
+static void ForEachCube( u32 count, JobSystem* jobs, const Func& fn ) {
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( count, fn, CUBE_FIELD_BATCH );
+    } else {
+        for ( u32 i = 0; i < count; ++i )
+            fn( i );
+    }
+}
+
+// the unit cube scaled, spun to angle and moved into place
+static Matrix GetCubeModel( const CubeInstance& cube, f32 angle ) {
+    Matrix model = MatrixRotationNormal( cube.m_axis, angle );
+    for ( u32 r = 0; r < 3; ++r ) {
+        model.r[ r ].x *= cube.m_scale;
+        model.r[ r ].y *= cube.m_scale;
+        model.r[ r ].z *= cube.m_scale;
+    }
+    model.r[ 3 ] = Float4( cube.m_position.x, cube.m_position.y, cube.m_position.z, 1.0f );
+    return model;
+}
+
+// the cube's angle at alpha between the previous and the current step
+static f32 GetCubeAngle( const CubeInstance& cube, f32 alpha ) {
+    return cube.m_prevAngle + ( cube.m_angle - cube.m_prevAngle ) * alpha;
+}
+
+// half size of the world box of the unit cube under model: each axis reaches
+// half the sum of the absolute rows' components
+static Float3 GetCubeExtent( const Matrix& model ) {
+    Float3 extent;
+    extent.x = 0.5f * ( std::fabs( model.r[ 0 ].x ) + std::fabs( model.r[ 1 ].x ) + std::fabs( model.r[ 2 ].x ) );
+    extent.y = 0.5f * ( std::fabs( model.r[ 0 ].y ) + std::fabs( model.r[ 1 ].y ) + std::fabs( model.r[ 2 ].y ) );
+    extent.z = 0.5f * ( std::fabs( model.r[ 0 ].z ) + std::fabs( model.r[ 1 ].z ) + std::fabs( model.r[ 2 ].z ) );
+    return extent;
+}
+
+//
+static Aabb GetCubeBox( const Matrix& model ) {
+    const Float3 extent = GetCubeExtent( model );
+    const Float4& p = model.r[ 3 ];
+    return { Float3( p.x - extent.x, p.y - extent.y, p.z - extent.z ), Float3( p.x + extent.x, p.y + extent.y, p.z + extent.z ) };
+}
+
+// refits the BVH to m_boxes, building it on first use
+static void UpdateCubeFieldBvh( CubeFieldScene& scene, JobSystem* jobs ) {
+    if ( scene.m_bvh.GetObjectCount() != scene.m_boxes.size() )
+        scene.m_bvh.Build( scene.m_boxes.data(), ( u32 )scene.m_boxes.size(), jobs );
+    else
+        scene.m_bvh.Update( scene.m_boxes.data(), jobs );
+}
+
+// occluders per frame of the cube field: the nearest cubes hide most of the
+// rest, and the farther ones would mostly fill pixels that are covered already
+constexpr u32 CUBE_FIELD_OCCLUDERS = 256;
+
+// the cubes in the view nearest the camera
+static void SelectCubeFieldOccluders( CubeFieldScene& scene ) {
+    const Frustum frustum = MakeFrustum( scene.m_viewProjection );
+    std::vector< std::pair< f32, u32 > > candidates;
+    for ( u32 i = 0; i < scene.m_cubeCount; ++i ) {
+        const CubeInstance cube = GetCube( scene, i );
+        if ( !IsSphereOutside( frustum, cube.m_position, CUBE_BOUNDING_RADIUS * cube.m_scale ) )
+            candidates.push_back( { TransformPoint( cube.m_position, scene.m_viewProjection ).w, i } );
+    }
+    const size_t count = std::min< size_t >( candidates.size(), CUBE_FIELD_OCCLUDERS );
+    std::partial_sort( candidates.begin(), candidates.begin() + count, candidates.end() );
+    scene.m_occluders.resize( count );
+    for ( size_t k = 0; k < count; ++k )
+        scene.m_occluders[ k ] = candidates[ k ].second;
+    scene.m_occluderViewProjection = scene.m_viewProjection;
+}
+
+// the occluders as they are drawn at alpha, chosen again when the camera moved
+static void RasterizeCubeFieldOccluders( CubeFieldScene& scene, f32 alpha, JobSystem* jobs ) {
+    if ( scene.m_occluders.empty() || memcmp( &scene.m_occluderViewProjection, &scene.m_viewProjection, sizeof( Matrix ) ) != 0 )
+        SelectCubeFieldOccluders( scene );
+    const Mesh& mesh = GetCubeMesh();
+    scene.m_hiz.Begin( scene.m_viewProjection );
+    for ( u32 i : scene.m_occluders ) {
+        const CubeInstance cube = GetCube( scene, i );
+        scene.m_hiz.AddOccluder( &mesh.m_vertices[ 0 ].m_pos, sizeof( Vertex ), mesh.m_indices, mesh.m_indexCount, GetCubeModel( cube, GetCubeAngle( cube, alpha ) ) );
+    }
+    scene.m_hiz.Finish( jobs );
+}
+
+// the angles before the step are kept for interpolation; rows past the
+// chunk's count are turned too, they are never read
+void RotateSystem( EntityStore& entities, f32 dt, JobSystem* jobs ) {
+    entities.ForEachChunk( ECS_TRANSFORM | ECS_SPIN, jobs, [ dt ]( EcsChunk& chunk ) {
+        f32* angle = chunk.Get( ECS_ANGLE );
+        f32* prevAngle = chunk.Get( ECS_PREV_ANGLE );
+        const f32* speed = chunk.Get( ECS_ANGULAR_SPEED );
+        const vf32 step = Splat( dt ), turn = Splat( MATH_2PI );
+        for ( u32 i = 0; i < chunk.GetCount(); i += SIMD_WIDTH ) {
+            const vf32 prev = Load( angle + i );
+            const vf32 next = prev + Load( speed + i ) * step;
+            // WrapAngle
+            const vf32 wrap = CmpGe( next, turn ) & turn;
+            Store( angle + i, next - wrap );
+            Store( prevAngle + i, prev - wrap );
+        }
+    } );
+}
+
+//
+void UpdateCubeField( CubeFieldScene& scene, f32 dt, JobSystem* jobs ) {
+    RotateSystem( scene.m_entities, dt, jobs );
+}
+
+//
+ConstantBuffer GetCubeFieldConstants( CubeFieldScene& scene, f32 alpha, JobSystem* jobs ) {
+    // the spheres do not move, so culling them first only skips work. the
+    // boxes turn with the cubes and are culled once they are known.
+    const bool occlusion = scene.m_occlusionCulling;
+    if ( occlusion )
+        RasterizeCubeFieldOccluders( scene, alpha, jobs );
+    u32 count = scene.m_cubeCount;
+    const u32* visible = nullptr;
+    if ( scene.m_culling == CUBE_FIELD_CULL_FRUSTUM ) {
+        count = scene.m_culler.Cull( scene.m_bounds, MakeFrustum( scene.m_viewProjection ), FRUSTUM_TEST_SPHERES, jobs );
+        visible = scene.m_culler.GetVisible();
+    }
+    const bool boxes = scene.m_culling == CUBE_FIELD_CULL_BVH;
+    if ( boxes )
+        scene.m_boxes.resize( count );
+    if ( occlusion )
+        scene.m_instanceBounds.Resize( count );
+
+    auto write = [ & ]( u32 k, const CubeInstance& cube ) {
+        const Matrix model = GetCubeModel( cube, GetCubeAngle( cube, alpha ) );
+        scene.m_instances[ k ].m_modelMatrix = model;
+        scene.m_instances[ k ].m_color = cube.m_color;
+        if ( boxes )
+            scene.m_boxes[ k ] = GetCubeBox( model );
+        if ( occlusion )
+            scene.m_instanceBounds.Set( k, cube.m_position, GetCubeExtent( model ), 0.0f );
+    };
+    if ( visible != nullptr ) {
+        ForEachCube( count, jobs, [ & ]( u32 k ) { write( k, GetCube( scene, visible[ k ] ) ); } );
+    } else {
+        scene.m_entities.ForEachChunk( CUBE_FIELD_COMPONENTS, jobs, [ & ]( const EcsChunk& chunk ) {
+            for ( u32 row = 0; row < chunk.GetCount(); ++row )
+                write( chunk.GetFirst() + row, ReadCube( chunk, row ) );
+        } );
+    }
+
+    // the instances left, in field order
+    if ( boxes ) {
+        UpdateCubeFieldBvh( scene, jobs );
+        scene.m_visible.clear();
+        scene.m_bvh.CullFrustum( MakeFrustum( scene.m_viewProjection ), scene.m_visible );
+        std::sort( scene.m_visible.begin(), scene.m_visible.end() );
+    } else if ( occlusion ) {
+        scene.m_visible.resize( count );
+        std::iota( scene.m_visible.begin(), scene.m_visible.end(), 0u );
+    }
+    if ( occlusion ) {
+        const u32 candidates = ( u32 )scene.m_visible.size();
+        scene.m_visible.resize( scene.m_hiz.Cull( scene.m_instanceBounds, scene.m_visible.data(), candidates, jobs ) );
+        scene.m_occludedCount = candidates - ( u32 )scene.m_visible.size();
+    }
+    if ( boxes || occlusion ) {
+        // every visible index is at least its position, so the instances move down in place
+        count = ( u32 )scene.m_visible.size();
+        for ( u32 k = 0; k < count; ++k )
+            scene.m_instances[ k ] = scene.m_instances[ scene.m_visible[ k ] ];
+    }
+    scene.m_instanceCount = count;
+
+    ConstantBuffer cb;
+    cb.m_modelMatrix = MatrixIdentity();
+    cb.m_viewProjection = MatrixTranspose( scene.m_viewProjection );
+    return cb;
+}
+
+// the ray in the cube's own frame against the unit cube
+class CubeRayTest : public BvhRayTest {
+public:
+    explicit CubeRayTest( const CubeFieldScene& scene ) : m_scene( scene ) {}
+
+    bool Intersect( u32 object, const Float3& origin, const Float3& direction, f32& t ) const override {
+        const CubeInstance cube = GetCube( m_scene, object );
+        const Matrix model = GetCubeModel( cube, cube.m_angle );
+        const Float3 offset( origin.x - cube.m_position.x, origin.y - cube.m_position.y, origin.z - cube.m_position.z );
+        // the rows are orthogonal with length scale
+        const f32 invScale2 = 1.0f / ( cube.m_scale * cube.m_scale );
+        f32 tMin = 0.0f, tMax = t;
+        for ( u32 r = 0; r < 3; ++r ) {
+            const Float3 axis( model.r[ r ].x, model.r[ r ].y, model.r[ r ].z );
+            const f32 o = Vector3Dot( offset, axis ) * invScale2;
+            const f32 d = Vector3Dot( direction, axis ) * invScale2;
+            const f32 t0 = ( -0.5f - o ) / d, t1 = ( 0.5f - o ) / d;
+            tMin = std::max( tMin, std::min( t0, t1 ) );
+            tMax = std::min( tMax, std::max( t0, t1 ) );
+        }
+        if ( tMin > tMax )
+            return false;
+        t = tMin;
+        return true;
+    }
+
+private:
+    const CubeFieldScene& m_scene;
+};
+
+// the view-space ray through the point, turned into world space by the
+// view's rotation, whose inverse is its transpose
+u32 PickCube( CubeFieldScene& scene, f32 ndcX, f32 ndcY, JobSystem* jobs ) {
+    scene.m_boxes.resize( scene.m_cubeCount );
+    scene.m_entities.ForEachChunk( CUBE_FIELD_COMPONENTS, jobs, [ & ]( const EcsChunk& chunk ) {
+        for ( u32 row = 0; row < chunk.GetCount(); ++row ) {
+            const CubeInstance cube = ReadCube( chunk, row );
+            scene.m_boxes[ chunk.GetFirst() + row ] = GetCubeBox( GetCubeModel( cube, cube.m_angle ) );
+        }
+    } );
+    UpdateCubeFieldBvh( scene, jobs );
+
+    const f32 tanHalfFov = std::tan( 0.5f * CUBE_FIELD_FOV );
+    const Float3 ray( ndcX * tanHalfFov * scene.m_aspect, ndcY * tanHalfFov, 1.0f );
+    Float3 direction;
+    direction.x = scene.m_view.r[ 0 ].x * ray.x + scene.m_view.r[ 0 ].y * ray.y + scene.m_view.r[ 0 ].z * ray.z;
+    direction.y = scene.m_view.r[ 1 ].x * ray.x + scene.m_view.r[ 1 ].y * ray.y + scene.m_view.r[ 1 ].z * ray.z;
+    direction.z = scene.m_view.r[ 2 ].x * ray.x + scene.m_view.r[ 2 ].y * ray.y + scene.m_view.r[ 2 ].z * ray.z;
+
+    const CubeRayTest test( scene );
+    BvhRayHit hit;
+    scene.m_bvh.Raycast( scene.m_eye, direction, hit, 1e30f, &test );
+    return hit.m_object;
+}
+
+//
+ConstantBuffer AnimateCubeField( CubeFieldScene& scene ) {
+    UpdateCubeField( scene, SIMULATION_STEP );
+    return GetCubeFieldConstants( scene, 1.0f );
+}
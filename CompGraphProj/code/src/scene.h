@@ -0,0 +1,178 @@
+#pragma once
+
+#include "bvh.h"
+#include "entity_store.h"
+#include "frustum_culling.h"
+#include "occlusion_culling.h"
+#include "shader_layout.h"
+#include "types.h"
+#include "vecmath.h"
+
+#include <vector>
+
+class JobSystem;
+
+struct Vertex {
+    Float3 m_pos;
+    Float4 m_color;
+};
+
+// vertex buffer slot 0 of every shader
+constexpr VertexElement VERTEX_ELEMENTS[] = {
+    VERTEX_ELEMENT( Vertex, m_pos, "POSITION", 0, VERTEX_FORMAT_FLOAT3 ),
+    VERTEX_ELEMENT( Vertex, m_color, "COLOR", 0, VERTEX_FORMAT_FLOAT4 ),
+};
+static_assert( IsValidVertexLayout( VERTEX_ELEMENTS, sizeof( Vertex ) ), "VERTEX_ELEMENTS does not match Vertex" );
+constexpr VertexStream VERTEX_STREAM = MakeVertexStream( VERTEX_ELEMENTS, sizeof( Vertex ), false );
+
+struct ConstantBuffer
+{
+    Matrix m_modelMatrix;
+    Matrix m_viewProjection;    // instanced draws only
+};
+
+// cbuffer ConstantBuffer of VertexShader.hlsl and InstancedVertexShader.hlsl
+constexpr CBufferField CONSTANT_BUFFER_FIELDS[] = {
+    CBUFFER_FIELD( ConstantBuffer, m_modelMatrix, "model" ),
+    CBUFFER_FIELD( ConstantBuffer, m_viewProjection, "viewProjection" ),
+};
+static_assert( IsValidCBufferLayout( CONSTANT_BUFFER_FIELDS, sizeof( ConstantBuffer ) ), "CONSTANT_BUFFER_FIELDS does not match ConstantBuffer" );
+
+// one element of the instance buffer (input slot 1). the model matrix is
+// row-major and read by the shader as four float4 rows, not through a cbuffer,
+// so unlike ConstantBuffer it is not transposed.
+struct InstanceData {
+    Matrix m_modelMatrix;
+    Float4 m_color;             // multiplies the vertex color
+};
+
+// vertex buffer slot 1 of InstancedVertexShader.hlsl
+constexpr VertexElement INSTANCE_ELEMENTS[] = {
+    VERTEX_ELEMENT_ROW( InstanceData, m_modelMatrix, 0, "WORLD", 0, VERTEX_FORMAT_FLOAT4 ),
+    VERTEX_ELEMENT_ROW( InstanceData, m_modelMatrix, 1, "WORLD", 1, VERTEX_FORMAT_FLOAT4 ),
+    VERTEX_ELEMENT_ROW( InstanceData, m_modelMatrix, 2, "WORLD", 2, VERTEX_FORMAT_FLOAT4 ),
+    VERTEX_ELEMENT_ROW( InstanceData, m_modelMatrix, 3, "WORLD", 3, VERTEX_FORMAT_FLOAT4 ),
+    VERTEX_ELEMENT( InstanceData, m_color, "INSTANCECOLOR", 0, VERTEX_FORMAT_FLOAT4 ),
+};
+static_assert( IsValidVertexLayout( INSTANCE_ELEMENTS, sizeof( InstanceData ) ), "INSTANCE_ELEMENTS does not match InstanceData" );
+constexpr VertexStream INSTANCE_STREAM = MakeVertexStream( INSTANCE_ELEMENTS, sizeof( InstanceData ), true );
+
+// non-owning view over indexed triangle-list geometry
+struct Mesh {
+    const Vertex*   m_vertices = nullptr;
+    u32             m_vertexCount = 0;
+    const u32*      m_indices = nullptr;
+    u32             m_indexCount = 0;
+};
+
+// owning geometry, e.g. generated or loaded meshes
+struct MeshData {
+    std::vector< Vertex >   m_vertices;
+    std::vector< u32 >      m_indices;
+
+    Mesh GetMesh() const { return { m_vertices.data(), ( u32 )m_vertices.size(), m_indices.data(), ( u32 )m_indices.size() }; }
+};
+
+// the simulation advances in fixed steps of this many seconds, independent of the frame rate
+constexpr f32 SIMULATION_STEP = 1.0f / 120.0f;
+
+struct Scene {
+    Matrix          m_objProjection = MatrixIdentity();
+    Matrix          m_objectTransform = MatrixIdentity();   // places the object before it spins, e.g. GetFitTransform
+    f32             m_angle = 0.0f;
+    f32             m_prevAngle = 0.0f;     // angle before the last step, for interpolation
+};
+
+// one cube of the field, gathered from its entity
+struct CubeInstance {
+    Float3  m_position;
+    Float3  m_axis;
+    f32     m_scale;
+    f32     m_angle;
+    f32     m_prevAngle;
+    f32     m_angularSpeed;     // radians per second
+    Float4  m_color;
+};
+
+// how GetCubeFieldConstants leaves out the cubes outside the view
+enum CubeFieldCulling {
+    CUBE_FIELD_CULL_NONE,
+    CUBE_FIELD_CULL_FRUSTUM,    // SIMD pass over the cubes' fixed bounding spheres
+    CUBE_FIELD_CULL_BVH,        // BVH over the spinning cubes' boxes, refit every frame
+};
+
+// the components of every cube in the field; its ECS_MESH_INDEX is 0, the cube mesh
+constexpr u32 CUBE_FIELD_COMPONENTS = ECS_TRANSFORM | ECS_SPIN | ECS_BOUNDS | ECS_MESH | ECS_MATERIAL;
+
+// N cubes on a jittered grid, each spinning about its own axis. cube i is
+// ordinal i of the CUBE_FIELD_COMPONENTS archetype in m_entities.
+struct CubeFieldScene {
+    EntityStore                 m_entities;
+    u32                         m_cubeCount = 0;
+    std::vector< InstanceData > m_instances;
+    Matrix                      m_viewProjection = MatrixIdentity();
+    Matrix                      m_view = MatrixIdentity();
+    Float3                      m_eye;
+    f32                         m_aspect = 1.0f;
+    f32                         m_extent = 1.0f;    // half size of the cube block plus a margin
+    u32                         m_instanceCount = 0;    // of m_instances to draw
+    CubeFieldCulling            m_culling = CUBE_FIELD_CULL_NONE;
+    CullingBounds               m_bounds;           // fixed, the cubes spin in place
+    FrustumCuller               m_culler;
+    Bvh                         m_bvh;              // for CUBE_FIELD_CULL_BVH and picking
+    std::vector< Aabb >         m_boxes;
+    std::vector< u32 >          m_visible;
+    // after m_culling, the cubes hidden behind the cubes nearest the camera are left out too
+    bool                        m_occlusionCulling = false;
+    HiZBuffer                   m_hiz;
+    std::vector< u32 >          m_occluders;        // chosen for m_occluderViewProjection
+    Matrix                      m_occluderViewProjection = MatrixIdentity();
+    CullingBounds               m_instanceBounds;   // boxes of this frame's instances
+    u32                         m_occludedCount = 0;    // in the last GetCubeFieldConstants
+};
+
+const Mesh& GetCubeMesh();
+
+// unit sphere of rings x segments quads, colored by its normal, with the
+// cube's clockwise winding. 256 x 512 gives a 262k triangle mesh.
+void GenerateSphereMesh( MeshData& mesh, u32 rings, u32 segments );
+
+// advances the animation by dt seconds
+void UpdateScene( Scene& scene, f32 dt );
+
+// constants for a frame alpha of the way from the previous to the current step
+ConstantBuffer GetSceneConstants( Scene& scene, f32 alpha );
+
+// one SIMULATION_STEP and the constants at its end, for loops that render
+// exactly once per step (headless runs, tests, benchmarks)
+ConstantBuffer Rotate( Scene& scene );
+
+// fills the scene with count cubes and a camera that sees all of them.
+// the layout only depends on count and seed.
+void GenerateCubeField( CubeFieldScene& scene, u32 count, f32 aspect, u32 seed = 1 );
+
+// rebuilds the camera projection for a new viewport aspect ratio
+void SetCubeFieldAspect( CubeFieldScene& scene, f32 aspect );
+
+// turns every entity with ECS_TRANSFORM and ECS_SPIN by dt seconds,
+// SIMD_WIDTH entities at a time, with chunks split over jobs when given
+void RotateSystem( EntityStore& entities, f32 dt, JobSystem* jobs = nullptr );
+
+// advances every cube by dt seconds, split over jobs when given
+void UpdateCubeField( CubeFieldScene& scene, f32 dt, JobSystem* jobs = nullptr );
+
+CubeInstance GetCube( const CubeFieldScene& scene, u32 cube );
+void SetCubeColor( CubeFieldScene& scene, u32 cube, const Float4& color );
+
+// rewrites m_instances at alpha between the previous and the current step and
+// returns the constants for the instanced draw. with m_culling or
+// m_occlusionCulling the first m_instanceCount instances are the visible
+// cubes in field order.
+ConstantBuffer GetCubeFieldConstants( CubeFieldScene& scene, f32 alpha, JobSystem* jobs = nullptr );
+
+// the cube under a point of the viewport in NDC, as it is after the last
+// step, or BVH_NONE. refits m_bvh to the cubes' current boxes.
+u32 PickCube( CubeFieldScene& scene, f32 ndcX, f32 ndcY, JobSystem* jobs = nullptr );
+
+// one SIMULATION_STEP, then GetCubeFieldConstants at its end
+ConstantBuffer AnimateCubeField( CubeFieldScene& scene );
@@ -0,0 +1,132 @@
+#include "shader_cache_d3d11.h"
+
+#include "profiler.h"
+
+#include <d3dcompiler.h>
+
+#include <cstdio>
+#include <cstring>
+
+static_assert( sizeof( ShaderDefine ) == sizeof( D3D_SHADER_MACRO ), "ShaderDefine mirrors D3D_SHADER_MACRO" );
+
+static const D3D_SHADER_MACRO perObjectDefines[] = { { "PER_OBJECT", "1" }, { nullptr, nullptr } };
+
+static const ShaderVariant shaderVariants[ SHADER_VARIANT_COUNT ] = {
+    { "VertexShader.hlsl", nullptr, "main", "vs_5_0" },
+    { "PixelShader.hlsl", nullptr, "main", "ps_5_0" },
+    { "InstancedVertexShader.hlsl", nullptr, "main", "vs_5_0" },
+    { "InstancedVertexShader.hlsl", perObjectDefines, "main", "vs_5_0" },
+};
+
+//
+const ShaderVariant& GetShaderVariant( ShaderVariantId id ) {
+    return shaderVariants[ id ];
+}
+
+//
+static bool ReadSource( const char* path, std::vector< char >& source ) {
+    FILE* file = fopen( path, "rb" );
+    if ( file == nullptr )
+        return false;
+    char buffer[ 4096 ];
+    size_t read;
+    source.clear();
+    while ( ( read = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+        source.insert( source.end(), buffer, buffer + read );
+    fclose( file );
+    return true;
+}
+
+//
+u32 D3D11ShaderCache::GetCompileFlags() {
+    u32 flags = 0;
+#ifdef _DEBUG
+    flags |= D3DCOMPILE_DEBUG;
+#endif
+    return flags;
+}
+
+//
+void D3D11ShaderCache::Open( const char* packPath ) {
+    PROFILE_ZONE( "OpenShaderPack" );
+    Close();
+    strncpy( m_packPath, packPath, sizeof( m_packPath ) - 1 );
+    m_pack.Open( packPath );
+}
+
+//
+void D3D11ShaderCache::Close() {
+    m_pack.Close();
+    m_compiled.clear();
+    m_hits = 0;
+}
+
+//
+HRESULT D3D11ShaderCache::GetBytecode( const char* file, const D3D_SHADER_MACRO* defines, const char* entry, const char* profile, ShaderBytecode& bytecode ) {
+    PROFILE_ZONE( "GetShaderBytecode" );
+
+    // only the main file is hashed, shaders that #include others must not change those alone
+    std::vector< char > source;
+    if ( !ReadSource( file, source ) )
+        return HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND );
+    const u32 flags = GetCompileFlags();
+    const u64 key = ShaderKey( source.data(), source.size(), ( const ShaderDefine* )defines, entry, profile, flags );
+
+    u32 size = 0;
+    if ( const u8* packed = m_pack.Find( key, &size ) ) {
+        ++m_hits;
+        bytecode.m_data = packed;
+        bytecode.m_size = size;
+        return S_OK;
+    }
+    for ( const CompiledShader& compiled : m_compiled ) {
+        if ( compiled.m_key == key ) {
+            bytecode.m_data = compiled.m_bytecode.data();
+            bytecode.m_size = compiled.m_bytecode.size();
+            return S_OK;
+        }
+    }
+
+    PROFILE_ZONE( "D3DCompile" );
+    ID3DBlob* blob = nullptr;
+    ID3DBlob* errors = nullptr;
+    HRESULT result = D3DCompile( source.data(), source.size(), file, defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        entry, profile, flags, 0, &blob, &errors );
+    if ( errors != nullptr ) {
+        OutputDebugStringA( ( const char* )errors->GetBufferPointer() );
+        errors->Release();
+    }
+    if ( FAILED( result ) )
+        return result;
+
+    const u8* data = ( const u8* )blob->GetBufferPointer();
+    m_compiled.push_back( { key, std::vector< u8 >( data, data + blob->GetBufferSize() ) } );
+    blob->Release();
+    bytecode.m_data = m_compiled.back().m_bytecode.data();
+    bytecode.m_size = m_compiled.back().m_bytecode.size();
+    return S_OK;
+}
+
+//
+HRESULT D3D11ShaderCache::GetBytecode( ShaderVariantId id, ShaderBytecode& bytecode ) {
+    const ShaderVariant& variant = GetShaderVariant( id );
+    return GetBytecode( variant.m_file, variant.m_defines, variant.m_entry, variant.m_profile, bytecode );
+}
+
+//
+bool D3D11ShaderCache::Save() {
+    if ( m_compiled.empty() || m_packPath[ 0 ] == '\0' )
+        return true;
+
+    ShaderPackWriter writer;
+    for ( const CompiledShader& compiled : m_compiled )
+        writer.Add( compiled.m_key, compiled.m_bytecode.data(), ( u32 )compiled.m_bytecode.size() );
+    writer.Merge( m_pack );
+
+    // the mapping has to go before the file can be replaced
+    m_pack.Close();
+    m_compiled.clear();
+    const bool written = writer.Write( m_packPath );
+    m_pack.Open( m_packPath );
+    return written;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "shader_pack.h"
+
+#include <d3d11.h>
+
+#include <vector>
+
+// compiled shader bytecode, valid until the cache is closed
+struct ShaderBytecode {
+    const void* m_data = nullptr;
+    size_t      m_size = 0;
+};
+
+// the variants the D3D11 backend compiles, in one table so the offline pack
+// build and the runtime agree on them
+enum ShaderVariantId : u32 {
+    SHADER_VERTEX,
+    SHADER_PIXEL,
+    SHADER_INSTANCED_VERTEX,
+    SHADER_PER_OBJECT_VERTEX,       // InstancedVertexShader.hlsl with PER_OBJECT
+    SHADER_VARIANT_COUNT
+};
+
+struct ShaderVariant {
+    const char*                 m_file;
+    const D3D_SHADER_MACRO*     m_defines;
+    const char*                 m_entry;
+    const char*                 m_profile;
+};
+
+const ShaderVariant& GetShaderVariant( ShaderVariantId id );
+
+// runtime side of the shader pack. variants are looked up in the mapped pack
+// by ShaderKey of their source, defines, profile and flags; misses are
+// compiled with D3DCompile and written back by Save, so the next start finds
+// them. build_shader_pack fills the pack offline with the variants the
+// backend uses, which leaves only reading the sources to hash them at startup.
+class D3D11ShaderCache {
+public:
+    // a missing or stale pack only means more compiles
+    void Open( const char* packPath );
+    void Close();
+
+    // files are relative to the working directory. the bytecode stays valid until Save or Close.
+    HRESULT GetBytecode( const char* file, const D3D_SHADER_MACRO* defines, const char* entry, const char* profile, ShaderBytecode& bytecode );
+    HRESULT GetBytecode( ShaderVariantId id, ShaderBytecode& bytecode );
+
+    // rewrites the pack with the compiled variants added, nothing happens without misses
+    bool Save();
+
+    u32 GetHitCount() const { return m_hits; }
+    u32 GetMissCount() const { return ( u32 )m_compiled.size(); }
+
+    // compile flags of the running build, part of every key
+    static u32 GetCompileFlags();
+
+private:
+    struct CompiledShader {
+        u64                 m_key;
+        std::vector< u8 >   m_bytecode;
+    };
+
+    char                            m_packPath[ 260 ] = {};
+    ShaderPack                      m_pack;
+    std::vector< CompiledShader >   m_compiled;
+    u32                             m_hits = 0;
+};
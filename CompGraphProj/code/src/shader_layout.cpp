@@ -0,0 +1,78 @@
+#include "shader_layout.h"
+
+#include "hash.h"
+
+#include <cstring>
+
+//
+const ShaderConstantBuffer* ShaderReflection::FindConstantBuffer( const char* name ) const {
+    for ( const ShaderConstantBuffer& buffer : m_constantBuffers ) {
+        if ( buffer.m_name == name )
+            return &buffer;
+    }
+    return nullptr;
+}
+
+//
+bool ResolveInputLayout( const ShaderReflection& shader, const VertexStream* streams, u32 streamCount, std::vector< InputLayoutElement >& layout ) {
+    layout.clear();
+    for ( const ShaderInput& input : shader.m_inputs ) {
+        if ( input.m_systemValue )
+            continue;
+
+        bool found = false;
+        for ( u32 slot = 0; slot < streamCount && !found; ++slot ) {
+            const VertexStream& stream = streams[ slot ];
+            for ( u32 i = 0; i < stream.m_elementCount && !found; ++i ) {
+                const VertexElement& element = stream.m_elements[ i ];
+                if ( element.m_semanticIndex != input.m_semanticIndex || !SemanticsEqual( element.m_semantic, input.m_semantic.c_str() ) )
+                    continue;
+                layout.push_back( { element.m_semantic, element.m_semanticIndex, element.m_format, slot, element.m_offset, stream.m_perInstance } );
+                found = true;
+            }
+        }
+        if ( !found )
+            return false;
+    }
+    return true;
+}
+
+//
+u64 InputLayoutKey( const ShaderReflection& shader, const VertexStream* streams, u32 streamCount ) {
+    u64 hash = HASH_SEED;
+    for ( const ShaderInput& input : shader.m_inputs ) {
+        hash = HashString( hash, input.m_semantic.c_str() );
+        hash = HashU32( hash, input.m_semanticIndex );
+        hash = HashU32( hash, input.m_systemValue ? 1 : 0 );
+    }
+    for ( u32 slot = 0; slot < streamCount; ++slot ) {
+        const VertexStream& stream = streams[ slot ];
+        hash = HashU32( hash, stream.m_stride );
+        hash = HashU32( hash, stream.m_perInstance ? 1 : 0 );
+        for ( u32 i = 0; i < stream.m_elementCount; ++i ) {
+            const VertexElement& element = stream.m_elements[ i ];
+            hash = HashString( hash, element.m_semantic );
+            hash = HashU32( hash, element.m_semanticIndex );
+            hash = HashU32( hash, element.m_format );
+            hash = HashU32( hash, element.m_offset );
+        }
+    }
+    return hash;
+}
+
+//
+bool MatchConstantBuffer( const ShaderConstantBuffer& shader, const CBufferField* fields, u32 fieldCount, u32 size ) {
+    // the constant buffer is bound in whole 16-byte registers
+    if ( shader.m_size > ( ( size + 15 ) & ~15u ) )
+        return false;
+    for ( const ShaderVariable& variable : shader.m_variables ) {
+        const CBufferField* field = nullptr;
+        for ( u32 i = 0; i < fieldCount && field == nullptr; ++i ) {
+            if ( variable.m_name == fields[ i ].m_name )
+                field = &fields[ i ];
+        }
+        if ( field == nullptr || field->m_offset != variable.m_offset || field->m_size != variable.m_size )
+            return false;
+    }
+    return true;
+}
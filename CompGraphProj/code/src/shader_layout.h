@@ -0,0 +1,171 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// C++ side of the shader interface. vertex and constant buffer structs
+// describe their members once with VERTEX_ELEMENT / CBUFFER_FIELD; the
+// descriptors are checked against the struct at compile time and against the
+// reflected shader at load time, and input layouts are derived from them.
+
+enum VertexElementFormat : u32 {
+    VERTEX_FORMAT_FLOAT2,
+    VERTEX_FORMAT_FLOAT3,
+    VERTEX_FORMAT_FLOAT4,
+    VERTEX_FORMAT_HALF4,
+    VERTEX_FORMAT_SNORM16X4,
+    VERTEX_FORMAT_UNORM8X4,
+    VERTEX_FORMAT_SNORM16X2,
+    VERTEX_FORMAT_COUNT
+};
+
+constexpr u32 VertexFormatSize( VertexElementFormat format ) {
+    switch ( format ) {
+    case VERTEX_FORMAT_FLOAT2: return 8;
+    case VERTEX_FORMAT_FLOAT3: return 12;
+    case VERTEX_FORMAT_FLOAT4: return 16;
+    case VERTEX_FORMAT_HALF4: return 8;
+    case VERTEX_FORMAT_SNORM16X4: return 8;
+    case VERTEX_FORMAT_UNORM8X4: return 4;
+    case VERTEX_FORMAT_SNORM16X2: return 4;
+    default: return 0;
+    }
+}
+
+struct VertexElement {
+    const char*         m_semantic;
+    u32                 m_semanticIndex;
+    VertexElementFormat m_format;
+    u32                 m_offset;
+    u32                 m_memberSize;       // bytes of the member from m_offset on
+    bool                m_wholeMember;      // the element must cover the member exactly
+};
+
+// element read from a whole member
+#define VERTEX_ELEMENT( Struct, member, semantic, index, format ) \
+    VertexElement{ semantic, index, format, ( u32 )offsetof( Struct, member ), ( u32 )sizeof( Struct::member ), true }
+
+// element read from row row of a matrix member
+#define VERTEX_ELEMENT_ROW( Struct, member, row, semantic, index, format )                                  \
+    VertexElement{ semantic, index, format, ( u32 )offsetof( Struct, member ) + ( row ) * VertexFormatSize( format ), \
+                   ( u32 )sizeof( Struct::member ) - ( row ) * VertexFormatSize( format ), false }
+
+// one vertex buffer slot
+struct VertexStream {
+    const VertexElement*    m_elements;
+    u32                     m_elementCount;
+    u32                     m_stride;
+    bool                    m_perInstance;
+};
+
+template< u32 Count >
+constexpr VertexStream MakeVertexStream( const VertexElement ( &elements )[ Count ], u32 stride, bool perInstance ) {
+    return { elements, Count, stride, perInstance };
+}
+
+constexpr bool SemanticsEqual( const char* a, const char* b ) {
+    for ( ; *a != '\0' && *b != '\0'; ++a, ++b ) {
+        const char ca = *a >= 'a' && *a <= 'z' ? ( char )( *a - 32 ) : *a;
+        const char cb = *b >= 'a' && *b <= 'z' ? ( char )( *b - 32 ) : *b;
+        if ( ca != cb )
+            return false;
+    }
+    return *a == *b;
+}
+
+// every element matches its member's size, lies inside the stride, overlaps
+// no other element and has a semantic of its own. for static_assert.
+template< u32 Count >
+constexpr bool IsValidVertexLayout( const VertexElement ( &elements )[ Count ], u32 stride ) {
+    for ( u32 i = 0; i < Count; ++i ) {
+        const VertexElement& e = elements[ i ];
+        const u32 size = VertexFormatSize( e.m_format );
+        if ( size == 0 || ( e.m_wholeMember ? size != e.m_memberSize : size > e.m_memberSize ) )
+            return false;
+        if ( e.m_offset + size > stride )
+            return false;
+        for ( u32 j = 0; j < i; ++j ) {
+            const VertexElement& other = elements[ j ];
+            if ( e.m_offset < other.m_offset + VertexFormatSize( other.m_format ) && other.m_offset < e.m_offset + size )
+                return false;
+            if ( e.m_semanticIndex == other.m_semanticIndex && SemanticsEqual( e.m_semantic, other.m_semantic ) )
+                return false;
+        }
+    }
+    return true;
+}
+
+struct CBufferField {
+    const char* m_name;         // variable name in the HLSL cbuffer
+    u32         m_offset;
+    u32         m_size;
+};
+
+#define CBUFFER_FIELD( Struct, member, name ) \
+    CBufferField{ name, ( u32 )offsetof( Struct, member ), ( u32 )sizeof( Struct::member ) }
+
+// fields are in order, do not overlap, fit the struct and follow HLSL packing:
+// a field never straddles a 16-byte register unless it starts on one. for static_assert.
+template< u32 Count >
+constexpr bool IsValidCBufferLayout( const CBufferField ( &fields )[ Count ], u32 size ) {
+    u32 end = 0;
+    for ( u32 i = 0; i < Count; ++i ) {
+        const CBufferField& f = fields[ i ];
+        if ( f.m_size == 0 || f.m_offset < end || f.m_offset + f.m_size > size )
+            return false;
+        if ( f.m_offset % 16 != 0 && f.m_offset / 16 != ( f.m_offset + f.m_size - 1 ) / 16 )
+            return false;
+        end = f.m_offset + f.m_size;
+    }
+    return true;
+}
+
+// what the shader reflection reports, without D3D types
+struct ShaderInput {
+    std::string m_semantic;
+    u32         m_semanticIndex = 0;
+    bool        m_systemValue = false;      // SV_ inputs are not fed from vertex buffers
+};
+
+struct ShaderVariable {
+    std::string m_name;
+    u32         m_offset = 0;
+    u32         m_size = 0;
+};
+
+struct ShaderConstantBuffer {
+    std::string                     m_name;
+    u32                             m_slot = 0;     // register( bN )
+    u32                             m_size = 0;
+    std::vector< ShaderVariable >   m_variables;
+};
+
+struct ShaderReflection {
+    std::vector< ShaderInput >          m_inputs;
+    std::vector< ShaderConstantBuffer > m_constantBuffers;
+
+    const ShaderConstantBuffer* FindConstantBuffer( const char* name ) const;
+};
+
+struct InputLayoutElement {
+    const char*         m_semantic;
+    u32                 m_semanticIndex;
+    VertexElementFormat m_format;
+    u32                 m_slot;
+    u32                 m_offset;
+    bool                m_perInstance;
+};
+
+// one element per input the shader reads, from the stream (slot) that declares
+// its semantic. false if no stream has one of them.
+bool ResolveInputLayout( const ShaderReflection& shader, const VertexStream* streams, u32 streamCount, std::vector< InputLayoutElement >& layout );
+
+// identifies an input layout. shaders with the same input signature share it.
+u64 InputLayoutKey( const ShaderReflection& shader, const VertexStream* streams, u32 streamCount );
+
+// true if every variable of the shader's cbuffer is at the offset and size of
+// the field with its name, and the cbuffer fits in size bytes
+bool MatchConstantBuffer( const ShaderConstantBuffer& shader, const CBufferField* fields, u32 fieldCount, u32 size );
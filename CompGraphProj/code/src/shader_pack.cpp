@@ -0,0 +1,153 @@
+#include "shader_pack.h"
+
+#include "hash.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+//
+u64 ShaderKey( const void* source, size_t sourceSize, const ShaderDefine* defines, const char* entry, const char* profile, u32 flags ) {
+    u64 hash = HashBytes( HASH_SEED, source, sourceSize );
+    for ( const ShaderDefine* define = defines; define != nullptr && define->m_name != nullptr; ++define ) {
+        hash = HashString( hash, define->m_name );
+        hash = HashString( hash, define->m_value );
+    }
+    hash = HashString( hash, entry );
+    hash = HashString( hash, profile );
+    return HashU32( hash, flags );
+}
+
+//
+bool ShaderPack::Open( const char* path ) {
+    Close();
+    if ( !m_file.Open( path ) )
+        return false;
+    if ( !OpenMemory( m_file.GetData(), m_file.GetSize() ) ) {
+        m_file.Close();
+        return false;
+    }
+    return true;
+}
+
+//
+bool ShaderPack::OpenMemory( const void* data, size_t size ) {
+    m_data = nullptr;
+    m_entries = nullptr;
+    m_entryCount = 0;
+    // the entry table is read in place
+    if ( size < sizeof( ShaderPackHeader ) || ( ( uintptr_t )data & ( alignof( ShaderPackEntry ) - 1 ) ) != 0 )
+        return false;
+
+    ShaderPackHeader header;
+    memcpy( &header, data, sizeof( header ) );
+    if ( header.m_magic != SHADER_PACK_MAGIC || header.m_version != SHADER_PACK_VERSION )
+        return false;
+    if ( header.m_entryCount > ( size - sizeof( header ) ) / sizeof( ShaderPackEntry ) )
+        return false;
+
+    // every blob inside the file and the keys strictly increasing, Find relies on both
+    const ShaderPackEntry* entries = ( const ShaderPackEntry* )( ( const u8* )data + sizeof( header ) );
+    for ( u32 i = 0; i < header.m_entryCount; ++i ) {
+        if ( entries[ i ].m_offset > size || entries[ i ].m_size > size - entries[ i ].m_offset )
+            return false;
+        if ( i > 0 && entries[ i - 1 ].m_key >= entries[ i ].m_key )
+            return false;
+    }
+
+    m_data = ( const u8* )data;
+    m_entries = entries;
+    m_entryCount = header.m_entryCount;
+    return true;
+}
+
+//
+void ShaderPack::Close() {
+    m_file.Close();
+    m_data = nullptr;
+    m_entries = nullptr;
+    m_entryCount = 0;
+}
+
+//
+const u8* ShaderPack::Find( u64 key, u32* size ) const {
+    const ShaderPackEntry* end = m_entries + m_entryCount;
+    const ShaderPackEntry* entry = std::lower_bound( m_entries, end, key,
+        []( const ShaderPackEntry& e, u64 k ) { return e.m_key < k; } );
+    if ( entry == end || entry->m_key != key )
+        return nullptr;
+    if ( size != nullptr )
+        *size = entry->m_size;
+    return m_data + entry->m_offset;
+}
+
+//
+void ShaderPackWriter::Add( u64 key, const void* data, u32 size ) {
+    for ( Blob& blob : m_blobs ) {
+        if ( blob.m_key == key ) {
+            blob.m_data.assign( ( const u8* )data, ( const u8* )data + size );
+            return;
+        }
+    }
+    m_blobs.push_back( { key, std::vector< u8 >( ( const u8* )data, ( const u8* )data + size ) } );
+}
+
+//
+void ShaderPackWriter::Merge( const ShaderPack& pack ) {
+    for ( u32 i = 0; i < pack.GetEntryCount(); ++i ) {
+        const ShaderPackEntry& entry = pack.GetEntry( i );
+        bool added = false;
+        for ( const Blob& blob : m_blobs )
+            added = added || blob.m_key == entry.m_key;
+        if ( !added )
+            m_blobs.push_back( { entry.m_key, std::vector< u8 >( pack.GetBlob( entry ), pack.GetBlob( entry ) + entry.m_size ) } );
+    }
+}
+
+//
+bool ShaderPackWriter::Write( const char* path ) const {
+    std::vector< const Blob* > sorted;
+    for ( const Blob& blob : m_blobs )
+        sorted.push_back( &blob );
+    std::sort( sorted.begin(), sorted.end(), []( const Blob* a, const Blob* b ) { return a->m_key < b->m_key; } );
+
+    ShaderPackHeader header = { SHADER_PACK_MAGIC, SHADER_PACK_VERSION, ( u32 )sorted.size(), 0 };
+    std::vector< ShaderPackEntry > entries( sorted.size() );
+    u64 offset = sizeof( header ) + sorted.size() * sizeof( ShaderPackEntry );
+    for ( size_t i = 0; i < sorted.size(); ++i ) {
+        offset = ( offset + SHADER_PACK_ALIGNMENT - 1 ) & ~( u64 )( SHADER_PACK_ALIGNMENT - 1 );
+        entries[ i ].m_key = sorted[ i ]->m_key;
+        entries[ i ].m_offset = ( u32 )offset;
+        entries[ i ].m_size = ( u32 )sorted[ i ]->m_data.size();
+        offset += entries[ i ].m_size;
+    }
+    if ( offset > 0xFFFFFFFFull )
+        return false;
+
+    const std::string tempPath = std::string( path ) + ".tmp";
+    FILE* file = fopen( tempPath.c_str(), "wb" );
+    if ( file == nullptr )
+        return false;
+    bool written = fwrite( &header, sizeof( header ), 1, file ) == 1;
+    if ( !entries.empty() )
+        written = written && fwrite( entries.data(), sizeof( ShaderPackEntry ), entries.size(), file ) == entries.size();
+    static const u8 padding[ SHADER_PACK_ALIGNMENT ] = {};
+    u64 position = sizeof( header ) + entries.size() * sizeof( ShaderPackEntry );
+    for ( size_t i = 0; i < sorted.size() && written; ++i ) {
+        const size_t pad = ( size_t )( entries[ i ].m_offset - position );
+        written = fwrite( padding, 1, pad, file ) == pad;
+        const std::vector< u8 >& data = sorted[ i ]->m_data;
+        written = written && ( data.empty() || fwrite( data.data(), 1, data.size(), file ) == data.size() );
+        position = entries[ i ].m_offset + data.size();
+    }
+    if ( fclose( file ) != 0 || !written ) {
+        remove( tempPath.c_str() );
+        return false;
+    }
+
+    // rename does not replace an existing file on Windows
+    remove( path );
+    return rename( tempPath.c_str(), path ) == 0;
+}
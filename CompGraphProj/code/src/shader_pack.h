@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <vector>
+
+// precompiled shader bytecode keyed by ShaderKey. the pack is one file:
+//
+//   ShaderPackHeader
+//   ShaderPackEntry[ m_entryCount ]    sorted by key
+//   bytecode blobs, SHADER_PACK_ALIGNMENT aligned
+//
+// all fields are little-endian. the format knows nothing about D3D, so packs
+// are built, read and tested on every platform.
+
+constexpr u32 SHADER_PACK_MAGIC = 0x50534743;   // "CGSP"
+constexpr u32 SHADER_PACK_VERSION = 1;
+constexpr u32 SHADER_PACK_ALIGNMENT = 16;
+
+struct ShaderPackHeader {
+    u32 m_magic;
+    u32 m_version;
+    u32 m_entryCount;
+    u32 m_reserved;
+};
+
+struct ShaderPackEntry {
+    u64 m_key;
+    u32 m_offset;       // bytes from the start of the file
+    u32 m_size;
+};
+
+static_assert( sizeof( ShaderPackHeader ) == 16 && sizeof( ShaderPackEntry ) == 16, "pack structs are written as is" );
+
+// a preprocessor define, same layout as D3D_SHADER_MACRO. lists end with { nullptr, nullptr }
+struct ShaderDefine {
+    const char* m_name;
+    const char* m_value;
+};
+
+// identifies one compiled variant: the source text, defines, entry point,
+// profile and compiler flags all change the key
+u64 ShaderKey( const void* source, size_t sourceSize, const ShaderDefine* defines, const char* entry, const char* profile, u32 flags );
+
+// read-only view of a pack, mapped with one call and never copied
+class ShaderPack {
+public:
+    // false if the file is missing or malformed, the pack is empty then
+    bool Open( const char* path );
+    // validates and uses memory the caller keeps alive, e.g. an embedded pack
+    bool OpenMemory( const void* data, size_t size );
+    void Close();
+
+    u32 GetEntryCount() const { return m_entryCount; }
+    const ShaderPackEntry& GetEntry( u32 index ) const { return m_entries[ index ]; }
+    const u8* GetBlob( const ShaderPackEntry& entry ) const { return m_data + entry.m_offset; }
+
+    // bytecode of the variant, nullptr if the pack does not have it
+    const u8* Find( u64 key, u32* size ) const;
+
+private:
+    MappedFile              m_file;
+    const u8*               m_data = nullptr;
+    const ShaderPackEntry*  m_entries = nullptr;
+    u32                     m_entryCount = 0;
+};
+
+// collects blobs and writes them as a pack
+class ShaderPackWriter {
+public:
+    // the blob is copied, a key added twice keeps the newest blob
+    void Add( u64 key, const void* data, u32 size );
+    // copies every entry of pack that was not added yet
+    void Merge( const ShaderPack& pack );
+
+    u32 GetEntryCount() const { return ( u32 )m_blobs.size(); }
+
+    // writes path.tmp and renames it over path, so readers never see half a pack.
+    // a pack mapped from path must be closed first.
+    bool Write( const char* path ) const;
+
+private:
+    struct Blob {
+        u64                 m_key;
+        std::vector< u8 >   m_data;
+    };
+    std::vector< Blob > m_blobs;
+};
@@ -0,0 +1,130 @@
+#include "shader_reflection_d3d11.h"
+
+#include <d3dcompiler.h>
+
+static const DXGI_FORMAT vertexFormats[] = {
+    DXGI_FORMAT_R32G32_FLOAT,           // VERTEX_FORMAT_FLOAT2
+    DXGI_FORMAT_R32G32B32_FLOAT,        // VERTEX_FORMAT_FLOAT3
+    DXGI_FORMAT_R32G32B32A32_FLOAT,     // VERTEX_FORMAT_FLOAT4
+    DXGI_FORMAT_R16G16B16A16_FLOAT,     // VERTEX_FORMAT_HALF4
+    DXGI_FORMAT_R16G16B16A16_SNORM,     // VERTEX_FORMAT_SNORM16X4
+    DXGI_FORMAT_R8G8B8A8_UNORM,         // VERTEX_FORMAT_UNORM8X4
+    DXGI_FORMAT_R16G16_SNORM,           // VERTEX_FORMAT_SNORM16X2
+};
+static_assert( ARRAYSIZE( vertexFormats ) == VERTEX_FORMAT_COUNT, "every vertex format needs a DXGI format" );
+
+//
+HRESULT ReflectShader( const ShaderBytecode& bytecode, ShaderReflection& reflection ) {
+    ID3D11ShaderReflection* reflector = nullptr;
+    HRESULT result = D3DReflect( bytecode.m_data, bytecode.m_size, __uuidof( ID3D11ShaderReflection ), ( void** )&reflector );
+    if ( FAILED( result ) )
+        return result;
+
+    D3D11_SHADER_DESC desc;
+    result = reflector->GetDesc( &desc );
+    if ( FAILED( result ) ) {
+        reflector->Release();
+        return result;
+    }
+
+    reflection.m_inputs.clear();
+    for ( u32 i = 0; i < desc.InputParameters; ++i ) {
+        D3D11_SIGNATURE_PARAMETER_DESC parameter;
+        if ( FAILED( reflector->GetInputParameterDesc( i, &parameter ) ) )
+            continue;
+        ShaderInput input;
+        input.m_semantic = parameter.SemanticName;
+        input.m_semanticIndex = parameter.SemanticIndex;
+        input.m_systemValue = parameter.SystemValueType != D3D_NAME_UNDEFINED;
+        reflection.m_inputs.push_back( input );
+    }
+
+    reflection.m_constantBuffers.clear();
+    for ( u32 i = 0; i < desc.ConstantBuffers; ++i ) {
+        ID3D11ShaderReflectionConstantBuffer* constantBuffer = reflector->GetConstantBufferByIndex( i );
+        D3D11_SHADER_BUFFER_DESC bufferDesc;
+        D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+        if ( FAILED( constantBuffer->GetDesc( &bufferDesc ) ) || bufferDesc.Type != D3D_CT_CBUFFER )
+            continue;
+        if ( FAILED( reflector->GetResourceBindingDescByName( bufferDesc.Name, &bindDesc ) ) )
+            continue;
+
+        ShaderConstantBuffer buffer;
+        buffer.m_name = bufferDesc.Name;
+        buffer.m_slot = bindDesc.BindPoint;
+        buffer.m_size = bufferDesc.Size;
+        for ( u32 v = 0; v < bufferDesc.Variables; ++v ) {
+            D3D11_SHADER_VARIABLE_DESC variableDesc;
+            if ( FAILED( constantBuffer->GetVariableByIndex( v )->GetDesc( &variableDesc ) ) )
+                continue;
+            ShaderVariable variable;
+            variable.m_name = variableDesc.Name;
+            variable.m_offset = variableDesc.StartOffset;
+            variable.m_size = variableDesc.Size;
+            buffer.m_variables.push_back( variable );
+        }
+        reflection.m_constantBuffers.push_back( buffer );
+    }
+
+    reflector->Release();
+    return S_OK;
+}
+
+//
+HRESULT GetConstantBufferSlot( const ShaderReflection& reflection, const char* name, const CBufferField* fields, u32 fieldCount, u32 size, u32& slot ) {
+    const ShaderConstantBuffer* buffer = reflection.FindConstantBuffer( name );
+    if ( buffer == nullptr || !MatchConstantBuffer( *buffer, fields, fieldCount, size ) ) {
+        OutputDebugStringA( "cbuffer layout does not match its C++ struct: " );
+        OutputDebugStringA( name );
+        OutputDebugStringA( "\n" );
+        return E_INVALIDARG;
+    }
+    slot = buffer->m_slot;
+    return S_OK;
+}
+
+//
+HRESULT D3D11InputLayoutCache::GetInputLayout( ID3D11Device* device, const ShaderBytecode& bytecode, const ShaderReflection& reflection,
+                                               const VertexStream* streams, u32 streamCount, ID3D11InputLayout** layout ) {
+    const u64 key = InputLayoutKey( reflection, streams, streamCount );
+    for ( const CachedLayout& cached : m_layouts ) {
+        if ( cached.m_key == key ) {
+            *layout = cached.m_layout;
+            return S_OK;
+        }
+    }
+
+    std::vector< InputLayoutElement > elements;
+    if ( !ResolveInputLayout( reflection, streams, streamCount, elements ) ) {
+        OutputDebugStringA( "shader reads a semantic no vertex stream provides\n" );
+        return E_INVALIDARG;
+    }
+
+    std::vector< D3D11_INPUT_ELEMENT_DESC > descs( elements.size() );
+    for ( size_t i = 0; i < elements.size(); ++i ) {
+        const InputLayoutElement& element = elements[ i ];
+        D3D11_INPUT_ELEMENT_DESC& desc = descs[ i ];
+        desc.SemanticName = element.m_semantic;
+        desc.SemanticIndex = element.m_semanticIndex;
+        desc.Format = vertexFormats[ element.m_format ];
+        desc.InputSlot = element.m_slot;
+        desc.AlignedByteOffset = element.m_offset;
+        desc.InputSlotClass = element.m_perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+        desc.InstanceDataStepRate = element.m_perInstance ? 1 : 0;
+    }
+
+    ID3D11InputLayout* created = nullptr;
+    const HRESULT result = device->CreateInputLayout( descs.data(), ( u32 )descs.size(), bytecode.m_data, bytecode.m_size, &created );
+    if ( FAILED( result ) )
+        return result;
+    m_layouts.push_back( { key, created } );
+    *layout = created;
+    return S_OK;
+}
+
+//
+void D3D11InputLayoutCache::Release() {
+    for ( CachedLayout& cached : m_layouts )
+        cached.m_layout->Release();
+    m_layouts.clear();
+}
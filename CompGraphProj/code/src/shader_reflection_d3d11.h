@@ -0,0 +1,33 @@
+#pragma once
+
+#include "shader_cache_d3d11.h"
+#include "shader_layout.h"
+
+#include <d3d11.h>
+
+#include <vector>
+
+// input signature and cbuffers of compiled bytecode, through D3DReflect
+HRESULT ReflectShader( const ShaderBytecode& bytecode, ShaderReflection& reflection );
+
+// register of the named cbuffer, after checking the shader's layout of it against fields
+HRESULT GetConstantBufferSlot( const ShaderReflection& reflection, const char* name, const CBufferField* fields, u32 fieldCount, u32 size, u32& slot );
+
+// input layouts derived from the shader's input signature and the streams'
+// element descriptors, created once per InputLayoutKey
+class D3D11InputLayoutCache {
+public:
+    // the cache keeps the reference, layout stays valid until Release
+    HRESULT GetInputLayout( ID3D11Device* device, const ShaderBytecode& bytecode, const ShaderReflection& reflection,
+                            const VertexStream* streams, u32 streamCount, ID3D11InputLayout** layout );
+    void Release();
+
+    u32 GetLayoutCount() const { return ( u32 )m_layouts.size(); }
+
+private:
+    struct CachedLayout {
+        u64                 m_key;
+        ID3D11InputLayout*  m_layout;
+    };
+    std::vector< CachedLayout > m_layouts;
+};
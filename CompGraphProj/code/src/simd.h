@@ -0,0 +1,281 @@
+#pragma once
+
+#include "types.h"
+
+// thin wrappers over the widest float/int vectors the target is compiled for.
+// code written against vf32/vi32 runs 8 lanes with AVX2, 4 lanes with SSE2
+// and falls back to plain 4-lane arrays everywhere else. defining
+// SIMD_FORCE_SCALAR selects the fallback on any target.
+
+#if defined( SIMD_FORCE_SCALAR )
+#define SIMD_SCALAR 1
+#define SIMD_WIDTH 4
+#include <cmath>
+#include <cstring>
+#elif defined( __AVX2__ )
+#define SIMD_AVX2 1
+#define SIMD_WIDTH 8
+#include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define SIMD_SSE2 1
+#define SIMD_WIDTH 4
+#if defined( __SSE4_1__ ) || defined( __AVX__ )
+#define SIMD_SSE41 1
+#include <smmintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+#else
+#define SIMD_SCALAR 1
+#define SIMD_WIDTH 4
+#include <cmath>
+#include <cstring>
+#endif
+
+#if defined( _MSC_VER )
+#define SIMD_INLINE __forceinline
+#else
+#define SIMD_INLINE inline __attribute__( ( always_inline ) )
+#endif
+
+#if defined( SIMD_AVX2 )
+
+struct vf32 { __m256 v; };
+struct vi32 { __m256i v; };
+
+SIMD_INLINE vf32 Splat( f32 f ) { return { _mm256_set1_ps( f ) }; }
+SIMD_INLINE vi32 Splat( i32 i ) { return { _mm256_set1_epi32( i ) }; }
+SIMD_INLINE vf32 Load( const f32* p ) { return { _mm256_loadu_ps( p ) }; }
+SIMD_INLINE vi32 Load( const i32* p ) { return { _mm256_loadu_si256( ( const __m256i* )p ) }; }
+SIMD_INLINE vi32 Load( const u32* p ) { return { _mm256_loadu_si256( ( const __m256i* )p ) }; }
+// SIMD_WIDTH 16-bit values, sign- or zero-extended to 32-bit lanes
+SIMD_INLINE vi32 LoadWiden( const i16* p ) { return { _mm256_cvtepi16_epi32( _mm_loadu_si128( ( const __m128i* )p ) ) }; }
+SIMD_INLINE vi32 LoadWiden( const u16* p ) { return { _mm256_cvtepu16_epi32( _mm_loadu_si128( ( const __m128i* )p ) ) }; }
+SIMD_INLINE void Store( f32* p, vf32 a ) { _mm256_storeu_ps( p, a.v ); }
+SIMD_INLINE void Store( i32* p, vi32 a ) { _mm256_storeu_si256( ( __m256i* )p, a.v ); }
+SIMD_INLINE void Store( u32* p, vi32 a ) { _mm256_storeu_si256( ( __m256i* )p, a.v ); }
+
+SIMD_INLINE vf32 operator+( vf32 a, vf32 b ) { return { _mm256_add_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator-( vf32 a, vf32 b ) { return { _mm256_sub_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator*( vf32 a, vf32 b ) { return { _mm256_mul_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator/( vf32 a, vf32 b ) { return { _mm256_div_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator&( vf32 a, vf32 b ) { return { _mm256_and_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator|( vf32 a, vf32 b ) { return { _mm256_or_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 Min( vf32 a, vf32 b ) { return { _mm256_min_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 Max( vf32 a, vf32 b ) { return { _mm256_max_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 Sqrt( vf32 a ) { return { _mm256_sqrt_ps( a.v ) }; }
+SIMD_INLINE vf32 CmpGe( vf32 a, vf32 b ) { return { _mm256_cmp_ps( a.v, b.v, _CMP_GE_OQ ) }; }
+SIMD_INLINE vf32 CmpGt( vf32 a, vf32 b ) { return { _mm256_cmp_ps( a.v, b.v, _CMP_GT_OQ ) }; }
+SIMD_INLINE vf32 CmpLe( vf32 a, vf32 b ) { return { _mm256_cmp_ps( a.v, b.v, _CMP_LE_OQ ) }; }
+SIMD_INLINE vf32 CmpLt( vf32 a, vf32 b ) { return { _mm256_cmp_ps( a.v, b.v, _CMP_LT_OQ ) }; }
+SIMD_INLINE vf32 Select( vf32 mask, vf32 a, vf32 b ) { return { _mm256_blendv_ps( b.v, a.v, mask.v ) }; }
+SIMD_INLINE u32 MoveMask( vf32 a ) { return ( u32 )_mm256_movemask_ps( a.v ); }
+
+SIMD_INLINE vi32 operator+( vi32 a, vi32 b ) { return { _mm256_add_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator-( vi32 a, vi32 b ) { return { _mm256_sub_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator*( vi32 a, vi32 b ) { return { _mm256_mullo_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator&( vi32 a, vi32 b ) { return { _mm256_and_si256( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator|( vi32 a, vi32 b ) { return { _mm256_or_si256( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator^( vi32 a, vi32 b ) { return { _mm256_xor_si256( a.v, b.v ) }; }
+template< i32 N > SIMD_INLINE vi32 ShiftLeft( vi32 a ) { return { _mm256_slli_epi32( a.v, N ) }; }
+template< i32 N > SIMD_INLINE vi32 ShiftRightLogical( vi32 a ) { return { _mm256_srli_epi32( a.v, N ) }; }
+SIMD_INLINE vi32 Min( vi32 a, vi32 b ) { return { _mm256_min_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 Max( vi32 a, vi32 b ) { return { _mm256_max_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 CmpEq( vi32 a, vi32 b ) { return { _mm256_cmpeq_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 CmpGt( vi32 a, vi32 b ) { return { _mm256_cmpgt_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 Select( vi32 mask, vi32 a, vi32 b ) { return { _mm256_blendv_epi8( b.v, a.v, mask.v ) }; }
+SIMD_INLINE u32 MoveMask( vi32 a ) { return ( u32 )_mm256_movemask_ps( _mm256_castsi256_ps( a.v ) ); }
+
+SIMD_INLINE vf32 ToFloat( vi32 a ) { return { _mm256_cvtepi32_ps( a.v ) }; }
+SIMD_INLINE vi32 TruncToInt( vf32 a ) { return { _mm256_cvttps_epi32( a.v ) }; }
+SIMD_INLINE vf32 AsFloat( vi32 a ) { return { _mm256_castsi256_ps( a.v ) }; }
+SIMD_INLINE vi32 AsInt( vf32 a ) { return { _mm256_castps_si256( a.v ) }; }
+
+SIMD_INLINE vi32 LaneIndex() { return { _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) }; }
+
+#elif defined( SIMD_SSE2 )
+
+struct vf32 { __m128 v; };
+struct vi32 { __m128i v; };
+
+SIMD_INLINE vf32 Splat( f32 f ) { return { _mm_set1_ps( f ) }; }
+SIMD_INLINE vi32 Splat( i32 i ) { return { _mm_set1_epi32( i ) }; }
+SIMD_INLINE vf32 Load( const f32* p ) { return { _mm_loadu_ps( p ) }; }
+SIMD_INLINE vi32 Load( const i32* p ) { return { _mm_loadu_si128( ( const __m128i* )p ) }; }
+SIMD_INLINE vi32 Load( const u32* p ) { return { _mm_loadu_si128( ( const __m128i* )p ) }; }
+#if defined( SIMD_SSE41 )
+SIMD_INLINE vi32 LoadWiden( const i16* p ) { return { _mm_cvtepi16_epi32( _mm_loadl_epi64( ( const __m128i* )p ) ) }; }
+SIMD_INLINE vi32 LoadWiden( const u16* p ) { return { _mm_cvtepu16_epi32( _mm_loadl_epi64( ( const __m128i* )p ) ) }; }
+#else
+// the halves land in the upper 16 bits of each lane, the arithmetic shift sign-extends them
+SIMD_INLINE vi32 LoadWiden( const i16* p ) { const __m128i h = _mm_loadl_epi64( ( const __m128i* )p ); return { _mm_srai_epi32( _mm_unpacklo_epi16( h, h ), 16 ) }; }
+SIMD_INLINE vi32 LoadWiden( const u16* p ) { return { _mm_unpacklo_epi16( _mm_loadl_epi64( ( const __m128i* )p ), _mm_setzero_si128() ) }; }
+#endif
+SIMD_INLINE void Store( f32* p, vf32 a ) { _mm_storeu_ps( p, a.v ); }
+SIMD_INLINE void Store( i32* p, vi32 a ) { _mm_storeu_si128( ( __m128i* )p, a.v ); }
+SIMD_INLINE void Store( u32* p, vi32 a ) { _mm_storeu_si128( ( __m128i* )p, a.v ); }
+
+SIMD_INLINE vf32 operator+( vf32 a, vf32 b ) { return { _mm_add_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator-( vf32 a, vf32 b ) { return { _mm_sub_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator*( vf32 a, vf32 b ) { return { _mm_mul_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator/( vf32 a, vf32 b ) { return { _mm_div_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator&( vf32 a, vf32 b ) { return { _mm_and_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 operator|( vf32 a, vf32 b ) { return { _mm_or_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 Min( vf32 a, vf32 b ) { return { _mm_min_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 Max( vf32 a, vf32 b ) { return { _mm_max_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 Sqrt( vf32 a ) { return { _mm_sqrt_ps( a.v ) }; }
+SIMD_INLINE vf32 CmpGe( vf32 a, vf32 b ) { return { _mm_cmpge_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 CmpGt( vf32 a, vf32 b ) { return { _mm_cmpgt_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 CmpLe( vf32 a, vf32 b ) { return { _mm_cmple_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 CmpLt( vf32 a, vf32 b ) { return { _mm_cmplt_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32 Select( vf32 mask, vf32 a, vf32 b ) { return { _mm_or_ps( _mm_and_ps( mask.v, a.v ), _mm_andnot_ps( mask.v, b.v ) ) }; }
+SIMD_INLINE u32 MoveMask( vf32 a ) { return ( u32 )_mm_movemask_ps( a.v ); }
+
+SIMD_INLINE vi32 operator+( vi32 a, vi32 b ) { return { _mm_add_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator-( vi32 a, vi32 b ) { return { _mm_sub_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator&( vi32 a, vi32 b ) { return { _mm_and_si128( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator|( vi32 a, vi32 b ) { return { _mm_or_si128( a.v, b.v ) }; }
+SIMD_INLINE vi32 operator^( vi32 a, vi32 b ) { return { _mm_xor_si128( a.v, b.v ) }; }
+template< i32 N > SIMD_INLINE vi32 ShiftLeft( vi32 a ) { return { _mm_slli_epi32( a.v, N ) }; }
+template< i32 N > SIMD_INLINE vi32 ShiftRightLogical( vi32 a ) { return { _mm_srli_epi32( a.v, N ) }; }
+SIMD_INLINE vi32 CmpEq( vi32 a, vi32 b ) { return { _mm_cmpeq_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 CmpGt( vi32 a, vi32 b ) { return { _mm_cmpgt_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 Select( vi32 mask, vi32 a, vi32 b ) { return { _mm_or_si128( _mm_and_si128( mask.v, a.v ), _mm_andnot_si128( mask.v, b.v ) ) }; }
+SIMD_INLINE u32 MoveMask( vi32 a ) { return ( u32 )_mm_movemask_ps( _mm_castsi128_ps( a.v ) ); }
+#if defined( SIMD_SSE41 )
+SIMD_INLINE vi32 operator*( vi32 a, vi32 b ) { return { _mm_mullo_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 Min( vi32 a, vi32 b ) { return { _mm_min_epi32( a.v, b.v ) }; }
+SIMD_INLINE vi32 Max( vi32 a, vi32 b ) { return { _mm_max_epi32( a.v, b.v ) }; }
+#else
+SIMD_INLINE vi32 operator*( vi32 a, vi32 b ) {
+    __m128i even = _mm_mul_epu32( a.v, b.v );
+    __m128i odd = _mm_mul_epu32( _mm_srli_epi64( a.v, 32 ), _mm_srli_epi64( b.v, 32 ) );
+    return { _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 ) ), _mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 ) ) ) };
+}
+SIMD_INLINE vi32 Min( vi32 a, vi32 b ) { return Select( CmpGt( a, b ), b, a ); }
+SIMD_INLINE vi32 Max( vi32 a, vi32 b ) { return Select( CmpGt( a, b ), a, b ); }
+#endif
+
+SIMD_INLINE vf32 ToFloat( vi32 a ) { return { _mm_cvtepi32_ps( a.v ) }; }
+SIMD_INLINE vi32 TruncToInt( vf32 a ) { return { _mm_cvttps_epi32( a.v ) }; }
+SIMD_INLINE vf32 AsFloat( vi32 a ) { return { _mm_castsi128_ps( a.v ) }; }
+SIMD_INLINE vi32 AsInt( vf32 a ) { return { _mm_castps_si128( a.v ) }; }
+
+SIMD_INLINE vi32 LaneIndex() { return { _mm_setr_epi32( 0, 1, 2, 3 ) }; }
+
+#else
+
+struct vf32 { f32 v[ SIMD_WIDTH ]; };
+struct vi32 { i32 v[ SIMD_WIDTH ]; };
+
+#define SIMD_LANES( expr ) for ( i32 l = 0; l < SIMD_WIDTH; ++l ) { expr; }
+
+SIMD_INLINE vf32 Splat( f32 f ) { vf32 r; SIMD_LANES( r.v[ l ] = f ) return r; }
+SIMD_INLINE vi32 Splat( i32 i ) { vi32 r; SIMD_LANES( r.v[ l ] = i ) return r; }
+SIMD_INLINE vf32 Load( const f32* p ) { vf32 r; memcpy( r.v, p, sizeof( r.v ) ); return r; }
+SIMD_INLINE vi32 Load( const i32* p ) { vi32 r; memcpy( r.v, p, sizeof( r.v ) ); return r; }
+SIMD_INLINE vi32 Load( const u32* p ) { vi32 r; memcpy( r.v, p, sizeof( r.v ) ); return r; }
+SIMD_INLINE vi32 LoadWiden( const i16* p ) { vi32 r; SIMD_LANES( r.v[ l ] = p[ l ] ) return r; }
+SIMD_INLINE vi32 LoadWiden( const u16* p ) { vi32 r; SIMD_LANES( r.v[ l ] = p[ l ] ) return r; }
+SIMD_INLINE void Store( f32* p, vf32 a ) { memcpy( p, a.v, sizeof( a.v ) ); }
+SIMD_INLINE void Store( i32* p, vi32 a ) { memcpy( p, a.v, sizeof( a.v ) ); }
+SIMD_INLINE void Store( u32* p, vi32 a ) { memcpy( p, a.v, sizeof( a.v ) ); }
+
+SIMD_INLINE i32 FloatBits( f32 f ) { i32 i; memcpy( &i, &f, sizeof( i ) ); return i; }
+SIMD_INLINE f32 BitsFloat( i32 i ) { f32 f; memcpy( &f, &i, sizeof( f ) ); return f; }
+
+SIMD_INLINE vf32 operator+( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] + b.v[ l ] ) return r; }
+SIMD_INLINE vf32 operator-( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] - b.v[ l ] ) return r; }
+SIMD_INLINE vf32 operator*( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] * b.v[ l ] ) return r; }
+SIMD_INLINE vf32 operator/( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] / b.v[ l ] ) return r; }
+SIMD_INLINE vf32 operator&( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = BitsFloat( FloatBits( a.v[ l ] ) & FloatBits( b.v[ l ] ) ) ) return r; }
+SIMD_INLINE vf32 operator|( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = BitsFloat( FloatBits( a.v[ l ] ) | FloatBits( b.v[ l ] ) ) ) return r; }
+SIMD_INLINE vf32 Min( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] < b.v[ l ] ? a.v[ l ] : b.v[ l ] ) return r; }
+SIMD_INLINE vf32 Max( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] > b.v[ l ] ? a.v[ l ] : b.v[ l ] ) return r; }
+SIMD_INLINE vf32 Sqrt( vf32 a ) { vf32 r; SIMD_LANES( r.v[ l ] = std::sqrt( a.v[ l ] ) ) return r; }
+SIMD_INLINE vf32 CmpGe( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = BitsFloat( a.v[ l ] >= b.v[ l ] ? -1 : 0 ) ) return r; }
+SIMD_INLINE vf32 CmpGt( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = BitsFloat( a.v[ l ] > b.v[ l ] ? -1 : 0 ) ) return r; }
+SIMD_INLINE vf32 CmpLe( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = BitsFloat( a.v[ l ] <= b.v[ l ] ? -1 : 0 ) ) return r; }
+SIMD_INLINE vf32 CmpLt( vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = BitsFloat( a.v[ l ] < b.v[ l ] ? -1 : 0 ) ) return r; }
+SIMD_INLINE vf32 Select( vf32 mask, vf32 a, vf32 b ) { vf32 r; SIMD_LANES( r.v[ l ] = FloatBits( mask.v[ l ] ) < 0 ? a.v[ l ] : b.v[ l ] ) return r; }
+SIMD_INLINE u32 MoveMask( vf32 a ) { u32 m = 0; SIMD_LANES( m |= ( FloatBits( a.v[ l ] ) < 0 ? 1u : 0u ) << l ) return m; }
+
+SIMD_INLINE vi32 operator+( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = ( i32 )( ( u32 )a.v[ l ] + ( u32 )b.v[ l ] ) ) return r; }
+SIMD_INLINE vi32 operator-( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = ( i32 )( ( u32 )a.v[ l ] - ( u32 )b.v[ l ] ) ) return r; }
+SIMD_INLINE vi32 operator*( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = ( i32 )( ( u32 )a.v[ l ] * ( u32 )b.v[ l ] ) ) return r; }
+SIMD_INLINE vi32 operator&( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] & b.v[ l ] ) return r; }
+SIMD_INLINE vi32 operator|( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] | b.v[ l ] ) return r; }
+SIMD_INLINE vi32 operator^( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] ^ b.v[ l ] ) return r; }
+template< i32 N > SIMD_INLINE vi32 ShiftLeft( vi32 a ) { vi32 r; SIMD_LANES( r.v[ l ] = ( i32 )( ( u32 )a.v[ l ] << N ) ) return r; }
+template< i32 N > SIMD_INLINE vi32 ShiftRightLogical( vi32 a ) { vi32 r; SIMD_LANES( r.v[ l ] = ( i32 )( ( u32 )a.v[ l ] >> N ) ) return r; }
+SIMD_INLINE vi32 Min( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] < b.v[ l ] ? a.v[ l ] : b.v[ l ] ) return r; }
+SIMD_INLINE vi32 Max( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] > b.v[ l ] ? a.v[ l ] : b.v[ l ] ) return r; }
+SIMD_INLINE vi32 CmpEq( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] == b.v[ l ] ? -1 : 0 ) return r; }
+SIMD_INLINE vi32 CmpGt( vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = a.v[ l ] > b.v[ l ] ? -1 : 0 ) return r; }
+SIMD_INLINE vi32 Select( vi32 mask, vi32 a, vi32 b ) { vi32 r; SIMD_LANES( r.v[ l ] = mask.v[ l ] < 0 ? a.v[ l ] : b.v[ l ] ) return r; }
+SIMD_INLINE u32 MoveMask( vi32 a ) { u32 m = 0; SIMD_LANES( m |= ( a.v[ l ] < 0 ? 1u : 0u ) << l ) return m; }
+
+SIMD_INLINE vf32 ToFloat( vi32 a ) { vf32 r; SIMD_LANES( r.v[ l ] = ( f32 )a.v[ l ] ) return r; }
+SIMD_INLINE vi32 TruncToInt( vf32 a ) { vi32 r; SIMD_LANES( r.v[ l ] = ( i32 )a.v[ l ] ) return r; }
+SIMD_INLINE vf32 AsFloat( vi32 a ) { vf32 r; memcpy( r.v, a.v, sizeof( r.v ) ); return r; }
+SIMD_INLINE vi32 AsInt( vf32 a ) { vi32 r; memcpy( r.v, a.v, sizeof( r.v ) ); return r; }
+
+SIMD_INLINE vi32 LaneIndex() { vi32 r; SIMD_LANES( r.v[ l ] = l ) return r; }
+
+#undef SIMD_LANES
+
+#endif
+
+SIMD_INLINE vf32 MulAdd( vf32 a, vf32 b, vf32 c ) { return a * b + c; }
+SIMD_INLINE vf32 Clamp( vf32 a, vf32 lo, vf32 hi ) { return Min( Max( a, lo ), hi ); }
+
+// fixed 4-lane floats for code that works on one xyzw value at a time, such
+// as a point, a matrix row or a quaternion, rather than on SIMD_WIDTH objects.
+// SSE with AVX2 or SSE2, plain arrays with the scalar fallback.
+
+#if defined( SIMD_AVX2 ) || defined( SIMD_SSE2 )
+
+struct vf32x4 { __m128 v; };
+
+SIMD_INLINE vf32x4 Splat4( f32 f ) { return { _mm_set1_ps( f ) }; }
+SIMD_INLINE vf32x4 Set4( f32 x, f32 y, f32 z, f32 w ) { return { _mm_setr_ps( x, y, z, w ) }; }
+SIMD_INLINE vf32x4 Load4( const f32* p ) { return { _mm_loadu_ps( p ) }; }
+SIMD_INLINE void Store( f32* p, vf32x4 a ) { _mm_storeu_ps( p, a.v ); }
+
+SIMD_INLINE vf32x4 operator+( vf32x4 a, vf32x4 b ) { return { _mm_add_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32x4 operator-( vf32x4 a, vf32x4 b ) { return { _mm_sub_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32x4 operator*( vf32x4 a, vf32x4 b ) { return { _mm_mul_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32x4 operator/( vf32x4 a, vf32x4 b ) { return { _mm_div_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32x4 Min( vf32x4 a, vf32x4 b ) { return { _mm_min_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32x4 Max( vf32x4 a, vf32x4 b ) { return { _mm_max_ps( a.v, b.v ) }; }
+SIMD_INLINE vf32x4 Sqrt( vf32x4 a ) { return { _mm_sqrt_ps( a.v ) }; }
+// lanes X, Y, Z, W of a, e.g. Swizzle< 1, 1, 1, 1 > repeats y
+template< i32 X, i32 Y, i32 Z, i32 W > SIMD_INLINE vf32x4 Swizzle( vf32x4 a ) { return { _mm_shuffle_ps( a.v, a.v, _MM_SHUFFLE( W, Z, Y, X ) ) }; }
+SIMD_INLINE f32 GetX( vf32x4 a ) { return _mm_cvtss_f32( a.v ); }
+
+#else
+
+struct vf32x4 { f32 v[ 4 ]; };
+
+#define SIMD_LANES4( expr ) for ( i32 l = 0; l < 4; ++l ) { expr; }
+
+SIMD_INLINE vf32x4 Splat4( f32 f ) { return { { f, f, f, f } }; }
+SIMD_INLINE vf32x4 Set4( f32 x, f32 y, f32 z, f32 w ) { return { { x, y, z, w } }; }
+SIMD_INLINE vf32x4 Load4( const f32* p ) { vf32x4 r; memcpy( r.v, p, sizeof( r.v ) ); return r; }
+SIMD_INLINE void Store( f32* p, vf32x4 a ) { memcpy( p, a.v, sizeof( a.v ) ); }
+
+SIMD_INLINE vf32x4 operator+( vf32x4 a, vf32x4 b ) { vf32x4 r; SIMD_LANES4( r.v[ l ] = a.v[ l ] + b.v[ l ] ) return r; }
+SIMD_INLINE vf32x4 operator-( vf32x4 a, vf32x4 b ) { vf32x4 r; SIMD_LANES4( r.v[ l ] = a.v[ l ] - b.v[ l ] ) return r; }
+SIMD_INLINE vf32x4 operator*( vf32x4 a, vf32x4 b ) { vf32x4 r; SIMD_LANES4( r.v[ l ] = a.v[ l ] * b.v[ l ] ) return r; }
+SIMD_INLINE vf32x4 operator/( vf32x4 a, vf32x4 b ) { vf32x4 r; SIMD_LANES4( r.v[ l ] = a.v[ l ] / b.v[ l ] ) return r; }
+SIMD_INLINE vf32x4 Min( vf32x4 a, vf32x4 b ) { vf32x4 r; SIMD_LANES4( r.v[ l ] = a.v[ l ] < b.v[ l ] ? a.v[ l ] : b.v[ l ] ) return r; }
+SIMD_INLINE vf32x4 Max( vf32x4 a, vf32x4 b ) { vf32x4 r; SIMD_LANES4( r.v[ l ] = a.v[ l ] > b.v[ l ] ? a.v[ l ] : b.v[ l ] ) return r; }
+SIMD_INLINE vf32x4 Sqrt( vf32x4 a ) { vf32x4 r; SIMD_LANES4( r.v[ l ] = std::sqrt( a.v[ l ] ) ) return r; }
+template< i32 X, i32 Y, i32 Z, i32 W > SIMD_INLINE vf32x4 Swizzle( vf32x4 a ) { return { { a.v[ X ], a.v[ Y ], a.v[ Z ], a.v[ W ] } }; }
+SIMD_INLINE f32 GetX( vf32x4 a ) { return a.v[ 0 ]; }
+
+#undef SIMD_LANES4
+
+#endif
+
+SIMD_INLINE vf32x4 MulAdd( vf32x4 a, vf32x4 b, vf32x4 c ) { return a * b + c; }
@@ -0,0 +1,124 @@
+#include "simd_math.h"
+
+#if defined( SIMD_AVX2 )
+// the 4x4 shuffles below work within each 128-bit half: points 0-3 go to the
+// low half and points 4-7 to the high half
+struct Points8 {
+    __m256 x, y, z;
+};
+
+// eight Float3s split into x, y and z
+static SIMD_INLINE Points8 LoadPoints8( const Float3* p ) {
+    const f32* f = &p[ 0 ].x;
+    const __m256 a = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( f + 0 ) ), _mm_loadu_ps( f + 12 ), 1 );
+    const __m256 b = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( f + 4 ) ), _mm_loadu_ps( f + 16 ), 1 );
+    const __m256 c = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( f + 8 ) ), _mm_loadu_ps( f + 20 ), 1 );
+    const __m256 xy23 = _mm256_shuffle_ps( b, c, _MM_SHUFFLE( 2, 1, 3, 2 ) );
+    const __m256 yz01 = _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 1, 0, 2, 1 ) );
+    Points8 points;
+    points.x = _mm256_shuffle_ps( a, xy23, _MM_SHUFFLE( 2, 0, 3, 0 ) );
+    points.y = _mm256_shuffle_ps( yz01, xy23, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+    points.z = _mm256_shuffle_ps( yz01, c, _MM_SHUFFLE( 3, 0, 3, 1 ) );
+    return points;
+}
+
+// every element of m in its own register, loaded before the loop so the
+// stores to out cannot force reloads
+static SIMD_INLINE void SplatMatrix( const Matrix& m, __m256 splat[ 16 ] ) {
+    for ( u32 i = 0; i < 16; ++i )
+        splat[ i ] = _mm256_set1_ps( ( &m.r[ 0 ].x )[ i ] );
+}
+
+// a * b + c as a separate multiply and add, which the build keeps unfused, so
+// the streams round like the single-value functions
+static SIMD_INLINE __m256 MulAdd8( __m256 a, __m256 b, __m256 c ) {
+    return _mm256_add_ps( _mm256_mul_ps( a, b ), c );
+}
+
+// one output column of eight points times m with w = 1, in Vec3Transform's order
+static SIMD_INLINE __m256 TransformColumn( const Points8& p, const __m256 m[ 16 ], u32 column ) {
+    const __m256 sum = MulAdd8( p.z, m[ 8 + column ], m[ 12 + column ] );
+    return MulAdd8( p.x, m[ column ], MulAdd8( p.y, m[ 4 + column ], sum ) );
+}
+#endif
+
+//
+void Vec3TransformStream( Float4* out, const Float3* points, u32 count, const Matrix& m ) {
+    u32 i = 0;
+#if defined( SIMD_AVX2 )
+    __m256 splat[ 16 ];
+    SplatMatrix( m, splat );
+    for ( ; i + 8 <= count; i += 8 ) {
+        const Points8 p = LoadPoints8( points + i );
+        const __m256 x = TransformColumn( p, splat, 0 ), y = TransformColumn( p, splat, 1 );
+        const __m256 z = TransformColumn( p, splat, 2 ), w = TransformColumn( p, splat, 3 );
+        const __m256 xy01 = _mm256_unpacklo_ps( x, y ), xy23 = _mm256_unpackhi_ps( x, y );
+        const __m256 zw01 = _mm256_unpacklo_ps( z, w ), zw23 = _mm256_unpackhi_ps( z, w );
+        const __m256 p0 = _mm256_shuffle_ps( xy01, zw01, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        const __m256 p1 = _mm256_shuffle_ps( xy01, zw01, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+        const __m256 p2 = _mm256_shuffle_ps( xy23, zw23, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        const __m256 p3 = _mm256_shuffle_ps( xy23, zw23, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+        _mm256_storeu_ps( &out[ i + 0 ].x, _mm256_permute2f128_ps( p0, p1, 0x20 ) );
+        _mm256_storeu_ps( &out[ i + 2 ].x, _mm256_permute2f128_ps( p2, p3, 0x20 ) );
+        _mm256_storeu_ps( &out[ i + 4 ].x, _mm256_permute2f128_ps( p0, p1, 0x31 ) );
+        _mm256_storeu_ps( &out[ i + 6 ].x, _mm256_permute2f128_ps( p2, p3, 0x31 ) );
+    }
+#endif
+    const Mat4 mat = LoadMatrix( m );
+    for ( ; i < count; ++i )
+        StoreFloat4( out[ i ], Vec3Transform( LoadFloat3( points[ i ] ), mat ) );
+}
+
+//
+void Vec3TransformCoordStream( Float3* out, const Float3* points, u32 count, const Matrix& m ) {
+    u32 i = 0;
+#if defined( SIMD_AVX2 )
+    __m256 splat[ 16 ];
+    SplatMatrix( m, splat );
+    for ( ; i + 8 <= count; i += 8 ) {
+        const Points8 p = LoadPoints8( points + i );
+        const __m256 w = TransformColumn( p, splat, 3 );
+        const __m256 x = _mm256_div_ps( TransformColumn( p, splat, 0 ), w );
+        const __m256 y = _mm256_div_ps( TransformColumn( p, splat, 1 ), w );
+        const __m256 z = _mm256_div_ps( TransformColumn( p, splat, 2 ), w );
+        // back to x y z x | y z x y | z x y z in each half
+        const __m256 xxyy = _mm256_shuffle_ps( x, y, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+        const __m256 zzxx = _mm256_shuffle_ps( z, x, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+        const __m256 yyzz = _mm256_shuffle_ps( y, z, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+        const __m256 a = _mm256_shuffle_ps( xxyy, zzxx, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+        const __m256 b = _mm256_shuffle_ps( yyzz, xxyy, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+        const __m256 c = _mm256_shuffle_ps( zzxx, yyzz, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+        f32* f = &out[ i ].x;
+        _mm256_storeu_ps( f + 0, _mm256_permute2f128_ps( a, b, 0x20 ) );
+        _mm256_storeu_ps( f + 8, _mm256_permute2f128_ps( c, a, 0x30 ) );
+        _mm256_storeu_ps( f + 16, _mm256_permute2f128_ps( b, c, 0x31 ) );
+    }
+#endif
+    const Mat4 mat = LoadMatrix( m );
+    for ( ; i < count; ++i )
+        StoreFloat3( out[ i ], Vec3TransformCoord( LoadFloat3( points[ i ] ), mat ) );
+}
+
+// with AVX2, rows 0-1 and rows 2-3 of a[ i ] are one register each, and the
+// in-lane permutes broadcast each row's elements within its half
+void Mat4MultiplyStream( Matrix* out, const Matrix* a, u32 count, const Matrix& b ) {
+#if defined( SIMD_AVX2 )
+    __m256 r[ 4 ];
+    for ( u32 row = 0; row < 4; ++row )
+        r[ row ] = _mm256_broadcast_ps( ( const __m128* )&b.r[ row ].x );
+    for ( u32 i = 0; i < count; ++i ) {
+        for ( u32 half = 0; half < 2; ++half ) {
+            const __m256 rows = _mm256_loadu_ps( &a[ i ].r[ half * 2 ].x );
+            const __m256 x = _mm256_mul_ps( _mm256_permute_ps( rows, _MM_SHUFFLE( 0, 0, 0, 0 ) ), r[ 0 ] );
+            const __m256 y = _mm256_mul_ps( _mm256_permute_ps( rows, _MM_SHUFFLE( 1, 1, 1, 1 ) ), r[ 1 ] );
+            const __m256 xz = MulAdd8( _mm256_permute_ps( rows, _MM_SHUFFLE( 2, 2, 2, 2 ) ), r[ 2 ], x );
+            const __m256 yw = MulAdd8( _mm256_permute_ps( rows, _MM_SHUFFLE( 3, 3, 3, 3 ) ), r[ 3 ], y );
+            _mm256_storeu_ps( &out[ i ].r[ half * 2 ].x, _mm256_add_ps( xz, yw ) );
+        }
+    }
+#else
+    const Mat4 mat = LoadMatrix( b );
+    for ( u32 i = 0; i < count; ++i )
+        StoreMatrix( out[ i ], Mat4Multiply( LoadMatrix( a[ i ] ), mat ) );
+#endif
+}
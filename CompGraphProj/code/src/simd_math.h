@@ -0,0 +1,257 @@
+#pragma once
+
+#include "simd.h"
+#include "types.h"
+#include "vecmath.h"
+
+#include <cmath>
+#include <limits>
+
+// register types for vector math on one value at a time, the counterpart of
+// XMVECTOR and XMMATRIX to vecmath.h's storage types. Float3, Float4 and
+// Matrix are loaded into Vec3, Vec4 and Mat4, worked on in SSE registers (or
+// the scalar fallback of simd.h) and stored back. conventions and names
+// follow DirectXMath: row vectors times row-major matrices, quaternions as
+// xyz + w, QuatMultiply( a, b ) rotates by a then b. every function adds and
+// rounds in the order of DirectXMath's SSE code, including the dpps dot
+// products it uses when AVX is on, so results match DirectXMath's SSE2 and
+// AVX builds bit for bit. they do not match its AVX2 builds, which fuse
+// multiply-adds, nor its no-intrinsics build, which sums left to right.
+// the scalar fallback gives the SSE2 results.
+
+// DirectXMath switches to dpps and roundps with AVX, not with SSE4.1 alone
+#if defined( SIMD_AVX2 ) || ( defined( SIMD_SSE41 ) && defined( __AVX__ ) )
+#define SIMD_MATH_DPPS 1
+#endif
+
+struct Vec3 { vf32x4 v; };      // w is 0 after a load and ignored otherwise
+struct Vec4 { vf32x4 v; };
+struct Quat { vf32x4 v; };
+struct Mat4 { vf32x4 r[ 4 ]; };
+
+SIMD_INLINE Vec3 LoadFloat3( const Float3& f ) { return { Set4( f.x, f.y, f.z, 0.0f ) }; }
+SIMD_INLINE Vec4 LoadFloat4( const Float4& f ) { return { Load4( &f.x ) }; }
+SIMD_INLINE Mat4 LoadMatrix( const Matrix& m ) { return { { Load4( &m.r[ 0 ].x ), Load4( &m.r[ 1 ].x ), Load4( &m.r[ 2 ].x ), Load4( &m.r[ 3 ].x ) } }; }
+
+//
+SIMD_INLINE void StoreFloat3( Float3& out, Vec3 v ) {
+    alignas( 16 ) f32 lanes[ 4 ];
+    Store( lanes, v.v );
+    out = Float3( lanes[ 0 ], lanes[ 1 ], lanes[ 2 ] );
+}
+
+SIMD_INLINE void StoreFloat4( Float4& out, Vec4 v ) { Store( &out.x, v.v ); }
+
+//
+SIMD_INLINE void StoreMatrix( Matrix& out, const Mat4& m ) {
+    for ( u32 i = 0; i < 4; ++i )
+        Store( &out.r[ i ].x, m.r[ i ] );
+}
+
+SIMD_INLINE Vec3 operator+( Vec3 a, Vec3 b ) { return { a.v + b.v }; }
+SIMD_INLINE Vec3 operator-( Vec3 a, Vec3 b ) { return { a.v - b.v }; }
+SIMD_INLINE Vec3 operator*( Vec3 a, Vec3 b ) { return { a.v * b.v }; }
+SIMD_INLINE Vec3 operator*( Vec3 a, f32 s ) { return { a.v * Splat4( s ) }; }
+SIMD_INLINE Vec4 operator+( Vec4 a, Vec4 b ) { return { a.v + b.v }; }
+SIMD_INLINE Vec4 operator-( Vec4 a, Vec4 b ) { return { a.v - b.v }; }
+SIMD_INLINE Vec4 operator*( Vec4 a, Vec4 b ) { return { a.v * b.v }; }
+SIMD_INLINE Vec4 operator*( Vec4 a, f32 s ) { return { a.v * Splat4( s ) }; }
+
+// v with its w lane replaced, like XMVectorSelect against a 1110 mask
+SIMD_INLINE vf32x4 WithW( vf32x4 v, f32 w ) {
+    alignas( 16 ) f32 lanes[ 4 ];
+    Store( lanes, v );
+    return Set4( lanes[ 0 ], lanes[ 1 ], lanes[ 2 ], w );
+}
+
+// the dot products in every lane. without dpps, ( x + y ) + z and
+// ( x + z ) + ( y + w ) as XMVector3Dot and XMVector4Dot add them
+SIMD_INLINE vf32x4 Vec3DotSplat( Vec3 a, Vec3 b ) {
+#if defined( SIMD_MATH_DPPS )
+    return { _mm_dp_ps( a.v.v, b.v.v, 0x7f ) };
+#else
+    const vf32x4 p = a.v * b.v;
+    return Splat4( ( GetX( p ) + GetX( Swizzle< 1, 1, 1, 1 >( p ) ) ) + GetX( Swizzle< 2, 2, 2, 2 >( p ) ) );
+#endif
+}
+
+//
+SIMD_INLINE vf32x4 Vec4DotSplat( Vec4 a, Vec4 b ) {
+#if defined( SIMD_MATH_DPPS )
+    return { _mm_dp_ps( a.v.v, b.v.v, 0xff ) };
+#else
+    const vf32x4 p = a.v * b.v;
+    const vf32x4 pairs = p + Swizzle< 2, 3, 0, 1 >( p );    // x + z, y + w
+    return Splat4( GetX( pairs ) + GetX( Swizzle< 1, 1, 1, 1 >( pairs ) ) );
+#endif
+}
+
+SIMD_INLINE f32 Vec3Dot( Vec3 a, Vec3 b ) { return GetX( Vec3DotSplat( a, b ) ); }
+SIMD_INLINE f32 Vec4Dot( Vec4 a, Vec4 b ) { return GetX( Vec4DotSplat( a, b ) ); }
+
+// XMVector3Length adds ( x + z ) + y without dpps, unlike XMVector3Dot
+SIMD_INLINE f32 Vec3Length( Vec3 v ) {
+#if defined( SIMD_MATH_DPPS )
+    return GetX( Sqrt( Vec3DotSplat( v, v ) ) );
+#else
+    const vf32x4 p = v.v * v.v;
+    return GetX( Sqrt( Splat4( ( GetX( p ) + GetX( Swizzle< 2, 2, 2, 2 >( p ) ) ) + GetX( Swizzle< 1, 1, 1, 1 >( p ) ) ) ) );
+#endif
+}
+
+// w is 0, as XMVector3Cross masks it
+SIMD_INLINE Vec3 Vec3Cross( Vec3 a, Vec3 b ) {
+    const vf32x4 left = Swizzle< 1, 2, 0, 3 >( a.v ) * Swizzle< 2, 0, 1, 3 >( b.v );
+    const vf32x4 right = Swizzle< 2, 0, 1, 3 >( a.v ) * Swizzle< 1, 2, 0, 3 >( b.v );
+    return { WithW( left - right, 0.0f ) };
+}
+
+// v divided by the square root of lengthSq, as XMVector3Normalize and
+// XMVector4Normalize finish: 0 for a zero length, NaN for an infinite one
+SIMD_INLINE vf32x4 DivideByLength( vf32x4 v, vf32x4 lengthSq ) {
+    if ( GetX( lengthSq ) == std::numeric_limits< f32 >::infinity() )
+        return Splat4( std::numeric_limits< f32 >::quiet_NaN() );
+    const vf32x4 length = Sqrt( lengthSq );
+    return GetX( length ) != 0.0f ? v / length : Splat4( 0.0f );
+}
+
+SIMD_INLINE Vec3 Vec3Normalize( Vec3 v ) { return { DivideByLength( v.v, Vec3DotSplat( v, v ) ) }; }
+
+// row vector times matrix, x * r0 + ( y * r1 + ( z * r2 + w * r3 ) )
+SIMD_INLINE Vec4 Vec4Transform( Vec4 v, const Mat4& m ) {
+    vf32x4 sum = Swizzle< 3, 3, 3, 3 >( v.v ) * m.r[ 3 ];
+    sum = MulAdd( Swizzle< 2, 2, 2, 2 >( v.v ), m.r[ 2 ], sum );
+    sum = MulAdd( Swizzle< 1, 1, 1, 1 >( v.v ), m.r[ 1 ], sum );
+    return { MulAdd( Swizzle< 0, 0, 0, 0 >( v.v ), m.r[ 0 ], sum ) };
+}
+
+// the point with w = 1 times the matrix
+SIMD_INLINE Vec4 Vec3Transform( Vec3 p, const Mat4& m ) {
+    vf32x4 sum = MulAdd( Swizzle< 2, 2, 2, 2 >( p.v ), m.r[ 2 ], m.r[ 3 ] );
+    sum = MulAdd( Swizzle< 1, 1, 1, 1 >( p.v ), m.r[ 1 ], sum );
+    return { MulAdd( Swizzle< 0, 0, 0, 0 >( p.v ), m.r[ 0 ], sum ) };
+}
+
+// Vec3Transform divided by w
+SIMD_INLINE Vec3 Vec3TransformCoord( Vec3 p, const Mat4& m ) {
+    const vf32x4 h = Vec3Transform( p, m ).v;
+    return { h / Swizzle< 3, 3, 3, 3 >( h ) };
+}
+
+// the direction times the upper 3x3
+SIMD_INLINE Vec3 Vec3TransformNormal( Vec3 n, const Mat4& m ) {
+    vf32x4 sum = Swizzle< 2, 2, 2, 2 >( n.v ) * m.r[ 2 ];
+    sum = MulAdd( Swizzle< 1, 1, 1, 1 >( n.v ), m.r[ 1 ], sum );
+    return { MulAdd( Swizzle< 0, 0, 0, 0 >( n.v ), m.r[ 0 ], sum ) };
+}
+
+SIMD_INLINE Mat4 Mat4Identity() { return { { Set4( 1.0f, 0.0f, 0.0f, 0.0f ), Set4( 0.0f, 1.0f, 0.0f, 0.0f ), Set4( 0.0f, 0.0f, 1.0f, 0.0f ), Set4( 0.0f, 0.0f, 0.0f, 1.0f ) } }; }
+
+// a * b, i.e. apply a first. each row of the result is
+// ( x * b0 + z * b2 ) + ( y * b1 + w * b3 ) for the row's x, y, z, w
+SIMD_INLINE Mat4 Mat4Multiply( const Mat4& a, const Mat4& b ) {
+    Mat4 m;
+    for ( u32 i = 0; i < 4; ++i ) {
+        const vf32x4 xz = MulAdd( Swizzle< 2, 2, 2, 2 >( a.r[ i ] ), b.r[ 2 ], Swizzle< 0, 0, 0, 0 >( a.r[ i ] ) * b.r[ 0 ] );
+        const vf32x4 yw = MulAdd( Swizzle< 3, 3, 3, 3 >( a.r[ i ] ), b.r[ 3 ], Swizzle< 1, 1, 1, 1 >( a.r[ i ] ) * b.r[ 1 ] );
+        m.r[ i ] = xz + yw;
+    }
+    return m;
+}
+
+//
+SIMD_INLINE Mat4 Mat4Transpose( const Mat4& m ) {
+#if defined( SIMD_AVX2 ) || defined( SIMD_SSE2 )
+    Mat4 t = m;
+    _MM_TRANSPOSE4_PS( t.r[ 0 ].v, t.r[ 1 ].v, t.r[ 2 ].v, t.r[ 3 ].v );
+    return t;
+#else
+    Mat4 t;
+    for ( u32 i = 0; i < 4; ++i )
+        t.r[ i ] = Set4( m.r[ 0 ].v[ i ], m.r[ 1 ].v[ i ], m.r[ 2 ].v[ i ], m.r[ 3 ].v[ i ] );
+    return t;
+#endif
+}
+
+SIMD_INLINE Quat QuatIdentity() { return { Set4( 0.0f, 0.0f, 0.0f, 1.0f ) }; }
+SIMD_INLINE Quat QuatConjugate( Quat q ) { return { q.v * Set4( -1.0f, -1.0f, -1.0f, 1.0f ) }; }
+
+// one lane of XMVectorSinCos. the polynomials are ScalarSinCos's, but the
+// angle is reduced with XMVectorModAngles, which rounds the quotient to
+// nearest even (with the 2^23 trick before AVX) instead of away from zero
+SIMD_INLINE void VectorSinCos( f32* outSin, f32* outCos, f32 value ) {
+    f32 quotient = value * MATH_1DIV2PI;
+#if defined( SIMD_MATH_DPPS )
+    quotient = std::nearbyint( quotient );
+#else
+    if ( std::fabs( quotient ) <= 8388608.0f ) {
+        const f32 magic = std::copysign( 8388608.0f, quotient );
+        quotient = ( quotient + magic ) - magic;
+    }
+#endif
+    f32 x = value - quotient * MATH_2PI;
+
+    // map x to [-pi/2,pi/2] with sin(x) unchanged
+    f32 sign = 1.0f;
+    if ( !( std::fabs( x ) <= MATH_PIDIV2 ) ) {
+        x = std::copysign( MATH_PI, x ) - x;
+        sign = -1.0f;
+    }
+
+    const f32 x2 = x * x;
+    *outSin = ( ( ( ( ( -2.3889859e-08f * x2 + 2.7525562e-06f ) * x2 - 0.00019840874f ) * x2 + 0.0083333310f ) * x2 - 0.16666667f ) * x2 + 1.0f ) * x;
+    *outCos = ( ( ( ( ( -2.6051615e-07f * x2 + 2.4760495e-05f ) * x2 - 0.0013888378f ) * x2 + 0.041666638f ) * x2 - 0.5f ) * x2 + 1.0f ) * sign;
+}
+
+// rotation by angle about a unit-length axis, ( axis, 1 ) * ( s, s, s, c )
+// of the half angle as in XMQuaternionRotationNormal
+SIMD_INLINE Quat QuatRotationNormal( Vec3 axis, f32 angle ) {
+    f32 s, c;
+    VectorSinCos( &s, &c, 0.5f * angle );
+    return { WithW( axis.v, 1.0f ) * Set4( s, s, s, c ) };
+}
+
+// rotation by a followed by b, the product b * a. the w and x terms and the
+// y and z terms are summed first, then added, as XMQuaternionMultiply does
+SIMD_INLINE Quat QuatMultiply( Quat a, Quat b ) {
+    const vf32x4 wx = MulAdd( Swizzle< 0, 0, 0, 0 >( b.v ) * Swizzle< 3, 2, 1, 0 >( a.v ), Set4( 1.0f, -1.0f, 1.0f, -1.0f ), Swizzle< 3, 3, 3, 3 >( b.v ) * a.v );
+    const vf32x4 y = ( Swizzle< 1, 1, 1, 1 >( b.v ) * Swizzle< 2, 3, 0, 1 >( a.v ) ) * Set4( 1.0f, 1.0f, -1.0f, -1.0f );
+    const vf32x4 yz = MulAdd( Swizzle< 2, 2, 2, 2 >( b.v ) * Swizzle< 1, 0, 3, 2 >( a.v ), Set4( -1.0f, 1.0f, 1.0f, -1.0f ), y );
+    return { wx + yz };
+}
+
+//
+SIMD_INLINE Quat QuatNormalize( Quat q ) { return { DivideByLength( q.v, Vec4DotSplat( Vec4{ q.v }, Vec4{ q.v } ) ) }; }
+
+// v rotated by the unit quaternion q, conjugate( q ) * v * q
+SIMD_INLINE Vec3 Vec3Rotate( Vec3 v, Quat q ) {
+    const Quat p = QuatMultiply( QuatConjugate( q ), Quat{ WithW( v.v, 0.0f ) } );
+    return { QuatMultiply( p, q ).v };
+}
+
+// the rotation matrix of a unit quaternion
+SIMD_INLINE Mat4 Mat4RotationQuat( Quat q ) {
+    alignas( 16 ) f32 c[ 4 ];
+    Store( c, q.v );
+    const f32 x = c[ 0 ], y = c[ 1 ], z = c[ 2 ], w = c[ 3 ];
+    const f32 xx = x * ( x + x ), yy = y * ( y + y ), zz = z * ( z + z );
+    const f32 xy = x * ( y + y ), xz = x * ( z + z ), yz = y * ( z + z );
+    const f32 wx = w * ( x + x ), wy = w * ( y + y ), wz = w * ( z + z );
+    Mat4 m;
+    m.r[ 0 ] = Set4( ( 1.0f - yy ) - zz, xy + wz, xz - wy, 0.0f );
+    m.r[ 1 ] = Set4( xy - wz, ( 1.0f - xx ) - zz, yz + wx, 0.0f );
+    m.r[ 2 ] = Set4( xz + wy, yz - wx, ( 1.0f - xx ) - yy, 0.0f );
+    m.r[ 3 ] = Set4( 0.0f, 0.0f, 0.0f, 1.0f );
+    return m;
+}
+
+// batches over arrays, out may not overlap the input. with AVX2 eight points
+// or two matrix rows go through one 8-wide operation, with the same bits as
+// the single-value functions.
+
+// out[ i ] = Vec3Transform( points[ i ], m )
+void Vec3TransformStream( Float4* out, const Float3* points, u32 count, const Matrix& m );
+// out[ i ] = Vec3TransformCoord( points[ i ], m )
+void Vec3TransformCoordStream( Float3* out, const Float3* points, u32 count, const Matrix& m );
+// out[ i ] = Mat4Multiply( a[ i ], b )
+void Mat4MultiplyStream( Matrix* out, const Matrix* a, u32 count, const Matrix& b );
@@ -0,0 +1,411 @@
+#include "tile_rasterizer.h"
+
+#include "job_system.h"
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+
+// screen positions are snapped to 1/16 pixel before edge setup. together with
+// the guard band this keeps per-pixel edge steps below 2^21, so the edge
+// values inside a partially covered 8x8 block always fit in 32 bits.
+constexpr i32 SUBPIXEL_BITS = 4;
+constexpr i32 SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+
+// triangles are clipped to |x|,|y| <= GUARD_BAND * w so snapped coordinates stay small
+constexpr f32 GUARD_BAND = 2.0f;
+
+// one input triangle can gain a vertex per clip plane
+constexpr u32 MAX_CLIP_VERTICES = 3 + 6;
+
+// binning work is split so every chunk has at least this many triangles
+constexpr u32 MIN_TRIANGLES_PER_CHUNK = 256;
+
+//
+void TileRasterizer::Resize( u32 width, u32 height ) {
+    m_width = width;
+    m_height = height;
+    // rows are padded so full-width block stores never touch the next row
+    m_pitch = ( width + BLOCK_SIZE - 1 ) & ~( BLOCK_SIZE - 1 );
+    m_tilesX = ( width + TILE_SIZE - 1 ) / TILE_SIZE;
+    m_tilesY = ( height + TILE_SIZE - 1 ) / TILE_SIZE;
+    m_chunks.clear();
+    m_chunkCount = 0;
+}
+
+//
+void TileRasterizer::BeginFrame( u32* color, u32 clearColor ) {
+    m_color = color;
+    m_clearColor = clearColor;
+    m_chunkCount = 0;
+}
+
+//
+void TileRasterizer::SubmitTriangles( const ClipStreams& clip, const Vertex* vertices, const u32* indices, u32 indexCount, JobSystem& jobs ) {
+    RasterDraw draw;
+    draw.m_clip = &clip;
+    draw.m_vertices = vertices;
+    draw.m_indices = indices;
+    draw.m_indexCount = indexCount;
+    SubmitTriangles( draw, jobs );
+}
+
+//
+u32 GetMaxInstanceCount( u32 instanceStride, u32 indexCount ) {
+    const u32 byVertices = ( ~0u - SIMD_WIDTH ) / std::max( instanceStride, 1u );
+    const u32 byTriangles = ( ~0u - MIN_TRIANGLES_PER_CHUNK ) / std::max( indexCount / 3, 1u );
+    return std::min( byVertices, byTriangles );
+}
+
+//
+void TileRasterizer::SubmitTriangles( const RasterDraw& draw, JobSystem& jobs ) {
+    const u32 triangleCount = draw.m_indexCount / 3 * draw.m_instanceCount;
+    if ( triangleCount == 0 )
+        return;
+
+    // a few chunks per thread keeps the workers busy when triangle costs vary
+    u32 chunkCount = std::min( jobs.GetThreadCount() * 4, ( triangleCount + MIN_TRIANGLES_PER_CHUNK - 1 ) / MIN_TRIANGLES_PER_CHUNK );
+    chunkCount = std::max( chunkCount, 1u );
+    const u32 trianglesPerChunk = ( triangleCount + chunkCount - 1 ) / chunkCount;
+
+    const u32 firstChunk = m_chunkCount;
+    m_chunkCount += chunkCount;
+    if ( m_chunks.size() < m_chunkCount )
+        m_chunks.resize( m_chunkCount );
+
+    const u32 tileCount = m_tilesX * m_tilesY;
+    jobs.ParallelFor( chunkCount, [ & ]( u32 chunkIndex ) {
+        PROFILE_ZONE( "BinChunk" );
+        BinChunk& chunk = m_chunks[ firstChunk + chunkIndex ];
+        chunk.m_triangles.clear();
+        chunk.m_tileBins.resize( tileCount );
+        for ( std::vector< u32 >& bin : chunk.m_tileBins )
+            bin.clear();
+
+        const u32 first = chunkIndex * trianglesPerChunk;
+        const u32 count = std::min( trianglesPerChunk, triangleCount - std::min( first, triangleCount ) );
+        BinTriangles( chunk, draw, first, count );
+    }, 1 );
+}
+
+//
+void TileRasterizer::EndFrame( JobSystem& jobs ) {
+    // one job per tile, tile costs vary too much to batch them
+    jobs.ParallelFor( m_tilesX * m_tilesY, [ this ]( u32 tileIndex ) {
+        PROFILE_ZONE( "RasterizeTile" );
+        RasterizeTile( tileIndex );
+    }, 1 );
+}
+
+// signed distance of a clip-space vertex to one of the clip planes, >= 0 is inside
+static f32 ClipDistance( const Float4& p, u32 plane ) {
+    switch ( plane ) {
+    case 0: return p.z;
+    case 1: return p.w - p.z;
+    case 2: return GUARD_BAND * p.w + p.x;
+    case 3: return GUARD_BAND * p.w - p.x;
+    case 4: return GUARD_BAND * p.w + p.y;
+    default: return GUARD_BAND * p.w - p.y;
+    }
+}
+
+// bit per clip plane the vertex is outside of
+static u32 ClipOutcode( const Float4& p ) {
+    u32 code = 0;
+    for ( u32 plane = 0; plane < 6; ++plane )
+        code |= ( ClipDistance( p, plane ) < 0.0f ? 1u : 0u ) << plane;
+    return code;
+}
+
+static ShadedVertex LerpVertex( const ShadedVertex& a, const ShadedVertex& b, f32 t ) {
+    auto lerp = [ t ]( const Float4& u, const Float4& v ) {
+        return Float4( u.x + ( v.x - u.x ) * t, u.y + ( v.y - u.y ) * t, u.z + ( v.z - u.z ) * t, u.w + ( v.w - u.w ) * t );
+    };
+    return { lerp( a.m_pos, b.m_pos ), lerp( a.m_color, b.m_color ) };
+}
+
+// Sutherland-Hodgman against the planes set in clipMask
+static u32 ClipPolygon( ShadedVertex* poly, u32 count, u32 clipMask ) {
+    ShadedVertex scratch[ MAX_CLIP_VERTICES ];
+    for ( u32 plane = 0; plane < 6 && count >= 3; ++plane ) {
+        if ( ( clipMask & ( 1u << plane ) ) == 0 )
+            continue;
+
+        u32 outCount = 0;
+        for ( u32 i = 0; i < count; ++i ) {
+            const ShadedVertex& a = poly[ i ];
+            const ShadedVertex& b = poly[ ( i + 1 ) % count ];
+            f32 da = ClipDistance( a.m_pos, plane );
+            f32 db = ClipDistance( b.m_pos, plane );
+            if ( da >= 0.0f )
+                scratch[ outCount++ ] = a;
+            if ( ( da >= 0.0f ) != ( db >= 0.0f ) )
+                scratch[ outCount++ ] = LerpVertex( a, b, da / ( da - db ) );
+        }
+        count = outCount;
+        std::copy( scratch, scratch + count, poly );
+    }
+    return count;
+}
+
+//
+void TileRasterizer::BinTriangles( BinChunk& chunk, const RasterDraw& draw, u32 firstTriangle, u32 triangleCount ) {
+    const ClipStreams& clip = *draw.m_clip;
+    const u32 trianglesPerInstance = draw.m_indexCount / 3;
+
+    // triangles are numbered instance by instance, so the submission order matches D3D11
+    u32 instance = firstTriangle / trianglesPerInstance;
+    u32 local = firstTriangle % trianglesPerInstance;
+    Float4 tint( 1.0f, 1.0f, 1.0f, 1.0f );
+    auto fetch = [ & ]( u32 index ) -> ShadedVertex {
+        const u32 c = instance * draw.m_instanceStride + index;
+        const Float4 color = draw.m_packedColors != nullptr ? UnpackUnorm8( draw.m_packedColors[ index ] ) : draw.m_vertices[ index ].m_color;
+        return {
+            Float4( clip.m_x[ c ], clip.m_y[ c ], clip.m_z[ c ], clip.m_w[ c ] ),
+            Float4( color.x * tint.x, color.y * tint.y, color.z * tint.z, color.w * tint.w ),
+        };
+    };
+
+    for ( u32 t = 0; t < triangleCount; ++t, ++local ) {
+        if ( local == trianglesPerInstance ) {
+            local = 0;
+            ++instance;
+        }
+        if ( draw.m_instances != nullptr )
+            tint = draw.m_instances[ instance ].m_color;
+
+        const u32* indices = draw.m_indices + local * 3;
+        const ShadedVertex v0 = fetch( indices[ 0 ] );
+        const ShadedVertex v1 = fetch( indices[ 1 ] );
+        const ShadedVertex v2 = fetch( indices[ 2 ] );
+
+        u32 code0 = ClipOutcode( v0.m_pos );
+        u32 code1 = ClipOutcode( v1.m_pos );
+        u32 code2 = ClipOutcode( v2.m_pos );
+        if ( code0 & code1 & code2 )
+            continue;
+
+        if ( ( code0 | code1 | code2 ) == 0 ) {
+            SetupTriangle( chunk, v0, v1, v2 );
+            continue;
+        }
+
+        ShadedVertex poly[ MAX_CLIP_VERTICES ] = { v0, v1, v2 };
+        u32 count = ClipPolygon( poly, 3, code0 | code1 | code2 );
+        for ( u32 v = 2; v < count; ++v )
+            SetupTriangle( chunk, poly[ 0 ], poly[ v - 1 ], poly[ v ] );
+    }
+}
+
+//
+void TileRasterizer::SetupTriangle( BinChunk& chunk, const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2 ) {
+    const ShadedVertex* verts[ 3 ] = { &v0, &v1, &v2 };
+
+    // perspective divide, viewport transform and snapping
+    i64 x[ 3 ], y[ 3 ];
+    f32 attribs[ 3 ][ 6 ];
+    for ( u32 i = 0; i < 3; ++i ) {
+        const Float4& p = verts[ i ]->m_pos;
+        f32 invW = 1.0f / p.w;
+        f32 sx = ( p.x * invW * 0.5f + 0.5f ) * ( f32 )m_width;
+        f32 sy = ( 0.5f - p.y * invW * 0.5f ) * ( f32 )m_height;
+        x[ i ] = ( i64 )std::floor( sx * SUBPIXEL_ONE + 0.5f );
+        y[ i ] = ( i64 )std::floor( sy * SUBPIXEL_ONE + 0.5f );
+
+        const Float4& c = verts[ i ]->m_color;
+        attribs[ i ][ 0 ] = invW;
+        attribs[ i ][ 1 ] = c.x * invW;
+        attribs[ i ][ 2 ] = c.y * invW;
+        attribs[ i ][ 3 ] = c.z * invW;
+        attribs[ i ][ 4 ] = c.w * invW;
+        attribs[ i ][ 5 ] = p.z * invW;
+    }
+
+    // clockwise triangles are front facing, everything else is culled
+    i64 area = ( x[ 1 ] - x[ 0 ] ) * ( y[ 2 ] - y[ 0 ] ) - ( y[ 1 ] - y[ 0 ] ) * ( x[ 2 ] - x[ 0 ] );
+    if ( area <= 0 )
+        return;
+
+    RasterTriangle tri;
+    tri.m_minX = ( i32 )std::max< i64 >( std::min( { x[ 0 ], x[ 1 ], x[ 2 ] } ) >> SUBPIXEL_BITS, 0 );
+    tri.m_minY = ( i32 )std::max< i64 >( std::min( { y[ 0 ], y[ 1 ], y[ 2 ] } ) >> SUBPIXEL_BITS, 0 );
+    tri.m_maxX = ( i32 )std::min< i64 >( std::max( { x[ 0 ], x[ 1 ], x[ 2 ] } ) >> SUBPIXEL_BITS, m_width - 1 );
+    tri.m_maxY = ( i32 )std::min< i64 >( std::max( { y[ 0 ], y[ 1 ], y[ 2 ] } ) >> SUBPIXEL_BITS, m_height - 1 );
+    if ( tri.m_minX > tri.m_maxX || tri.m_minY > tri.m_maxY )
+        return;
+
+    // edge i is opposite vertex i, inside is E >= 0
+    for ( u32 e = 0; e < 3; ++e ) {
+        u32 a = ( e + 1 ) % 3;
+        u32 b = ( e + 2 ) % 3;
+        i64 dx = x[ b ] - x[ a ];
+        i64 dy = y[ b ] - y[ a ];
+        // top-left fill rule: pixels exactly on a right or bottom edge are not covered
+        i64 bias = ( dy < 0 || ( dy == 0 && dx > 0 ) ) ? 0 : -1;
+        // E at the center of pixel (0,0), which sits at subpixel (8,8)
+        tri.m_edgeC[ e ] = dx * ( SUBPIXEL_ONE / 2 - y[ a ] ) - dy * ( SUBPIXEL_ONE / 2 - x[ a ] ) + bias;
+        tri.m_edgeDx[ e ] = ( i32 )( -dy * SUBPIXEL_ONE );
+        tri.m_edgeDy[ e ] = ( i32 )( dx * SUBPIXEL_ONE );
+    }
+
+    // attribute planes in pixel units, evaluated at pixel centers
+    const f32 fx0 = ( f32 )x[ 0 ] / SUBPIXEL_ONE, fy0 = ( f32 )y[ 0 ] / SUBPIXEL_ONE;
+    const f32 dx1 = ( f32 )( x[ 1 ] - x[ 0 ] ) / SUBPIXEL_ONE, dy1 = ( f32 )( y[ 1 ] - y[ 0 ] ) / SUBPIXEL_ONE;
+    const f32 dx2 = ( f32 )( x[ 2 ] - x[ 0 ] ) / SUBPIXEL_ONE, dy2 = ( f32 )( y[ 2 ] - y[ 0 ] ) / SUBPIXEL_ONE;
+    const f32 invDet = 1.0f / ( dx1 * dy2 - dy1 * dx2 );
+    for ( u32 p = 0; p < 6; ++p ) {
+        f32 q0 = attribs[ 0 ][ p ];
+        f32 dq1 = attribs[ 1 ][ p ] - q0;
+        f32 dq2 = attribs[ 2 ][ p ] - q0;
+        f32 ddx = ( dq1 * dy2 - dq2 * dy1 ) * invDet;
+        f32 ddy = ( dq2 * dx1 - dq1 * dx2 ) * invDet;
+        tri.m_planes[ p ][ 0 ] = q0 + ddx * ( 0.5f - fx0 ) + ddy * ( 0.5f - fy0 );
+        tri.m_planes[ p ][ 1 ] = ddx;
+        tri.m_planes[ p ][ 2 ] = ddy;
+    }
+
+    // bin into every tile the bounding box touches that no edge fully rejects
+    const u32 triIndex = ( u32 )chunk.m_triangles.size();
+    const i32 tileMinX = tri.m_minX / ( i32 )TILE_SIZE, tileMaxX = tri.m_maxX / ( i32 )TILE_SIZE;
+    const i32 tileMinY = tri.m_minY / ( i32 )TILE_SIZE, tileMaxY = tri.m_maxY / ( i32 )TILE_SIZE;
+    const bool singleTile = tileMinX == tileMaxX && tileMinY == tileMaxY;
+    for ( i32 ty = tileMinY; ty <= tileMaxY; ++ty ) {
+        for ( i32 tx = tileMinX; tx <= tileMaxX; ++tx ) {
+            bool outside = false;
+            for ( u32 e = 0; e < 3 && !singleTile && !outside; ++e ) {
+                i64 corner = tri.m_edgeC[ e ] + ( i64 )tri.m_edgeDx[ e ] * tx * TILE_SIZE + ( i64 )tri.m_edgeDy[ e ] * ty * TILE_SIZE;
+                i64 maxEdge = corner + std::max< i64 >( tri.m_edgeDx[ e ], 0 ) * ( TILE_SIZE - 1 ) + std::max< i64 >( tri.m_edgeDy[ e ], 0 ) * ( TILE_SIZE - 1 );
+                outside = maxEdge < 0;
+            }
+            if ( !outside )
+                chunk.m_tileBins[ ty * m_tilesX + tx ].push_back( triIndex );
+        }
+    }
+    chunk.m_triangles.push_back( tri );
+}
+
+//
+void TileRasterizer::RasterizeTile( u32 tileIndex ) {
+    const i32 tileX0 = ( i32 )( ( tileIndex % m_tilesX ) * TILE_SIZE );
+    const i32 tileY0 = ( i32 )( ( tileIndex / m_tilesX ) * TILE_SIZE );
+    const i32 tileX1 = std::min( tileX0 + ( i32 )TILE_SIZE, ( i32 )m_width );
+    const i32 tileY1 = std::min( tileY0 + ( i32 )TILE_SIZE, ( i32 )m_height );
+
+    for ( i32 y = tileY0; y < tileY1; ++y ) {
+        u32* row = m_color + ( size_t )y * m_pitch;
+        std::fill( row + tileX0, row + tileX1, m_clearColor );
+    }
+
+    bool empty = true;
+    for ( u32 c = 0; c < m_chunkCount && empty; ++c )
+        empty = m_chunks[ c ].m_tileBins[ tileIndex ].empty();
+    if ( empty )
+        return;
+
+    // depth never leaves the tile, so it lives on the worker's stack instead
+    // of a full-screen buffer and is only cleared for tiles with triangles
+    alignas( 32 ) f32 depth[ TILE_SIZE * TILE_SIZE ];
+    std::fill( depth, depth + TILE_SIZE * TILE_SIZE, 1.0f );
+
+    for ( u32 c = 0; c < m_chunkCount; ++c ) {
+        const BinChunk& chunk = m_chunks[ c ];
+        for ( u32 triIndex : chunk.m_tileBins[ tileIndex ] )
+            RasterizeTriangle( chunk.m_triangles[ triIndex ], depth, tileX0, tileY0, tileX1, tileY1 );
+    }
+}
+
+// shades the covered pixels of one 8x8 block. for edges that fully contain
+// the block edge/step are zero so the coverage test passes trivially.
+static void ShadeBlock( const RasterTriangle& tri, u32* dst, u32 pitch, f32* depth, i32 blockX, i32 blockY, i32 rows, i32 cols,
+                        const i32 edge[ 3 ], const i32 stepX[ 3 ], const i32 stepY[ 3 ] ) {
+    const vi32 lane = LaneIndex();
+    const vf32 laneF = ToFloat( lane );
+    const vf32 zero = Splat( 0.0f );
+    const vf32 one = Splat( 1.0f );
+    const vf32 scale = Splat( 255.0f );
+    const vf32 half = Splat( 0.5f );
+
+    vi32 laneStep[ 3 ];
+    for ( u32 e = 0; e < 3; ++e )
+        laneStep[ e ] = lane * Splat( stepX[ e ] );
+
+    for ( i32 j = 0; j < rows; ++j ) {
+        const vf32 py = Splat( ( f32 )( blockY + j ) );
+        u32* row = dst + ( size_t )j * pitch;
+        f32* depthRow = depth + ( size_t )j * TILE_SIZE;
+        for ( i32 x0 = 0; x0 < ( i32 )BLOCK_SIZE; x0 += SIMD_WIDTH ) {
+            vi32 mask = CmpGt( Splat( cols - x0 ), lane );
+            vi32 e0 = Splat( edge[ 0 ] + stepY[ 0 ] * j + stepX[ 0 ] * x0 ) + laneStep[ 0 ];
+            vi32 e1 = Splat( edge[ 1 ] + stepY[ 1 ] * j + stepX[ 1 ] * x0 ) + laneStep[ 1 ];
+            vi32 e2 = Splat( edge[ 2 ] + stepY[ 2 ] * j + stepX[ 2 ] * x0 ) + laneStep[ 2 ];
+            mask = mask & CmpGt( e0 | e1 | e2, Splat( -1 ) );
+            if ( MoveMask( mask ) == 0 )
+                continue;
+
+            const vf32 px = Splat( ( f32 )( blockX + x0 ) ) + laneF;
+            auto plane = [ & ]( u32 p ) {
+                return MulAdd( Splat( tri.m_planes[ p ][ 1 ] ), px, MulAdd( Splat( tri.m_planes[ p ][ 2 ] ), py, Splat( tri.m_planes[ p ][ 0 ] ) ) );
+            };
+
+            // D3D11_COMPARISON_LESS
+            const vf32 z = plane( 5 );
+            const vf32 storedZ = Load( depthRow + x0 );
+            mask = mask & AsInt( CmpLt( z, storedZ ) );
+            if ( MoveMask( mask ) == 0 )
+                continue;
+            Store( depthRow + x0, Select( AsFloat( mask ), z, storedZ ) );
+
+            const vf32 w = one / plane( 0 );
+            auto unorm = [ & ]( u32 p ) {
+                return TruncToInt( MulAdd( Clamp( plane( p ) * w, zero, one ), scale, half ) );
+            };
+            // PixelShader.hlsl returns the interpolated color as is
+            vi32 color = unorm( 1 ) | ShiftLeft< 8 >( unorm( 2 ) ) | ShiftLeft< 16 >( unorm( 3 ) ) | ShiftLeft< 24 >( unorm( 4 ) );
+            Store( row + x0, Select( mask, color, Load( row + x0 ) ) );
+        }
+    }
+}
+
+//
+void TileRasterizer::RasterizeTriangle( const RasterTriangle& tri, f32* depth, i32 tileX0, i32 tileY0, i32 tileX1, i32 tileY1 ) {
+    const i32 minX = std::max( tri.m_minX, tileX0 ) & ~( i32 )( BLOCK_SIZE - 1 );
+    const i32 minY = std::max( tri.m_minY, tileY0 ) & ~( i32 )( BLOCK_SIZE - 1 );
+    const i32 maxX = std::min( tri.m_maxX, tileX1 - 1 );
+    const i32 maxY = std::min( tri.m_maxY, tileY1 - 1 );
+    const i32 lastPixel = ( i32 )BLOCK_SIZE - 1;
+
+    for ( i32 by = minY; by <= maxY; by += BLOCK_SIZE ) {
+        for ( i32 bx = minX; bx <= maxX; bx += BLOCK_SIZE ) {
+            i32 edge[ 3 ], stepX[ 3 ], stepY[ 3 ];
+            bool rejected = false;
+            for ( u32 e = 0; e < 3; ++e ) {
+                // classify the block against the edge using its extreme corners
+                i64 corner = tri.m_edgeC[ e ] + ( i64 )tri.m_edgeDx[ e ] * bx + ( i64 )tri.m_edgeDy[ e ] * by;
+                i64 lo = corner + std::min( tri.m_edgeDx[ e ], 0 ) * lastPixel + std::min( tri.m_edgeDy[ e ], 0 ) * lastPixel;
+                i64 hi = corner + std::max( tri.m_edgeDx[ e ], 0 ) * lastPixel + std::max( tri.m_edgeDy[ e ], 0 ) * lastPixel;
+                if ( hi < 0 ) {
+                    rejected = true;
+                    break;
+                }
+                if ( lo >= 0 ) {
+                    edge[ e ] = 0;
+                    stepX[ e ] = 0;
+                    stepY[ e ] = 0;
+                } else {
+                    // the edge crosses the block, so its value is bounded by the block extent
+                    edge[ e ] = ( i32 )corner;
+                    stepX[ e ] = tri.m_edgeDx[ e ];
+                    stepY[ e ] = tri.m_edgeDy[ e ];
+                }
+            }
+            if ( rejected )
+                continue;
+
+            const i32 rows = std::min( ( i32 )BLOCK_SIZE, tileY1 - by );
+            const i32 cols = std::min( ( i32 )BLOCK_SIZE, tileX1 - bx );
+            u32* dst = m_color + ( size_t )by * m_pitch + bx;
+            f32* blockDepth = depth + ( by - tileY0 ) * TILE_SIZE + ( bx - tileX0 );
+            ShadeBlock( tri, dst, m_pitch, blockDepth, bx, by, rows, cols, edge, stepX, stepY );
+        }
+    }
+}
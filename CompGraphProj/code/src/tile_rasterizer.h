@@ -0,0 +1,92 @@
+#pragma once
+
+#include "vertex_stage.h"
+
+#include <vector>
+
+class JobSystem;
+
+constexpr u32 TILE_SIZE = 64;
+constexpr u32 BLOCK_SIZE = 8;
+
+// vertex after clipping: clip-space position plus the attributes the pixel
+// stage interpolates
+struct ShadedVertex {
+    Float4 m_pos;
+    Float4 m_color;
+};
+
+// everything the tile workers need to rasterize one triangle, so bins can be
+// replayed without going back to the vertex data
+struct RasterTriangle {
+    i64 m_edgeC[ 3 ];           // edge value at the center of pixel (0,0), fill-rule bias folded in
+    i32 m_edgeDx[ 3 ];          // edge step per pixel in x
+    i32 m_edgeDy[ 3 ];          // edge step per pixel in y
+    i32 m_minX, m_minY, m_maxX, m_maxY;
+    f32 m_planes[ 6 ][ 3 ];     // 1/w, color/w and z/w as c + dx * px + dy * py
+};
+
+// one indexed draw as the rasterizer sees it. instance i reads its positions
+// from clip at i * m_instanceStride; the vertex colors are shared by all
+// instances and multiplied by the instance color when m_instances is set.
+// m_packedColors, when set, replaces the colors of m_vertices with RGBA8.
+struct RasterDraw {
+    const ClipStreams*  m_clip = nullptr;
+    const Vertex*       m_vertices = nullptr;
+    const u32*          m_packedColors = nullptr;
+    const u32*          m_indices = nullptr;
+    u32                 m_indexCount = 0;
+    u32                 m_instanceCount = 1;
+    u32                 m_instanceStride = 0;
+    const InstanceData* m_instances = nullptr;
+};
+
+// the most instances of a draw that RasterDraw's u32 arithmetic can address:
+// clip index i * instanceStride + vertex within the padded ClipStreams, and
+// triangle number i * ( indexCount / 3 ) + triangle with room for the chunking
+u32 GetMaxInstanceCount( u32 instanceStride, u32 indexCount );
+
+// sort-middle rasterizer: triangles are set up and binned into TILE_SIZE
+// tiles in parallel chunks, then every tile is cleared and rasterized by one
+// worker in 8x8 blocks. bins are replayed in submission order, so the result
+// does not depend on the thread count. depth is tested LESS against a 32-bit
+// float depth cleared to 1 like the D3D11 default depth-stencil state.
+class TileRasterizer {
+public:
+    void Resize( u32 width, u32 height );
+
+    u32 GetWidth() const { return m_width; }
+    u32 GetHeight() const { return m_height; }
+    // row stride of color targets in pixels
+    u32 GetPitch() const { return m_pitch; }
+
+    // color is GetPitch() * GetHeight() pixels owned by the caller, e.g. one
+    // buffer of a swap chain
+    void BeginFrame( u32* color, u32 clearColor );
+    // positions come from the vertex stage, colors pass through from the vertex buffer
+    void SubmitTriangles( const RasterDraw& draw, JobSystem& jobs );
+    void SubmitTriangles( const ClipStreams& clip, const Vertex* vertices, const u32* indices, u32 indexCount, JobSystem& jobs );
+    void EndFrame( JobSystem& jobs );
+
+private:
+    struct BinChunk {
+        std::vector< RasterTriangle >       m_triangles;
+        std::vector< std::vector< u32 > >   m_tileBins;
+    };
+
+    void BinTriangles( BinChunk& chunk, const RasterDraw& draw, u32 firstTriangle, u32 triangleCount );
+    void SetupTriangle( BinChunk& chunk, const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2 );
+    void RasterizeTile( u32 tileIndex );
+    void RasterizeTriangle( const RasterTriangle& tri, f32* depth, i32 tileX0, i32 tileY0, i32 tileX1, i32 tileY1 );
+
+    u32                         m_width = 0;
+    u32                         m_height = 0;
+    u32                         m_pitch = 0;
+    u32                         m_tilesX = 0;
+    u32                         m_tilesY = 0;
+    u32                         m_clearColor = 0;
+    u32*                        m_color = nullptr;
+
+    std::vector< BinChunk >     m_chunks;
+    u32                         m_chunkCount = 0;
+};
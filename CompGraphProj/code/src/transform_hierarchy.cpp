@@ -0,0 +1,201 @@
+#include "transform_hierarchy.h"
+
+#include "job_system.h"
+#include "profiler.h"
+#include "simd_math.h"
+
+#include <algorithm>
+
+//
+u32 TransformHierarchy::AddNode( u32 parent, const Matrix& local ) {
+    const u32 node = ( u32 )m_parents.size();
+    m_parents.push_back( parent );
+    m_nodeSlots.push_back( node );
+    m_dirty.push_back( 1 );
+    m_dirtyNodes.push_back( node );
+    m_slots.emplace_back();
+    m_transforms.push_back( { local, local } );
+    return node;
+}
+
+//
+void TransformHierarchy::SetLocal( u32 node, const Matrix& local ) {
+    m_transforms[ m_nodeSlots[ node ] ].m_local = local;
+    if ( m_dirty[ node ] == 0 ) {
+        m_dirty[ node ] = 1;
+        m_dirtyNodes.push_back( node );
+    }
+}
+
+// lays the trees out again, roots in id order and every tree breadth first
+// with siblings in id order, and moves the matrices to the new slots
+void TransformHierarchy::Rebuild() {
+    PROFILE_ZONE( "TransformHierarchy::Rebuild" );
+    const u32 count = GetNodeCount();
+
+    // children of every node by id
+    std::vector< u32 > childStart( count + 1, 0 ), children( count );
+    for ( u32 node = 0; node < count; ++node ) {
+        if ( m_parents[ node ] != TRANSFORM_ROOT )
+            childStart[ m_parents[ node ] + 1 ]++;
+    }
+    for ( u32 node = 0; node < count; ++node )
+        childStart[ node + 1 ] += childStart[ node ];
+    std::vector< u32 > cursor( childStart.begin(), childStart.end() - 1 );
+    for ( u32 node = 0; node < count; ++node ) {
+        if ( m_parents[ node ] != TRANSFORM_ROOT )
+            children[ cursor[ m_parents[ node ] ]++ ] = node;
+    }
+
+    // each tree is its own breadth-first queue: a node's children are appended
+    // together, so the children of a run of slots are a run of slots as well.
+    // a leaf's m_firstChild is where the next node's children start.
+    std::vector< u32 > nodes( count );
+    u32 end = 0;
+    for ( u32 root = 0; root < count; ++root ) {
+        if ( m_parents[ root ] != TRANSFORM_ROOT )
+            continue;
+        const u32 tree = end;
+        nodes[ end ] = root;
+        m_slots[ end++ ] = { TRANSFORM_ROOT, 0, 0, 0, tree };
+        for ( u32 slot = tree; slot < end; ++slot ) {
+            const u32 node = nodes[ slot ];
+            m_slots[ slot ].m_firstChild = end;
+            m_slots[ slot ].m_childCount = childStart[ node + 1 ] - childStart[ node ];
+            for ( u32 c = childStart[ node ]; c < childStart[ node + 1 ]; ++c ) {
+                nodes[ end ] = children[ c ];
+                m_slots[ end++ ] = { slot, 0, 0, m_slots[ slot ].m_depth + 1, tree };
+            }
+        }
+    }
+
+    std::vector< Transform > transforms( count );
+    for ( u32 slot = 0; slot < count; ++slot )
+        transforms[ slot ] = m_transforms[ m_nodeSlots[ nodes[ slot ] ] ];
+    for ( u32 slot = 0; slot < count; ++slot )
+        m_nodeSlots[ nodes[ slot ] ] = slot;
+    m_transforms.swap( transforms );
+    m_sortedCount = count;
+}
+
+// world matrices of slots of one depth, whose parents are all final
+void TransformHierarchy::UpdateRange( SlotRange range ) {
+    for ( u32 slot = range.m_begin; slot < range.m_end; ++slot ) {
+        Transform& transform = m_transforms[ slot ];
+        const u32 parent = m_slots[ slot ].m_parent;
+        if ( parent != TRANSFORM_ROOT )
+            StoreMatrix( transform.m_world, Mat4Multiply( LoadMatrix( transform.m_local ), LoadMatrix( m_transforms[ parent ].m_world ) ) );
+        else
+            transform.m_world = transform.m_local;
+    }
+}
+
+// appends [ begin, end ) to sorted disjoint ranges, joining it to the last one when they touch
+void TransformHierarchy::AppendRange( std::vector< SlotRange >& ranges, u32 begin, u32 end ) {
+    if ( !ranges.empty() && ranges.back().m_end == begin )
+        ranges.back().m_end = end;
+    else
+        ranges.push_back( { begin, end } );
+}
+
+// the changed slots of one tree, sorted, so also by depth. the tree is
+// walked one depth at a time: the slots to update at a depth are the
+// children of the ranges updated at the one above, merged with the changed
+// slots of that depth that they do not cover yet.
+u32 TransformHierarchy::UpdateTree( const u32* changed, u32 changedCount, UpdateScratch& scratch ) {
+    std::vector< SlotRange >& level = scratch.m_level;
+    std::vector< SlotRange >& merged = scratch.m_merged;
+    level.clear();
+    u32 updated = 0, next = 0, depth = 0;
+    while ( !level.empty() || next < changedCount ) {
+        if ( level.empty() )
+            depth = m_slots[ changed[ next ] ].m_depth;
+
+        merged.clear();
+        u32 r = 0;
+        while ( r < ( u32 )level.size() || ( next < changedCount && m_slots[ changed[ next ] ].m_depth == depth ) ) {
+            const bool fromChanged = next < changedCount && m_slots[ changed[ next ] ].m_depth == depth &&
+                ( r == ( u32 )level.size() || changed[ next ] < level[ r ].m_end );
+            if ( !fromChanged ) {
+                AppendRange( merged, level[ r ].m_begin, level[ r ].m_end );
+                ++r;
+            } else {
+                if ( r == ( u32 )level.size() || changed[ next ] < level[ r ].m_begin )
+                    AppendRange( merged, changed[ next ], changed[ next ] + 1 );
+                ++next;
+            }
+        }
+
+        level.clear();
+        for ( const SlotRange& range : merged ) {
+            UpdateRange( range );
+            updated += range.m_end - range.m_begin;
+            const Slot& last = m_slots[ range.m_end - 1 ];
+            const u32 childEnd = last.m_firstChild + last.m_childCount;
+            if ( m_slots[ range.m_begin ].m_firstChild < childEnd )
+                AppendRange( level, m_slots[ range.m_begin ].m_firstChild, childEnd );
+        }
+        ++depth;
+    }
+    return updated;
+}
+
+//
+u32 TransformHierarchy::Update( JobSystem* jobs ) {
+    PROFILE_ZONE( "TransformHierarchy::Update" );
+    if ( m_sortedCount != GetNodeCount() )
+        Rebuild();
+    if ( m_dirtyNodes.empty() )
+        return 0;
+
+    m_changed.clear();
+    for ( u32 node : m_dirtyNodes ) {
+        m_changed.push_back( m_nodeSlots[ node ] );
+        m_dirty[ node ] = 0;
+    }
+    m_dirtyNodes.clear();
+    std::sort( m_changed.begin(), m_changed.end() );
+
+    m_runs.clear();
+    for ( u32 i = 0; i < ( u32 )m_changed.size(); ++i ) {
+        if ( m_runs.empty() || m_slots[ m_changed[ i ] ].m_tree != m_slots[ m_changed[ m_runs.back().m_begin ] ].m_tree ) {
+            m_runs.emplace_back();
+            m_runs.back().m_begin = i;
+        }
+        m_runs.back().m_end = i + 1;
+    }
+
+    // trees own disjoint slots, workers their scratch
+    m_scratch.resize( jobs != nullptr ? jobs->GetThreadCount() + 1 : 1 );
+    auto update = [ & ]( u32 r ) {
+        TreeRun& run = m_runs[ r ];
+        UpdateScratch& scratch = m_scratch[ jobs != nullptr ? jobs->GetWorkerIndex() : 0 ];
+        run.m_updated = UpdateTree( m_changed.data() + run.m_begin, run.m_end - run.m_begin, scratch );
+    };
+    const u32 runCount = ( u32 )m_runs.size();
+    if ( jobs != nullptr ) {
+        jobs->ParallelFor( runCount, update );
+    } else {
+        for ( u32 r = 0; r < runCount; ++r )
+            update( r );
+    }
+
+    u32 updated = 0;
+    for ( const TreeRun& run : m_runs )
+        updated += run.m_updated;
+    return updated;
+}
+
+//
+void TransformHierarchy::Clear() {
+    m_parents.clear();
+    m_nodeSlots.clear();
+    m_dirty.clear();
+    m_dirtyNodes.clear();
+    m_slots.clear();
+    m_transforms.clear();
+    m_sortedCount = 0;
+    m_changed.clear();
+    m_runs.clear();
+    m_scratch.clear();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "types.h"
+#include "vecmath.h"
+
+#include <vector>
+
+class JobSystem;
+
+// parent-relative transforms of a forest of nodes and their world matrices,
+// world = local * parent world. every tree occupies one contiguous run of
+// slots, breadth first, so a node's depth never decreases along the run and
+// the children of a run of nodes are a run as well.
+//
+// Update only visits the subtrees under nodes whose local matrix changed
+// since the last one: one depth at a time as runs of slots, with 4-wide SIMD
+// multiplies, and the trees that have changes spread over the job system.
+// nodes that did not change cost nothing per update.
+
+constexpr u32 TRANSFORM_ROOT = ~0u;
+
+class TransformHierarchy {
+public:
+    // a node under parent, an earlier node or TRANSFORM_ROOT to start a new
+    // tree. returns its id; ids count up from 0 and never change.
+    u32 AddNode( u32 parent, const Matrix& local );
+
+    void SetLocal( u32 node, const Matrix& local );
+    const Matrix& GetLocal( u32 node ) const { return m_transforms[ m_nodeSlots[ node ] ].m_local; }
+    // as of the last Update
+    const Matrix& GetWorld( u32 node ) const { return m_transforms[ m_nodeSlots[ node ] ].m_world; }
+    u32 GetParent( u32 node ) const { return m_parents[ node ]; }
+    u32 GetNodeCount() const { return ( u32 )m_parents.size(); }
+
+    // recomputes the world matrices of the changed nodes and everything
+    // below them, returns how many that were. the changed trees are split
+    // over jobs when given; one tree is updated on one thread.
+    u32 Update( JobSystem* jobs = nullptr );
+
+    void Clear();
+
+private:
+    struct Slot {
+        u32 m_parent = TRANSFORM_ROOT;  // slot
+        u32 m_firstChild = 0;
+        u32 m_childCount = 0;
+        u32 m_depth = 0;
+        u32 m_tree = 0;         // first slot of the tree
+    };
+    // local and world side by side, Update reads one and writes the other
+    struct Transform {
+        Matrix m_local;
+        Matrix m_world;
+    };
+    // the changed slots of one tree, a range of m_changed
+    struct TreeRun {
+        u32 m_begin = 0;
+        u32 m_end = 0;
+        u32 m_updated = 0;
+    };
+    // [ m_begin, m_end ) of the slots of one depth
+    struct SlotRange {
+        u32 m_begin;
+        u32 m_end;
+    };
+    // one per worker
+    struct UpdateScratch {
+        std::vector< SlotRange > m_level;
+        std::vector< SlotRange > m_merged;
+    };
+
+    void Rebuild();
+    u32 UpdateTree( const u32* changed, u32 changedCount, UpdateScratch& scratch );
+    void UpdateRange( SlotRange range );
+    static void AppendRange( std::vector< SlotRange >& ranges, u32 begin, u32 end );
+
+    // by node id
+    std::vector< u32 >          m_parents;
+    std::vector< u32 >          m_nodeSlots;
+    std::vector< u8 >           m_dirty;
+    std::vector< u32 >          m_dirtyNodes;
+
+    // by slot; nodes added since the last Update are appended after
+    // m_sortedCount and moved into their tree's run by Rebuild
+    std::vector< Slot >         m_slots;
+    std::vector< Transform >    m_transforms;
+    u32                         m_sortedCount = 0;
+
+    std::vector< u32 >          m_changed;
+    std::vector< TreeRun >      m_runs;
+    std::vector< UpdateScratch > m_scratch;
+};
@@ -0,0 +1,28 @@
+#include "upload_ring.h"
+
+//
+void UploadRing::Reset( u32 capacity ) {
+    m_capacity = capacity & ~( UPLOAD_ALIGNMENT - 1 );
+    m_head = 0;
+    m_mapped = false;
+}
+
+//
+bool UploadRing::Allocate( u32 size, UploadAllocation& allocation ) {
+    const u32 aligned = ( size + UPLOAD_ALIGNMENT - 1 ) & ~( UPLOAD_ALIGNMENT - 1 );
+    if ( size == 0 || aligned > m_capacity )
+        return false;
+
+    bool discard = !m_mapped;
+    if ( aligned > m_capacity - m_head ) {
+        m_head = 0;
+        discard = true;
+    }
+
+    allocation.m_offset = m_head;
+    allocation.m_size = aligned;
+    allocation.m_discard = discard;
+    m_head += aligned;
+    m_mapped = true;
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.h"
+
+// D3D11.1 constant buffer offsets must be multiples of 16 constants
+constexpr u32 UPLOAD_ALIGNMENT = 256;
+
+struct UploadAllocation {
+    u32     m_offset = 0;       // bytes from the start of the buffer, UPLOAD_ALIGNMENT aligned
+    u32     m_size = 0;         // requested size rounded up to UPLOAD_ALIGNMENT
+    bool    m_discard = false;  // map with WRITE_DISCARD instead of WRITE_NO_OVERWRITE
+};
+
+// offset bookkeeping for sub-allocating per-frame data out of one dynamic
+// buffer. allocations are appended behind each other, which is safe to map
+// with NO_OVERWRITE because nothing the GPU may still read is touched. when
+// the buffer is full the ring restarts at 0 and asks for DISCARD, so the
+// driver hands out a fresh copy instead of waiting for the GPU.
+class UploadRing {
+public:
+    void Reset( u32 capacity );
+
+    u32 GetCapacity() const { return m_capacity; }
+    u32 GetHead() const { return m_head; }
+
+    // fails only if size does not fit into the whole buffer
+    bool Allocate( u32 size, UploadAllocation& allocation );
+
+private:
+    u32     m_capacity = 0;
+    u32     m_head = 0;
+    bool    m_mapped = false;   // the first map of a dynamic buffer has to discard
+};
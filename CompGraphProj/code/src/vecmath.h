@@ -0,0 +1,182 @@
+#pragma once
+
+#include "types.h"
+
+#include <cmath>
+
+// minimal portable replacement for the DirectXMath subset the scene uses.
+// conventions follow DirectXMath: row-major storage, row vectors (v * M),
+// left-handed rotations.
+
+constexpr f32 MATH_PI = 3.141592654f;
+constexpr f32 MATH_2PI = 6.283185307f;
+constexpr f32 MATH_1DIV2PI = 0.159154943f;
+constexpr f32 MATH_PIDIV2 = 1.570796327f;
+
+struct Float3 {
+    f32 x, y, z;
+
+    Float3() = default;
+    constexpr Float3( f32 _x, f32 _y, f32 _z ) : x( _x ), y( _y ), z( _z ) {}
+};
+
+struct Float4 {
+    f32 x, y, z, w;
+
+    Float4() = default;
+    constexpr Float4( f32 _x, f32 _y, f32 _z, f32 _w ) : x( _x ), y( _y ), z( _z ), w( _w ) {}
+};
+
+struct alignas( 16 ) Matrix {
+    Float4 r[ 4 ];
+};
+
+// same minimax polynomials as XMScalarSinCos so rotations match bit for bit
+inline void ScalarSinCos( f32* outSin, f32* outCos, f32 value ) {
+    // map value to y in [-pi,pi], x = 2*pi*quotient + remainder
+    f32 quotient = MATH_1DIV2PI * value;
+    if ( value >= 0.0f )
+        quotient = ( f32 )( i32 )( quotient + 0.5f );
+    else
+        quotient = ( f32 )( i32 )( quotient - 0.5f );
+    f32 y = value - MATH_2PI * quotient;
+
+    // map y to [-pi/2,pi/2] with sin(y) = sin(value)
+    f32 sign;
+    if ( y > MATH_PIDIV2 ) {
+        y = MATH_PI - y;
+        sign = -1.0f;
+    } else if ( y < -MATH_PIDIV2 ) {
+        y = -MATH_PI - y;
+        sign = -1.0f;
+    } else {
+        sign = +1.0f;
+    }
+
+    f32 y2 = y * y;
+
+    // 11-degree minimax approximation
+    *outSin = ( ( ( ( ( -2.3889859e-08f * y2 + 2.7525562e-06f ) * y2 - 0.00019840874f ) * y2 + 0.0083333310f ) * y2 - 0.16666667f ) * y2 + 1.0f ) * y;
+
+    // 10-degree minimax approximation
+    f32 p = ( ( ( ( -2.6051615e-07f * y2 + 2.4760495e-05f ) * y2 - 0.0013888378f ) * y2 + 0.041666638f ) * y2 - 0.5f ) * y2 + 1.0f;
+    *outCos = sign * p;
+}
+
+inline Matrix MatrixIdentity() {
+    Matrix m;
+    m.r[ 0 ] = Float4( 1.0f, 0.0f, 0.0f, 0.0f );
+    m.r[ 1 ] = Float4( 0.0f, 1.0f, 0.0f, 0.0f );
+    m.r[ 2 ] = Float4( 0.0f, 0.0f, 1.0f, 0.0f );
+    m.r[ 3 ] = Float4( 0.0f, 0.0f, 0.0f, 1.0f );
+    return m;
+}
+
+inline Float3 Vector3Normalize( const Float3& v ) {
+    f32 length = std::sqrt( v.x * v.x + v.y * v.y + v.z * v.z );
+    if ( length > 0.0f )
+        length = 1.0f / length;
+    return Float3( v.x * length, v.y * length, v.z * length );
+}
+
+// rotation about a unit-length axis, laid out exactly like XMMatrixRotationNormal
+inline Matrix MatrixRotationNormal( const Float3& n, f32 angle ) {
+    f32 s, c;
+    ScalarSinCos( &s, &c, angle );
+    const f32 t = 1.0f - c;
+
+    Matrix m;
+    m.r[ 0 ] = Float4( t * n.x * n.x + c, t * n.x * n.y + s * n.z, t * n.z * n.x - s * n.y, 0.0f );
+    m.r[ 1 ] = Float4( t * n.x * n.y - s * n.z, t * n.y * n.y + c, t * n.y * n.z + s * n.x, 0.0f );
+    m.r[ 2 ] = Float4( t * n.z * n.x + s * n.y, t * n.y * n.z - s * n.x, t * n.z * n.z + c, 0.0f );
+    m.r[ 3 ] = Float4( 0.0f, 0.0f, 0.0f, 1.0f );
+    return m;
+}
+
+inline Matrix MatrixRotationAxis( const Float3& axis, f32 angle ) {
+    return MatrixRotationNormal( Vector3Normalize( axis ), angle );
+}
+
+inline Matrix MatrixTranspose( const Matrix& m ) {
+    Matrix t;
+    t.r[ 0 ] = Float4( m.r[ 0 ].x, m.r[ 1 ].x, m.r[ 2 ].x, m.r[ 3 ].x );
+    t.r[ 1 ] = Float4( m.r[ 0 ].y, m.r[ 1 ].y, m.r[ 2 ].y, m.r[ 3 ].y );
+    t.r[ 2 ] = Float4( m.r[ 0 ].z, m.r[ 1 ].z, m.r[ 2 ].z, m.r[ 3 ].z );
+    t.r[ 3 ] = Float4( m.r[ 0 ].w, m.r[ 1 ].w, m.r[ 2 ].w, m.r[ 3 ].w );
+    return t;
+}
+
+// row vector times matrix, w taken as 1
+inline Float4 TransformPoint( const Float3& p, const Matrix& m ) {
+    return Float4(
+        p.x * m.r[ 0 ].x + p.y * m.r[ 1 ].x + p.z * m.r[ 2 ].x + m.r[ 3 ].x,
+        p.x * m.r[ 0 ].y + p.y * m.r[ 1 ].y + p.z * m.r[ 2 ].y + m.r[ 3 ].y,
+        p.x * m.r[ 0 ].z + p.y * m.r[ 1 ].z + p.z * m.r[ 2 ].z + m.r[ 3 ].z,
+        p.x * m.r[ 0 ].w + p.y * m.r[ 1 ].w + p.z * m.r[ 2 ].w + m.r[ 3 ].w );
+}
+
+inline Float3 Vector3Cross( const Float3& a, const Float3& b ) {
+    return Float3( a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x );
+}
+
+inline f32 Vector3Dot( const Float3& a, const Float3& b ) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// a * b, i.e. apply a first
+inline Matrix MatrixMultiply( const Matrix& a, const Matrix& b ) {
+    Matrix m;
+    for ( u32 i = 0; i < 4; ++i ) {
+        const Float4& r = a.r[ i ];
+        m.r[ i ] = Float4(
+            r.x * b.r[ 0 ].x + r.y * b.r[ 1 ].x + r.z * b.r[ 2 ].x + r.w * b.r[ 3 ].x,
+            r.x * b.r[ 0 ].y + r.y * b.r[ 1 ].y + r.z * b.r[ 2 ].y + r.w * b.r[ 3 ].y,
+            r.x * b.r[ 0 ].z + r.y * b.r[ 1 ].z + r.z * b.r[ 2 ].z + r.w * b.r[ 3 ].z,
+            r.x * b.r[ 0 ].w + r.y * b.r[ 1 ].w + r.z * b.r[ 2 ].w + r.w * b.r[ 3 ].w );
+    }
+    return m;
+}
+
+inline Matrix MatrixScaling( f32 sx, f32 sy, f32 sz ) {
+    Matrix m = MatrixIdentity();
+    m.r[ 0 ].x = sx;
+    m.r[ 1 ].y = sy;
+    m.r[ 2 ].z = sz;
+    return m;
+}
+
+inline Matrix MatrixTranslation( f32 tx, f32 ty, f32 tz ) {
+    Matrix m = MatrixIdentity();
+    m.r[ 3 ] = Float4( tx, ty, tz, 1.0f );
+    return m;
+}
+
+// left-handed view matrix, same as XMMatrixLookAtLH
+inline Matrix MatrixLookAtLH( const Float3& eye, const Float3& focus, const Float3& up ) {
+    const Float3 z = Vector3Normalize( Float3( focus.x - eye.x, focus.y - eye.y, focus.z - eye.z ) );
+    const Float3 x = Vector3Normalize( Vector3Cross( up, z ) );
+    const Float3 y = Vector3Cross( z, x );
+
+    Matrix m;
+    m.r[ 0 ] = Float4( x.x, y.x, z.x, 0.0f );
+    m.r[ 1 ] = Float4( x.y, y.y, z.y, 0.0f );
+    m.r[ 2 ] = Float4( x.z, y.z, z.z, 0.0f );
+    m.r[ 3 ] = Float4( -Vector3Dot( x, eye ), -Vector3Dot( y, eye ), -Vector3Dot( z, eye ), 1.0f );
+    return m;
+}
+
+// left-handed perspective projection to 0 <= z <= w, same as XMMatrixPerspectiveFovLH
+inline Matrix MatrixPerspectiveFovLH( f32 fovY, f32 aspect, f32 nearZ, f32 farZ ) {
+    f32 s, c;
+    ScalarSinCos( &s, &c, 0.5f * fovY );
+    const f32 height = c / s;
+    const f32 width = height / aspect;
+    const f32 range = farZ / ( farZ - nearZ );
+
+    Matrix m;
+    m.r[ 0 ] = Float4( width, 0.0f, 0.0f, 0.0f );
+    m.r[ 1 ] = Float4( 0.0f, height, 0.0f, 0.0f );
+    m.r[ 2 ] = Float4( 0.0f, 0.0f, range, 1.0f );
+    m.r[ 3 ] = Float4( 0.0f, 0.0f, -range * nearZ, 0.0f );
+    return m;
+}
@@ -0,0 +1,323 @@
+#include "vertex_quantization.h"
+
+#include "mapped_file.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static const char* const positionEncodingNames[ POSITION_ENCODING_COUNT ] = { "float32", "half", "snorm16" };
+
+#define QUANTIZED_ELEMENT( semantic, format, offset ) \
+    VertexElement{ semantic, 0, format, offset, VertexFormatSize( format ), true }
+
+// the normal is last, so meshes without one use the first two elements
+constexpr VertexElement float32Elements[] = {
+    QUANTIZED_ELEMENT( "POSITION", VERTEX_FORMAT_FLOAT3, 0 ),
+    QUANTIZED_ELEMENT( "COLOR", VERTEX_FORMAT_UNORM8X4, 12 ),
+    QUANTIZED_ELEMENT( "NORMAL", VERTEX_FORMAT_SNORM16X2, 16 ),
+};
+constexpr VertexElement halfElements[] = {
+    QUANTIZED_ELEMENT( "POSITION", VERTEX_FORMAT_HALF4, 0 ),
+    QUANTIZED_ELEMENT( "COLOR", VERTEX_FORMAT_UNORM8X4, 8 ),
+    QUANTIZED_ELEMENT( "NORMAL", VERTEX_FORMAT_SNORM16X2, 12 ),
+};
+constexpr VertexElement snorm16Elements[] = {
+    QUANTIZED_ELEMENT( "POSITION", VERTEX_FORMAT_SNORM16X4, 0 ),
+    QUANTIZED_ELEMENT( "COLOR", VERTEX_FORMAT_UNORM8X4, 8 ),
+    QUANTIZED_ELEMENT( "NORMAL", VERTEX_FORMAT_SNORM16X2, 12 ),
+};
+static_assert( IsValidVertexLayout( float32Elements, 20 ), "float32Elements overlap" );
+static_assert( IsValidVertexLayout( halfElements, 16 ), "halfElements overlap" );
+static_assert( IsValidVertexLayout( snorm16Elements, 16 ), "snorm16Elements overlap" );
+
+static const VertexElement* const quantizedElements[ POSITION_ENCODING_COUNT ] = { float32Elements, halfElements, snorm16Elements };
+
+//
+const char* GetPositionEncodingName( PositionEncoding encoding ) {
+    return encoding < POSITION_ENCODING_COUNT ? positionEncodingNames[ encoding ] : "unknown";
+}
+
+//
+bool ParsePositionEncoding( const char* name, PositionEncoding& encoding ) {
+    for ( u32 i = 0; i < POSITION_ENCODING_COUNT; ++i ) {
+        if ( strcmp( name, positionEncodingNames[ i ] ) == 0 ) {
+            encoding = ( PositionEncoding )i;
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+MeshConstants GetIdentityMeshConstants() {
+    MeshConstants constants;
+    constants.m_positionScale = Float4( 1.0f, 1.0f, 1.0f, 1.0f );
+    constants.m_positionBias = Float4( 0.0f, 0.0f, 0.0f, 0.0f );
+    return constants;
+}
+
+// round to nearest even, overflow goes to infinity
+u16 FloatToHalf( f32 value ) {
+    u32 bits;
+    memcpy( &bits, &value, sizeof( bits ) );
+    const u32 sign = ( bits >> 16 ) & 0x8000;
+    bits &= 0x7FFFFFFF;
+
+    if ( bits >= 0x7F800000 )
+        return ( u16 )( sign | 0x7C00 | ( bits > 0x7F800000 ? 0x0200 : 0 ) );
+    // 65520 and up round past the largest half, 65504
+    if ( bits >= 0x477FF000 )
+        return ( u16 )( sign | 0x7C00 );
+    // below 2^-14 the result is denormal: the value in units of 2^-24
+    if ( bits < 0x38800000 ) {
+        f32 magnitude;
+        memcpy( &magnitude, &bits, sizeof( magnitude ) );
+        return ( u16 )( sign | ( u32 )std::nearbyint( magnitude * 16777216.0f ) );
+    }
+    // rebias the exponent from 127 to 15 and round the 13 dropped mantissa bits
+    bits += 0xC8000FFF + ( ( bits >> 13 ) & 1 );
+    return ( u16 )( sign | ( bits >> 13 ) );
+}
+
+// the SIMD decode in vertex_stage.cpp uses the same scaling, so both agree bit for bit
+f32 HalfToFloat( u16 half ) {
+    const u32 sign = ( u32 )( half & 0x8000 ) << 16;
+    u32 bits;
+    if ( ( half & 0x7C00 ) == 0x7C00 ) {
+        bits = sign | 0x7F800000 | ( ( u32 )( half & 0x03FF ) << 13 );
+    } else {
+        const u32 magnitudeBits = ( u32 )( half & 0x7FFF ) << 13;
+        f32 magnitude;
+        memcpy( &magnitude, &magnitudeBits, sizeof( magnitude ) );
+        magnitude *= HALF_EXPONENT_SCALE;
+        memcpy( &bits, &magnitude, sizeof( bits ) );
+        bits |= sign;
+    }
+    f32 value;
+    memcpy( &value, &bits, sizeof( value ) );
+    return value;
+}
+
+//
+i16 FloatToSnorm16( f32 value ) {
+    value = value < -1.0f ? -1.0f : ( value > 1.0f ? 1.0f : value );
+    return ( i16 )( value * 32767.0f + ( value >= 0.0f ? 0.5f : -0.5f ) );
+}
+
+//
+f32 Snorm16ToFloat( i16 value ) {
+    return ( f32 )value / 32767.0f;
+}
+
+//
+u32 PackUnorm8( const Float4& color ) {
+    auto unorm = []( f32 c ) -> u32 {
+        c = c < 0.0f ? 0.0f : ( c > 1.0f ? 1.0f : c );
+        return ( u32 )( c * 255.0f + 0.5f );
+    };
+    return unorm( color.x ) | ( unorm( color.y ) << 8 ) | ( unorm( color.z ) << 16 ) | ( unorm( color.w ) << 24 );
+}
+
+//
+Float4 UnpackUnorm8( u32 color ) {
+    return Float4( ( f32 )( color & 0xFF ) / 255.0f, ( f32 )( ( color >> 8 ) & 0xFF ) / 255.0f,
+                   ( f32 )( ( color >> 16 ) & 0xFF ) / 255.0f, ( f32 )( color >> 24 ) / 255.0f );
+}
+
+// projects onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the diagonals
+u32 OctEncodeNormal( const Float3& normal ) {
+    const f32 length = fabsf( normal.x ) + fabsf( normal.y ) + fabsf( normal.z );
+    f32 x = length > 0.0f ? normal.x / length : 0.0f;
+    f32 y = length > 0.0f ? normal.y / length : 0.0f;
+    if ( length > 0.0f && normal.z < 0.0f ) {
+        const f32 foldedX = ( 1.0f - fabsf( y ) ) * ( x >= 0.0f ? 1.0f : -1.0f );
+        const f32 foldedY = ( 1.0f - fabsf( x ) ) * ( y >= 0.0f ? 1.0f : -1.0f );
+        x = foldedX;
+        y = foldedY;
+    }
+    return ( u32 )( u16 )FloatToSnorm16( x ) | ( ( u32 )( u16 )FloatToSnorm16( y ) << 16 );
+}
+
+//
+Float3 OctDecodeNormal( u32 encoded ) {
+    f32 x = Snorm16ToFloat( ( i16 )( encoded & 0xFFFF ) );
+    f32 y = Snorm16ToFloat( ( i16 )( encoded >> 16 ) );
+    const f32 z = 1.0f - fabsf( x ) - fabsf( y );
+    const f32 fold = z < 0.0f ? -z : 0.0f;
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+    return Vector3Normalize( Float3( x, y, z ) );
+}
+
+//
+void ComputeVertexNormals( const Mesh& mesh, std::vector< Float3 >& normals ) {
+    normals.assign( mesh.m_vertexCount, Float3( 0.0f, 0.0f, 0.0f ) );
+    for ( u32 i = 0; i + 2 < mesh.m_indexCount; i += 3 ) {
+        const u32 i0 = mesh.m_indices[ i ], i1 = mesh.m_indices[ i + 1 ], i2 = mesh.m_indices[ i + 2 ];
+        if ( i0 >= mesh.m_vertexCount || i1 >= mesh.m_vertexCount || i2 >= mesh.m_vertexCount )
+            continue;
+        const Float3& p0 = mesh.m_vertices[ i0 ].m_pos;
+        const Float3& p1 = mesh.m_vertices[ i1 ].m_pos;
+        const Float3& p2 = mesh.m_vertices[ i2 ].m_pos;
+        // twice the area long, so large faces weigh more
+        const Float3 n = Vector3Cross( Float3( p1.x - p0.x, p1.y - p0.y, p1.z - p0.z ), Float3( p2.x - p0.x, p2.y - p0.y, p2.z - p0.z ) );
+        for ( u32 v : { i0, i1, i2 } ) {
+            normals[ v ].x += n.x;
+            normals[ v ].y += n.y;
+            normals[ v ].z += n.z;
+        }
+    }
+    for ( Float3& n : normals )
+        n = Vector3Normalize( n );
+}
+
+//
+u32 GetPositionSize( PositionEncoding encoding ) {
+    return encoding == POSITION_FLOAT32 ? 12 : 8;
+}
+
+//
+u32 GetQuantizedStride( PositionEncoding encoding, bool normals ) {
+    return GetPositionSize( encoding ) + 4 + ( normals ? 4 : 0 );
+}
+
+//
+VertexStream QuantizedMesh::GetStream() const {
+    return { quantizedElements[ m_position ], m_normals ? 3u : 2u, m_stride, false };
+}
+
+//
+u32 QuantizedMesh::GetColor( u32 i ) const {
+    u32 color;
+    memcpy( &color, &m_vertices[ ( size_t )i * m_stride + GetPositionSize( m_position ) ], sizeof( color ) );
+    return color;
+}
+
+//
+Float3 QuantizedMesh::GetPosition( u32 i ) const {
+    const u8* src = &m_vertices[ ( size_t )i * m_stride ];
+    f32 p[ 3 ];
+    if ( m_position == POSITION_FLOAT32 ) {
+        memcpy( p, src, sizeof( p ) );
+    } else {
+        u16 q[ 3 ];
+        memcpy( q, src, sizeof( q ) );
+        for ( u32 c = 0; c < 3; ++c )
+            p[ c ] = m_position == POSITION_HALF ? HalfToFloat( q[ c ] ) : Snorm16ToFloat( ( i16 )q[ c ] );
+    }
+    const Float4& scale = m_constants.m_positionScale;
+    const Float4& bias = m_constants.m_positionBias;
+    return Float3( p[ 0 ] * scale.x + bias.x, p[ 1 ] * scale.y + bias.y, p[ 2 ] * scale.z + bias.z );
+}
+
+//
+void QuantizeMesh( const Mesh& mesh, const QuantizeDesc& desc, QuantizedMesh& out ) {
+    out.m_position = desc.m_position;
+    out.m_normals = desc.m_normals;
+    out.m_stride = GetQuantizedStride( desc.m_position, desc.m_normals );
+    out.m_vertexCount = mesh.m_vertexCount;
+    out.m_constants = GetIdentityMeshConstants();
+    out.m_vertices.assign( ( size_t )mesh.m_vertexCount * out.m_stride, 0 );
+    out.m_indices.assign( mesh.m_indices, mesh.m_indices + mesh.m_indexCount );
+
+    // half and snorm16 store positions relative to the bounding box, mapped to [-1,1]
+    Float3 center( 0.0f, 0.0f, 0.0f ), extent( 1.0f, 1.0f, 1.0f );
+    if ( desc.m_position != POSITION_FLOAT32 && mesh.m_vertexCount > 0 ) {
+        Float3 lo = mesh.m_vertices[ 0 ].m_pos, hi = lo;
+        for ( u32 i = 1; i < mesh.m_vertexCount; ++i ) {
+            const Float3& p = mesh.m_vertices[ i ].m_pos;
+            lo = Float3( p.x < lo.x ? p.x : lo.x, p.y < lo.y ? p.y : lo.y, p.z < lo.z ? p.z : lo.z );
+            hi = Float3( p.x > hi.x ? p.x : hi.x, p.y > hi.y ? p.y : hi.y, p.z > hi.z ? p.z : hi.z );
+        }
+        center = Float3( ( lo.x + hi.x ) * 0.5f, ( lo.y + hi.y ) * 0.5f, ( lo.z + hi.z ) * 0.5f );
+        extent = Float3( ( hi.x - lo.x ) * 0.5f, ( hi.y - lo.y ) * 0.5f, ( hi.z - lo.z ) * 0.5f );
+        // flat axes keep a unit scale so nothing divides by zero
+        extent.x = extent.x > 0.0f ? extent.x : 1.0f;
+        extent.y = extent.y > 0.0f ? extent.y : 1.0f;
+        extent.z = extent.z > 0.0f ? extent.z : 1.0f;
+        out.m_constants.m_positionScale = Float4( extent.x, extent.y, extent.z, 1.0f );
+        out.m_constants.m_positionBias = Float4( center.x, center.y, center.z, 0.0f );
+    }
+
+    std::vector< Float3 > normals;
+    if ( desc.m_normals )
+        ComputeVertexNormals( mesh, normals );
+
+    const u32 positionSize = GetPositionSize( desc.m_position );
+    for ( u32 i = 0; i < mesh.m_vertexCount; ++i ) {
+        u8* dst = &out.m_vertices[ ( size_t )i * out.m_stride ];
+        const Float3& p = mesh.m_vertices[ i ].m_pos;
+        if ( desc.m_position == POSITION_FLOAT32 ) {
+            memcpy( dst, &p, sizeof( p ) );
+        } else {
+            const f32 n[ 3 ] = { ( p.x - center.x ) / extent.x, ( p.y - center.y ) / extent.y, ( p.z - center.z ) / extent.z };
+            u16 q[ 4 ];
+            for ( u32 c = 0; c < 3; ++c ) {
+                const f32 v = n[ c ] < -1.0f ? -1.0f : ( n[ c ] > 1.0f ? 1.0f : n[ c ] );
+                q[ c ] = desc.m_position == POSITION_HALF ? FloatToHalf( v ) : ( u16 )FloatToSnorm16( v );
+            }
+            // w = 1 so the shader sees the same float4 as from a float3 position
+            q[ 3 ] = desc.m_position == POSITION_HALF ? FloatToHalf( 1.0f ) : ( u16 )FloatToSnorm16( 1.0f );
+            memcpy( dst, q, sizeof( q ) );
+        }
+        const u32 color = PackUnorm8( mesh.m_vertices[ i ].m_color );
+        memcpy( dst + positionSize, &color, sizeof( color ) );
+        if ( desc.m_normals ) {
+            const u32 normal = OctEncodeNormal( normals[ i ] );
+            memcpy( dst + positionSize + 4, &normal, sizeof( normal ) );
+        }
+    }
+}
+
+//
+bool WriteQuantizedMesh( const char* path, const QuantizedMesh& mesh ) {
+    QuantizedMeshHeader header;
+    memset( &header, 0, sizeof( header ) );
+    header.m_magic = QUANTIZED_MESH_MAGIC;
+    header.m_version = QUANTIZED_MESH_VERSION;
+    header.m_position = mesh.m_position;
+    header.m_normals = mesh.m_normals ? 1 : 0;
+    header.m_vertexCount = mesh.m_vertexCount;
+    header.m_indexCount = ( u32 )mesh.m_indices.size();
+    header.m_constants = mesh.m_constants;
+
+    FILE* file = fopen( path, "wb" );
+    if ( file == nullptr )
+        return false;
+    bool written = fwrite( &header, sizeof( header ), 1, file ) == 1;
+    written = written && fwrite( mesh.m_vertices.data(), 1, mesh.m_vertices.size(), file ) == mesh.m_vertices.size();
+    written = written && fwrite( mesh.m_indices.data(), sizeof( u32 ), mesh.m_indices.size(), file ) == mesh.m_indices.size();
+    return fclose( file ) == 0 && written;
+}
+
+//
+bool ReadQuantizedMesh( const char* path, QuantizedMesh& mesh ) {
+    MappedFile file;
+    if ( !file.Open( path ) || file.GetSize() < sizeof( QuantizedMeshHeader ) )
+        return false;
+
+    QuantizedMeshHeader header;
+    memcpy( &header, file.GetData(), sizeof( header ) );
+    if ( header.m_magic != QUANTIZED_MESH_MAGIC || header.m_version != QUANTIZED_MESH_VERSION ||
+         header.m_position >= POSITION_ENCODING_COUNT || header.m_normals > 1 )
+        return false;
+
+    const PositionEncoding position = ( PositionEncoding )header.m_position;
+    const u32 stride = GetQuantizedStride( position, header.m_normals != 0 );
+    const u64 vertexBytes = ( u64 )header.m_vertexCount * stride;
+    const u64 indexBytes = ( u64 )header.m_indexCount * sizeof( u32 );
+    if ( sizeof( header ) + vertexBytes + indexBytes != file.GetSize() )
+        return false;
+
+    const u8* data = file.GetData() + sizeof( header );
+    mesh.m_position = position;
+    mesh.m_normals = header.m_normals != 0;
+    mesh.m_stride = stride;
+    mesh.m_vertexCount = header.m_vertexCount;
+    mesh.m_constants = header.m_constants;
+    mesh.m_vertices.assign( data, data + vertexBytes );
+    mesh.m_indices.resize( header.m_indexCount );
+    memcpy( mesh.m_indices.data(), data + vertexBytes, ( size_t )indexBytes );
+    return true;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "scene.h"
+
+#include <vector>
+
+// compact vertex formats. positions are stored as half floats or 16-bit snorm
+// in the mesh's bounding box, colors as RGBA8 and optional normals as two
+// snorm16 octahedral coordinates, interleaved in one buffer:
+//
+//   encoding   position  color  normal  stride   vs Vertex (28 bytes)
+//   float32    12        4      4       16 / 20
+//   half       8         4      4       12 / 16  2.3x / 1.75x
+//   snorm16    8         4      4       12 / 16  2.3x / 1.75x
+//
+// half and snorm16 store w = 1, so the hardware expands POSITION to a float4
+// like the float3 format does. the vertex shaders finish the decode with
+// pos * positionScale + positionBias from MeshConstants.
+
+enum PositionEncoding : u32 {
+    POSITION_FLOAT32,
+    POSITION_HALF,
+    POSITION_SNORM16,
+    POSITION_ENCODING_COUNT
+};
+
+const char* GetPositionEncodingName( PositionEncoding encoding );
+// false for unknown names, accepts what GetPositionEncodingName returns
+bool ParsePositionEncoding( const char* name, PositionEncoding& encoding );
+
+// cbuffer MeshConstants of the vertex shaders: dequantization of the bound mesh
+struct MeshConstants {
+    Float4 m_positionScale;
+    Float4 m_positionBias;
+};
+
+constexpr CBufferField MESH_CONSTANTS_FIELDS[] = {
+    CBUFFER_FIELD( MeshConstants, m_positionScale, "positionScale" ),
+    CBUFFER_FIELD( MeshConstants, m_positionBias, "positionBias" ),
+};
+static_assert( IsValidCBufferLayout( MESH_CONSTANTS_FIELDS, sizeof( MeshConstants ) ), "MESH_CONSTANTS_FIELDS does not match MeshConstants" );
+
+// scale 1, bias 0: meshes made of Vertex
+MeshConstants GetIdentityMeshConstants();
+
+// scalar codecs. the encoders round to nearest; snorm16 never produces -32768,
+// so decoding does not need the -1 clamp of the D3D conversion rules.
+u16 FloatToHalf( f32 value );
+f32 HalfToFloat( u16 half );
+// 2^112: a half's exponent and mantissa shifted into a float's place, times
+// this, is the half's value. denormals come out right, inf and nan do not.
+constexpr f32 HALF_EXPONENT_SCALE = 5.192296858534828e+33f;
+i16 FloatToSnorm16( f32 value );
+f32 Snorm16ToFloat( i16 value );
+// packs a [0,1] float color the way the output merger does for R8G8B8A8_UNORM, R in the low byte
+u32 PackUnorm8( const Float4& color );
+Float4 UnpackUnorm8( u32 color );
+// unit vector to two snorm16 octahedral coordinates, x in the low half
+u32 OctEncodeNormal( const Float3& normal );
+Float3 OctDecodeNormal( u32 encoded );
+
+// area-weighted face normals accumulated per vertex, for meshes that come
+// without them. front faces are clockwise like the rasterizer state.
+void ComputeVertexNormals( const Mesh& mesh, std::vector< Float3 >& normals );
+
+struct QuantizeDesc {
+    PositionEncoding    m_position = POSITION_SNORM16;
+    bool                m_normals = false;
+};
+
+struct QuantizedMesh {
+    PositionEncoding    m_position = POSITION_FLOAT32;
+    bool                m_normals = false;
+    u32                 m_stride = 0;
+    u32                 m_vertexCount = 0;
+    MeshConstants       m_constants = {};       // decoded position * scale + bias = model-space position
+    std::vector< u8 >   m_vertices;
+    std::vector< u32 >  m_indices;
+
+    // slot-0 layout of the vertex buffer, static storage
+    VertexStream GetStream() const;
+    // the color of vertex i as stored
+    u32 GetColor( u32 i ) const;
+    // the model-space position of vertex i after dequantization
+    Float3 GetPosition( u32 i ) const;
+};
+
+// byte sizes of the interleaved attributes
+u32 GetPositionSize( PositionEncoding encoding );
+u32 GetQuantizedStride( PositionEncoding encoding, bool normals );
+
+void QuantizeMesh( const Mesh& mesh, const QuantizeDesc& desc, QuantizedMesh& out );
+
+// .cgqm: QuantizedMeshHeader, the vertex buffer, the u32 indices. written by
+// the quantize_mesh tool at import so the app loads meshes without re-encoding.
+constexpr u32 QUANTIZED_MESH_MAGIC = 0x4D514743;    // "CGQM"
+constexpr u32 QUANTIZED_MESH_VERSION = 1;
+
+struct QuantizedMeshHeader {
+    u32             m_magic;
+    u32             m_version;
+    u32             m_position;         // PositionEncoding
+    u32             m_normals;
+    u32             m_vertexCount;
+    u32             m_indexCount;
+    MeshConstants   m_constants;
+};
+
+bool WriteQuantizedMesh( const char* path, const QuantizedMesh& mesh );
+// false on a missing file, another version or sizes that do not add up
+bool ReadQuantizedMesh( const char* path, QuantizedMesh& mesh );
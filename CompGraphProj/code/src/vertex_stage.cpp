@@ -0,0 +1,198 @@
+#include "vertex_stage.h"
+
+#include "simd.h"
+
+#include <cstring>
+
+static u32 PaddedCount( u32 count ) {
+    return ( count + SIMD_WIDTH - 1 ) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+//
+void PositionStreams::Assign( const Vertex* vertices, u32 count ) {
+    const u32 padded = PaddedCount( count );
+    m_x.assign( padded, 0.0f );
+    m_y.assign( padded, 0.0f );
+    m_z.assign( padded, 0.0f );
+    for ( u32 i = 0; i < count; ++i ) {
+        m_x[ i ] = vertices[ i ].m_pos.x;
+        m_y[ i ] = vertices[ i ].m_pos.y;
+        m_z[ i ] = vertices[ i ].m_pos.z;
+    }
+    m_packedX.clear();
+    m_packedY.clear();
+    m_packedZ.clear();
+    m_encoding = POSITION_FLOAT32;
+    m_constants = GetIdentityMeshConstants();
+    m_count = count;
+}
+
+//
+void PositionStreams::Assign( const QuantizedMesh& mesh ) {
+    const u32 count = mesh.m_vertexCount;
+    const u32 padded = PaddedCount( count );
+    if ( mesh.m_position == POSITION_FLOAT32 ) {
+        m_x.assign( padded, 0.0f );
+        m_y.assign( padded, 0.0f );
+        m_z.assign( padded, 0.0f );
+        for ( u32 i = 0; i < count; ++i ) {
+            f32 p[ 3 ];
+            memcpy( p, &mesh.m_vertices[ ( size_t )i * mesh.m_stride ], sizeof( p ) );
+            m_x[ i ] = p[ 0 ];
+            m_y[ i ] = p[ 1 ];
+            m_z[ i ] = p[ 2 ];
+        }
+        m_packedX.clear();
+        m_packedY.clear();
+        m_packedZ.clear();
+    } else {
+        m_x.clear();
+        m_y.clear();
+        m_z.clear();
+        m_packedX.assign( padded, 0 );
+        m_packedY.assign( padded, 0 );
+        m_packedZ.assign( padded, 0 );
+        for ( u32 i = 0; i < count; ++i ) {
+            u16 q[ 3 ];
+            memcpy( q, &mesh.m_vertices[ ( size_t )i * mesh.m_stride ], sizeof( q ) );
+            m_packedX[ i ] = q[ 0 ];
+            m_packedY[ i ] = q[ 1 ];
+            m_packedZ[ i ] = q[ 2 ];
+        }
+    }
+    m_encoding = mesh.m_position;
+    m_constants = mesh.m_constants;
+    m_count = count;
+}
+
+//
+void ClipStreams::Resize( u32 count ) {
+    const u32 padded = PaddedCount( count );
+    m_x.resize( padded );
+    m_y.resize( padded );
+    m_z.resize( padded );
+    m_w.resize( padded );
+    m_count = count;
+}
+
+// same scaling as HalfToFloat, finite halves only
+static SIMD_INLINE vf32 DecodeHalf( vi32 half ) {
+    const vf32 sign = AsFloat( ShiftLeft< 16 >( half & Splat( 0x8000 ) ) );
+    const vf32 magnitude = AsFloat( ShiftLeft< 13 >( half & Splat( 0x7FFF ) ) ) * Splat( HALF_EXPONENT_SCALE );
+    return magnitude | sign;
+}
+
+// one stream of positions as floats, before the dequantization scale and bias
+template< PositionEncoding Encoding >
+static SIMD_INLINE vf32 LoadPosition( const std::vector< f32 >& floats, const std::vector< u16 >& packed, u32 i ) {
+    if constexpr ( Encoding == POSITION_FLOAT32 )
+        return Load( &floats[ i ] );
+    else if constexpr ( Encoding == POSITION_HALF )
+        return DecodeHalf( LoadWiden( &packed[ i ] ) );
+    else
+        return ToFloat( LoadWiden( ( const i16* )&packed[ i ] ) );
+}
+
+// scalar LoadPosition
+static Float3 DecodePosition( const PositionStreams& in, u32 i ) {
+    switch ( in.m_encoding ) {
+    case POSITION_HALF:
+        return Float3( HalfToFloat( in.m_packedX[ i ] ), HalfToFloat( in.m_packedY[ i ] ), HalfToFloat( in.m_packedZ[ i ] ) );
+    case POSITION_SNORM16:
+        return Float3( ( f32 )( i16 )in.m_packedX[ i ], ( f32 )( i16 )in.m_packedY[ i ], ( f32 )( i16 )in.m_packedZ[ i ] );
+    default:
+        return Float3( in.m_x[ i ], in.m_y[ i ], in.m_z[ i ] );
+    }
+}
+
+// model with the dequantization in front: snorm16 loads as the raw integer,
+// so the 1 / 32767 of the snorm conversion goes into the scale as well
+static Matrix GetPositionTransform( const PositionStreams& in, const Matrix& model ) {
+    if ( in.m_encoding == POSITION_FLOAT32 )
+        return model;
+    const f32 unit = in.m_encoding == POSITION_SNORM16 ? 1.0f / 32767.0f : 1.0f;
+    const Float4& scale = in.m_constants.m_positionScale;
+    const Float4& bias = in.m_constants.m_positionBias;
+    Matrix decode = MatrixScaling( scale.x * unit, scale.y * unit, scale.z * unit );
+    decode.r[ 3 ] = Float4( bias.x, bias.y, bias.z, 1.0f );
+    return MatrixMultiply( decode, model );
+}
+
+// transforms the SIMD-aligned range [first, end) of in into out shifted by
+// outOffset, optionally applying the x / 1.6 of VertexShader.hlsl
+template< PositionEncoding Encoding >
+static void TransformRange( const PositionStreams& in, u32 first, u32 end, const Matrix& model, bool aspectDivide, ClipStreams& out, u32 outOffset ) {
+    const vf32 m00 = Splat( model.r[ 0 ].x ), m01 = Splat( model.r[ 0 ].y ), m02 = Splat( model.r[ 0 ].z ), m03 = Splat( model.r[ 0 ].w );
+    const vf32 m10 = Splat( model.r[ 1 ].x ), m11 = Splat( model.r[ 1 ].y ), m12 = Splat( model.r[ 1 ].z ), m13 = Splat( model.r[ 1 ].w );
+    const vf32 m20 = Splat( model.r[ 2 ].x ), m21 = Splat( model.r[ 2 ].y ), m22 = Splat( model.r[ 2 ].z ), m23 = Splat( model.r[ 2 ].w );
+    const vf32 m30 = Splat( model.r[ 3 ].x ), m31 = Splat( model.r[ 3 ].y ), m32 = Splat( model.r[ 3 ].z ), m33 = Splat( model.r[ 3 ].w );
+    const vf32 aspect = Splat( 1.6f );
+
+    for ( u32 i = first; i < end; i += SIMD_WIDTH ) {
+        const vf32 x = LoadPosition< Encoding >( in.m_x, in.m_packedX, i );
+        const vf32 y = LoadPosition< Encoding >( in.m_y, in.m_packedY, i );
+        const vf32 z = LoadPosition< Encoding >( in.m_z, in.m_packedZ, i );
+
+        // same association as TransformPoint so both paths agree bit for bit
+        vf32 cx = x * m00 + y * m10 + z * m20 + m30;
+        vf32 cy = x * m01 + y * m11 + z * m21 + m31;
+        vf32 cz = x * m02 + y * m12 + z * m22 + m32;
+        vf32 cw = x * m03 + y * m13 + z * m23 + m33;
+
+        const u32 o = i + outOffset;
+        Store( &out.m_x[ o ], aspectDivide ? cx / aspect : cx );
+        Store( &out.m_y[ o ], cy );
+        Store( &out.m_z[ o ], cz );
+        Store( &out.m_w[ o ], cw );
+    }
+}
+
+// picks the decode for the stream's encoding
+static void TransformRange( const PositionStreams& in, u32 first, u32 end, const Matrix& model, bool aspectDivide, ClipStreams& out, u32 outOffset ) {
+    const Matrix transform = GetPositionTransform( in, model );
+    switch ( in.m_encoding ) {
+    case POSITION_HALF:
+        TransformRange< POSITION_HALF >( in, first, end, transform, aspectDivide, out, outOffset );
+        break;
+    case POSITION_SNORM16:
+        TransformRange< POSITION_SNORM16 >( in, first, end, transform, aspectDivide, out, outOffset );
+        break;
+    default:
+        TransformRange< POSITION_FLOAT32 >( in, first, end, transform, aspectDivide, out, outOffset );
+        break;
+    }
+}
+
+//
+void RunVertexStage( const PositionStreams& in, u32 first, u32 count, const Matrix& model, ClipStreams& out ) {
+    TransformRange( in, first, PaddedCount( first + count ), model, true, out, 0 );
+}
+
+//
+u32 GetInstanceStride( const PositionStreams& in ) {
+    return PaddedCount( in.m_count );
+}
+
+//
+void RunVertexStageInstanced( const PositionStreams& in, const Matrix* transforms, u32 firstInstance, u32 instanceCount, ClipStreams& out ) {
+    const u32 stride = GetInstanceStride( in );
+    for ( u32 i = firstInstance; i < firstInstance + instanceCount; ++i )
+        TransformRange( in, 0, stride, transforms[ i ], false, out, i * stride );
+}
+
+//
+Matrix GetObjectClipTransform( const Matrix& model ) {
+    return MatrixMultiply( model, MatrixScaling( 1.0f / 1.6f, 1.0f, 1.0f ) );
+}
+
+//
+void RunVertexStageScalar( const PositionStreams& in, u32 first, u32 count, const Matrix& model, ClipStreams& out ) {
+    const Matrix transform = GetPositionTransform( in, model );
+    for ( u32 i = first; i < first + count; ++i ) {
+        Float4 pos = TransformPoint( DecodePosition( in, i ), transform );
+        out.m_x[ i ] = pos.x / 1.6f;
+        out.m_y[ i ] = pos.y;
+        out.m_z[ i ] = pos.z;
+        out.m_w[ i ] = pos.w;
+    }
+}
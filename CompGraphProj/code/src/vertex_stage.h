@@ -0,0 +1,53 @@
+#pragma once
+
+#include "scene.h"
+#include "vertex_quantization.h"
+
+#include <vector>
+
+// structure-of-arrays vertex positions. every stream is padded to a multiple
+// of SIMD_WIDTH so batches never need a scalar tail loop. half and snorm16
+// meshes keep their 16-bit positions in the packed streams, the vertex stage
+// decodes them with m_constants on the fly.
+struct PositionStreams {
+    std::vector< f32 >  m_x, m_y, m_z;
+    std::vector< u16 >  m_packedX, m_packedY, m_packedZ;
+    PositionEncoding    m_encoding = POSITION_FLOAT32;
+    MeshConstants       m_constants = GetIdentityMeshConstants();
+    u32                 m_count = 0;
+
+    void Assign( const Vertex* vertices, u32 count );
+    void Assign( const QuantizedMesh& mesh );
+};
+
+// clip-space output of the vertex stage, padded like PositionStreams
+struct ClipStreams {
+    std::vector< f32 >  m_x, m_y, m_z, m_w;
+    u32                 m_count = 0;
+
+    void Resize( u32 count );
+};
+
+// CPU equivalent of VertexShader.hlsl: pos = mul( pos, model ), pos.x /= 1.6.
+// quantized positions are widened to float and transformed by the
+// dequantization folded into model, one matrix for decode and transform.
+// model is the row-major matrix, i.e. the transpose of what goes into the
+// constant buffer. first must be a multiple of SIMD_WIDTH; the batch runs
+// 8 vertices per instruction with AVX2, 4 with SSE2.
+void RunVertexStage( const PositionStreams& in, u32 first, u32 count, const Matrix& model, ClipStreams& out );
+
+// what RunVertexStage does to a model-space position as one matrix, the
+// model followed by the x / 1.6, for culling against the object's clip space
+Matrix GetObjectClipTransform( const Matrix& model );
+
+// instanced variant: instance i is transformed by transforms[ i ] (model *
+// view-projection, row-major) and written to out at i * stride, where stride
+// is the padded vertex count of in. there is no 1.6 aspect divide, the
+// projection in the instanced constants already accounts for it.
+void RunVertexStageInstanced( const PositionStreams& in, const Matrix* transforms, u32 firstInstance, u32 instanceCount, ClipStreams& out );
+
+// padded vertex count of one instance in the instanced clip streams
+u32 GetInstanceStride( const PositionStreams& in );
+
+// one vertex at a time, produces the same bits as RunVertexStage
+void RunVertexStageScalar( const PositionStreams& in, u32 first, u32 count, const Matrix& model, ClipStreams& out );
@@ -0,0 +1,271 @@
+#include "backend_software.h"
+#include "frame_timing.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// renders canonical scenes through the software backend and compares them
+// against the PPM images in the golden directory. each comparison prints the
+// scene's render time next to it, so rasterizer changes show both effects.
+//
+//   compgraph_golden --dir DIR [--update] [filter]
+//
+// --update rewrites the golden images instead of comparing. a failed scene
+// leaves NAME_actual.ppm and NAME_diff.ppm in the working directory.
+
+static const u32 GoldenWidth = 256;
+static const u32 GoldenHeight = 144;
+
+// a channel may differ by this much before the pixel counts as different
+static const u32 ChannelTolerance = 8;
+// edge pixels may flip between compilers and instruction sets, 1 in 500 is allowed
+static const u32 MaxDifferentPerMille = 2;
+
+// renders timed after the first, the best one is reported
+static const u32 TimedRenders = 5;
+
+struct GoldenImage {
+    u32                 m_width = 0;
+    u32                 m_height = 0;
+    std::vector< u8 >   m_rgb;
+};
+
+// setup creates the geometry and uploads the constants of the frame to render.
+// scenes with m_golden compare against another scene's image, e.g. an
+// optimization that must not change what is drawn.
+struct GoldenScene {
+    const char* m_name;
+    bool ( *m_setup )( SoftwareBackend& backend );
+    const char* m_golden = nullptr;
+    bool        m_clusterCulling = false;
+};
+
+//
+static bool SetupCube( SoftwareBackend& backend ) {
+    if ( !backend.CreateObject( GetCubeMesh() ) )
+        return false;
+    // a quarter second in, so three faces are visible
+    Scene scene;
+    ConstantBuffer cb;
+    for ( u32 step = 0; step < 30; ++step )
+        cb = Rotate( scene );
+    backend.UpdateConstants( cb );
+    return true;
+}
+
+//
+static bool SetupCubeField( SoftwareBackend& backend ) {
+    const u32 cubes = 10000;
+    if ( !backend.CreateObject( GetCubeMesh() ) || !backend.CreateInstanceBuffer( cubes ) )
+        return false;
+    CubeFieldScene scene;
+    GenerateCubeField( scene, cubes, ( f32 )GoldenWidth / ( f32 )GoldenHeight );
+    backend.UpdateConstants( AnimateCubeField( scene ) );
+    backend.UpdateInstances( scene.m_instances.data(), cubes );
+    return true;
+}
+
+// the 262k triangle sphere, as Vertex or in a compact vertex format
+static bool SetupSphere( SoftwareBackend& backend, PositionEncoding encoding ) {
+    MeshData sphere;
+    GenerateSphereMesh( sphere, 256, 512 );
+    if ( encoding == POSITION_FLOAT32 ) {
+        if ( !backend.CreateObject( sphere.GetMesh() ) )
+            return false;
+    } else {
+        QuantizeDesc desc;
+        desc.m_position = encoding;
+        QuantizedMesh quantized;
+        QuantizeMesh( sphere.GetMesh(), desc, quantized );
+        if ( !backend.CreateQuantizedObject( quantized ) )
+            return false;
+    }
+
+    // tilted so the poles' dense fans are in view, squeezed into the clip volume's depth range
+    Matrix model = MatrixMultiply( MatrixRotationAxis( Float3( 1.0f, 0.3f, 0.0f ), 0.7f ), MatrixScaling( 0.9f, 0.9f, 0.45f ) );
+    model = MatrixMultiply( model, MatrixTranslation( 0.0f, 0.0f, 0.5f ) );
+    ConstantBuffer cb;
+    cb.m_modelMatrix = MatrixTranspose( model );
+    cb.m_viewProjection = MatrixIdentity();
+    backend.UpdateConstants( cb );
+    return true;
+}
+
+//
+static bool SetupSphereFloat( SoftwareBackend& backend ) {
+    return SetupSphere( backend, POSITION_FLOAT32 );
+}
+
+// 12-byte vertices: snorm16 positions and RGBA8 colors
+static bool SetupSphereSnorm16( SoftwareBackend& backend ) {
+    return SetupSphere( backend, POSITION_SNORM16 );
+}
+
+static const GoldenScene goldenScenes[] = {
+    { "cube", SetupCube },
+    { "cubes_10k", SetupCubeField },
+    { "sphere_262k", SetupSphereFloat },
+    { "sphere_262k_snorm16", SetupSphereSnorm16 },
+    // meshlet culling draws fewer triangles, but the same image
+    { "cube_clusters", SetupCube, "cube", true },
+    { "sphere_262k_clusters", SetupSphereFloat, "sphere_262k", true },
+    { "sphere_262k_snorm16_clusters", SetupSphereSnorm16, "sphere_262k_snorm16", true },
+};
+
+//
+static bool ReadPpm( const std::string& path, GoldenImage& image ) {
+    FILE* file = fopen( path.c_str(), "rb" );
+    if ( file == nullptr )
+        return false;
+    u32 maxValue = 0;
+    const bool header = fscanf( file, "P6 %u %u %u", &image.m_width, &image.m_height, &maxValue ) == 3 && maxValue == 255 && fgetc( file ) != EOF;
+    bool ok = false;
+    if ( header && image.m_width * image.m_height != 0 ) {
+        image.m_rgb.resize( ( size_t )image.m_width * image.m_height * 3 );
+        ok = fread( image.m_rgb.data(), 1, image.m_rgb.size(), file ) == image.m_rgb.size();
+    }
+    fclose( file );
+    return ok;
+}
+
+//
+static bool WritePpm( const std::string& path, const GoldenImage& image ) {
+    FILE* file = fopen( path.c_str(), "wb" );
+    if ( file == nullptr )
+        return false;
+    fprintf( file, "P6\n%u %u\n255\n", image.m_width, image.m_height );
+    const bool written = fwrite( image.m_rgb.data(), 1, image.m_rgb.size(), file ) == image.m_rgb.size();
+    return fclose( file ) == 0 && written;
+}
+
+// the framebuffer holds R in the low byte, alpha is dropped
+static GoldenImage CaptureFramebuffer( const SoftwareBackend& backend ) {
+    GoldenImage image;
+    image.m_width = backend.GetWidth();
+    image.m_height = backend.GetHeight();
+    image.m_rgb.resize( ( size_t )image.m_width * image.m_height * 3 );
+    const u32* pixels = backend.GetFramebuffer();
+    u8* out = image.m_rgb.data();
+    for ( u32 y = 0; y < image.m_height; ++y ) {
+        for ( u32 x = 0; x < image.m_width; ++x ) {
+            const u32 p = pixels[ y * backend.GetPitch() + x ];
+            *out++ = ( u8 )p;
+            *out++ = ( u8 )( p >> 8 );
+            *out++ = ( u8 )( p >> 16 );
+        }
+    }
+    return image;
+}
+
+// counts pixels with a channel off by more than the tolerance and marks them white in diff
+static u32 ComparePixels( const GoldenImage& expected, const GoldenImage& actual, GoldenImage& diff, u32& maxDelta ) {
+    diff.m_width = actual.m_width;
+    diff.m_height = actual.m_height;
+    diff.m_rgb.assign( actual.m_rgb.size(), 0 );
+    maxDelta = 0;
+    u32 different = 0;
+    for ( size_t i = 0; i < actual.m_rgb.size(); i += 3 ) {
+        u32 delta = 0;
+        for ( size_t c = 0; c < 3; ++c ) {
+            const u32 d = ( u32 )abs( ( i32 )expected.m_rgb[ i + c ] - ( i32 )actual.m_rgb[ i + c ] );
+            delta = d > delta ? d : delta;
+        }
+        maxDelta = delta > maxDelta ? delta : maxDelta;
+        if ( delta > ChannelTolerance ) {
+            ++different;
+            memset( &diff.m_rgb[ i ], 0xFF, 3 );
+        }
+    }
+    return different;
+}
+
+// renders one scene, compares or updates its golden image, false on a mismatch or error
+static bool RunScene( const GoldenScene& goldenScene, const std::string& dir, bool update ) {
+    SoftwareBackend backend;
+    BackendDesc desc;
+    desc.m_width = GoldenWidth;
+    desc.m_height = GoldenHeight;
+    desc.m_clusterCulling = goldenScene.m_clusterCulling;
+    if ( !backend.Initialize( desc ) || !goldenScene.m_setup( backend ) ) {
+        printf( "FAIL %-20s could not be set up\n", goldenScene.m_name );
+        return false;
+    }
+
+    // the first render warms caches and allocations, the rest re-render the same frame
+    backend.RenderScene();
+    f64 bestMs = 0.0;
+    for ( u32 i = 0; i < TimedRenders; ++i ) {
+        const FrameClock::time_point start = FrameClock::now();
+        backend.WaitForNextFrame();
+        backend.RenderScene();
+        const f64 ms = SecondsBetween( start, FrameClock::now() ) * 1000.0;
+        bestMs = i == 0 || ms < bestMs ? ms : bestMs;
+    }
+    const GoldenImage actual = CaptureFramebuffer( backend );
+    const ClusterCullStats cull = backend.GetClusterCullStats();
+    backend.Release();
+    if ( goldenScene.m_clusterCulling )
+        printf( "     %-20s %u of %u triangles drawn\n", goldenScene.m_name, cull.m_visibleTriangles, cull.m_triangles );
+
+    const std::string goldenPath = dir + "/" + ( goldenScene.m_golden != nullptr ? goldenScene.m_golden : goldenScene.m_name ) + ".ppm";
+    if ( goldenScene.m_golden != nullptr && update ) {
+        printf( "ok   %-20s compares against %s, %.3f ms\n", goldenScene.m_name, goldenScene.m_golden, bestMs );
+        return true;
+    }
+    if ( update ) {
+        const bool written = WritePpm( goldenPath, actual );
+        printf( "%s %-20s %s, %.3f ms\n", written ? "ok  " : "FAIL", goldenScene.m_name, goldenPath.c_str(), bestMs );
+        return written;
+    }
+
+    GoldenImage expected;
+    if ( !ReadPpm( goldenPath, expected ) ) {
+        printf( "FAIL %-20s %s missing or unreadable, run with --update\n", goldenScene.m_name, goldenPath.c_str() );
+        return false;
+    }
+    if ( expected.m_width != actual.m_width || expected.m_height != actual.m_height ) {
+        printf( "FAIL %-20s golden is %ux%u, rendered %ux%u\n", goldenScene.m_name, expected.m_width, expected.m_height, actual.m_width, actual.m_height );
+        return false;
+    }
+
+    GoldenImage diff;
+    u32 maxDelta = 0;
+    const u32 different = ComparePixels( expected, actual, diff, maxDelta );
+    const u32 pixelCount = actual.m_width * actual.m_height;
+    const bool passed = ( u64 )different * 1000 <= ( u64 )pixelCount * MaxDifferentPerMille;
+    printf( "%s %-20s %u of %u pixels differ (max delta %u), %.3f ms\n",
+        passed ? "ok  " : "FAIL", goldenScene.m_name, different, pixelCount, maxDelta, bestMs );
+    if ( !passed ) {
+        WritePpm( std::string( goldenScene.m_name ) + "_actual.ppm", actual );
+        WritePpm( std::string( goldenScene.m_name ) + "_diff.ppm", diff );
+    }
+    return passed;
+}
+
+//
+int main( int argc, char** argv ) {
+    std::string dir = ".";
+    bool update = false;
+    const char* filter = nullptr;
+    for ( i32 i = 1; i < argc; ++i ) {
+        if ( strcmp( argv[ i ], "--dir" ) == 0 && i + 1 < argc )
+            dir = argv[ ++i ];
+        else if ( strcmp( argv[ i ], "--update" ) == 0 )
+            update = true;
+        else
+            filter = argv[ i ];
+    }
+
+    u32 run = 0, failed = 0;
+    for ( const GoldenScene& scene : goldenScenes ) {
+        if ( filter != nullptr && strstr( scene.m_name, filter ) == nullptr )
+            continue;
+        ++run;
+        failed += RunScene( scene, dir, update ) ? 0 : 1;
+    }
+    printf( "%u scenes, %u failed\n", run, failed );
+    return failed == 0 ? 0 : 1;
+}
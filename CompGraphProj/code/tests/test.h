@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h"
+
+#include <cmath>
+#include <cstdio>
+
+// minimal self-registering test harness, no third-party dependency
+
+using TestFunc = void ( * )();
+
+struct TestCase {
+    const char* m_name;
+    TestFunc    m_func;
+    TestCase*   m_next;
+};
+
+// returns the head of the registered test list
+TestCase*& TestRegistry();
+
+// counts a failure for the currently running test
+void TestFail( const char* file, i32 line, const char* expr );
+
+struct TestRegistrar {
+    TestRegistrar( TestCase* test ) {
+        test->m_next = TestRegistry();
+        TestRegistry() = test;
+    }
+};
+
+#define TEST( name )                                                        \
+    static void name();                                                     \
+    static TestCase name##_case = { #name, &name, nullptr };                \
+    static TestRegistrar name##_registrar( &name##_case );                  \
+    static void name()
+
+#define CHECK( expr )                                                       \
+    do {                                                                    \
+        if ( !( expr ) )                                                    \
+            TestFail( __FILE__, __LINE__, #expr );                          \
+    } while ( 0 )
+
+#define CHECK_NEAR( a, b, eps ) CHECK( std::fabs( ( a ) - ( b ) ) <= ( eps ) )
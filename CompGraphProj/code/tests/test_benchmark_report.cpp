@@ -0,0 +1,66 @@
+#include "test.h"
+
+#include "benchmark_report.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+//
+TEST( FrameStatsUseNearestRank ) {
+    std::vector< f64 > samples;
+    for ( u32 i = 100; i >= 1; --i )
+        samples.push_back( ( f64 )i );
+    const FrameStats stats = ComputeFrameStats( samples );
+    CHECK( stats.m_min == 1.0 && stats.m_max == 100.0 );
+    CHECK_NEAR( stats.m_mean, 50.5, 1e-9 );
+    CHECK( stats.m_p50 == 50.0 );
+    CHECK( stats.m_p95 == 95.0 );
+    CHECK( stats.m_p99 == 99.0 );
+
+    const FrameStats empty = ComputeFrameStats( {} );
+    CHECK( empty.m_min == 0.0 && empty.m_max == 0.0 && empty.m_p99 == 0.0 );
+}
+
+// a frame's stage timings count once, even when the backend reports them again
+TEST( BenchmarkRecorderWritesJson ) {
+    StageTimings stages;
+    stages.m_frame = 1;
+    stages.Add( "Rasterize", 2.0 );
+    stages.Add( "Present", 0.5 );
+
+    BenchmarkRecorder recorder;
+    recorder.AddFrame( 4.0, stages );
+    recorder.AddFrame( 5.0, stages );
+    stages.m_frame = 0;
+    recorder.AddFrame( 6.0, stages );
+    stages.m_frame = 2;
+    stages.m_ms[ 0 ] = 3.0;
+    recorder.AddFrame( 7.0, stages );
+    CHECK( recorder.GetFrameCount() == 4 );
+    CHECK( recorder.GetFrameStats().m_max == 7.0 );
+
+    const char* path = "compgraph_test_benchmark.json";
+    BenchmarkInfo info;
+    info.m_backend = "Software";
+    info.m_cubes = 1;
+    CHECK( recorder.WriteJson( path, info ) );
+
+    std::string json;
+    FILE* file = fopen( path, "rb" );
+    CHECK( file != nullptr );
+    if ( file != nullptr ) {
+        char buffer[ 512 ];
+        size_t read;
+        while ( ( read = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+            json.append( buffer, read );
+        fclose( file );
+    }
+    remove( path );
+
+    CHECK( json.find( "\"frame_ms\": { \"samples\": 4," ) != std::string::npos );
+    CHECK( json.find( "\"Rasterize\": { \"samples\": 2, \"min\": 2.0000" ) != std::string::npos );
+    CHECK( json.find( "\"Present\"" ) != std::string::npos );
+    CHECK( json.find( "\"p99\"" ) != std::string::npos );
+    CHECK( json.find( "\"backend\": \"Software\"" ) != std::string::npos );
+}
@@ -0,0 +1,196 @@
+#include "test.h"
+
+#include "bvh.h"
+#include "job_system.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// small boxes scattered through a 100 unit block, a few of them long
+static std::vector< Aabb > GetTestBoxes( u32 count, u32 seed ) {
+    std::mt19937 rng( seed );
+    std::uniform_real_distribution< f32 > position( -50.0f, 50.0f ), size( 0.1f, 1.5f ), unit( 0.0f, 1.0f );
+    std::vector< Aabb > boxes( count );
+    for ( Aabb& box : boxes ) {
+        const Float3 c( position( rng ), position( rng ), position( rng ) );
+        Float3 e( size( rng ), size( rng ), size( rng ) );
+        if ( unit( rng ) < 0.02f )
+            e.x *= 20.0f;
+        box = { Float3( c.x - e.x, c.y - e.y, c.z - e.z ), Float3( c.x + e.x, c.y + e.y, c.z + e.z ) };
+    }
+    return boxes;
+}
+
+//
+static bool Contains( const BvhNode& node, const Aabb& box ) {
+    return node.m_min.x <= box.m_min.x && node.m_min.y <= box.m_min.y && node.m_min.z <= box.m_min.z &&
+           node.m_max.x >= box.m_max.x && node.m_max.y >= box.m_max.y && node.m_max.z >= box.m_max.z;
+}
+
+// every object in exactly one leaf, every node's box holding its subtree,
+// the left child right after its parent
+static void CheckTree( const Bvh& bvh, const std::vector< Aabb >& boxes ) {
+    const std::vector< BvhNode >& nodes = bvh.GetNodes();
+    const std::vector< u32 >& order = bvh.GetPrimitiveOrder();
+    std::vector< u32 > seen( boxes.size(), 0 );
+    for ( u32 object : order )
+        seen[ object ]++;
+    CHECK( std::count( seen.begin(), seen.end(), 1u ) == ( i64 )boxes.size() );
+
+    u32 leafObjects = 0;
+    for ( size_t i = 0; i < nodes.size(); ++i ) {
+        const BvhNode& node = nodes[ i ];
+        if ( node.m_count > 0 ) {
+            leafObjects += node.m_count;
+            for ( u32 k = node.m_first; k < node.m_first + node.m_count; ++k )
+                CHECK( Contains( node, boxes[ order[ k ] ] ) );
+            continue;
+        }
+        CHECK( node.m_first > i + 1 && node.m_first < nodes.size() );
+        CHECK( Contains( node, { nodes[ i + 1 ].m_min, nodes[ i + 1 ].m_max } ) );
+        CHECK( Contains( node, { nodes[ node.m_first ].m_min, nodes[ node.m_first ].m_max } ) );
+    }
+    CHECK( leafObjects == boxes.size() );
+}
+
+// the parallel build makes the same tree as the serial one, and SAH keeps
+// it far cheaper than testing every object, whose cost is the object count
+TEST( BvhBuildIsValidAndDeterministic ) {
+    const std::vector< Aabb > boxes = GetTestBoxes( 100000, 1 );
+    Bvh serial, parallel;
+    serial.Build( boxes.data(), ( u32 )boxes.size() );
+    JobSystem jobs( 3 );
+    parallel.Build( boxes.data(), ( u32 )boxes.size(), &jobs );
+    CheckTree( serial, boxes );
+    CHECK( serial.GetNodes().size() == parallel.GetNodes().size() );
+    CHECK( memcmp( serial.GetNodes().data(), parallel.GetNodes().data(), serial.GetNodes().size() * sizeof( BvhNode ) ) == 0 );
+    CHECK( serial.GetPrimitiveOrder() == parallel.GetPrimitiveOrder() );
+    CHECK( serial.GetCost() > 1.0f && serial.GetCost() * 100.0f < ( f32 )boxes.size() );
+
+    // one object, and many on one spot, which binning cannot split
+    Bvh single;
+    single.Build( boxes.data(), 1 );
+    CHECK( single.GetNodes().size() == 1 && single.GetNodes()[ 0 ].m_count == 1 );
+    const std::vector< Aabb > stacked( 100, boxes[ 0 ] );
+    Bvh same;
+    same.Build( stacked.data(), ( u32 )stacked.size() );
+    CheckTree( same, stacked );
+}
+
+// accepts rectangles that lie entirely behind depth 0.9
+struct FarOccluder : OcclusionTest {
+    bool IsOccluded( const Float4&, f32 minDepth ) const override { return minDepth > 0.9f; }
+};
+
+// the queries find what testing every object finds
+TEST( BvhQueriesMatchBruteForce ) {
+    const std::vector< Aabb > boxes = GetTestBoxes( 20000, 2 );
+    Bvh bvh;
+    bvh.Build( boxes.data(), ( u32 )boxes.size() );
+    const Matrix clip = MatrixMultiply( MatrixLookAtLH( Float3( -10.0f, 5.0f, -70.0f ), Float3( 5.0f, 0.0f, 0.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+                                        MatrixPerspectiveFovLH( 0.9f, 1.6f, 0.5f, 200.0f ) );
+    const Frustum frustum = MakeFrustum( clip );
+    const FarOccluder occluder;
+
+    std::vector< u32 > inside, unoccluded;
+    for ( u32 i = 0; i < ( u32 )boxes.size(); ++i ) {
+        const Float3 c( 0.5f * ( boxes[ i ].m_min.x + boxes[ i ].m_max.x ), 0.5f * ( boxes[ i ].m_min.y + boxes[ i ].m_max.y ),
+                        0.5f * ( boxes[ i ].m_min.z + boxes[ i ].m_max.z ) );
+        const Float3 e( boxes[ i ].m_max.x - c.x, boxes[ i ].m_max.y - c.y, boxes[ i ].m_max.z - c.z );
+        if ( IsBoxOutside( frustum, c, e ) )
+            continue;
+        inside.push_back( i );
+        if ( !IsBoxOccluded( occluder, clip, c, e ) )
+            unoccluded.push_back( i );
+    }
+    CHECK( unoccluded.size() < inside.size() && inside.size() < boxes.size() );
+
+    std::vector< u32 > visible;
+    CHECK( bvh.CullFrustum( frustum, visible ) == inside.size() );
+    std::sort( visible.begin(), visible.end() );
+    CHECK( visible == inside );
+    visible.clear();
+    CHECK( bvh.CullOccluded( frustum, clip, occluder, visible ) == unoccluded.size() );
+    std::sort( visible.begin(), visible.end() );
+    CHECK( visible == unoccluded );
+
+    // rays from outside towards the block: the nearest box entry
+    std::mt19937 rng( 9 );
+    std::uniform_real_distribution< f32 > target( -40.0f, 40.0f );
+    u32 hits = 0;
+    for ( u32 r = 0; r < 200; ++r ) {
+        const Float3 origin( target( rng ), target( rng ), -80.0f );
+        const Float3 direction( target( rng ) - origin.x, target( rng ) - origin.y, target( rng ) - origin.z );
+        const Float3 inv( 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z );
+        f32 nearest = FLT_MAX;
+        for ( const Aabb& box : boxes ) {
+            const f32 tx0 = ( box.m_min.x - origin.x ) * inv.x, tx1 = ( box.m_max.x - origin.x ) * inv.x;
+            const f32 ty0 = ( box.m_min.y - origin.y ) * inv.y, ty1 = ( box.m_max.y - origin.y ) * inv.y;
+            const f32 tz0 = ( box.m_min.z - origin.z ) * inv.z, tz1 = ( box.m_max.z - origin.z ) * inv.z;
+            const f32 t0 = std::max( { 0.0f, std::min( tx0, tx1 ), std::min( ty0, ty1 ), std::min( tz0, tz1 ) } );
+            const f32 t1 = std::min( { std::max( tx0, tx1 ), std::max( ty0, ty1 ), std::max( tz0, tz1 ) } );
+            if ( t0 <= t1 )
+                nearest = std::min( nearest, t0 );
+        }
+        BvhRayHit hit;
+        const bool found = bvh.Raycast( origin, direction, hit );
+        CHECK( found == ( nearest != FLT_MAX ) );
+        if ( found )
+            CHECK( hit.m_t == nearest );
+        hits += found ? 1 : 0;
+    }
+    CHECK( hits > 20 );
+}
+
+// small moves refit the tree; scrambling every object degrades it until it
+// is rebuilt
+TEST( BvhRefitsAndRebuildsWhenDegraded ) {
+    std::vector< Aabb > boxes = GetTestBoxes( 20000, 3 );
+    Bvh bvh;
+    JobSystem jobs( 2 );
+    bvh.Build( boxes.data(), ( u32 )boxes.size(), &jobs );
+    const f32 built = bvh.GetBuildCost();
+
+    for ( Aabb& box : boxes ) {
+        box.m_min.y += 0.3f;
+        box.m_max.y += 0.3f;
+    }
+    CHECK( !bvh.Update( boxes.data(), &jobs ) );
+    CheckTree( bvh, boxes );
+    CHECK( bvh.GetBuildCost() == built && bvh.GetCost() < built * BVH_REBUILD_RATIO );
+
+    std::vector< Aabb > scrambled = GetTestBoxes( 20000, 4 );
+    Bvh refitted;
+    refitted.Build( boxes.data(), ( u32 )boxes.size() );
+    refitted.Refit( scrambled.data() );
+    CheckTree( refitted, scrambled );
+    CHECK( refitted.GetCost() > built * BVH_REBUILD_RATIO );
+    CHECK( bvh.Update( scrambled.data(), &jobs ) );
+    CheckTree( bvh, scrambled );
+    CHECK( bvh.GetCost() < refitted.GetCost() && bvh.GetBuildCost() == bvh.GetCost() );
+}
+
+// clicking the projected center of the nearest cube picks it
+TEST( PickCubeFindsTheCubeUnderTheCursor ) {
+    CubeFieldScene scene;
+    GenerateCubeField( scene, 1000, 1.6f );
+    AnimateCubeField( scene );
+
+    u32 nearest = BVH_NONE;
+    f32 nearestW = FLT_MAX;
+    for ( u32 i = 0; i < scene.m_cubeCount; ++i ) {
+        const Float4 c = TransformPoint( GetCube( scene, i ).m_position, scene.m_viewProjection );
+        if ( c.w > 0.0f && c.w < nearestW ) {
+            nearestW = c.w;
+            nearest = i;
+        }
+    }
+    const Float4 c = TransformPoint( GetCube( scene, nearest ).m_position, scene.m_viewProjection );
+    CHECK( PickCube( scene, c.x / c.w, c.y / c.w ) == nearest );
+    // straight up from the camera there is nothing
+    CHECK( PickCube( scene, 0.0f, 50.0f ) == BVH_NONE );
+}
@@ -0,0 +1,119 @@
+#include "test.h"
+
+#include "entity_store.h"
+#include "job_system.h"
+#include "scene.h"
+
+#include <cmath>
+#include <vector>
+
+// the rows of every chunk of one archetype, and whether they fill every
+// chunk but the last
+static u32 CountRows( EntityStore& store, u32 components, bool& packed ) {
+    const u32 capacity = EntityStore::GetChunkCapacity( components );
+    u32 rows = 0, partial = 0;
+    bool aligned = true;
+    store.ForEachChunk( components, nullptr, [ & ]( const EcsChunk& chunk ) {
+        rows += chunk.GetCount();
+        partial += chunk.GetCount() < capacity ? 1 : 0;
+        aligned = aligned && chunk.GetCount() > 0 && chunk.GetFirst() % capacity == 0;
+    } );
+    packed = aligned && partial <= 1;
+    return rows;
+}
+
+// destroyed entities are replaced by the last row, their handles stop
+// working and their slots come back with a new generation
+TEST( EntityStoreKeepsChunksPacked ) {
+    const u32 components = ECS_TRANSFORM | ECS_MATERIAL;
+    const u32 count = 3000;
+    CHECK( EntityStore::GetChunkCapacity( components ) % ECS_CHUNK_ROWS_ALIGN == 0 );
+    CHECK( EntityStore::GetChunkCapacity( components ) < count / 4 );
+
+    EntityStore store;
+    std::vector< Entity > entities( count );
+    for ( u32 i = 0; i < count; ++i ) {
+        entities[ i ] = store.Create( components );
+        *store.Get( entities[ i ], ECS_POSITION_X ) = ( f32 )i;
+        *store.Get( entities[ i ], ECS_COLOR_A ) = 1.0f;
+    }
+    CHECK( store.Get( entities[ 0 ], ECS_ANGULAR_SPEED ) == nullptr );
+
+    for ( u32 i = 0; i < count; i += 3 )
+        CHECK( store.Destroy( entities[ i ] ) );
+    CHECK( !store.Destroy( entities[ 0 ] ) );
+    CHECK( !store.IsAlive( entities[ 3 ] ) && store.Get( entities[ 3 ], ECS_POSITION_X ) == nullptr );
+
+    bool packed;
+    CHECK( CountRows( store, components, packed ) == count - count / 3 && packed );
+    CHECK( store.GetCount( ECS_TRANSFORM ) == count - count / 3 );
+    u32 wrong = 0;
+    for ( u32 i = 0; i < count; ++i ) {
+        if ( i % 3 != 0 )
+            wrong += *store.Get( entities[ i ], ECS_POSITION_X ) != ( f32 )i ? 1 : 0;
+    }
+    CHECK( wrong == 0 );
+
+    const Entity reused = store.Create( components );
+    CHECK( reused.m_index == entities[ count - 3 ].m_index && reused.m_generation != entities[ count - 3 ].m_generation );
+    CHECK( store.IsAlive( reused ) && !store.IsAlive( entities[ count - 3 ] ) );
+    CHECK( *store.Get( reused, ECS_POSITION_X ) == 0.0f && *store.Get( reused, ECS_COLOR_A ) == 0.0f );
+}
+
+// an entity that gains or loses components moves archetype and keeps the
+// fields both have
+TEST( EntityStoreMovesBetweenArchetypes ) {
+    EntityStore store;
+    const Entity a = store.Create( ECS_TRANSFORM );
+    const Entity b = store.Create( ECS_TRANSFORM );
+    *store.Get( a, ECS_ANGLE ) = 1.5f;
+    *store.Get( b, ECS_ANGLE ) = 2.5f;
+
+    CHECK( store.SetComponents( a, ECS_TRANSFORM | ECS_SPIN | ECS_MESH ) );
+    CHECK( store.GetComponents( a ) == ( ECS_TRANSFORM | ECS_SPIN | ECS_MESH ) );
+    CHECK( *store.Get( a, ECS_ANGLE ) == 1.5f && *store.Get( a, ECS_ANGULAR_SPEED ) == 0.0f );
+    *store.GetU32( a, ECS_MESH_INDEX ) = 7;
+    CHECK( *store.Get( b, ECS_ANGLE ) == 2.5f );
+    CHECK( store.GetCount( ECS_TRANSFORM ) == 2 && store.GetCount( ECS_SPIN ) == 1 );
+
+    CHECK( store.SetComponents( a, ECS_MESH ) );
+    CHECK( store.Get( a, ECS_ANGLE ) == nullptr && *store.GetU32( a, ECS_MESH_INDEX ) == 7 );
+    CHECK( store.GetCount( ECS_TRANSFORM ) == 1 && store.GetCount( ECS_SPIN ) == 0 );
+    bool packed;
+    CHECK( CountRows( store, ECS_TRANSFORM | ECS_SPIN, packed ) == 0 );
+}
+
+// the rotate system turns every spinning entity as one step of the scalar
+// update would, on any thread count, and leaves the others alone
+TEST( RotateSystemMatchesScalarUpdate ) {
+    CubeFieldScene scene;
+    GenerateCubeField( scene, 10007, 1.0f );
+    std::vector< CubeInstance > expected( scene.m_cubeCount );
+    for ( u32 i = 0; i < scene.m_cubeCount; ++i )
+        expected[ i ] = GetCube( scene, i );
+    const Entity still = scene.m_entities.Create( ECS_TRANSFORM );
+    *scene.m_entities.Get( still, ECS_ANGLE ) = 1.0f;
+
+    JobSystem jobs( 3 );
+    const f32 dt = 0.25f;
+    for ( u32 step = 0; step < 40; ++step ) {
+        RotateSystem( scene.m_entities, dt, step % 2 == 0 ? &jobs : nullptr );
+        for ( CubeInstance& cube : expected ) {
+            cube.m_prevAngle = cube.m_angle;
+            cube.m_angle += cube.m_angularSpeed * dt;
+            if ( cube.m_angle >= MATH_2PI ) {
+                cube.m_angle -= MATH_2PI;
+                cube.m_prevAngle -= MATH_2PI;
+            }
+        }
+    }
+
+    u32 wrong = 0;
+    for ( u32 i = 0; i < scene.m_cubeCount; ++i ) {
+        const CubeInstance cube = GetCube( scene, i );
+        wrong += std::fabs( cube.m_angle - expected[ i ].m_angle ) > 1e-5f || std::fabs( cube.m_prevAngle - expected[ i ].m_prevAngle ) > 1e-5f ? 1 : 0;
+        wrong += cube.m_angle < 0.0f || cube.m_angle >= MATH_2PI ? 1 : 0;
+    }
+    CHECK( wrong == 0 );
+    CHECK( *scene.m_entities.Get( still, ECS_ANGLE ) == 1.0f );
+}
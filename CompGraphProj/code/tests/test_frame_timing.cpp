@@ -0,0 +1,70 @@
+#include "test.h"
+
+#include "frame_timing.h"
+#include "scene.h"
+
+#include <cstring>
+
+//
+TEST( FixedTimestepAccumulatesPartialFrames ) {
+    FixedTimestep timestep( 0.01 );
+    CHECK( timestep.Advance( 0.004 ) == 0 );
+    CHECK_NEAR( timestep.GetAlpha(), 0.4f, 1e-5f );
+    CHECK( timestep.Advance( 0.007 ) == 1 );
+    CHECK_NEAR( timestep.GetAlpha(), 0.1f, 1e-5f );
+    CHECK( timestep.Advance( 0.025 ) == 2 );
+    CHECK_NEAR( timestep.GetAlpha(), 0.6f, 1e-5f );
+}
+
+// a stall runs at most maxStepsPerFrame steps and drops the rest
+TEST( FixedTimestepClampsLongStalls ) {
+    FixedTimestep timestep( 0.01, 4 );
+    CHECK( timestep.Advance( 1.005 ) == 4 );
+    CHECK( timestep.GetAlpha() >= 0.0f && timestep.GetAlpha() < 1.0f );
+    CHECK( timestep.Advance( 0.0 ) == 0 );
+}
+
+// the same total time gives the same simulation no matter how it is split into frames
+TEST( SimulationDoesNotDependOnFrameRate ) {
+    Scene fast, slow;
+    FixedTimestep fastStep( SIMULATION_STEP ), slowStep( SIMULATION_STEP );
+    for ( u32 frame = 0; frame < 600; ++frame ) {
+        for ( u32 s = fastStep.Advance( 1.0 / 600.0 ); s > 0; --s )
+            UpdateScene( fast, SIMULATION_STEP );
+    }
+    for ( u32 frame = 0; frame < 50; ++frame ) {
+        for ( u32 s = slowStep.Advance( 1.0 / 50.0 ); s > 0; --s )
+            UpdateScene( slow, SIMULATION_STEP );
+    }
+    CHECK_NEAR( fast.m_angle, slow.m_angle, SIMULATION_STEP );
+}
+
+// alpha 0 renders the previous step, alpha 1 the current one
+TEST( SceneConstantsInterpolateBetweenSteps ) {
+    Scene scene;
+    UpdateScene( scene, SIMULATION_STEP );
+    UpdateScene( scene, SIMULATION_STEP );
+
+    Scene previous;
+    UpdateScene( previous, SIMULATION_STEP );
+
+    ConstantBuffer atPrevious = GetSceneConstants( scene, 0.0f );
+    ConstantBuffer expected = GetSceneConstants( previous, 1.0f );
+    CHECK( memcmp( &atPrevious.m_modelMatrix, &expected.m_modelMatrix, sizeof( Matrix ) ) == 0 );
+
+    ConstantBuffer half = GetSceneConstants( scene, 0.5f );
+    ConstantBuffer end = GetSceneConstants( scene, 1.0f );
+    CHECK( memcmp( &half.m_modelMatrix, &end.m_modelMatrix, sizeof( Matrix ) ) != 0 );
+}
+
+//
+TEST( FrameLimiterHoldsTheTargetRate ) {
+    FrameLimiter limiter;
+    limiter.SetTargetFps( 200.0 );
+    limiter.Wait();
+    FrameClock::time_point start = FrameClock::now();
+    for ( u32 i = 0; i < 10; ++i )
+        limiter.Wait();
+    f64 seconds = SecondsBetween( start, FrameClock::now() );
+    CHECK( seconds >= 0.045 );
+}
@@ -0,0 +1,158 @@
+#include "test.h"
+
+#include "backend_software.h"
+#include "frustum_culling.h"
+#include "job_system.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// a camera at the origin looking down +z with a narrow field of view
+static Matrix GetTestCamera() {
+    return MatrixMultiply( MatrixLookAtLH( Float3( 0.0f, 0.0f, 0.0f ), Float3( 0.3f, -0.2f, 1.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+                           MatrixPerspectiveFovLH( 0.7f, 1.6f, 0.5f, 40.0f ) );
+}
+
+// random boxes and spheres around the frustum, many of them across its planes
+static CullingBounds GetTestBounds( u32 count, u32 seed ) {
+    std::mt19937 rng( seed );
+    std::uniform_real_distribution< f32 > position( -30.0f, 30.0f ), size( 0.05f, 3.0f );
+    CullingBounds bounds;
+    bounds.Resize( count );
+    for ( u32 i = 0; i < count; ++i ) {
+        const Float3 center( position( rng ), position( rng ), position( rng ) + 15.0f );
+        const Float3 extent( size( rng ), size( rng ), size( rng ) );
+        bounds.Set( i, center, extent, std::sqrt( Vector3Dot( extent, extent ) ) );
+    }
+    return bounds;
+}
+
+// a point is inside every plane exactly when it is inside the clip volume
+TEST( FrustumPlanesBoundTheClipVolume ) {
+    const Matrix clip = GetTestCamera();
+    const Frustum frustum = MakeFrustum( clip );
+    std::mt19937 rng( 3 );
+    std::uniform_real_distribution< f32 > position( -40.0f, 40.0f );
+    u32 inside = 0;
+    for ( u32 i = 0; i < 20000; ++i ) {
+        const Float3 p( position( rng ), position( rng ), position( rng ) );
+        const Float4 c = TransformPoint( p, clip );
+        const bool clipInside = c.x >= -c.w && c.x <= c.w && c.y >= -c.w && c.y <= c.w && c.z >= 0.0f && c.z <= c.w;
+        f32 nearest = 1e30f;
+        for ( const Float4& plane : frustum.m_planes )
+            nearest = std::min( nearest, plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w );
+        // points within rounding of a plane may go either way
+        if ( std::fabs( nearest ) > 1e-3f )
+            CHECK( clipInside == ( nearest > 0.0f ) );
+        inside += clipInside ? 1 : 0;
+    }
+    CHECK( inside > 100 );
+}
+
+// the SIMD kernel reports the objects the scalar tests keep, in order, also
+// for a count that ends inside a SIMD group, and culls only boxes whose
+// corners are all outside one clip plane
+TEST( SimdFrustumCullingMatchesScalar ) {
+    const u32 count = 10007;
+    const CullingBounds bounds = GetTestBounds( count, 11 );
+    const Matrix clip = GetTestCamera();
+    const Frustum frustum = MakeFrustum( clip );
+
+    std::vector< u32 > spheres, boxes;
+    for ( u32 i = 0; i < count; ++i ) {
+        const Float3 center( bounds.m_centerX[ i ], bounds.m_centerY[ i ], bounds.m_centerZ[ i ] );
+        const Float3 extent( bounds.m_extentX[ i ], bounds.m_extentY[ i ], bounds.m_extentZ[ i ] );
+        if ( !IsSphereOutside( frustum, center, bounds.m_radius[ i ] ) )
+            spheres.push_back( i );
+        if ( IsBoxOutside( frustum, center, extent ) ) {
+            bool rejected = false;
+            const u32 planes = 6;
+            for ( u32 p = 0; p < planes && !rejected; ++p ) {
+                bool allOutside = true;
+                for ( u32 corner = 0; corner < 8; ++corner ) {
+                    const Float3 q( center.x + ( corner & 1 ? extent.x : -extent.x ), center.y + ( corner & 2 ? extent.y : -extent.y ),
+                                    center.z + ( corner & 4 ? extent.z : -extent.z ) );
+                    const Float4 c = TransformPoint( q, clip );
+                    const f32 d[ planes ] = { c.w + c.x, c.w - c.x, c.w + c.y, c.w - c.y, c.z, c.w - c.z };
+                    allOutside = allOutside && d[ p ] < 1e-4f;
+                }
+                rejected = allOutside;
+            }
+            CHECK( rejected );
+        } else {
+            boxes.push_back( i );
+        }
+    }
+    CHECK( !boxes.empty() && boxes.size() < count / 2 );
+    // the boxes are tighter than the spheres around them
+    CHECK( boxes.size() <= spheres.size() );
+
+    std::vector< u32 > out( count + SIMD_WIDTH );
+    const u32 visibleSpheres = CullBounds( bounds, 0, count, frustum, FRUSTUM_TEST_SPHERES, out.data() );
+    CHECK( std::vector< u32 >( out.begin(), out.begin() + visibleSpheres ) == spheres );
+    const u32 visibleBoxes = CullBounds( bounds, 0, count, frustum, FRUSTUM_TEST_BOXES, out.data() );
+    CHECK( std::vector< u32 >( out.begin(), out.begin() + visibleBoxes ) == boxes );
+}
+
+// batches on jobs give the same list as one serial pass
+TEST( FrustumCullerCompactsAcrossJobs ) {
+    const u32 count = 100003;
+    const CullingBounds bounds = GetTestBounds( count, 5 );
+    const Frustum frustum = MakeFrustum( GetTestCamera() );
+
+    std::vector< u32 > expected( count + SIMD_WIDTH );
+    expected.resize( CullBounds( bounds, 0, count, frustum, FRUSTUM_TEST_BOXES, expected.data() ) );
+
+    FrustumCuller serial, parallel;
+    JobSystem jobs( 3 );
+    CHECK( serial.Cull( bounds, frustum ) == expected.size() );
+    for ( u32 frame = 0; frame < 2; ++frame ) {
+        CHECK( parallel.Cull( bounds, frustum, FRUSTUM_TEST_BOXES, &jobs ) == expected.size() );
+        CHECK( std::vector< u32 >( parallel.GetVisible(), parallel.GetVisible() + parallel.GetVisibleCount() ) == expected );
+    }
+    CHECK( std::vector< u32 >( serial.GetVisible(), serial.GetVisible() + serial.GetVisibleCount() ) == expected );
+}
+
+// a camera inside the cube field draws fewer instances with any culling
+// and the same pixels
+TEST( CulledCubeFieldKeepsTheImage ) {
+    const u32 width = 200, height = 120, cubes = 1000;
+    const CubeFieldCulling modes[ 5 ] = { CUBE_FIELD_CULL_NONE, CUBE_FIELD_CULL_FRUSTUM, CUBE_FIELD_CULL_BVH, CUBE_FIELD_CULL_FRUSTUM, CUBE_FIELD_CULL_BVH };
+    std::vector< u32 > frames[ 5 ];
+    u32 drawn[ 5 ] = {}, occluded[ 5 ] = {};
+    for ( u32 run = 0; run < 5; ++run ) {
+        SoftwareBackend backend;
+        BackendDesc desc;
+        desc.m_width = width;
+        desc.m_height = height;
+        desc.m_threadCount = 2;
+        CHECK( backend.Initialize( desc ) );
+        CHECK( backend.CreateObject( GetCubeMesh() ) );
+        CHECK( backend.CreateInstanceBuffer( cubes ) );
+
+        CubeFieldScene scene;
+        GenerateCubeField( scene, cubes, ( f32 )width / ( f32 )height );
+        scene.m_culling = modes[ run ];
+        scene.m_occlusionCulling = run >= 3;
+        scene.m_viewProjection = MatrixMultiply( MatrixLookAtLH( Float3( -3.0f, 2.0f, -12.0f ), Float3( 2.0f, -1.0f, 0.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+                                                 MatrixPerspectiveFovLH( 0.6f, ( f32 )width / ( f32 )height, 0.1f, 100.0f ) );
+        backend.UpdateConstants( AnimateCubeField( scene ) );
+        backend.UpdateInstances( scene.m_instances.data(), scene.m_instanceCount );
+        backend.RenderScene();
+        drawn[ run ] = scene.m_instanceCount;
+        occluded[ run ] = scene.m_occludedCount;
+
+        frames[ run ].assign( backend.GetFramebuffer(), backend.GetFramebuffer() + backend.GetPitch() * height );
+        backend.Release();
+    }
+    CHECK( drawn[ 0 ] == cubes && drawn[ 1 ] > 0 && drawn[ 1 ] < cubes / 2 );
+    CHECK( drawn[ 2 ] > 0 && drawn[ 2 ] < cubes / 2 );
+    // both occlusion runs see the same boxes, only the frustum tests differ
+    CHECK( occluded[ 3 ] > 0 && drawn[ 3 ] + occluded[ 3 ] == drawn[ 1 ] );
+    CHECK( occluded[ 4 ] > 0 && drawn[ 4 ] + occluded[ 4 ] == drawn[ 2 ] );
+    for ( u32 run = 1; run < 5; ++run )
+        CHECK( frames[ 0 ] == frames[ run ] );
+}
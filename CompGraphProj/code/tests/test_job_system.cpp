@@ -0,0 +1,83 @@
+#include "test.h"
+
+#include "job_system.h"
+
+#include <atomic>
+#include <vector>
+
+// every index runs exactly once, whatever the thread count and batch size
+TEST( ParallelForVisitsEveryIndexOnce ) {
+    for ( u32 threads : { 1u, 2u, 5u } ) {
+        JobSystem jobs( threads );
+        for ( u32 batch : { 0u, 1u, 7u } ) {
+            std::vector< std::atomic< u32 > > hits( 10000 );
+            jobs.ParallelFor( ( u32 )hits.size(), [ & ]( u32 i ) { hits[ i ].fetch_add( 1 ); }, batch );
+
+            u32 wrong = 0;
+            for ( std::atomic< u32 >& hit : hits )
+                wrong += hit.load() != 1 ? 1 : 0;
+            CHECK( wrong == 0 );
+        }
+    }
+}
+
+// jobs may fan out again and wait for their children
+TEST( NestedParallelForCompletes ) {
+    JobSystem jobs( 4 );
+    std::atomic< u32 > total{ 0 };
+    jobs.ParallelFor( 16, [ & ]( u32 ) {
+        jobs.ParallelFor( 100, [ & ]( u32 ) { total.fetch_add( 1 ); }, 1 );
+    }, 1 );
+    CHECK( total.load() == 1600 );
+}
+
+struct StageData {
+    std::atomic< u32 >  m_first{ 0 };
+    std::atomic< u32 >  m_secondSawFirst{ 0 };
+};
+
+// jobs queued with RunAfter start only after every job of their dependency finished
+TEST( RunAfterWaitsForDependency ) {
+    JobSystem jobs( 4 );
+    StageData data;
+
+    JobDecl first;
+    first.m_data = &data;
+    first.m_function = []( void* d, u32, u32 ) { ( ( StageData* )d )->m_first.fetch_add( 1 ); };
+    JobDecl second;
+    second.m_data = &data;
+    second.m_function = []( void* d, u32, u32 ) {
+        StageData& stage = *( StageData* )d;
+        if ( stage.m_first.load() == 64 )
+            stage.m_secondSawFirst.fetch_add( 1 );
+    };
+
+    std::vector< JobDecl > firstJobs( 64, first ), secondJobs( 8, second );
+    JobCounter firstDone, secondDone;
+    jobs.Run( firstJobs.data(), ( u32 )firstJobs.size(), &firstDone );
+    jobs.RunAfter( firstDone, secondJobs.data(), ( u32 )secondJobs.size(), &secondDone );
+    jobs.Wait( secondDone );
+    CHECK( firstDone.IsDone() );
+    CHECK( data.m_secondSawFirst.load() == 8 );
+
+    // a dependency that is already done releases the jobs right away
+    JobCounter thirdDone;
+    jobs.RunAfter( firstDone, secondJobs.data(), 1, &thirdDone );
+    jobs.Wait( thirdDone );
+    CHECK( data.m_secondSawFirst.load() == 9 );
+}
+
+// more jobs than a worker has slots still all run
+TEST( RunOverflowsInline ) {
+    JobSystem jobs( 2 );
+    std::atomic< u32 > count{ 0 };
+    JobDecl job;
+    job.m_data = &count;
+    job.m_function = []( void* d, u32 begin, u32 end ) { ( ( std::atomic< u32 >* )d )->fetch_add( end - begin ); };
+    std::vector< JobDecl > decls( 5000, job );
+
+    JobCounter done;
+    jobs.Run( decls.data(), ( u32 )decls.size(), &done );
+    jobs.Wait( done );
+    CHECK( count.load() == 5000 );
+}
@@ -0,0 +1,47 @@
+#include "test.h"
+
+#include <cstring>
+#include <vector>
+
+static u32 currentFailures = 0;
+
+//
+TestCase*& TestRegistry() {
+    static TestCase* head = nullptr;
+    return head;
+}
+
+//
+void TestFail( const char* file, i32 line, const char* expr ) {
+    printf( "  %s:%d: CHECK( %s ) failed\n", file, line, expr );
+    ++currentFailures;
+}
+
+// runs every test whose name contains argv[1], or all of them
+int main( int argc, char** argv ) {
+    const char* filter = argc > 1 ? argv[ 1 ] : nullptr;
+
+    // registration prepends, so reverse to run in declaration order per file
+    std::vector< TestCase* > tests;
+    for ( TestCase* test = TestRegistry(); test != nullptr; test = test->m_next )
+        tests.insert( tests.begin(), test );
+
+    u32 run = 0, failed = 0;
+    for ( TestCase* test : tests ) {
+        if ( filter != nullptr && strstr( test->m_name, filter ) == nullptr )
+            continue;
+
+        currentFailures = 0;
+        test->m_func();
+        ++run;
+        if ( currentFailures != 0 ) {
+            ++failed;
+            printf( "FAIL %s\n", test->m_name );
+        } else {
+            printf( "ok   %s\n", test->m_name );
+        }
+    }
+
+    printf( "%u tests, %u failed\n", run, failed );
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+#include "test.h"
+
+#include "job_system.h"
+#include "mesh_import.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* const ObjPath = "compgraph_test_mesh.obj";
+
+static bool SamePosition( const Float3& a, const Float3& b ) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// a right-handed, counter-clockwise sphere as an exporter would write it
+static std::string WriteSphereObj( const MeshData& sphere ) {
+    std::string text = "# sphere\r\no sphere\r\n";
+    char line[ 128 ];
+    for ( const Vertex& v : sphere.m_vertices ) {
+        snprintf( line, sizeof( line ), "v %.9g %.9g %.9g\r\n", v.m_pos.x, v.m_pos.y, -v.m_pos.z );
+        text += line;
+    }
+    for ( size_t i = 0; i < sphere.m_indices.size(); i += 3 ) {
+        snprintf( line, sizeof( line ), "f %u %u %u\r\n", sphere.m_indices[ i ] + 1, sphere.m_indices[ i + 1 ] + 1, sphere.m_indices[ i + 2 ] + 1 );
+        text += line;
+    }
+    return text;
+}
+
+// quads fan into triangles, negative and v//vn corners resolve, shared corners
+// become one vertex and z flips into the renderer's left-handed space
+TEST( ObjParsesFacesAndIndices ) {
+    const char* text =
+        "# quad facing +z\n"
+        "mtllib none.mtl\n"
+        "v 0 0 +1.5\n"
+        "v 1 0 1.5\n"
+        "v 1 1 1.5\n"
+        "  v 0 1 1.5e0\n"
+        "vt 0 0\n"
+        "vn 0 0 1\n"
+        "usemtl none\n"
+        "f -4//-1 -3//-1 -2//-1 -1//-1\n"
+        "f 1/1/1 3/1/1 4/1/1\n";
+    MeshData mesh;
+    CHECK( ImportObj( text, strlen( text ), mesh ) );
+    CHECK( mesh.m_vertices.size() == 4 && mesh.m_indices.size() == 9 );
+    const u32 expected[] = { 0, 1, 2, 0, 2, 3, 0, 2, 3 };
+    CHECK( memcmp( mesh.m_indices.data(), expected, sizeof( expected ) ) == 0 );
+    CHECK( SamePosition( mesh.m_vertices[ 2 ].m_pos, Float3( 1.0f, 1.0f, -1.5f ) ) );
+    // the normal flips with z, 0.5 + 0.5 * n
+    CHECK( mesh.m_vertices[ 0 ].m_color.z == 0.0f && mesh.m_vertices[ 0 ].m_color.x == 0.5f );
+
+    const char* broken[] = { "v 0 0 0\nf 1 2 3\n", "v 0 0 0\nv 0 0 0\nv 0 0 0\nf 0 1 2\n", "v 0 0\n", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1/1/x 2 3\n" };
+    for ( const char* source : broken )
+        CHECK( !ImportObj( source, strlen( source ), mesh ) );
+}
+
+// more than one chunk parses the same with and without jobs and keeps the geometry
+TEST( ObjChunksMatchSource ) {
+    MeshData sphere;
+    GenerateSphereMesh( sphere, 128, 256 );
+    const std::string text = WriteSphereObj( sphere );
+    CHECK( text.size() > 2 << 20 );
+
+    MeshData serial, parallel;
+    JobSystem jobs( 4 );
+    CHECK( ImportObj( text.data(), text.size(), serial ) );
+    CHECK( ImportObj( text.data(), text.size(), parallel, &jobs ) );
+    CHECK( serial.m_indices == parallel.m_indices );
+    CHECK( memcmp( serial.m_vertices.data(), parallel.m_vertices.data(), serial.m_vertices.size() * sizeof( Vertex ) ) == 0 );
+
+    CHECK( serial.m_vertices.size() == sphere.m_vertices.size() && serial.m_indices.size() == sphere.m_indices.size() );
+    for ( size_t i = 0; i < sphere.m_indices.size(); ++i )
+        CHECK( SamePosition( serial.m_vertices[ serial.m_indices[ i ] ].m_pos, sphere.m_vertices[ sphere.m_indices[ i ] ].m_pos ) );
+    // no normals in the file: colored by computed ones, which point outwards
+    const Vertex& top = serial.m_vertices[ serial.m_indices[ sphere.m_indices.size() / 2 ] ];
+    const Float3 n( top.m_color.x * 2.0f - 1.0f, top.m_color.y * 2.0f - 1.0f, top.m_color.z * 2.0f - 1.0f );
+    CHECK( Vector3Dot( n, top.m_pos ) > 0.9f );
+}
+
+//
+static std::string EncodeBase64( const void* data, size_t size ) {
+    static const char* const digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const u8* bytes = ( const u8* )data;
+    std::string text;
+    for ( size_t i = 0; i < size; i += 3 ) {
+        const u32 chunk = ( bytes[ i ] << 16 ) | ( i + 1 < size ? bytes[ i + 1 ] << 8 : 0 ) | ( i + 2 < size ? bytes[ i + 2 ] : 0 );
+        text += digits[ chunk >> 18 ];
+        text += digits[ ( chunk >> 12 ) & 63 ];
+        text += i + 1 < size ? digits[ ( chunk >> 6 ) & 63 ] : '=';
+        text += i + 2 < size ? digits[ chunk & 63 ] : '=';
+    }
+    return text;
+}
+
+// one triangle with u16 indices and u8 colors, drawn by two nodes: the second
+// mirrors it, which turns the winding around, and vertices repeated in the
+// buffer merge
+TEST( GltfNodesAndBuffers ) {
+    struct {
+        f32 m_positions[ 4 ][ 3 ] = { { 0, 0, 1 }, { 1, 0, 1 }, { 0, 1, 1 }, { 0, 0, 1 } };
+        u8  m_colors[ 4 ][ 4 ] = { { 255, 0, 0, 255 }, { 0, 255, 0, 255 }, { 0, 0, 255, 255 }, { 255, 0, 0, 255 } };
+        u16 m_indices[ 3 ] = { 0, 1, 2 };
+        u16 m_padding = 0;
+    } buffer;
+    static_assert( sizeof( buffer ) == 48 + 16 + 8, "buffer has no gaps" );
+
+    const std::string json = std::string(
+        "{ \"asset\": { \"version\": \"2.0\" }, \"scene\": 0, \"scenes\": [ { \"nodes\": [ 0 ] } ],\n"
+        "  \"nodes\": [ { \"mesh\": 0, \"translation\": [ 10, 0, 0 ], \"children\": [ 1 ] }, { \"mesh\": 0, \"scale\": [ -1, 1, 1 ] } ],\n"
+        "  \"meshes\": [ { \"primitives\": [ { \"attributes\": { \"POSITION\": 0, \"COLOR_0\": 1 }, \"indices\": 2 } ] } ],\n"
+        "  \"accessors\": [ { \"bufferView\": 0, \"componentType\": 5126, \"count\": 4, \"type\": \"VEC3\" },\n"
+        "                 { \"bufferView\": 1, \"componentType\": 5121, \"normalized\": true, \"count\": 4, \"type\": \"VEC4\" },\n"
+        "                 { \"bufferView\": 2, \"componentType\": 5123, \"count\": 3, \"type\": \"SCALAR\" } ],\n"
+        "  \"bufferViews\": [ { \"buffer\": 0, \"byteLength\": 48 }, { \"buffer\": 0, \"byteOffset\": 48, \"byteLength\": 16 },\n"
+        "                   { \"buffer\": 0, \"byteOffset\": 64, \"byteLength\": 6 } ],\n"
+        "  \"buffers\": [ { \"byteLength\": 72" );
+    const std::string gltf = json + ", \"uri\": \"data:application/octet-stream;base64," + EncodeBase64( &buffer, sizeof( buffer ) ) + "\" } ] }";
+
+    // .glb: header, JSON chunk padded with spaces, BIN chunk
+    std::string glbJson = json + " } ] }";
+    glbJson.resize( ( glbJson.size() + 3 ) & ~( size_t )3, ' ' );
+    std::vector< u8 > glb( 12 + 8 + glbJson.size() + 8 + sizeof( buffer ) );
+    const u32 header[ 5 ] = { 0x46546C67, 2, ( u32 )glb.size(), ( u32 )glbJson.size(), 0x4E4F534A };
+    const u32 binHeader[ 2 ] = { ( u32 )sizeof( buffer ), 0x004E4942 };
+    memcpy( glb.data(), header, sizeof( header ) );
+    memcpy( glb.data() + 20, glbJson.data(), glbJson.size() );
+    memcpy( glb.data() + 20 + glbJson.size(), binHeader, sizeof( binHeader ) );
+    memcpy( glb.data() + 28 + glbJson.size(), &buffer, sizeof( buffer ) );
+
+    MeshData fromGltf, fromGlb;
+    CHECK( ImportGltf( ( const u8* )gltf.data(), gltf.size(), "", fromGltf ) );
+    CHECK( ImportGltf( glb.data(), glb.size(), "", fromGlb ) );
+    CHECK( fromGltf.m_indices == fromGlb.m_indices );
+    CHECK( fromGltf.m_vertices.size() == fromGlb.m_vertices.size() );
+
+    const MeshData& mesh = fromGlb;
+    // 4 + 4 vertices: the repeated one merges, and so do the two corners on the mirror plane
+    CHECK( mesh.m_vertices.size() == 4 && mesh.m_indices.size() == 6 );
+    CHECK( SamePosition( mesh.m_vertices[ mesh.m_indices[ 1 ] ].m_pos, Float3( 11.0f, 0.0f, -1.0f ) ) );
+    CHECK( mesh.m_vertices[ mesh.m_indices[ 1 ] ].m_color.y == 1.0f );
+    // the child inherits the translation and swaps its last two corners
+    CHECK( SamePosition( mesh.m_vertices[ mesh.m_indices[ 4 ] ].m_pos, Float3( 10.0f, 1.0f, -1.0f ) ) );
+    CHECK( SamePosition( mesh.m_vertices[ mesh.m_indices[ 5 ] ].m_pos, Float3( 9.0f, 0.0f, -1.0f ) ) );
+
+    const std::string truncated = gltf.substr( 0, gltf.size() - 10 );
+    CHECK( !ImportGltf( ( const u8* )truncated.data(), truncated.size(), "", fromGltf ) );
+
+    // counts, strides, offsets and indices that do not fit an integer are rejected
+    const char* const malformed[][ 2 ] = {
+        { "\"count\": 4, \"type\": \"VEC3\"", "\"count\": -4, \"type\": \"VEC3\"" },
+        { "\"count\": 4, \"type\": \"VEC3\"", "\"count\": 1e300, \"type\": \"VEC3\"" },
+        { "\"count\": 4, \"type\": \"VEC3\"", "\"count\": 2.5, \"type\": \"VEC3\"" },
+        { "\"buffer\": 0, \"byteLength\": 48", "\"buffer\": 0, \"byteLength\": 48, \"byteStride\": 1e300" },
+        { "\"byteOffset\": 48,", "\"byteOffset\": -1e300," },
+        { "\"byteOffset\": 64, \"byteLength\": 6", "\"byteOffset\": 64, \"byteLength\": 1e20" },
+        { "\"componentType\": 5123", "\"componentType\": -5123" },
+        { "\"nodes\": [ 0 ]", "\"nodes\": [ -1e300 ]" },
+        { "\"children\": [ 1 ]", "\"children\": [ 1e300 ]" },
+    };
+    for ( const auto& edit : malformed ) {
+        std::string source = gltf;
+        const size_t at = source.find( edit[ 0 ] );
+        CHECK( at != std::string::npos );
+        source.replace( at, strlen( edit[ 0 ] ), edit[ 1 ] );
+        CHECK( !ImportGltf( ( const u8* )source.data(), source.size(), "", fromGltf ) );
+    }
+    glb[ 8 ] = 0xFF;
+    CHECK( !ImportGltf( glb.data(), glb.size(), "", fromGlb ) );
+}
+
+// the second load maps the cache, a changed source is imported again
+TEST( MeshCacheFollowsSource ) {
+    const std::string cachePath = std::string( ObjPath ) + MESH_CACHE_EXTENSION;
+    const char* quad = "v -1 0 0\nv 1 0 0\nv 1 2 0\nv -1 2 0\nf 1 2 3 4\n";
+    FILE* file = fopen( ObjPath, "wb" );
+    CHECK( file != nullptr );
+    fputs( quad, file );
+    fclose( file );
+    remove( cachePath.c_str() );
+
+    LoadedMesh imported, cached;
+    CHECK( LoadMesh( ObjPath, imported ) && !imported.IsMapped() );
+    CHECK( LoadMesh( ObjPath, cached ) && cached.IsMapped() );
+    const Mesh& a = imported.GetMesh();
+    const Mesh& b = cached.GetMesh();
+    CHECK( a.m_vertexCount == 4 && b.m_vertexCount == 4 && a.m_indexCount == 6 && b.m_indexCount == 6 );
+    CHECK( memcmp( a.m_vertices, b.m_vertices, 4 * sizeof( Vertex ) ) == 0 && memcmp( a.m_indices, b.m_indices, 6 * sizeof( u32 ) ) == 0 );
+    CHECK( SamePosition( cached.GetBoundsMin(), Float3( -1.0f, 0.0f, 0.0f ) ) && SamePosition( cached.GetBoundsMax(), Float3( 1.0f, 2.0f, 0.0f ) ) );
+
+    // fitted into the unit cube around the origin
+    const Float4 corner = TransformPoint( cached.GetBoundsMax(), GetFitTransform( cached.GetBoundsMin(), cached.GetBoundsMax() ) );
+    CHECK( corner.x == 0.5f && corner.y == 0.5f && corner.z == 0.0f );
+
+    file = fopen( ObjPath, "ab" );
+    fputs( "f 1 3 4\n", file );
+    fclose( file );
+    LoadedMesh changed;
+    CHECK( LoadMesh( ObjPath, changed ) && !changed.IsMapped() && changed.GetMesh().m_indexCount == 9 );
+    remove( ObjPath );
+    remove( cachePath.c_str() );
+    CHECK( !LoadMesh( ObjPath, changed ) );
+}
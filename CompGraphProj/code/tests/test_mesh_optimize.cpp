@@ -0,0 +1,118 @@
+#include "test.h"
+
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+#include <tuple>
+#include <vector>
+
+using Triangle = std::array< f32, 9 >;
+
+// the triangles as position triples, rotated to start at their smallest corner
+// so the comparison ignores which corner comes first but not the winding
+static std::vector< Triangle > GetTriangles( const MeshData& mesh ) {
+    std::vector< Triangle > triangles;
+    for ( size_t i = 0; i + 2 < mesh.m_indices.size(); i += 3 ) {
+        std::array< Float3, 3 > p = { mesh.m_vertices[ mesh.m_indices[ i ] ].m_pos, mesh.m_vertices[ mesh.m_indices[ i + 1 ] ].m_pos,
+                                      mesh.m_vertices[ mesh.m_indices[ i + 2 ] ].m_pos };
+        u32 first = 0;
+        for ( u32 k = 1; k < 3; ++k ) {
+            if ( std::tie( p[ k ].x, p[ k ].y, p[ k ].z ) < std::tie( p[ first ].x, p[ first ].y, p[ first ].z ) )
+                first = k;
+        }
+        Triangle t;
+        for ( u32 k = 0; k < 3; ++k ) {
+            const Float3& q = p[ ( first + k ) % 3 ];
+            t[ k * 3 ] = q.x;
+            t[ k * 3 + 1 ] = q.y;
+            t[ k * 3 + 2 ] = q.z;
+        }
+        triangles.push_back( t );
+    }
+    std::sort( triangles.begin(), triangles.end() );
+    return triangles;
+}
+
+// known values: no reuse within a triangle, full reuse once a fan is cached
+TEST( VertexCacheStatsCountMisses ) {
+    const u32 triangle[] = { 0, 1, 2 };
+    VertexCacheStats stats = AnalyzeVertexCache( triangle, 3, 3 );
+    CHECK( stats.m_acmr == 3.0f && stats.m_atvr == 1.0f );
+
+    // a fan of 8 triangles around vertex 0 loads each of its 10 vertices once
+    std::vector< u32 > fan;
+    for ( u32 i = 1; i <= 8; ++i )
+        fan.insert( fan.end(), { 0, i, i + 1 } );
+    stats = AnalyzeVertexCache( fan.data(), ( u32 )fan.size(), 10 );
+    CHECK( stats.m_acmr == 10.0f / 8.0f && stats.m_atvr == 1.0f );
+
+    // a 1-entry cache only keeps the last vertex, which never comes right back
+    stats = AnalyzeVertexCache( fan.data(), ( u32 )fan.size(), 10, 1 );
+    CHECK( stats.m_acmr == 3.0f );
+}
+
+// a sphere in random triangle order gets back to good reuse, keeps every
+// triangle with its winding and reads the vertex buffer in first-use order
+TEST( OptimizeMeshRestoresLocality ) {
+    MeshData mesh;
+    GenerateSphereMesh( mesh, 48, 96 );
+    std::mt19937 rng( 7 );
+    std::vector< u32 > order( mesh.m_indices.size() / 3 );
+    for ( u32 i = 0; i < ( u32 )order.size(); ++i )
+        order[ i ] = i;
+    std::shuffle( order.begin(), order.end(), rng );
+    std::vector< u32 > shuffled;
+    for ( u32 t : order )
+        shuffled.insert( shuffled.end(), mesh.m_indices.begin() + t * 3, mesh.m_indices.begin() + t * 3 + 3 );
+    mesh.m_indices.swap( shuffled );
+    const std::vector< Triangle > before = GetTriangles( mesh );
+
+    const MeshOptimizeStats stats = OptimizeMesh( mesh );
+    CHECK( stats.m_before.m_acmr > 2.5f );
+    CHECK( stats.m_after.m_acmr < 0.8f );
+    CHECK( stats.m_after.m_atvr < 1.5f );
+    CHECK( GetTriangles( mesh ) == before );
+
+    u32 next = 0;
+    for ( u32 index : mesh.m_indices ) {
+        CHECK( index <= next );
+        next = index == next ? next + 1 : next;
+    }
+    CHECK( next == ( u32 )mesh.m_vertices.size() );
+}
+
+// clusters start on triangle boundaries, and sorting them keeps every
+// triangle and gives up little of the reuse
+TEST( OptimizeOverdrawKeepsCacheEfficiency ) {
+    MeshData mesh;
+    GenerateSphereMesh( mesh, 32, 64 );
+    const u32 vertexCount = ( u32 )mesh.m_vertices.size();
+    std::vector< u32 > indices, clusters;
+    OptimizeVertexCache( mesh.m_indices.data(), ( u32 )mesh.m_indices.size(), vertexCount, indices, &clusters );
+    CHECK( !clusters.empty() && clusters[ 0 ] == 0 );
+    for ( u32 c : clusters )
+        CHECK( c % 3 == 0 && c < indices.size() );
+
+    const f32 cacheAcmr = AnalyzeVertexCache( indices.data(), ( u32 )indices.size(), vertexCount ).m_acmr;
+    std::vector< u32 > sorted = indices;
+    OptimizeOverdraw( sorted, clusters, mesh.m_vertices.data(), vertexCount, 1.05f );
+    CHECK( sorted.size() == indices.size() );
+    CHECK( AnalyzeVertexCache( sorted.data(), ( u32 )sorted.size(), vertexCount ).m_acmr < cacheAcmr * 1.1f );
+
+    std::vector< u32 > a = indices, b = sorted;
+    std::sort( a.begin(), a.end() );
+    std::sort( b.begin(), b.end() );
+    CHECK( a == b );
+}
+
+//
+TEST( Index16FollowsVertexCount ) {
+    CHECK( CanUseIndex16( 65536 ) && !CanUseIndex16( 65537 ) );
+    const u32 indices[] = { 0, 65535, 7 };
+    std::vector< u16 > packed;
+    PackIndex16( indices, 3, packed );
+    CHECK( packed.size() == 3 && packed[ 1 ] == 65535 && packed[ 2 ] == 7 );
+}
@@ -0,0 +1,181 @@
+#include "test.h"
+
+#include "backend_software.h"
+#include "job_system.h"
+#include "mesh_optimize.h"
+#include "meshlet.h"
+#include "vertex_stage.h"
+
+#include <cstring>
+#include <vector>
+
+// the sphere in the order LoadMesh leaves imported meshes in
+static MeshData GetOptimizedSphere( u32 rings, u32 segments ) {
+    MeshData sphere;
+    GenerateSphereMesh( sphere, rings, segments );
+    OptimizeMesh( sphere );
+    return sphere;
+}
+
+// twice the signed area of the triangle in NDC times its w's: negative for
+// the clockwise front faces the rasterizer keeps
+static f32 GetClipWinding( const Float4& a, const Float4& b, const Float4& c ) {
+    return a.x * ( b.y * c.w - b.w * c.y ) - a.y * ( b.x * c.w - b.w * c.x ) + a.w * ( b.x * c.y - b.y * c.x );
+}
+
+// a perspective camera looking at the sphere from a corner, and the cube's view
+static std::vector< Matrix > GetTestViews() {
+    const Matrix model = MatrixMultiply( MatrixRotationAxis( Float3( 0.3f, 1.0f, 0.2f ), 0.9f ), MatrixTranslation( 0.2f, -0.1f, 0.3f ) );
+    const Matrix camera = MatrixMultiply( MatrixLookAtLH( Float3( 1.5f, 1.0f, -2.5f ), Float3( 0.0f, 0.0f, 0.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+                                          MatrixPerspectiveFovLH( 0.8f, 1.6f, 0.1f, 10.0f ) );
+    const Matrix tilted = MatrixMultiply( MatrixRotationAxis( Float3( 1.0f, 0.3f, 0.0f ), 0.7f ), MatrixScaling( 0.9f, 0.9f, 0.45f ) );
+    return { MatrixMultiply( model, camera ), GetObjectClipTransform( MatrixMultiply( tilted, MatrixTranslation( 0.0f, 0.0f, 0.5f ) ) ) };
+}
+
+// meshlets are consecutive, within the limits, and their bounds hold every triangle
+TEST( MeshletsPartitionTheIndexBuffer ) {
+    const MeshData sphere = GetOptimizedSphere( 32, 64 );
+    MeshletMesh meshlets;
+    BuildMeshlets( sphere.GetMesh(), meshlets );
+    CHECK( meshlets.m_meshlets.size() == meshlets.m_bounds.size() );
+    CHECK( meshlets.m_meshlets.size() >= sphere.m_indices.size() / 3 / MESHLET_MAX_TRIANGLES );
+
+    u32 next = 0;
+    f32 cutoffs = 0.0f;
+    std::vector< u32 > seen( sphere.m_vertices.size(), ~0u );
+    for ( size_t m = 0; m < meshlets.m_meshlets.size(); ++m ) {
+        const Meshlet& meshlet = meshlets.m_meshlets[ m ];
+        const MeshletBounds& bounds = meshlets.m_bounds[ m ];
+        CHECK( meshlet.m_firstIndex == next );
+        CHECK( meshlet.m_triangleCount > 0 && meshlet.m_triangleCount <= MESHLET_MAX_TRIANGLES );
+        next += meshlet.m_triangleCount * 3;
+
+        u32 distinct = 0;
+        for ( u32 i = meshlet.m_firstIndex; i < next; ++i ) {
+            const u32 v = sphere.m_indices[ i ];
+            distinct += seen[ v ] != m ? 1 : 0;
+            seen[ v ] = ( u32 )m;
+            const Float3& p = sphere.m_vertices[ v ].m_pos;
+            const Float3 d( p.x - bounds.m_center.x, p.y - bounds.m_center.y, p.z - bounds.m_center.z );
+            CHECK( Vector3Dot( d, d ) <= bounds.m_radius * bounds.m_radius * 1.0001f );
+        }
+        CHECK( distinct == meshlet.m_vertexCount && distinct <= MESHLET_MAX_VERTICES );
+
+        cutoffs += bounds.m_coneCutoff;
+    }
+    CHECK( next == sphere.m_indices.size() );
+    // a sphere's meshlets are small caps with narrow cones
+    CHECK( cutoffs < 0.5f * meshlets.m_meshlets.size() );
+}
+
+// a culled meshlet has only triangles the rasterizer would drop: all back
+// facing, or all outside one clip plane
+TEST( ClusterCullingIsConservative ) {
+    const MeshData sphere = GetOptimizedSphere( 48, 96 );
+    MeshletMesh meshlets;
+    BuildMeshlets( sphere.GetMesh(), meshlets );
+
+    for ( const Matrix& clip : GetTestViews() ) {
+        const ClusterCullView view = MakeClusterCullView( clip );
+        u32 backfacing = 0;
+        for ( size_t m = 0; m < meshlets.m_meshlets.size(); ++m ) {
+            const Meshlet& meshlet = meshlets.m_meshlets[ m ];
+            const MeshletBounds& bounds = meshlets.m_bounds[ m ];
+            const bool back = IsBackfacing( bounds, view );
+            const bool outside = IsOutsideFrustum( bounds, view );
+            backfacing += back ? 1 : 0;
+            for ( u32 i = meshlet.m_firstIndex; i < meshlet.m_firstIndex + meshlet.m_triangleCount * 3; i += 3 ) {
+                Float4 p[ 3 ];
+                for ( u32 k = 0; k < 3; ++k )
+                    p[ k ] = TransformPoint( sphere.m_vertices[ sphere.m_indices[ i + k ] ].m_pos, clip );
+                // the poles' degenerate triangles come out as rounding noise around 0
+                if ( back )
+                    CHECK( GetClipWinding( p[ 0 ], p[ 1 ], p[ 2 ] ) >= -1e-5f );
+                if ( outside ) {
+                    bool rejected = false;
+                    const f32 planes[ 6 ][ 3 ] = {
+                        { p[ 0 ].w + p[ 0 ].x, p[ 1 ].w + p[ 1 ].x, p[ 2 ].w + p[ 2 ].x }, { p[ 0 ].w - p[ 0 ].x, p[ 1 ].w - p[ 1 ].x, p[ 2 ].w - p[ 2 ].x },
+                        { p[ 0 ].w + p[ 0 ].y, p[ 1 ].w + p[ 1 ].y, p[ 2 ].w + p[ 2 ].y }, { p[ 0 ].w - p[ 0 ].y, p[ 1 ].w - p[ 1 ].y, p[ 2 ].w - p[ 2 ].y },
+                        { p[ 0 ].z, p[ 1 ].z, p[ 2 ].z }, { p[ 0 ].w - p[ 0 ].z, p[ 1 ].w - p[ 1 ].z, p[ 2 ].w - p[ 2 ].z },
+                    };
+                    for ( const auto& d : planes )
+                        rejected = rejected || ( d[ 0 ] < 0.0f && d[ 1 ] < 0.0f && d[ 2 ] < 0.0f );
+                    CHECK( rejected );
+                }
+            }
+        }
+        // about half of a sphere faces away, the cones find most of it
+        CHECK( backfacing * 3 > meshlets.m_meshlets.size() );
+    }
+}
+
+// hides every meshlet that lies entirely behind depth 0.35, the sphere's rim
+struct DepthOccluder : OcclusionTest {
+    bool IsOccluded( const Float4& rect, f32 minDepth ) const override {
+        return rect.x <= rect.z && rect.y <= rect.w && minDepth > 0.35f;
+    }
+};
+
+// the compacted stream is the visible meshlets' ranges in order, the same
+// with and without jobs, and the statistics add up
+TEST( ClusterCullerCompactsVisibleMeshlets ) {
+    const MeshData sphere = GetOptimizedSphere( 64, 128 );
+    MeshletMesh meshlets;
+    BuildMeshlets( sphere.GetMesh(), meshlets );
+    DepthOccluder occluder;
+    const ClusterCullView view = MakeClusterCullView( GetTestViews()[ 1 ], &occluder );
+
+    std::vector< u32 > expected;
+    for ( size_t m = 0; m < meshlets.m_meshlets.size(); ++m ) {
+        const MeshletBounds& bounds = meshlets.m_bounds[ m ];
+        if ( IsBackfacing( bounds, view ) || IsOutsideFrustum( bounds, view ) || IsOccluded( bounds, view ) )
+            continue;
+        const Meshlet& meshlet = meshlets.m_meshlets[ m ];
+        expected.insert( expected.end(), sphere.m_indices.begin() + meshlet.m_firstIndex,
+                         sphere.m_indices.begin() + meshlet.m_firstIndex + meshlet.m_triangleCount * 3 );
+    }
+
+    ClusterCuller serial, parallel;
+    JobSystem jobs( 3 );
+    CHECK( serial.Cull( meshlets, sphere.m_indices.data(), view ) == expected.size() );
+    CHECK( parallel.Cull( meshlets, sphere.m_indices.data(), view, &jobs ) == expected.size() );
+    CHECK( memcmp( serial.GetIndices(), expected.data(), expected.size() * sizeof( u32 ) ) == 0 );
+    CHECK( memcmp( parallel.GetIndices(), expected.data(), expected.size() * sizeof( u32 ) ) == 0 );
+
+    const ClusterCullStats& stats = parallel.GetStats();
+    CHECK( stats.m_meshlets == meshlets.m_meshlets.size() );
+    CHECK( stats.m_triangles == sphere.m_indices.size() / 3 );
+    CHECK( stats.m_visibleTriangles * 3 == expected.size() );
+    CHECK( stats.m_backfaceCulled > 0 && stats.m_occlusionCulled > 0 );
+}
+
+// the backend draws fewer triangles with culling and the same pixels
+TEST( ClusterCullingKeepsTheImage ) {
+    const MeshData sphere = GetOptimizedSphere( 64, 128 );
+    Scene scene;
+    for ( u32 step = 0; step < 20; ++step )
+        Rotate( scene );
+    const ConstantBuffer cb = Rotate( scene );
+
+    std::vector< u32 > frames[ 2 ];
+    for ( u32 run = 0; run < 2; ++run ) {
+        SoftwareBackend backend;
+        BackendDesc desc;
+        desc.m_width = 200;
+        desc.m_height = 120;
+        desc.m_threadCount = 2;
+        desc.m_clusterCulling = run == 1;
+        CHECK( backend.Initialize( desc ) );
+        CHECK( backend.CreateObject( sphere.GetMesh() ) );
+        backend.UpdateConstants( cb );
+        backend.RenderScene();
+        frames[ run ].assign( backend.GetFramebuffer(), backend.GetFramebuffer() + backend.GetPitch() * desc.m_height );
+        if ( run == 1 ) {
+            const ClusterCullStats& stats = backend.GetClusterCullStats();
+            CHECK( stats.m_visibleTriangles * 10 < stats.m_triangles * 7 );
+            CHECK( strcmp( backend.GetStageTimings().m_names[ 0 ], "ClusterCull" ) == 0 );
+        }
+        backend.Release();
+    }
+    CHECK( frames[ 0 ] == frames[ 1 ] );
+}
@@ -0,0 +1,97 @@
+#include "test.h"
+
+#include "job_system.h"
+#include "occlusion_culling.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// a camera at the origin looking down +z, with the buffer's aspect
+static Matrix GetTestCamera() {
+    return MatrixMultiply( MatrixLookAtLH( Float3( 0.0f, 0.0f, 0.0f ), Float3( 0.0f, 0.0f, 1.0f ), Float3( 0.0f, 1.0f, 0.0f ) ),
+                           MatrixPerspectiveFovLH( 1.0f, 2.0f, 0.5f, 100.0f ) );
+}
+
+// a square facing the camera, clockwise on screen: top left, top right, bottom right
+static const Float3 wallPositions[] = {
+    Float3( -4.0f, 4.0f, 0.0f ), Float3( 4.0f, 4.0f, 0.0f ), Float3( 4.0f, -4.0f, 0.0f ), Float3( -4.0f, -4.0f, 0.0f ),
+};
+static const u32 wallIndices[] = { 0, 1, 2, 0, 2, 3 };
+static const u32 wallBackIndices[] = { 0, 2, 1, 0, 3, 2 };
+
+//
+static bool IsOccluded( const HiZBuffer& hiz, const Float3& center, f32 extent ) {
+    return IsBoxOccluded( hiz, GetTestCamera(), center, Float3( extent, extent, extent ) );
+}
+
+// boxes entirely behind the wall on screen are hidden, boxes in front of it,
+// through it or reaching past its edge are not, and its back hides nothing
+TEST( HiZWallHidesWhatIsBehindIt ) {
+    HiZBuffer hiz;
+    hiz.Begin( GetTestCamera() );
+    hiz.AddOccluder( wallPositions, sizeof( Float3 ), wallIndices, 6, MatrixTranslation( 0.0f, 0.0f, 10.0f ) );
+    hiz.Finish();
+    CHECK( hiz.GetOccluderTriangleCount() == 2 );
+
+    CHECK( IsOccluded( hiz, Float3( 0.0f, 0.0f, 20.0f ), 1.0f ) );
+    CHECK( IsOccluded( hiz, Float3( 2.0f, -1.0f, 11.5f ), 1.0f ) );
+    CHECK( !IsOccluded( hiz, Float3( 0.0f, 0.0f, 5.0f ), 1.0f ) );
+    CHECK( !IsOccluded( hiz, Float3( 0.0f, 0.0f, 10.0f ), 1.0f ) );
+    CHECK( !IsOccluded( hiz, Float3( 0.0f, 7.0f, 20.0f ), 1.0f ) );
+    CHECK( !IsOccluded( hiz, Float3( 30.0f, 0.0f, 40.0f ), 1.0f ) );
+
+    // every texel is the farthest of the four below it
+    for ( u32 level = 1; level < HIZ_LEVELS; ++level ) {
+        const u32 width = HIZ_WIDTH >> level, height = HIZ_HEIGHT >> level;
+        const f32* below = hiz.GetLevel( level - 1 );
+        for ( u32 y = 0; y < height; ++y ) {
+            for ( u32 x = 0; x < width; ++x ) {
+                const f32 farthest = std::max( { below[ 2 * y * 2 * width + 2 * x ], below[ 2 * y * 2 * width + 2 * x + 1 ],
+                                                 below[ ( 2 * y + 1 ) * 2 * width + 2 * x ], below[ ( 2 * y + 1 ) * 2 * width + 2 * x + 1 ] } );
+                CHECK( hiz.GetLevel( level )[ y * width + x ] == farthest );
+            }
+        }
+    }
+
+    hiz.Begin( GetTestCamera() );
+    hiz.AddOccluder( wallPositions, sizeof( Float3 ), wallBackIndices, 6, MatrixTranslation( 0.0f, 0.0f, 10.0f ) );
+    hiz.Finish();
+    CHECK( hiz.GetOccluderTriangleCount() == 0 );
+    CHECK( !IsOccluded( hiz, Float3( 0.0f, 0.0f, 20.0f ), 1.0f ) );
+}
+
+// the SIMD batches only cull boxes the exact screen bounds cull too, keep
+// the rest in order, and give the same list on jobs
+TEST( HiZCullKeepsWhatTheBoxTestsKeep ) {
+    HiZBuffer hiz;
+    hiz.Begin( GetTestCamera() );
+    hiz.AddOccluder( wallPositions, sizeof( Float3 ), wallIndices, 6, MatrixTranslation( -2.0f, 1.0f, 12.0f ) );
+    hiz.AddOccluder( wallPositions, sizeof( Float3 ), wallIndices, 6, MatrixMultiply( MatrixScaling( 0.5f, 0.5f, 1.0f ), MatrixTranslation( 4.0f, -2.0f, 8.0f ) ) );
+    JobSystem jobs( 3 );
+    hiz.Finish( &jobs );
+
+    const u32 count = 5003;
+    std::mt19937 rng( 7 );
+    std::uniform_real_distribution< f32 > position( -15.0f, 15.0f ), depth( 1.0f, 60.0f ), size( 0.05f, 2.0f );
+    CullingBounds bounds;
+    bounds.Resize( count );
+    std::vector< u32 > expected;
+    for ( u32 i = 0; i < count; ++i ) {
+        const Float3 center( position( rng ), position( rng ), depth( rng ) );
+        const Float3 extent( size( rng ), size( rng ), size( rng ) );
+        bounds.Set( i, center, extent, 0.0f );
+        if ( !IsBoxOccluded( hiz, GetTestCamera(), center, extent ) )
+            expected.push_back( i );
+    }
+
+    std::vector< u32 > serial( count ), parallel( count );
+    for ( u32 i = 0; i < count; ++i )
+        serial[ i ] = parallel[ i ] = i;
+    serial.resize( hiz.Cull( bounds, serial.data(), count ) );
+    parallel.resize( hiz.Cull( bounds, parallel.data(), count, &jobs ) );
+    CHECK( serial == parallel );
+    CHECK( std::is_sorted( serial.begin(), serial.end() ) );
+    CHECK( std::includes( serial.begin(), serial.end(), expected.begin(), expected.end() ) );
+    CHECK( serial.size() < count - count / 10 );
+}
@@ -0,0 +1,84 @@
+#include "test.h"
+
+#include "backend_software.h"
+#include "present_queue.h"
+
+// without vsync every present flips at once and the next frame reuses the other buffer
+TEST( ImmediatePresentFlipsAtOnce ) {
+    PresentDesc desc;
+    desc.m_bufferCount = 2;
+    PresentQueue queue;
+    queue.Reset( desc );
+
+    for ( u32 frame = 0; frame < 4; ++frame ) {
+        queue.WaitForFrame();
+        const u32 back = queue.GetBackBufferIndex();
+        CHECK( back != queue.GetFrontBufferIndex() );
+        queue.Present();
+        CHECK( queue.GetFrontBufferIndex() == back );
+        CHECK( queue.GetQueuedFrames() == 0 );
+    }
+    CHECK( queue.GetStats().m_framesShown == 4 );
+}
+
+// with vsync the queue never holds more than the latency limit and never renders into a queued buffer
+TEST( VsyncQueueBoundsLatency ) {
+    PresentDesc desc;
+    desc.m_bufferCount = 3;
+    desc.m_maxFrameLatency = 2;
+    desc.m_vsync = true;
+    desc.m_refreshRate = 500.0;
+    PresentQueue queue;
+    queue.Reset( desc );
+    CHECK( queue.GetBufferCount() == 3 );
+
+    for ( u32 frame = 0; frame < 20; ++frame ) {
+        queue.WaitForFrame();
+        CHECK( queue.GetQueuedFrames() < 2 );
+        CHECK( queue.GetBackBufferIndex() != queue.GetFrontBufferIndex() );
+        queue.Present();
+        CHECK( queue.GetQueuedFrames() <= 2 );
+    }
+
+    // a frame waits at most for the queued frames and its own vertical blank
+    const PresentStats& stats = queue.GetStats();
+    CHECK( stats.m_framesShown >= 17 );
+    CHECK( stats.GetAverageLatency() > 0.0 );
+    CHECK( stats.m_maxLatency < 0.05 );
+}
+
+// out of range descriptions are clamped to what a flip-model swap chain allows
+TEST( PresentDescIsClamped ) {
+    PresentDesc desc;
+    desc.m_bufferCount = 8;
+    desc.m_maxFrameLatency = 0;
+    PresentQueue queue;
+    queue.Reset( desc );
+    CHECK( queue.GetBufferCount() == 3 );
+
+    desc.m_bufferCount = 1;
+    queue.Reset( desc );
+    CHECK( queue.GetBufferCount() == 2 );
+}
+
+// resizing the software backend keeps rendering into buffers of the new size
+TEST( SoftwareBackendResizes ) {
+    SoftwareBackend backend;
+    BackendDesc desc;
+    desc.m_width = 64;
+    desc.m_height = 48;
+    desc.m_threadCount = 1;
+    desc.m_present.m_bufferCount = 3;
+    CHECK( backend.Initialize( desc ) );
+    CHECK( backend.CreateObject( GetCubeMesh() ) );
+
+    CHECK( backend.Resize( 200, 100 ) );
+    CHECK( backend.GetWidth() == 200 && backend.GetHeight() == 100 );
+    Scene scene;
+    backend.WaitForNextFrame();
+    backend.UpdateConstants( Rotate( scene ) );
+    backend.RenderScene();
+    CHECK( backend.GetFramebuffer()[ 50 * backend.GetPitch() + 100 ] != backend.GetFramebuffer()[ 0 ] );
+    CHECK( !backend.Resize( 0, 100 ) );
+    backend.Release();
+}
@@ -0,0 +1,60 @@
+#include "test.h"
+
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+//
+static std::string ReadFile( const char* path ) {
+    std::string text;
+    FILE* file = fopen( path, "rb" );
+    if ( file == nullptr )
+        return text;
+    char buffer[ 4096 ];
+    for ( size_t read = fread( buffer, 1, sizeof( buffer ), file ); read > 0; read = fread( buffer, 1, sizeof( buffer ), file ) )
+        text.append( buffer, read );
+    fclose( file );
+    return text;
+}
+
+// zones from several threads end up in one trace, with their thread names
+TEST( ProfilerWritesChromeTrace ) {
+    {
+        PROFILE_ZONE( "TestOuterZone" );
+        PROFILE_ZONE( "TestInnerZone" );
+    }
+    ProfileTrack* track = ProfilerCreateTrack( "TestTrack" );
+    const u64 now = ProfilerTimestamp();
+    ProfilerRecord( track, "TestTrackZone", now, now + 1000 );
+    std::thread worker( [] {
+        ProfilerSetThreadName( "test \"worker\"" );
+        PROFILE_ZONE( "TestWorkerZone" );
+    } );
+    worker.join();
+
+    const char* path = "compgraph_test_trace.json";
+    CHECK( ProfilerWriteChromeTrace( path ) );
+    const std::string trace = ReadFile( path );
+    remove( path );
+
+    CHECK( trace.compare( 0, 15, "{\"traceEvents\":" ) == 0 );
+    CHECK( trace.find( "\"name\":\"TestOuterZone\",\"ph\":\"X\"" ) != std::string::npos );
+    CHECK( trace.find( "\"name\":\"TestInnerZone\",\"ph\":\"X\"" ) != std::string::npos );
+    CHECK( trace.find( "\"name\":\"TestWorkerZone\",\"ph\":\"X\"" ) != std::string::npos );
+    CHECK( trace.find( "\"name\":\"TestTrackZone\",\"ph\":\"X\"" ) != std::string::npos );
+    CHECK( trace.find( "\"args\":{\"name\":\"TestTrack\"}" ) != std::string::npos );
+    CHECK( trace.find( "\"args\":{\"name\":\"test \\\"worker\\\"\"}" ) != std::string::npos );
+    CHECK( trace.size() > 2 && trace.compare( trace.size() - 2, 2, "}\n" ) == 0 );
+}
+
+// the tick rate is calibrated against the steady clock
+TEST( ProfilerTicksMatchWallClock ) {
+    const f64 rate = ProfilerTicksPerSecond();
+    const u64 begin = ProfilerTimestamp();
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    const f64 seconds = ( f64 )( ProfilerTimestamp() - begin ) / rate;
+    CHECK( seconds > 0.015 && seconds < 0.5 );
+}
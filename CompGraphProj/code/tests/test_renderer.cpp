@@ -0,0 +1,206 @@
+#include "test.h"
+
+#include "backend_software.h"
+#include "job_system.h"
+#include "tile_rasterizer.h"
+#include "vertex_stage.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const u32 TestWidth = 200;
+static const u32 TestHeight = 120;
+
+// renders clip-space triangles straight through the tile rasterizer, white unless colors are given
+static std::vector< u32 > RasterizeClip( const std::vector< Float4 >& clipPositions, const std::vector< u32 >& indices, u32 threads,
+                                         const std::vector< Float4 >& colors = {} ) {
+    const u32 count = ( u32 )clipPositions.size();
+    ClipStreams clip;
+    clip.Resize( count );
+    std::vector< Vertex > vertices( count );
+    for ( u32 i = 0; i < count; ++i ) {
+        clip.m_x[ i ] = clipPositions[ i ].x;
+        clip.m_y[ i ] = clipPositions[ i ].y;
+        clip.m_z[ i ] = clipPositions[ i ].z;
+        clip.m_w[ i ] = clipPositions[ i ].w;
+        vertices[ i ].m_color = colors.empty() ? Float4( 1.0f, 1.0f, 1.0f, 1.0f ) : colors[ i ];
+    }
+
+    JobSystem jobs( threads );
+    TileRasterizer rasterizer;
+    rasterizer.Resize( TestWidth, TestHeight );
+    std::vector< u32 > color( rasterizer.GetPitch() * TestHeight );
+    rasterizer.BeginFrame( color.data(), 0 );
+    rasterizer.SubmitTriangles( clip, vertices.data(), indices.data(), ( u32 )indices.size(), jobs );
+    rasterizer.EndFrame( jobs );
+
+    std::vector< u32 > pixels( TestWidth * TestHeight );
+    for ( u32 y = 0; y < TestHeight; ++y )
+        memcpy( &pixels[ y * TestWidth ], color.data() + y * rasterizer.GetPitch(), TestWidth * sizeof( u32 ) );
+    return pixels;
+}
+
+static u32 CountCovered( const std::vector< u32 >& pixels ) {
+    u32 covered = 0;
+    for ( u32 p : pixels )
+        covered += p != 0 ? 1 : 0;
+    return covered;
+}
+
+//
+TEST( VertexStageMatchesScalar ) {
+    std::mt19937 rng( 7 );
+    std::uniform_real_distribution< f32 > dist( -4.0f, 4.0f );
+    std::vector< Vertex > vertices( 1027 );
+    for ( Vertex& v : vertices )
+        v.m_pos = Float3( dist( rng ), dist( rng ), dist( rng ) );
+
+    PositionStreams in;
+    in.Assign( vertices.data(), ( u32 )vertices.size() );
+    ClipStreams simd, scalar;
+    simd.Resize( in.m_count );
+    scalar.Resize( in.m_count );
+
+    Matrix model = MatrixRotationAxis( Float3( 1, 2, 3 ), 1.3f );
+    model.r[ 3 ] = Float4( 0.5f, -0.25f, 2.0f, 1.0f );
+    RunVertexStage( in, 0, in.m_count, model, simd );
+    RunVertexStageScalar( in, 0, in.m_count, model, scalar );
+
+    const size_t bytes = in.m_count * sizeof( f32 );
+    CHECK( memcmp( simd.m_x.data(), scalar.m_x.data(), bytes ) == 0 );
+    CHECK( memcmp( simd.m_y.data(), scalar.m_y.data(), bytes ) == 0 );
+    CHECK( memcmp( simd.m_z.data(), scalar.m_z.data(), bytes ) == 0 );
+    CHECK( memcmp( simd.m_w.data(), scalar.m_w.data(), bytes ) == 0 );
+}
+
+// two triangles sharing a diagonal must cover the quad exactly once
+TEST( SharedEdgeHasNoGapsOrOverlap ) {
+    std::vector< Float4 > quad = {
+        Float4( -0.73f, 0.61f, 0.5f, 1.0f ),
+        Float4( 0.59f, 0.83f, 0.5f, 1.0f ),
+        Float4( 0.67f, -0.71f, 0.5f, 1.0f ),
+        Float4( -0.81f, -0.57f, 0.5f, 1.0f ),
+    };
+    u32 first = CountCovered( RasterizeClip( quad, { 0, 1, 2 }, 1 ) );
+    u32 second = CountCovered( RasterizeClip( quad, { 0, 2, 3 }, 1 ) );
+    u32 both = CountCovered( RasterizeClip( quad, { 0, 1, 2, 0, 2, 3 }, 1 ) );
+    CHECK( first > 0 && second > 0 );
+    CHECK( first + second == both );
+}
+
+//
+TEST( CounterClockwiseIsCulled ) {
+    std::vector< Float4 > tri = {
+        Float4( -0.5f, -0.5f, 0.5f, 1.0f ),
+        Float4( 0.0f, 0.5f, 0.5f, 1.0f ),
+        Float4( 0.5f, -0.5f, 0.5f, 1.0f ),
+    };
+    CHECK( CountCovered( RasterizeClip( tri, { 0, 1, 2 }, 1 ) ) > 0 );
+    CHECK( CountCovered( RasterizeClip( tri, { 0, 2, 1 }, 1 ) ) == 0 );
+}
+
+// the instance cap keeps the last clip index and triangle number inside u32,
+// whichever of the two runs out first, and one more instance would not
+TEST( MaxInstanceCountFitsU32 ) {
+    const u64 limit = 0xFFFFFFFFull;
+    const u32 cases[][ 2 ] = { { 100000, 600000 }, { 24, 36 }, { 8, 3 }, { 262144, 3 }, { 1 << 20, 6 << 20 } };
+    for ( const auto& c : cases ) {
+        const u32 stride = c[ 0 ], triangles = c[ 1 ] / 3;
+        const u64 count = GetMaxInstanceCount( stride, c[ 1 ] );
+        CHECK( count * stride + SIMD_WIDTH <= limit && count * triangles + 256 <= limit );
+        CHECK( ( count + 1 ) * stride + SIMD_WIDTH > limit || ( count + 1 ) * triangles + 256 > limit );
+    }
+    CHECK( GetMaxInstanceCount( 0, 0 ) > 0 );
+    // a closed mesh has about twice as many triangles as vertices, so they bind first
+    CHECK( GetMaxInstanceCount( 100000, 600000 ) < ( 0xFFFFFFFFu - SIMD_WIDTH ) / 100000 );
+}
+
+//
+TEST( ResultDoesNotDependOnThreadCount ) {
+    std::mt19937 rng( 3 );
+    std::uniform_real_distribution< f32 > dist( -1.5f, 1.5f );
+    std::vector< Float4 > positions;
+    std::vector< u32 > indices;
+    for ( u32 i = 0; i < 3000; ++i ) {
+        positions.push_back( Float4( dist( rng ), dist( rng ), 0.5f + dist( rng ) * 0.4f, 1.0f ) );
+        indices.push_back( i );
+    }
+    CHECK( RasterizeClip( positions, indices, 1 ) == RasterizeClip( positions, indices, 4 ) );
+}
+
+// the far triangle is submitted last and must lose where the two overlap
+TEST( DepthTestKeepsNearestSurface ) {
+    std::vector< Float4 > positions = {
+        Float4( -0.5f, -0.5f, 0.2f, 1.0f ), Float4( 0.0f, 0.5f, 0.2f, 1.0f ), Float4( 0.5f, -0.5f, 0.2f, 1.0f ),
+        Float4( -0.9f, -0.9f, 0.8f, 1.0f ), Float4( 0.0f, 0.9f, 0.8f, 1.0f ), Float4( 0.9f, -0.9f, 0.8f, 1.0f ),
+    };
+    const Float4 red( 1.0f, 0.0f, 0.0f, 1.0f ), green( 0.0f, 1.0f, 0.0f, 1.0f );
+    std::vector< Float4 > colors = { red, red, red, green, green, green };
+    std::vector< u32 > pixels = RasterizeClip( positions, { 0, 1, 2, 3, 4, 5 }, 1, colors );
+
+    const u32 center = pixels[ ( TestHeight / 2 ) * TestWidth + TestWidth / 2 ];
+    const u32 border = pixels[ ( TestHeight * 4 / 5 ) * TestWidth + TestWidth / 2 ];
+    CHECK( center == PackUnorm8( red ) );
+    CHECK( border == PackUnorm8( green ) );
+}
+
+//
+TEST( SoftwareBackendRendersCube ) {
+    SoftwareBackend backend;
+    BackendDesc desc;
+    desc.m_width = TestWidth;
+    desc.m_height = TestHeight;
+    desc.m_threadCount = 2;
+    CHECK( backend.Initialize( desc ) );
+    CHECK( backend.CreateObject( GetCubeMesh() ) );
+
+    Scene scene;
+    backend.UpdateConstants( Rotate( scene ) );
+    backend.RenderScene();
+
+    const u32 clearColor = PackUnorm8( Float4( 0.337f, 0.627f, 0.827f, 1.0f ) );
+    const u32* pixels = backend.GetFramebuffer();
+    CHECK( pixels[ 0 ] == clearColor );
+    CHECK( pixels[ ( TestHeight / 2 ) * backend.GetPitch() + TestWidth / 2 ] != clearColor );
+
+    // every stage of the frame is timed, in pipeline order
+    const StageTimings& stages = backend.GetStageTimings();
+    CHECK( stages.m_frame == 1 && stages.m_count == 4 );
+    CHECK( strcmp( stages.m_names[ 0 ], "VertexStage" ) == 0 && strcmp( stages.m_names[ 3 ], "Present" ) == 0 );
+    for ( u32 i = 0; i < stages.m_count; ++i )
+        CHECK( stages.m_ms[ i ] >= 0.0 );
+    backend.Release();
+}
+
+//
+TEST( InstancedCubeFieldDoesNotDependOnThreadCount ) {
+    std::vector< u32 > frames[ 2 ];
+    const u32 threads[ 2 ] = { 1, 3 };
+    for ( u32 run = 0; run < 2; ++run ) {
+        SoftwareBackend backend;
+        BackendDesc desc;
+        desc.m_width = TestWidth;
+        desc.m_height = TestHeight;
+        desc.m_threadCount = threads[ run ];
+        CHECK( backend.Initialize( desc ) );
+        CHECK( backend.CreateObject( GetCubeMesh() ) );
+        CHECK( backend.CreateInstanceBuffer( 125 ) );
+
+        CubeFieldScene scene;
+        GenerateCubeField( scene, 125, ( f32 )TestWidth / ( f32 )TestHeight );
+        backend.UpdateConstants( AnimateCubeField( scene ) );
+        backend.UpdateInstances( scene.m_instances.data(), ( u32 )scene.m_instances.size() );
+        backend.RenderScene();
+
+        frames[ run ].assign( backend.GetFramebuffer(), backend.GetFramebuffer() + backend.GetPitch() * TestHeight );
+        backend.Release();
+    }
+    CHECK( frames[ 0 ] == frames[ 1 ] );
+
+    const u32 clearColor = PackUnorm8( Float4( 0.337f, 0.627f, 0.827f, 1.0f ) );
+    u32 covered = 0;
+    for ( u32 p : frames[ 0 ] )
+        covered += p != clearColor ? 1 : 0;
+    CHECK( covered > TestWidth * TestHeight / 20 );
+}
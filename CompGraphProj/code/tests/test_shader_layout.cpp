@@ -0,0 +1,105 @@
+#include "test.h"
+
+#include "scene.h"
+#include "shader_layout.h"
+
+#include <utility>
+
+// the compile-time checks reject descriptors that drifted from their struct
+struct MisalignedConstants {
+    Float3 m_a;
+    Float3 m_b;     // at 12, straddles the first 16-byte register
+};
+constexpr VertexElement WRONG_SIZE[] = { VERTEX_ELEMENT( Vertex, m_pos, "POSITION", 0, VERTEX_FORMAT_FLOAT4 ) };
+constexpr VertexElement DUPLICATE_SEMANTIC[] = {
+    VERTEX_ELEMENT( Vertex, m_pos, "POSITION", 0, VERTEX_FORMAT_FLOAT3 ),
+    VERTEX_ELEMENT( Vertex, m_color, "position", 0, VERTEX_FORMAT_FLOAT4 ),
+};
+constexpr CBufferField STRADDLING_FIELD[] = {
+    CBUFFER_FIELD( MisalignedConstants, m_a, "a" ),
+    CBUFFER_FIELD( MisalignedConstants, m_b, "b" ),
+};
+static_assert( !IsValidVertexLayout( WRONG_SIZE, sizeof( Vertex ) ), "a float4 does not fit Vertex::m_pos" );
+static_assert( !IsValidVertexLayout( DUPLICATE_SEMANTIC, sizeof( Vertex ) ), "semantics are case-insensitive" );
+static_assert( !IsValidCBufferLayout( STRADDLING_FIELD, sizeof( MisalignedConstants ) ), "HLSL would move m_b to 16" );
+
+// reflection of InstancedVertexShader.hlsl as D3DReflect reports it
+static ShaderReflection InstancedSignature() {
+    ShaderReflection shader;
+    const char* semantics[] = { "POSITION", "COLOR", "WORLD", "WORLD", "WORLD", "WORLD", "INSTANCECOLOR" };
+    const u32 indices[] = { 0, 0, 0, 1, 2, 3, 0 };
+    for ( u32 i = 0; i < 7; ++i ) {
+        ShaderInput input;
+        input.m_semantic = semantics[ i ];
+        input.m_semanticIndex = indices[ i ];
+        shader.m_inputs.push_back( input );
+    }
+    return shader;
+}
+
+// every input comes from the stream that declares it, in signature order
+TEST( InputLayoutFollowsSignature ) {
+    const VertexStream streams[ 2 ] = { VERTEX_STREAM, INSTANCE_STREAM };
+    std::vector< InputLayoutElement > layout;
+    CHECK( ResolveInputLayout( InstancedSignature(), streams, 2, layout ) );
+    CHECK( layout.size() == 7 );
+    if ( layout.size() == 7 ) {
+        CHECK( layout[ 0 ].m_slot == 0 && layout[ 0 ].m_offset == 0 && layout[ 0 ].m_format == VERTEX_FORMAT_FLOAT3 && !layout[ 0 ].m_perInstance );
+        CHECK( layout[ 1 ].m_slot == 0 && layout[ 1 ].m_offset == 12 );
+        CHECK( layout[ 4 ].m_slot == 1 && layout[ 4 ].m_semanticIndex == 2 && layout[ 4 ].m_offset == 32 && layout[ 4 ].m_perInstance );
+        CHECK( layout[ 6 ].m_slot == 1 && layout[ 6 ].m_offset == 64 );
+    }
+
+    // a shader reading instance data cannot be fed by the vertex stream alone
+    CHECK( !ResolveInputLayout( InstancedSignature(), &VERTEX_STREAM, 1, layout ) );
+
+    // system values are generated, not fetched
+    ShaderReflection withVertexId = InstancedSignature();
+    ShaderInput vertexId;
+    vertexId.m_semantic = "SV_VertexID";
+    vertexId.m_systemValue = true;
+    withVertexId.m_inputs.push_back( vertexId );
+    CHECK( ResolveInputLayout( withVertexId, streams, 2, layout ) && layout.size() == 7 );
+}
+
+// the key depends on the signature and the streams, not on which shader asked
+TEST( InputLayoutKeySharesSignatures ) {
+    const VertexStream streams[ 2 ] = { VERTEX_STREAM, INSTANCE_STREAM };
+    const u64 key = InputLayoutKey( InstancedSignature(), streams, 2 );
+    CHECK( key == InputLayoutKey( InstancedSignature(), streams, 2 ) );
+    CHECK( key != InputLayoutKey( InstancedSignature(), streams, 1 ) );
+
+    ShaderReflection reordered = InstancedSignature();
+    std::swap( reordered.m_inputs[ 0 ], reordered.m_inputs[ 1 ] );
+    CHECK( key != InputLayoutKey( reordered, streams, 2 ) );
+}
+
+//
+TEST( ConstantBufferMatchesReflection ) {
+    ShaderConstantBuffer shader;
+    shader.m_name = "ConstantBuffer";
+    shader.m_size = 128;
+    shader.m_variables.push_back( { "model", 0, 64 } );
+    shader.m_variables.push_back( { "viewProjection", 64, 64 } );
+    CHECK( MatchConstantBuffer( shader, CONSTANT_BUFFER_FIELDS, 2, sizeof( ConstantBuffer ) ) );
+
+    // a shader may declare fewer variables than the struct has
+    ShaderConstantBuffer modelOnly = shader;
+    modelOnly.m_size = 64;
+    modelOnly.m_variables.pop_back();
+    CHECK( MatchConstantBuffer( modelOnly, CONSTANT_BUFFER_FIELDS, 2, sizeof( ConstantBuffer ) ) );
+
+    ShaderConstantBuffer moved = shader;
+    moved.m_variables[ 1 ].m_offset = 80;
+    CHECK( !MatchConstantBuffer( moved, CONSTANT_BUFFER_FIELDS, 2, sizeof( ConstantBuffer ) ) );
+
+    ShaderConstantBuffer unknown = shader;
+    unknown.m_variables.push_back( { "objectColor", 128, 16 } );
+    unknown.m_size = 144;
+    CHECK( !MatchConstantBuffer( unknown, CONSTANT_BUFFER_FIELDS, 2, sizeof( ConstantBuffer ) ) );
+
+    ShaderReflection reflection;
+    reflection.m_constantBuffers.push_back( shader );
+    CHECK( reflection.FindConstantBuffer( "ConstantBuffer" ) != nullptr );
+    CHECK( reflection.FindConstantBuffer( "ObjectConstants" ) == nullptr );
+}
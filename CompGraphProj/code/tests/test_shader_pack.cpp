@@ -0,0 +1,109 @@
+#include "test.h"
+
+#include "shader_pack.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* const PackPath = "compgraph_test_shaders.pack";
+
+// every input of a variant changes its key
+TEST( ShaderKeyCoversEveryInput ) {
+    const char source[] = "float4 main() : SV_Target { return 1; }";
+    const ShaderDefine none[] = { { nullptr, nullptr } };
+    const ShaderDefine perObject[] = { { "PER_OBJECT", "1" }, { nullptr, nullptr } };
+    const ShaderDefine perObjectTwo[] = { { "PER_OBJECT", "2" }, { nullptr, nullptr } };
+
+    const u64 key = ShaderKey( source, sizeof( source ), nullptr, "main", "ps_5_0", 0 );
+    CHECK( key == ShaderKey( source, sizeof( source ), none, "main", "ps_5_0", 0 ) );
+    CHECK( key != ShaderKey( source, sizeof( source ) - 2, nullptr, "main", "ps_5_0", 0 ) );
+    CHECK( key != ShaderKey( source, sizeof( source ), perObject, "main", "ps_5_0", 0 ) );
+    CHECK( ShaderKey( source, sizeof( source ), perObject, "main", "ps_5_0", 0 ) != ShaderKey( source, sizeof( source ), perObjectTwo, "main", "ps_5_0", 0 ) );
+    CHECK( key != ShaderKey( source, sizeof( source ), nullptr, "main", "vs_5_0", 0 ) );
+    CHECK( key != ShaderKey( source, sizeof( source ), nullptr, "mai", "nps_5_0", 0 ) );
+    CHECK( key != ShaderKey( source, sizeof( source ), nullptr, "main", "ps_5_0", 1 ) );
+}
+
+// a written pack maps back with every blob aligned and findable, merges keep both sides
+TEST( ShaderPackRoundTrips ) {
+    std::vector< u8 > blobs[ 3 ];
+    for ( u32 i = 0; i < 3; ++i ) {
+        for ( u32 b = 0; b < 37 + i * 100; ++b )
+            blobs[ i ].push_back( ( u8 )( b * 7 + i ) );
+    }
+
+    ShaderPackWriter writer;
+    writer.Add( 300, blobs[ 0 ].data(), ( u32 )blobs[ 0 ].size() );
+    writer.Add( 100, blobs[ 2 ].data(), ( u32 )blobs[ 2 ].size() );
+    writer.Add( 100, blobs[ 1 ].data(), ( u32 )blobs[ 1 ].size() );
+    CHECK( writer.GetEntryCount() == 2 );
+    CHECK( writer.Write( PackPath ) );
+
+    ShaderPack pack;
+    CHECK( pack.Open( PackPath ) );
+    CHECK( pack.GetEntryCount() == 2 );
+    u32 size = 0;
+    const u8* blob = pack.Find( 100, &size );
+    CHECK( blob != nullptr && size == blobs[ 1 ].size() && memcmp( blob, blobs[ 1 ].data(), size ) == 0 );
+    CHECK( ( ( size_t )( blob - pack.GetBlob( pack.GetEntry( 0 ) ) ) % SHADER_PACK_ALIGNMENT ) == 0 );
+    blob = pack.Find( 300, &size );
+    CHECK( blob != nullptr && size == blobs[ 0 ].size() && memcmp( blob, blobs[ 0 ].data(), size ) == 0 );
+    CHECK( pack.GetEntry( 1 ).m_offset % SHADER_PACK_ALIGNMENT == 0 );
+    CHECK( pack.Find( 200, &size ) == nullptr );
+
+    ShaderPackWriter merged;
+    merged.Add( 200, blobs[ 2 ].data(), ( u32 )blobs[ 2 ].size() );
+    merged.Merge( pack );
+    pack.Close();
+    CHECK( merged.Write( PackPath ) );
+    CHECK( pack.Open( PackPath ) );
+    CHECK( pack.GetEntryCount() == 3 );
+    CHECK( pack.Find( 100, nullptr ) != nullptr && pack.Find( 200, nullptr ) != nullptr && pack.Find( 300, nullptr ) != nullptr );
+    pack.Close();
+    remove( PackPath );
+}
+
+// truncated, foreign or inconsistent packs are rejected instead of read out of bounds
+TEST( ShaderPackRejectsMalformedFiles ) {
+    const u8 bytecode[ 24 ] = { 1, 2, 3 };
+    ShaderPackWriter writer;
+    writer.Add( 1, bytecode, sizeof( bytecode ) );
+    writer.Add( 2, bytecode, sizeof( bytecode ) );
+    CHECK( writer.Write( PackPath ) );
+
+    std::vector< u8 > file;
+    {
+        MappedFile mapped;
+        CHECK( mapped.Open( PackPath ) );
+        file.assign( mapped.GetData(), mapped.GetData() + mapped.GetSize() );
+    }
+    remove( PackPath );
+
+    ShaderPack pack;
+    CHECK( pack.OpenMemory( file.data(), file.size() ) );
+    CHECK( !pack.OpenMemory( file.data(), file.size() - 1 ) );
+    CHECK( !pack.OpenMemory( file.data(), sizeof( ShaderPackHeader ) - 1 ) );
+
+    std::vector< u8 > corrupt = file;
+    corrupt[ 0 ] ^= 0xFF;
+    CHECK( !pack.OpenMemory( corrupt.data(), corrupt.size() ) );
+
+    // entry 1 pointing past the end
+    corrupt = file;
+    ShaderPackEntry entry;
+    memcpy( &entry, &corrupt[ sizeof( ShaderPackHeader ) + sizeof( ShaderPackEntry ) ], sizeof( entry ) );
+    entry.m_size = 0xFFFFFFF0u;
+    memcpy( &corrupt[ sizeof( ShaderPackHeader ) + sizeof( ShaderPackEntry ) ], &entry, sizeof( entry ) );
+    CHECK( !pack.OpenMemory( corrupt.data(), corrupt.size() ) );
+
+    // keys out of order would break the binary search
+    corrupt = file;
+    memcpy( &entry, &corrupt[ sizeof( ShaderPackHeader ) ], sizeof( entry ) );
+    entry.m_key = 5;
+    memcpy( &corrupt[ sizeof( ShaderPackHeader ) ], &entry, sizeof( entry ) );
+    CHECK( !pack.OpenMemory( corrupt.data(), corrupt.size() ) );
+
+    CHECK( !pack.Open( "compgraph_missing.pack" ) );
+    CHECK( pack.GetEntryCount() == 0 && pack.Find( 1, nullptr ) == nullptr );
+}
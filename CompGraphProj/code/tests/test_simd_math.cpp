@@ -0,0 +1,204 @@
+#include "test.h"
+
+#include "simd_math.h"
+
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+//
+static bool Near( const f32* a, const f32* b, u32 count, f32 tolerance ) {
+    for ( u32 i = 0; i < count; ++i ) {
+        if ( std::fabs( a[ i ] - b[ i ] ) > tolerance * ( 1.0f + std::fabs( b[ i ] ) ) )
+            return false;
+    }
+    return true;
+}
+
+// a rotation, scale and translation, with a perspective column so w varies
+static Matrix RandomMatrix( std::mt19937& rng ) {
+    std::uniform_real_distribution< f32 > unit( -1.0f, 1.0f );
+    Matrix m = MatrixMultiply( MatrixRotationAxis( Float3( unit( rng ), unit( rng ), unit( rng ) + 2.0f ), unit( rng ) * MATH_PI ),
+                               MatrixTranslation( unit( rng ) * 10.0f, unit( rng ) * 10.0f, unit( rng ) * 10.0f ) );
+    m.r[ 2 ].w = 0.5f + 0.25f * unit( rng );
+    m.r[ 3 ].w = 2.0f;
+    return m;
+}
+
+// the register types agree with vecmath.h's scalar functions, which follow
+// DirectXMath, and the quaternion functions with the rotation matrices
+TEST( SimdMathMatchesScalarMath ) {
+    std::mt19937 rng( 3 );
+    std::uniform_real_distribution< f32 > unit( -1.0f, 1.0f );
+    u32 wrong = 0;
+    for ( u32 iteration = 0; iteration < 200; ++iteration ) {
+        const Matrix a = RandomMatrix( rng ), b = RandomMatrix( rng );
+        const Float3 p( unit( rng ) * 5.0f, unit( rng ) * 5.0f, unit( rng ) * 5.0f );
+        const Float3 q( unit( rng ), unit( rng ), unit( rng ) );
+
+        Matrix product;
+        StoreMatrix( product, Mat4Multiply( LoadMatrix( a ), LoadMatrix( b ) ) );
+        const Matrix expectedProduct = MatrixMultiply( a, b );
+        wrong += Near( &product.r[ 0 ].x, &expectedProduct.r[ 0 ].x, 16, 1e-5f ) ? 0 : 1;
+
+        Matrix transposed;
+        StoreMatrix( transposed, Mat4Transpose( LoadMatrix( a ) ) );
+        const Matrix expectedTransposed = MatrixTranspose( a );
+        wrong += memcmp( &transposed, &expectedTransposed, sizeof( Matrix ) ) == 0 ? 0 : 1;
+
+        Float4 point;
+        StoreFloat4( point, Vec3Transform( LoadFloat3( p ), LoadMatrix( a ) ) );
+        const Float4 expectedPoint = TransformPoint( p, a );
+        wrong += Near( &point.x, &expectedPoint.x, 4, 1e-5f ) ? 0 : 1;
+
+        Float3 coord;
+        StoreFloat3( coord, Vec3TransformCoord( LoadFloat3( p ), LoadMatrix( a ) ) );
+        const Float3 expectedCoord( expectedPoint.x / expectedPoint.w, expectedPoint.y / expectedPoint.w, expectedPoint.z / expectedPoint.w );
+        wrong += Near( &coord.x, &expectedCoord.x, 3, 1e-5f ) ? 0 : 1;
+
+        Float3 cross, normal;
+        StoreFloat3( cross, Vec3Cross( LoadFloat3( p ), LoadFloat3( q ) ) );
+        StoreFloat3( normal, Vec3Normalize( LoadFloat3( q ) ) );
+        const Float3 expectedCross = Vector3Cross( p, q ), expectedNormal = Vector3Normalize( q );
+        wrong += Near( &cross.x, &expectedCross.x, 3, 1e-5f ) && Near( &normal.x, &expectedNormal.x, 3, 1e-5f ) ? 0 : 1;
+        wrong += std::fabs( Vec3Dot( LoadFloat3( p ), LoadFloat3( q ) ) - Vector3Dot( p, q ) ) <= 1e-5f * ( 1.0f + std::fabs( Vector3Dot( p, q ) ) ) ? 0 : 1;
+
+        // quaternions turn points like the matrices of the same rotations
+        const Float3 axisA = Vector3Normalize( q ), axisB = Vector3Normalize( Float3( q.z, 1.0f, q.x ) );
+        const f32 angleA = unit( rng ) * MATH_PI, angleB = unit( rng ) * MATH_PI;
+        const Quat qa = QuatRotationNormal( LoadFloat3( axisA ), angleA ), qb = QuatRotationNormal( LoadFloat3( axisB ), angleB );
+        const Matrix ra = MatrixRotationNormal( axisA, angleA ), rb = MatrixRotationNormal( axisB, angleB );
+
+        Matrix fromQuat;
+        StoreMatrix( fromQuat, Mat4RotationQuat( qa ) );
+        wrong += Near( &fromQuat.r[ 0 ].x, &ra.r[ 0 ].x, 16, 1e-5f ) ? 0 : 1;
+
+        Matrix composed;
+        StoreMatrix( composed, Mat4RotationQuat( QuatNormalize( QuatMultiply( qa, qb ) ) ) );
+        const Matrix expectedComposed = MatrixMultiply( ra, rb );
+        wrong += Near( &composed.r[ 0 ].x, &expectedComposed.r[ 0 ].x, 16, 1e-5f ) ? 0 : 1;
+
+        Float3 rotated;
+        StoreFloat3( rotated, Vec3Rotate( LoadFloat3( p ), qa ) );
+        const Float4 expectedRotated = TransformPoint( p, ra );
+        wrong += Near( &rotated.x, &expectedRotated.x, 3, 1e-5f ) ? 0 : 1;
+    }
+    CHECK( wrong == 0 );
+
+    Float4 identity;
+    StoreFloat4( identity, Vec4{ QuatMultiply( QuatIdentity(), QuatConjugate( QuatIdentity() ) ).v } );
+    CHECK( identity.x == 0.0f && identity.y == 0.0f && identity.z == 0.0f && identity.w == 1.0f );
+}
+
+// expected values are DirectXMath's SSE2 path (and its AVX path where that
+// uses dpps), replayed in f32 one rounding at a time. the inputs are chosen so
+// that other addition orders give other bits
+TEST( SimdMathMatchesDirectXMath ) {
+#if defined( SIMD_MATH_DPPS )
+    const bool dpps = true;
+#else
+    const bool dpps = false;
+#endif
+    const auto same = []( const f32* a, std::initializer_list< f32 > b ) {
+        return memcmp( a, b.begin(), b.size() * sizeof( f32 ) ) == 0;
+    };
+
+    const Vec4 a = LoadFloat4( Float4( -9.25008678f, -1.32708633f, -8.60289192f, -8.18573952f ) );
+    const Vec4 b = LoadFloat4( Float4( -1.50961626f, 6.53704262f, -7.52396059f, -5.53522062f ) );
+    const f32 dot = Vec4Dot( a, b );
+    CHECK( dot == ( dpps ? 115.326561f : 115.326553f ) );
+
+    const Float3 v( 1.38913465f, -1.27602458f, 0.477444649f );
+    CHECK( Vec3Length( LoadFloat3( v ) ) == ( dpps ? 1.94573569f : 1.94573557f ) );
+    Float4 normal;
+    StoreFloat4( normal, Vec4{ Vec3Normalize( LoadFloat3( v ) ).v } );
+    CHECK( same( &normal.x, { 0.713937998f, -0.655805707f, 0.245380014f, 0.0f } ) );
+
+    const Float3 p( -0.724076927f, -1.85852826f, 0.855618656f );
+    Float4 cross;
+    StoreFloat4( cross, Vec4{ Vec3Cross( LoadFloat3( v ), LoadFloat3( p ) ).v } );
+    CHECK( same( &cross.x, { -0.204446077f, -1.53427625f, -3.50568604f, 0.0f } ) );
+
+    const Quat q1{ Set4( 0.254866451f, 0.895417869f, 0.154205903f, -0.206639051f ) };
+    const Quat q2{ Set4( 0.952510238f, -0.906834662f, 0.716936946f, -0.420781434f ) };
+    Float4 product;
+    StoreFloat4( product, Vec4{ QuatMultiply( q1, q2 ).v } );
+    CHECK( same( &product.x, { -1.08586633f, -0.153547287f, 0.87098223f, 0.545627058f } ) );
+
+    Float4 normalized;
+    StoreFloat4( normalized, Vec4{ QuatNormalize( Quat{ Set4( 0.0929486006f, 0.705556512f, 1.05720055f, -2.67604256f ) } ).v } );
+    CHECK( dpps ? same( &normalized.x, { 0.0313591212f, 0.238041595f, 0.356679708f, -0.902846754f } )
+                : same( &normalized.x, { 0.0313591249f, 0.23804161f, 0.356679738f, -0.902846873f } ) );
+
+    const Quat rotation = QuatRotationNormal( LoadFloat3( Float3( -0.636678815f, -0.641320944f, -0.428191036f ) ), 3.60799956f );
+    Float4 rotationValue, rotated;
+    StoreFloat4( rotationValue, Vec4{ rotation.v } );
+    StoreFloat4( rotated, Vec4{ Vec3Rotate( LoadFloat3( p ), rotation ).v } );
+    CHECK( same( &rotationValue.x, { -0.619444609f, -0.623961091f, -0.416600376f, -0.231095374f } ) );
+    CHECK( same( &rotated.x, { -0.299400449f, -0.286420643f, -2.13045096f, 5.96046448e-08f } ) );
+
+    Matrix m1, m2;
+    m1.r[ 0 ] = Float4( -0.280893743f, -1.20139802f, 1.76627684f, 1.19396663f );
+    m1.r[ 1 ] = Float4( -1.53542089f, 0.446542263f, 0.151179016f, 2.25082493f );
+    m1.r[ 2 ] = Float4( 1.37667179f, -1.27237344f, 2.88104916f, -2.29160523f );
+    m1.r[ 3 ] = Float4( -0.491263062f, 1.54284561f, -2.0880928f, -0.0662213936f );
+    m2.r[ 0 ] = Float4( -2.76475644f, 1.00929511f, 1.58742523f, 0.438155651f );
+    m2.r[ 1 ] = Float4( 2.25286698f, -1.11751497f, 1.17177224f, 0.56621927f );
+    m2.r[ 2 ] = Float4( 0.47937122f, -0.262768f, 2.0398066f, 2.66808653f );
+    m2.r[ 3 ] = Float4( -0.155409977f, 0.98491323f, -2.63598347f, 1.20895207f );
+    Matrix m;
+    StoreMatrix( m, Mat4Multiply( LoadMatrix( m1 ), LoadMatrix( m2 ) ) );
+    CHECK( same( &m.r[ 0 ].x, { -1.26883912f, 1.770908f, -1.39807606f, 5.35269785f,
+                                4.97373486f, 0.128431678f, -7.5388813f, 2.70458555f,
+                                -4.93542004f, -0.202715516f, 12.6118479f, 4.79920197f,
+                                3.84336877f, -1.73652089f, -3.05672646f, -4.99293137f } ) );
+    Float4 transformed;
+    StoreFloat4( transformed, Vec3Transform( LoadFloat3( v ), LoadMatrix( m1 ) ) );
+    CHECK( same( &transformed.x, { 1.73505712f, -1.30334473f, 1.54813683f, -2.3738637f } ) );
+
+    // zero and infinite lengths
+    Float4 zero, infinite;
+    StoreFloat4( zero, Vec4{ Vec3Normalize( LoadFloat3( Float3( 0.0f, 0.0f, 0.0f ) ) ).v } );
+    StoreFloat4( infinite, Vec4{ Vec3Normalize( LoadFloat3( Float3( 1e30f, 0.0f, 0.0f ) ) ).v } );
+    CHECK( zero.x == 0.0f && zero.y == 0.0f && zero.z == 0.0f && zero.w == 0.0f );
+    CHECK( std::isnan( infinite.x ) && std::isnan( infinite.w ) );
+}
+
+// the batch functions give the same bits as the single-value ones, including
+// the elements after the last full group
+TEST( SimdMathStreamsMatchSingleValues ) {
+    std::mt19937 rng( 4 );
+    std::uniform_real_distribution< f32 > unit( -10.0f, 10.0f );
+    const u32 count = 1001;
+    std::vector< Float3 > points( count );
+    std::vector< Matrix > matrices( count );
+    for ( u32 i = 0; i < count; ++i ) {
+        points[ i ] = Float3( unit( rng ), unit( rng ), unit( rng ) );
+        matrices[ i ] = RandomMatrix( rng );
+    }
+    const Matrix m = RandomMatrix( rng );
+    const Mat4 mat = LoadMatrix( m );
+
+    std::vector< Float4 > transformed( count );
+    std::vector< Float3 > coords( count );
+    std::vector< Matrix > products( count );
+    Vec3TransformStream( transformed.data(), points.data(), count, m );
+    Vec3TransformCoordStream( coords.data(), points.data(), count, m );
+    Mat4MultiplyStream( products.data(), matrices.data(), count, m );
+
+    u32 wrong = 0;
+    for ( u32 i = 0; i < count; ++i ) {
+        Float4 point;
+        Float3 coord;
+        Matrix product;
+        StoreFloat4( point, Vec3Transform( LoadFloat3( points[ i ] ), mat ) );
+        StoreFloat3( coord, Vec3TransformCoord( LoadFloat3( points[ i ] ), mat ) );
+        StoreMatrix( product, Mat4Multiply( LoadMatrix( matrices[ i ] ), mat ) );
+        wrong += memcmp( &transformed[ i ], &point, sizeof( point ) ) == 0 ? 0 : 1;
+        wrong += memcmp( &coords[ i ], &coord, sizeof( coord ) ) == 0 ? 0 : 1;
+        wrong += memcmp( &products[ i ], &product, sizeof( product ) ) == 0 ? 0 : 1;
+    }
+    CHECK( wrong == 0 );
+}
@@ -0,0 +1,120 @@
+#include "test.h"
+
+#include "job_system.h"
+#include "transform_hierarchy.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// a rotation, scale and translation, far from identity in every element
+static Matrix RandomLocal( std::mt19937& rng ) {
+    std::uniform_real_distribution< f32 > unit( -1.0f, 1.0f );
+    const Matrix rotation = MatrixRotationAxis( Float3( unit( rng ), unit( rng ), unit( rng ) + 2.0f ), unit( rng ) * MATH_PI );
+    const f32 scale = 0.8f + 0.2f * unit( rng );
+    return MatrixMultiply( MatrixMultiply( MatrixScaling( scale, scale, scale ), rotation ), MatrixTranslation( unit( rng ), unit( rng ), unit( rng ) ) );
+}
+
+// world matrices by id with the scalar multiply; parents come before their children
+static std::vector< Matrix > ExpectedWorlds( const TransformHierarchy& hierarchy ) {
+    std::vector< Matrix > world( hierarchy.GetNodeCount() );
+    for ( u32 node = 0; node < hierarchy.GetNodeCount(); ++node ) {
+        const u32 parent = hierarchy.GetParent( node );
+        world[ node ] = parent != TRANSFORM_ROOT ? MatrixMultiply( hierarchy.GetLocal( node ), world[ parent ] ) : hierarchy.GetLocal( node );
+    }
+    return world;
+}
+
+//
+static u32 CountWrongWorlds( const TransformHierarchy& hierarchy ) {
+    const std::vector< Matrix > expected = ExpectedWorlds( hierarchy );
+    u32 wrong = 0;
+    for ( u32 node = 0; node < hierarchy.GetNodeCount(); ++node ) {
+        const f32* a = &hierarchy.GetWorld( node ).r[ 0 ].x;
+        const f32* b = &expected[ node ].r[ 0 ].x;
+        bool match = true;
+        for ( u32 k = 0; k < 16; ++k )
+            match = match && std::fabs( a[ k ] - b[ k ] ) <= 1e-4f * ( 1.0f + std::fabs( b[ k ] ) );
+        wrong += match ? 0 : 1;
+    }
+    return wrong;
+}
+
+// random trees: every node hangs under a random earlier node of its tree
+static void AddForest( TransformHierarchy& hierarchy, u32 trees, u32 nodesPerTree, std::mt19937& rng ) {
+    for ( u32 t = 0; t < trees; ++t ) {
+        const u32 root = hierarchy.AddNode( TRANSFORM_ROOT, RandomLocal( rng ) );
+        for ( u32 i = 1; i < nodesPerTree; ++i )
+            hierarchy.AddNode( root + ( u32 )( rng() % i ), RandomLocal( rng ) );
+    }
+}
+
+// a forest built in two parts, with trees and subtrees added to the first
+// after it was updated, matches the scalar recompute on any thread count
+TEST( TransformHierarchyMatchesScalarRecompute ) {
+    std::mt19937 rng( 5 );
+    TransformHierarchy hierarchy;
+    AddForest( hierarchy, 37, 61, rng );
+    CHECK( hierarchy.Update() == hierarchy.GetNodeCount() );
+    CHECK( CountWrongWorlds( hierarchy ) == 0 );
+
+    JobSystem jobs( 3 );
+    AddForest( hierarchy, 11, 203, rng );
+    const u32 before = hierarchy.GetNodeCount();
+    for ( u32 i = 0; i < 300; ++i )
+        hierarchy.AddNode( ( u32 )( rng() % before ), RandomLocal( rng ) );
+    CHECK( hierarchy.Update( &jobs ) == hierarchy.GetNodeCount() - 37 * 61 );
+    CHECK( CountWrongWorlds( hierarchy ) == 0 );
+    CHECK( hierarchy.Update( &jobs ) == 0 );
+
+    for ( u32 i = 0; i < 500; ++i )
+        hierarchy.SetLocal( ( u32 )( rng() % hierarchy.GetNodeCount() ), RandomLocal( rng ) );
+    hierarchy.Update( &jobs );
+    CHECK( CountWrongWorlds( hierarchy ) == 0 );
+}
+
+// only the changed nodes and their descendants are recomputed, once each
+// even when a changed node lies below another, and the others keep their
+// world matrices bit for bit
+TEST( TransformHierarchyUpdatesOnlyDirtySubtrees ) {
+    std::mt19937 rng( 9 );
+    TransformHierarchy hierarchy;
+    AddForest( hierarchy, 20, 150, rng );
+    hierarchy.Update();
+    std::vector< Matrix > before( hierarchy.GetNodeCount() );
+    for ( u32 node = 0; node < hierarchy.GetNodeCount(); ++node )
+        before[ node ] = hierarchy.GetWorld( node );
+
+    std::vector< u8 > changed( hierarchy.GetNodeCount(), 0 );
+    for ( u32 i = 0; i < 40; ++i ) {
+        const u32 node = ( u32 )( rng() % hierarchy.GetNodeCount() );
+        changed[ node ] = 1;
+        hierarchy.SetLocal( node, RandomLocal( rng ) );
+        hierarchy.SetLocal( node, RandomLocal( rng ) );
+    }
+    const u32 parent = hierarchy.GetParent( hierarchy.GetNodeCount() - 1 );
+    changed[ parent ] = changed[ hierarchy.GetNodeCount() - 1 ] = 1;
+    hierarchy.SetLocal( parent, RandomLocal( rng ) );
+    hierarchy.SetLocal( hierarchy.GetNodeCount() - 1, RandomLocal( rng ) );
+
+    // a node is affected when it or an ancestor changed
+    u32 affected = 0;
+    std::vector< u8 > dirty( hierarchy.GetNodeCount(), 0 );
+    for ( u32 node = 0; node < hierarchy.GetNodeCount(); ++node ) {
+        const u32 up = hierarchy.GetParent( node );
+        dirty[ node ] = changed[ node ] != 0 || ( up != TRANSFORM_ROOT && dirty[ up ] != 0 ) ? 1 : 0;
+        affected += dirty[ node ];
+    }
+
+    JobSystem jobs( 4 );
+    CHECK( hierarchy.Update( &jobs ) == affected );
+    CHECK( CountWrongWorlds( hierarchy ) == 0 );
+    u32 moved = 0;
+    for ( u32 node = 0; node < hierarchy.GetNodeCount(); ++node ) {
+        if ( dirty[ node ] == 0 )
+            moved += memcmp( &before[ node ], &hierarchy.GetWorld( node ), sizeof( Matrix ) ) != 0 ? 1 : 0;
+    }
+    CHECK( moved == 0 );
+    CHECK( hierarchy.Update( &jobs ) == 0 );
+}
@@ -0,0 +1,42 @@
+#include "test.h"
+
+#include "upload_ring.h"
+
+//
+TEST( UploadRingAlignsAndAppends ) {
+    UploadRing ring;
+    ring.Reset( 4096 );
+
+    UploadAllocation a, b;
+    CHECK( ring.Allocate( 128, a ) );
+    CHECK( ring.Allocate( 300, b ) );
+    CHECK( a.m_offset == 0 && a.m_size == 256 );
+    CHECK( b.m_offset == 256 && b.m_size == 512 );
+    CHECK( b.m_offset % UPLOAD_ALIGNMENT == 0 );
+    CHECK( ring.GetHead() == 768 );
+}
+
+// the first map of a dynamic buffer and every wrap must discard, appends must not
+TEST( UploadRingDiscardsOnlyOnWrap ) {
+    UploadRing ring;
+    ring.Reset( 1024 );
+
+    UploadAllocation allocation;
+    CHECK( ring.Allocate( 256, allocation ) && allocation.m_discard );
+    CHECK( ring.Allocate( 512, allocation ) && !allocation.m_discard && allocation.m_offset == 256 );
+    CHECK( ring.Allocate( 256, allocation ) && !allocation.m_discard && allocation.m_offset == 768 );
+    CHECK( ring.Allocate( 16, allocation ) && allocation.m_discard && allocation.m_offset == 0 );
+    CHECK( ring.Allocate( 1024, allocation ) && allocation.m_discard && allocation.m_offset == 0 );
+}
+
+//
+TEST( UploadRingRejectsOversizedAllocations ) {
+    UploadRing ring;
+    ring.Reset( 1000 );     // rounded down to 768
+
+    UploadAllocation allocation;
+    CHECK( ring.GetCapacity() == 768 );
+    CHECK( !ring.Allocate( 769, allocation ) );
+    CHECK( !ring.Allocate( 0, allocation ) );
+    CHECK( ring.Allocate( 768, allocation ) );
+}
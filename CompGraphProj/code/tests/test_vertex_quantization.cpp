@@ -0,0 +1,153 @@
+#include "test.h"
+
+#include "vertex_quantization.h"
+#include "vertex_stage.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const char* const MeshPath = "compgraph_test_mesh.cgqm";
+
+// exact values survive, everything else lands within half a step, overflow saturates
+TEST( HalfAndSnorm16RoundTrip ) {
+    const f32 exact[] = { 0.0f, 1.0f, -2.5f, 0.5f, 65504.0f, 6.103515625e-05f, 5.9604644775390625e-08f };
+    for ( f32 v : exact )
+        CHECK( HalfToFloat( FloatToHalf( v ) ) == v );
+    CHECK( FloatToHalf( 65520.0f ) == 0x7C00 );
+    CHECK( FloatToHalf( -1.0f ) == 0xBC00 );
+    // ties go to even: 1 + 2^-11 sits between 1 and 1 + 2^-10
+    CHECK( FloatToHalf( 1.00048828125f ) == 0x3C00 );
+
+    std::mt19937 rng( 3 );
+    std::uniform_real_distribution< f32 > dist( -1.0f, 1.0f );
+    for ( u32 i = 0; i < 10000; ++i ) {
+        const f32 v = dist( rng );
+        const f32 half = HalfToFloat( FloatToHalf( v ) );
+        CHECK( fabsf( half - v ) <= fabsf( v ) * ( 1.0f / 2048.0f ) + 3e-8f );
+        CHECK( fabsf( Snorm16ToFloat( FloatToSnorm16( v ) ) - v ) <= 0.5f / 32767.0f + 1e-7f );
+    }
+    CHECK( FloatToSnorm16( 2.0f ) == 32767 );
+    CHECK( FloatToSnorm16( -2.0f ) == -32767 );
+}
+
+// octahedral normals stay within a fraction of a degree, on both hemispheres and the axes
+TEST( OctahedralNormalsRoundTrip ) {
+    std::mt19937 rng( 5 );
+    std::normal_distribution< f32 > dist;
+    std::vector< Float3 > normals = { Float3( 0, 0, 1 ), Float3( 0, 0, -1 ), Float3( 1, 0, 0 ), Float3( 0, -1, 0 ) };
+    for ( u32 i = 0; i < 10000; ++i )
+        normals.push_back( Vector3Normalize( Float3( dist( rng ), dist( rng ), dist( rng ) ) ) );
+    for ( const Float3& n : normals ) {
+        const Float3 decoded = OctDecodeNormal( OctEncodeNormal( n ) );
+        CHECK( Vector3Dot( n, decoded ) > 0.99999f );
+    }
+    CHECK( UnpackUnorm8( PackUnorm8( Float4( 1.0f, 0.0f, 0.2f, 0.6f ) ) ).x == 1.0f );
+    CHECK( PackUnorm8( UnpackUnorm8( 0x80FF4001 ) ) == 0x80FF4001 );
+}
+
+// the stride is what the layout says, positions decode within the encoding's
+// step of the bounds, colors are RGBA8 and the sphere's normals point outwards
+TEST( QuantizeMeshKeepsGeometry ) {
+    MeshData sphere;
+    GenerateSphereMesh( sphere, 16, 32 );
+    for ( Vertex& v : sphere.m_vertices )
+        v.m_pos = Float3( v.m_pos.x * 3.0f + 10.0f, v.m_pos.y, v.m_pos.z * 0.5f - 4.0f );
+    const Mesh mesh = sphere.GetMesh();
+
+    const f32 tolerance[ POSITION_ENCODING_COUNT ] = { 0.0f, 3.0f / 2048.0f, 3.0f / 65534.0f + 1e-6f };
+    for ( u32 e = 0; e < POSITION_ENCODING_COUNT; ++e ) {
+        QuantizeDesc desc;
+        desc.m_position = ( PositionEncoding )e;
+        desc.m_normals = true;
+        QuantizedMesh quantized;
+        QuantizeMesh( mesh, desc, quantized );
+        const VertexStream stream = quantized.GetStream();
+        CHECK( stream.m_stride == quantized.m_stride && stream.m_elementCount == 3 );
+        CHECK( quantized.m_vertices.size() == mesh.m_vertexCount * ( size_t )quantized.m_stride );
+        CHECK( quantized.m_indices.size() == mesh.m_indexCount );
+        // 3 units is the largest extent, so the error is relative to it
+        for ( u32 i = 0; i < mesh.m_vertexCount; ++i ) {
+            const Float3 p = quantized.GetPosition( i );
+            const Float3& q = mesh.m_vertices[ i ].m_pos;
+            CHECK( fabsf( p.x - q.x ) <= tolerance[ e ] * 3.0f + 1e-5f );
+            CHECK( fabsf( p.y - q.y ) <= tolerance[ e ] + 1e-5f );
+            CHECK( fabsf( p.z - q.z ) <= tolerance[ e ] * 0.5f + 1e-5f );
+            CHECK( quantized.GetColor( i ) == PackUnorm8( mesh.m_vertices[ i ].m_color ) );
+
+            // the first and last pole vertex only touch degenerate triangles and have no normal
+            if ( fabsf( q.y ) == 1.0f )
+                continue;
+            u32 normal;
+            memcpy( &normal, &quantized.m_vertices[ i * quantized.m_stride + GetPositionSize( desc.m_position ) + 4 ], sizeof( normal ) );
+            const Float3 n = OctDecodeNormal( normal );
+            const Float3 outward( ( q.x - 10.0f ) / 3.0f, q.y, ( q.z + 4.0f ) * 2.0f );
+            CHECK( Vector3Dot( n, outward ) > 0.0f );
+        }
+    }
+    CHECK( GetQuantizedStride( POSITION_SNORM16, false ) * 2 < ( u32 )sizeof( Vertex ) );
+}
+
+// half and snorm16 streams decode in SIMD to the same bits as one vertex at a time
+TEST( QuantizedVertexStageMatchesScalar ) {
+    std::mt19937 rng( 11 );
+    std::uniform_real_distribution< f32 > dist( -4.0f, 4.0f );
+    std::vector< Vertex > vertices( 1027 );
+    std::vector< u32 > indices( 3, 0 );
+    for ( Vertex& v : vertices )
+        v.m_pos = Float3( dist( rng ), dist( rng ) + 1.0f, dist( rng ) * 0.25f );
+
+    Matrix model = MatrixRotationAxis( Float3( 1, 2, 3 ), 1.3f );
+    model.r[ 3 ] = Float4( 0.5f, -0.25f, 2.0f, 1.0f );
+    for ( PositionEncoding encoding : { POSITION_HALF, POSITION_SNORM16 } ) {
+        QuantizeDesc desc;
+        desc.m_position = encoding;
+        QuantizedMesh quantized;
+        QuantizeMesh( Mesh{ vertices.data(), ( u32 )vertices.size(), indices.data(), 3 }, desc, quantized );
+
+        PositionStreams in;
+        in.Assign( quantized );
+        ClipStreams simd, scalar;
+        simd.Resize( in.m_count );
+        scalar.Resize( in.m_count );
+        RunVertexStage( in, 0, in.m_count, model, simd );
+        RunVertexStageScalar( in, 0, in.m_count, model, scalar );
+
+        const size_t bytes = in.m_count * sizeof( f32 );
+        CHECK( memcmp( simd.m_x.data(), scalar.m_x.data(), bytes ) == 0 );
+        CHECK( memcmp( simd.m_y.data(), scalar.m_y.data(), bytes ) == 0 );
+        CHECK( memcmp( simd.m_z.data(), scalar.m_z.data(), bytes ) == 0 );
+        CHECK( memcmp( simd.m_w.data(), scalar.m_w.data(), bytes ) == 0 );
+
+        // and close to transforming the float positions
+        for ( u32 i = 0; i < in.m_count; ++i ) {
+            const Float4 expected = TransformPoint( vertices[ i ].m_pos, model );
+            CHECK( fabsf( simd.m_x[ i ] - expected.x / 1.6f ) < 0.01f );
+            CHECK( fabsf( simd.m_w[ i ] - expected.w ) < 0.01f );
+        }
+    }
+}
+
+// .cgqm files read back as written, truncated ones are rejected
+TEST( QuantizedMeshFileRoundTrips ) {
+    QuantizeDesc desc;
+    desc.m_position = POSITION_HALF;
+    desc.m_normals = true;
+    QuantizedMesh written;
+    QuantizeMesh( GetCubeMesh(), desc, written );
+    CHECK( WriteQuantizedMesh( MeshPath, written ) );
+
+    QuantizedMesh read;
+    CHECK( ReadQuantizedMesh( MeshPath, read ) );
+    CHECK( read.m_position == POSITION_HALF && read.m_normals && read.m_stride == written.m_stride );
+    CHECK( read.m_vertices == written.m_vertices && read.m_indices == written.m_indices );
+    CHECK( memcmp( &read.m_constants, &written.m_constants, sizeof( MeshConstants ) ) == 0 );
+
+    written.m_indices.pop_back();
+    written.m_vertexCount++;
+    CHECK( WriteQuantizedMesh( MeshPath, written ) );
+    CHECK( !ReadQuantizedMesh( MeshPath, read ) );
+    remove( MeshPath );
+    CHECK( !ReadQuantizedMesh( MeshPath, read ) );
+}
@@ -0,0 +1,35 @@
+#include "shader_cache_d3d11.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// offline shader build: compiles every variant of the D3D11 backend and
+// writes them as one shader pack, so the app starts without D3DCompile.
+// run it from the directory that holds the .hlsl files, like the app.
+//
+//   build_shader_pack [output, shaders.pack by default]
+int main( int argc, char** argv ) {
+    const char* output = argc > 1 ? argv[ 1 ] : "shaders.pack";
+
+    // start from nothing, a stale pack must not survive a rebuild
+    remove( output );
+    D3D11ShaderCache cache;
+    cache.Open( output );
+    for ( u32 id = 0; id < SHADER_VARIANT_COUNT; ++id ) {
+        ShaderBytecode bytecode;
+        const HRESULT result = cache.GetBytecode( ( ShaderVariantId )id, bytecode );
+        const ShaderVariant& variant = GetShaderVariant( ( ShaderVariantId )id );
+        if ( FAILED( result ) ) {
+            printf( "%s (%s): compile failed, 0x%08lx\n", variant.m_file, variant.m_profile, ( unsigned long )result );
+            return EXIT_FAILURE;
+        }
+        printf( "%s (%s%s): %zu bytes\n", variant.m_file, variant.m_profile, variant.m_defines != nullptr ? ", defines" : "", bytecode.m_size );
+    }
+
+    if ( !cache.Save() ) {
+        printf( "could not write %s\n", output );
+        return EXIT_FAILURE;
+    }
+    printf( "wrote %u shaders to %s\n", ( u32 )SHADER_VARIANT_COUNT, output );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "mesh_import.h"
+#include "mesh_optimize.h"
+#include "vertex_quantization.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// import-time mesh conversion: quantizes a mesh into one of the compact
+// vertex formats and writes it as .cgqm, which the app draws with --mesh.
+// prints the vertex buffer size before and after and the largest position
+// error the encoding introduced.
+//
+//   quantize_mesh [--format float32|half|snorm16] [--normals] [--optimize] (--cube | --sphere RINGS SEGMENTS | --input FILE) OUTPUT
+//
+// --input takes .obj, .gltf and .glb. --optimize reorders indices and vertices
+// with OptimizeMesh first and prints the vertex cache statistics before and after.
+int main( int argc, char** argv ) {
+    QuantizeDesc desc;
+    const char* output = nullptr;
+    bool sphere = false;
+    u32 rings = 0, segments = 0;
+    bool cube = false;
+    const char* input = nullptr;
+    bool optimize = false;
+    for ( i32 i = 1; i < argc; ++i ) {
+        if ( strcmp( argv[ i ], "--format" ) == 0 && i + 1 < argc ) {
+            if ( !ParsePositionEncoding( argv[ ++i ], desc.m_position ) ) {
+                printf( "unknown format %s\n", argv[ i ] );
+                return EXIT_FAILURE;
+            }
+        } else if ( strcmp( argv[ i ], "--normals" ) == 0 ) {
+            desc.m_normals = true;
+        } else if ( strcmp( argv[ i ], "--optimize" ) == 0 ) {
+            optimize = true;
+        } else if ( strcmp( argv[ i ], "--cube" ) == 0 ) {
+            cube = true;
+        } else if ( strcmp( argv[ i ], "--sphere" ) == 0 && i + 2 < argc ) {
+            sphere = true;
+            rings = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+            segments = ( u32 )strtoul( argv[ ++i ], nullptr, 10 );
+        } else if ( strcmp( argv[ i ], "--input" ) == 0 && i + 1 < argc ) {
+            input = argv[ ++i ];
+        } else {
+            output = argv[ i ];
+        }
+    }
+    if ( output == nullptr || ( cube ? 1 : 0 ) + ( sphere ? 1 : 0 ) + ( input != nullptr ? 1 : 0 ) != 1 ) {
+        printf( "usage: quantize_mesh [--format float32|half|snorm16] [--normals] [--optimize] (--cube | --sphere RINGS SEGMENTS | --input FILE) OUTPUT\n" );
+        return EXIT_FAILURE;
+    }
+
+    MeshData source;
+    if ( cube ) {
+        const Mesh& cubeMesh = GetCubeMesh();
+        source.m_vertices.assign( cubeMesh.m_vertices, cubeMesh.m_vertices + cubeMesh.m_vertexCount );
+        source.m_indices.assign( cubeMesh.m_indices, cubeMesh.m_indices + cubeMesh.m_indexCount );
+    }
+    if ( sphere )
+        GenerateSphereMesh( source, rings, segments );
+    if ( input != nullptr && !ImportMeshFile( input, source ) ) {
+        printf( "could not import %s\n", input );
+        return EXIT_FAILURE;
+    }
+    if ( optimize ) {
+        const MeshOptimizeStats stats = OptimizeMesh( source );
+        printf( "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%u-entry FIFO)\n", stats.m_before.m_acmr, stats.m_after.m_acmr,
+            stats.m_before.m_atvr, stats.m_after.m_atvr, VERTEX_CACHE_SIZE );
+    }
+    const Mesh mesh = source.GetMesh();
+    if ( mesh.m_vertexCount == 0 || mesh.m_indexCount == 0 ) {
+        printf( "empty mesh\n" );
+        return EXIT_FAILURE;
+    }
+
+    QuantizedMesh quantized;
+    QuantizeMesh( mesh, desc, quantized );
+
+    f32 maxError = 0.0f;
+    for ( u32 i = 0; i < mesh.m_vertexCount; ++i ) {
+        const Float3 p = quantized.GetPosition( i );
+        const Float3& q = mesh.m_vertices[ i ].m_pos;
+        const f32 error = fmaxf( fabsf( p.x - q.x ), fmaxf( fabsf( p.y - q.y ), fabsf( p.z - q.z ) ) );
+        maxError = error > maxError ? error : maxError;
+    }
+
+    if ( !WriteQuantizedMesh( output, quantized ) ) {
+        printf( "could not write %s\n", output );
+        return EXIT_FAILURE;
+    }
+    const u64 before = ( u64 )mesh.m_vertexCount * sizeof( Vertex );
+    const u64 after = quantized.m_vertices.size();
+    printf( "%u vertices, %u triangles, %s%s\n", mesh.m_vertexCount, mesh.m_indexCount / 3,
+        GetPositionEncodingName( desc.m_position ), desc.m_normals ? " + normals" : "" );
+    printf( "vertex buffer: %llu -> %llu bytes (%u -> %u per vertex, %.2fx)\n", ( unsigned long long )before, ( unsigned long long )after,
+        ( u32 )sizeof( Vertex ), quantized.m_stride, ( f64 )before / ( f64 )after );
+    printf( "max position error: %g\n", maxError );
+    printf( "wrote %s\n", output );
+    return EXIT_SUCCESS;
+}